@@ -21,9 +21,7 @@ using namespace Z3D;
 
 
 
-#ifdef RENDER_TEAPOT
 #include "teapotdata.h"
-#endif
 
 
 inline
@@ -33,6 +31,68 @@ double clamp(const double& lo, const double& hi, const double& v)
 }
 
 
+// [comment]
+// Compute the position of a point along a Bezier curve at t [0:1]
+// [/comment]
+Vec3d evalBezierCurve(const Vec3d* P, const double& t)
+{
+    double b0 = (1 - t) * (1 - t) * (1 - t);
+    double b1 = 3 * t * (1 - t) * (1 - t);
+    double b2 = 3 * t * t * (1 - t);
+    double b3 = t * t * t;
+
+    return P[0] * b0 + P[1] * b1 + P[2] * b2 + P[3] * b3;
+}
+
+Vec3d evalBezierPatch(const Vec3d* controlPoints, const double& u, const double& v)
+{
+    Vec3d uCurve[4];
+    for (int i = 0; i < 4; ++i)
+        uCurve[i] = evalBezierCurve(controlPoints + 4 * i, u);
+
+    return evalBezierCurve(uCurve, v);
+}
+
+Vec3d derivBezier(const Vec3d* P, const double& t)
+{
+    return -3 * (1 - t) * (1 - t) * P[0] +
+        (3 * (1 - t) * (1 - t) - 6 * t * (1 - t)) * P[1] +
+        (6 * t * (1 - t) - 3 * t * t) * P[2] +
+        3 * t * t * P[3];
+}
+
+// [comment]
+// Compute the derivative of a point on Bezier patch along the u parametric direction
+// [/comment]
+Vec3d dUBezier(const Vec3d* controlPoints, const double& u, const double& v)
+{
+    Vec3d P[4];
+    Vec3d vCurve[4];
+    for (int i = 0; i < 4; ++i) {
+        P[0] = controlPoints[i];
+        P[1] = controlPoints[4 + i];
+        P[2] = controlPoints[8 + i];
+        P[3] = controlPoints[12 + i];
+        vCurve[i] = evalBezierCurve(P, v);
+    }
+
+    return derivBezier(vCurve, u);
+}
+
+// [comment]
+// Compute the derivative of a point on Bezier patch along the v parametric direction
+// [/comment]
+Vec3d dVBezier(const Vec3d* controlPoints, const double& u, const double& v)
+{
+    Vec3d uCurve[4];
+    for (int i = 0; i < 4; ++i) {
+        uCurve[i] = evalBezierCurve(controlPoints + 4 * i, u);
+    }
+
+    return derivBezier(uCurve, v);
+}
+
+
 #ifdef RENDER_TEAPOT
 
 static const double kInfinity = FLT_MAX;
@@ -375,67 +435,6 @@ void render(
     auto passedTime = std::chrono::duration<double, std::milli>(timeEnd - timeStart).count();
 }
 
-// [comment]
-// Compute the position of a point along a Bezier curve at t [0:1]
-// [/comment]
-Vec3d evalBezierCurve(const Vec3d* P, const double& t)
-{
-    double b0 = (1 - t) * (1 - t) * (1 - t);
-    double b1 = 3 * t * (1 - t) * (1 - t);
-    double b2 = 3 * t * t * (1 - t);
-    double b3 = t * t * t;
-
-    return P[0] * b0 + P[1] * b1 + P[2] * b2 + P[3] * b3;
-}
-
-Vec3d evalBezierPatch(const Vec3d* controlPoints, const double& u, const double& v)
-{
-    Vec3d uCurve[4];
-    for (int i = 0; i < 4; ++i)
-        uCurve[i] = evalBezierCurve(controlPoints + 4 * i, u);
-
-    return evalBezierCurve(uCurve, v);
-}
-
-Vec3d derivBezier(const Vec3d* P, const double& t)
-{
-    return -3 * (1 - t) * (1 - t) * P[0] +
-        (3 * (1 - t) * (1 - t) - 6 * t * (1 - t)) * P[1] +
-        (6 * t * (1 - t) - 3 * t * t) * P[2] +
-        3 * t * t * P[3];
-}
-
-// [comment]
-// Compute the derivative of a point on Bezier patch along the u parametric direction
-// [/comment]
-Vec3d dUBezier(const Vec3d* controlPoints, const double& u, const double& v)
-{
-    Vec3d P[4];
-    Vec3d vCurve[4];
-    for (int i = 0; i < 4; ++i) {
-        P[0] = controlPoints[i];
-        P[1] = controlPoints[4 + i];
-        P[2] = controlPoints[8 + i];
-        P[3] = controlPoints[12 + i];
-        vCurve[i] = evalBezierCurve(P, v);
-    }
-
-    return derivBezier(vCurve, u);
-}
-
-// [comment]
-// Compute the derivative of a point on Bezier patch along the v parametric direction
-// [/comment]
-Vec3d dVBezier(const Vec3d* controlPoints, const double& u, const double& v)
-{
-    Vec3d uCurve[4];
-    for (int i = 0; i < 4; ++i) {
-        uCurve[i] = evalBezierCurve(controlPoints + 4 * i, u);
-    }
-
-    return derivBezier(uCurve, v);
-}
-
 // [comment]
 // Generate a poly-mesh Utah teapot out of Bezier patches
 // [/comment]
@@ -926,6 +925,10 @@ Z3DTestWin::Z3DTestWin()
     mnRenderSize = 256;
     mbControlPanelEnabled = true;
 
+    mnTeapotDivisions = 16;
+    mbRenderTeapotMesh = false;
+    mbTextureTeapot = false;
+
     mIdleSleepMS = 16;
 
     mLastTimeStamp = gTimer.GetMSSinceEpoch();
@@ -1018,6 +1021,8 @@ bool Z3DTestWin::Init()
     UpdateSphereCount();
 #endif
 
+    BuildTeapotMesh();
+
     if (mbControlPanelEnabled)
     {
 
@@ -1073,9 +1078,17 @@ bool Z3DTestWin::Init()
         pToggle = pCP->Toggle("renderspheres", &mbRenderSpheres, "Render Spheres");
         pToggle->msWinGroup = "rendermode";
 
+        pToggle = pCP->Toggle("renderteapot", &mbRenderTeapotMesh, "Render Teapot");
+        pToggle->msWinGroup = "rendermode";
+
         pCP->Toggle("outersphere", &mbOuterSphere, "Outer Sphere", sUpdateSphereCountMsg, sUpdateSphereCountMsg);
         pCP->Toggle("centersphere", &mbCenterSphere, "Center Sphere", sUpdateSphereCountMsg, sUpdateSphereCountMsg);
 
+        pCP->AddSpace(16);
+        pCP->Toggle("textureteapot", &mbTextureTeapot, "Texture Teapot");
+        pCP->Caption("teapotdetail", "Teapot Detail");
+        pCP->Slider("teapotdetail", &mnTeapotDivisions, 1, 128, 1, 0.25, ZMessage("updateteapot", this), true, false);
+
         ChildAdd(pCP);
     }
     else
@@ -1174,91 +1187,148 @@ void multPointMatrix(const Vec3d& in, Vec3d& out, const Matrix44d& M)
 
 
 
-bool Z3DTestWin::Process()
+// Like multPointMatrix but keeps w, for ZRasterizer::RasterizeMesh
+void multPointMatrixClip(const Vec3d& in, ZRasterizer::ClipVertex& out, const Matrix44d& M)
 {
-    return true;
+    out.x = (float)(in.x * M[0][0] + in.y * M[1][0] + in.z * M[2][0] + M[3][0]);
+    out.y = (float)(in.x * M[0][1] + in.y * M[1][1] + in.z * M[2][1] + M[3][1]);
+    out.z = (float)(in.x * M[0][2] + in.y * M[1][2] + in.z * M[2][2] + M[3][2]);
+    out.w = (float)(in.x * M[0][3] + in.y * M[1][3] + in.z * M[2][3] + M[3][3]);
 }
 
-void Z3DTestWin::RenderPoly(vector<Vec3d>& worldVerts, Matrix44d& mtxProjection, Matrix44d& mtxWorldToCamera, uint32_t nCol)
-{
-    tColorVertexArray screenVerts;
-    screenVerts.resize(worldVerts.size());
 
 
 
+bool Z3DTestWin::Process()
+{
+    return true;
+}
 
+// Projected -1..1 spans mnRenderSize * 10 pixels either side of the window center
+ZRect Z3DTestWin::MeshViewport()
+{
+    int64_t nHalf = mnRenderSize * 10;
+    ZPoint center(mAreaLocal.Width() / 2, mAreaLocal.Height() / 2);
+    return ZRect(center.x - nHalf, center.y - nHalf, center.x + nHalf, center.y + nHalf);
+}
+
+void Z3DTestWin::RenderPoly(vector<Vec3d>& worldVerts, Matrix44d& mtxProjection, Matrix44d& mtxWorldToCamera, uint32_t nCol)
+{
+    Matrix44d mtxWorldToClip = mtxWorldToCamera * mtxProjection;
 
+    ZRasterizer::tClipVertexArray clipVerts;
+    clipVerts.resize(worldVerts.size());
     for (int i = 0; i < worldVerts.size(); i++)
     {
-        Vec3d v = worldVerts[i];
-
-        Vec3d vertCamera;
-        Vec3d vertProjected;
-
-        multPointMatrix(v, vertCamera, mtxWorldToCamera);
-        multPointMatrix(vertCamera, vertProjected, mtxProjection);
-
-        /*        if (vertProjected.x < -1 || vertProjected.x > 1 || vertProjected.y < -1 || vertProjected.y > 1)
-                    continue;*/
-
-        screenVerts[i].x = (double)(mAreaLocal.Width() / 2 + (int64_t)(vertProjected.x * mnRenderSize * 10));
-        screenVerts[i].y = (double)(mAreaLocal.Height() / 2 + (int64_t)(vertProjected.y * mnRenderSize * 10));
-
-        screenVerts[i].mColor = nCol;
+        multPointMatrixClip(worldVerts[i], clipVerts[i], mtxWorldToClip);
+        clipVerts[i].mColor = nCol;
     }
 
-    Vec3d planeX(screenVerts[1].x - screenVerts[0].x, screenVerts[1].y - screenVerts[0].y, 1);
-    Vec3d planeY(screenVerts[0].x - screenVerts[3].x, screenVerts[0].y - screenVerts[3].y, 1);
-    Vec3d normal = planeX.crossProduct(planeY);
-    if (normal.z > 0)
-        return;
+    vector<uint32_t> indices;
+    for (uint32_t i = 2; i < worldVerts.size(); i++)
+        indices.insert(indices.end(), { 0, i - 1, i });
 
-    gRasterizer.Rasterize(mpSurface.get(), screenVerts);
+    // culling and depth are handled by the rasterizer
+    gRasterizer.RasterizeMesh(mpSurface.get(), MeshViewport(), clipVerts, indices);
 }
 
 void Z3DTestWin::RenderPoly(vector<Vec3d>& worldVerts, Matrix44d& mtxProjection, Matrix44d& mtxWorldToCamera, tZBufferPtr pTexture)
 {
-    tUVVertexArray screenVerts;
-    screenVerts.resize(worldVerts.size());
+    Matrix44d mtxWorldToClip = mtxWorldToCamera * mtxProjection;
 
+    ZRasterizer::tClipVertexArray clipVerts;
+    clipVerts.resize(worldVerts.size());
     for (int i = 0; i < worldVerts.size(); i++)
-    {
-        Vec3d v = worldVerts[i];
+        multPointMatrixClip(worldVerts[i], clipVerts[i], mtxWorldToClip);
 
-        Vec3d vertCamera;
-        Vec3d vertProjected;
+    clipVerts[0].u = 0.0;
+    clipVerts[0].v = 0.0;
 
-        multPointMatrix(v, vertCamera, mtxWorldToCamera);
-        multPointMatrix(vertCamera, vertProjected, mtxProjection);
+    clipVerts[1].u = 1.0;
+    clipVerts[1].v = 0.0;
 
-        /*        if (vertProjected.x < -1 || vertProjected.x > 1 || vertProjected.y < -1 || vertProjected.y > 1)
-                    continue;*/
+    clipVerts[2].u = 1.0;
+    clipVerts[2].v = 1.0;
 
-        screenVerts[i].x = (double)(mAreaLocal.Width() / 2 + (int64_t)(vertProjected.x * mnRenderSize * 10));
-        screenVerts[i].y = (double)(mAreaLocal.Height() / 2 + (int64_t)(vertProjected.y * mnRenderSize * 10));
-    }
+    clipVerts[3].u = 0.0;
+    clipVerts[3].v = 1.0;
 
-    Vec3d planeX(screenVerts[1].x - screenVerts[0].x, screenVerts[1].y - screenVerts[0].y, 1);
-    Vec3d planeY(screenVerts[0].x - screenVerts[3].x, screenVerts[0].y - screenVerts[3].y, 1);
-    Vec3d normal = planeX.crossProduct(planeY);
-    if (normal.z > 0)
-        return;
+    vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+    gRasterizer.RasterizeMesh(mpSurface.get(), MeshViewport(), clipVerts, indices, pTexture.get());
+}
 
+void Z3DTestWin::BuildTeapotMesh()
+{
+    uint32_t nDivs = (uint32_t)mnTeapotDivisions;
+    uint32_t nPatchVerts = (nDivs + 1) * (nDivs + 1);
+    mTeapotPoints.resize(kTeapotNumPatches * nPatchVerts);
+    mTeapotNormals.resize(kTeapotNumPatches * nPatchVerts);
+    mTeapotVerts.resize(kTeapotNumPatches * nPatchVerts);
+    mTeapotIndices.clear();
+    mTeapotIndices.reserve(kTeapotNumPatches * nDivs * nDivs * 6);
 
-    screenVerts[0].u = 0.0;
-    screenVerts[0].v = 0.0;
+    Vec3d controlPoints[16];
+    for (uint32_t np = 0; np < kTeapotNumPatches; np++)
+    {
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const float* pVert = teapotVertices[teapotPatches[np][i] - 1];
+            controlPoints[i] = Vec3d(pVert[0], pVert[1], pVert[2]);
+        }
 
-    screenVerts[1].u = 1.0;
-    screenVerts[1].v = 0.0;
+        uint32_t nBase = np * nPatchVerts;
+        for (uint32_t j = 0, k = nBase; j <= nDivs; j++)
+        {
+            double v = j / (double)nDivs;
+            for (uint32_t i = 0; i <= nDivs; i++, k++)
+            {
+                double u = i / (double)nDivs;
+                mTeapotPoints[k] = evalBezierPatch(controlPoints, u, v);
+                mTeapotNormals[k] = dUBezier(controlPoints, u, v).crossProduct(dVBezier(controlPoints, u, v)).normalize();
+                mTeapotVerts[k].u = (float)u;
+                mTeapotVerts[k].v = (float)v;
+            }
+        }
 
-    screenVerts[2].u = 1.0;
-    screenVerts[2].v = 1.0;
+        // two triangles per grid quad, the same winding as the cube sides
+        for (uint32_t j = 0; j < nDivs; j++)
+        {
+            for (uint32_t i = 0; i < nDivs; i++)
+            {
+                uint32_t n = nBase + j * (nDivs + 1) + i;
+                mTeapotIndices.insert(mTeapotIndices.end(), { n, n + 1, n + nDivs + 2, n, n + nDivs + 2, n + nDivs + 1 });
+            }
+        }
+    }
+}
 
-    screenVerts[3].u = 0.0;
-    screenVerts[3].v = 1.0;
+void Z3DTestWin::RenderTeapotMesh(Matrix44d& mtxProjection, Matrix44d& mtxWorldToCamera)
+{
+    // patches are z up with the base at 0, so center and stand it up before spinning
+    Matrix44d mtxCenter;
+    setTranslationMatrix(0.0, 0.0, -1.5, mtxCenter);
+    Matrix44d mtxOrientation;
+    setOrientationMatrix(-M_PI / 2.0, mfBaseAngle, 0.0, mtxOrientation);
+    Matrix44d mtxObjectToClip = mtxCenter * mtxOrientation * mtxWorldToCamera * mtxProjection;
+
+    // two sided diffuse from a light near the camera
+    Vec3d lightDir(0.3, 0.5, -1.0);
+    lightDir.normalize();
+
+    for (size_t k = 0; k < mTeapotPoints.size(); k++)
+    {
+        ZRasterizer::ClipVertex& vert = mTeapotVerts[k];
+        multPointMatrixClip(mTeapotPoints[k], vert, mtxObjectToClip);
+
+        const Vec3d& n = mTeapotNormals[k];
+        Vec3d worldNormal(n.x * mtxOrientation[0][0] + n.y * mtxOrientation[1][0] + n.z * mtxOrientation[2][0],
+                          n.x * mtxOrientation[0][1] + n.y * mtxOrientation[1][1] + n.z * mtxOrientation[2][1],
+                          n.x * mtxOrientation[0][2] + n.y * mtxOrientation[1][2] + n.z * mtxOrientation[2][2]);
+        double fLight = 0.2 + 0.8 * fabs(worldNormal.dotProduct(lightDir));
+        vert.mColor = ARGB(0xff, (uint32_t)(fLight * 0xe0), (uint32_t)(fLight * 0xb0), (uint32_t)(fLight * 0x60));
+    }
 
-    gRasterizer.Rasterize(mpSurface.get(), pTexture.get(), screenVerts);
-    //    gRasterizer.MultiSampleRasterizeWithAlpha(mpSurface.get(), pTexture.get(), screenVerts, nullptr, 1);
+    gRasterizer.RasterizeMesh(mpSurface.get(), MeshViewport(), mTeapotVerts, mTeapotIndices, mbTextureTeapot ? mpTexture.get() : nullptr);
 }
 
 
@@ -1303,7 +1373,7 @@ bool Z3DTestWin::Paint()
     gpFontSystem->GetDefaultFont()->DrawText(mpSurface.get(), sTime, mAreaLocal);
     mLastTimeStamp = nTime;
 
-    if (mbRenderCube)
+    if (mbRenderCube || mbRenderTeapotMesh)
     {
         Matrix44d mtxProjection;
         Matrix44d mtxWorldToCamera;
@@ -1319,13 +1389,14 @@ bool Z3DTestWin::Paint()
 
         setProjectionMatrix(fFoV, fAspect, fNear, fFar, mtxProjection);
 
+        // depth buffered, so sides and meshes can draw in any order
+        mpSurface->ClearDepth();
 
-        vector<Vec3d> worldVerts;
-        worldVerts.resize(4);
-
-        int i = 1;
-        //    for (; i < 100; i++)
+        if (mbRenderCube)
         {
+            vector<Vec3d> worldVerts;
+            worldVerts.resize(4);
+
             //        setOrientationMatrix((float)sin(i)*gTimer.GetElapsedTime() / 1050.0, (float)gTimer.GetElapsedTime() / 8000.0, (float)gTimer.GetElapsedTime() / 1000.0, mObjectToWorld);
             setOrientationMatrix(4.0, 0.0, mfBaseAngle, mObjectToWorld);
 
@@ -1351,6 +1422,8 @@ bool Z3DTestWin::Paint()
             }
         }
 
+        if (mbRenderTeapotMesh)
+            RenderTeapotMesh(mtxProjection, mtxWorldToCamera);
     }
 
 #ifdef RENDER_TEAPOT
@@ -1388,6 +1461,11 @@ bool Z3DTestWin::HandleMessage(const ZMessage& message)
         UpdateSphereCount();
         return true;
     }
+    else if (sType == "updateteapot")
+    {
+        BuildTeapotMesh();
+        return true;
+    }
     else if (sType == "updaterendersize")
     {
         gRegistry["3dtestwin"]["render_size"] = mnRenderSize;
@@ -6,6 +6,7 @@
 #include "ZTimer.h"
 #include <vector>
 #include "Z3DMath.h"
+#include "ZRasterizer.h"
 
 /////////////////////////////////////////////////////////////////////////
 // 
@@ -55,6 +56,7 @@ public:
 
     void    RenderPoly(std::vector<Z3D::Vec3d>& worldVerts, Z3D::Matrix44d& mtxProjection, Z3D::Matrix44d& mtxWorldToCamera, uint32_t nCol);
     void    RenderPoly(std::vector<Z3D::Vec3d>& worldVerts, Z3D::Matrix44d& mtxProjection, Z3D::Matrix44d& mtxWorldToCamera, tZBufferPtr pTexture);
+    void    RenderTeapotMesh(Z3D::Matrix44d& mtxProjection, Z3D::Matrix44d& mtxWorldToCamera);
     bool	HandleMessage(const ZMessage& message);
 
 private:
@@ -68,6 +70,18 @@ private:
     tZBufferPtr mpTexture;
     bool mbControlPanelEnabled;
 
+    ZRect   MeshViewport();
+    void    BuildTeapotMesh();
+
+    // depth buffered Utah teapot, mnTeapotDivisions x mnTeapotDivisions quads per patch
+    std::vector<Z3D::Vec3d>         mTeapotPoints;
+    std::vector<Z3D::Vec3d>         mTeapotNormals;
+    ZRasterizer::tClipVertexArray   mTeapotVerts;       // u,v set by BuildTeapotMesh, the rest each frame
+    std::vector<uint32_t>           mTeapotIndices;
+    int64_t     mnTeapotDivisions;
+    bool        mbRenderTeapotMesh;
+    bool        mbTextureTeapot;
+
 #ifdef RENDER_TEAPOT
     tZBufferPtr mpTeapotRender;
     void    RenderTeapot();
@@ -0,0 +1,1014 @@
+#include "Benchmarks.h"
+#include "ZBuffer.h"
+#include "ZTimer.h"
+#include "ZDebug.h"
+#include "ZRandom.h"
+#include "ZRasterizer.h"
+#include "ZRegion.h"
+#include "ZScreenBuffer.h"
+
+using namespace std;
+
+namespace Benchmarks
+{
+    static void FillNoise(ZBuffer* pBuf)
+    {
+        uint32_t* pPixels = pBuf->GetPixels();
+        int64_t nPixels = pBuf->GetArea().Area();
+        for (int64_t i = 0; i < nPixels; i++)
+            pPixels[i] = (uint32_t)RANDU64(0, 0xffffffff);
+        pBuf->MarkDirty();
+    }
+
+    static bool Identical(ZBuffer* pA, ZBuffer* pB)
+    {
+        if (pA->GetArea() != pB->GetArea())
+            return false;
+        return memcmp(pA->GetPixels(), pB->GetPixels(), pA->GetArea().Area() * sizeof(uint32_t)) == 0;
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Rotate
+
+    // Previous ZBuffer::Rotate.  Temp buffer per step through GetPixel/SetPixel, compound orientations in two steps
+    static void ReferenceRotate(ZBuffer* pBuf, ZBuffer::eOrientation rotation)
+    {
+        int64_t nW = pBuf->GetArea().Width();
+        int64_t nH = pBuf->GetArea().Height();
+        int64_t nPixels = nW * nH;
+
+        if (rotation == ZBuffer::kLeft || rotation == ZBuffer::kLeftAndVFlip || rotation == ZBuffer::kRight || rotation == ZBuffer::kRightAndVFlip)
+        {
+            bool bLeft = (rotation == ZBuffer::kLeft || rotation == ZBuffer::kLeftAndVFlip);
+            ZBuffer newBuf;
+            newBuf.Init(nH, nW);
+            for (int64_t y = 0; y < nH; y++)
+            {
+                for (int64_t x = 0; x < nW; x++)
+                {
+                    if (bLeft)
+                        newBuf.SetPixel(y, nW - x - 1, pBuf->GetPixel(x, y));
+                    else
+                        newBuf.SetPixel(nH - y - 1, x, pBuf->GetPixel(x, y));
+                }
+            }
+            pBuf->mSurfaceArea.Set(0, 0, nH, nW);
+            memcpy(pBuf->GetPixels(), newBuf.GetPixels(), nPixels * sizeof(uint32_t));
+            pBuf->MarkDirty();
+            nW = pBuf->GetArea().Width();
+            nH = pBuf->GetArea().Height();
+        }
+
+        if (rotation == ZBuffer::k180 || rotation == ZBuffer::kHFlip || rotation == ZBuffer::kVFlip || rotation == ZBuffer::kLeftAndVFlip || rotation == ZBuffer::kRightAndVFlip)
+        {
+            bool bFlipX = (rotation == ZBuffer::k180 || rotation == ZBuffer::kHFlip);
+            bool bFlipY = (rotation != ZBuffer::kHFlip);
+            ZBuffer newBuf;
+            newBuf.Init(nW, nH);
+            for (int64_t y = 0; y < nH; y++)
+            {
+                for (int64_t x = 0; x < nW; x++)
+                    newBuf.SetPixel(bFlipX ? nW - x - 1 : x, bFlipY ? nH - y - 1 : y, pBuf->GetPixel(x, y));
+            }
+            memcpy(pBuf->GetPixels(), newBuf.GetPixels(), nPixels * sizeof(uint32_t));
+            pBuf->MarkDirty();
+        }
+    }
+
+    void Rotate()
+    {
+        const char* names[] = { "Unknown", "None", "HFlip", "180", "VFlip", "LeftAndVFlip", "Left", "RightAndVFlip", "Right" };
+
+        ZBuffer source;
+        source.Init(kImageW, kImageH);
+        FillNoise(&source);
+
+        ZOUT("Rotate ", kImageW, "x", kImageH, "\n");
+        for (int32_t o = ZBuffer::kHFlip; o <= ZBuffer::kRight; o++)
+        {
+            ZBuffer::eOrientation orientation = (ZBuffer::eOrientation)o;
+
+            ZBuffer ref(&source);
+            int64_t nStart = gTimer.GetUSSinceEpoch();
+            ReferenceRotate(&ref, orientation);
+            int64_t nRefTime = gTimer.GetUSSinceEpoch() - nStart;
+
+            ZBuffer cur(&source);
+            nStart = gTimer.GetUSSinceEpoch();
+            cur.Rotate(orientation);
+            int64_t nCurTime = gTimer.GetUSSinceEpoch() - nStart;
+
+            ZOUT("  ", names[o], ": reference ", nRefTime / 1000, "ms  current ", nCurTime / 1000, "ms  ", Identical(&ref, &cur) ? "match" : "MISMATCH", "\n");
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Scale
+
+    // Previous ZBuffer::BltScaled.  Radial weight in double precision for every tap
+    static void ReferenceScale(ZBuffer* pDst, ZBuffer* pSrc)
+    {
+        uint32_t* srcBuffer = pSrc->GetPixels();
+        int64_t srcWidth = pSrc->GetArea().Width();
+        int64_t srcHeight = pSrc->GetArea().Height();
+        uint32_t* destBuffer = pDst->GetPixels();
+        int64_t destWidth = pDst->GetArea().Width();
+        int64_t destHeight = pDst->GetArea().Height();
+
+        double xScale = static_cast<double>(srcWidth) / destWidth;
+        double yScale = static_cast<double>(srcHeight) / destHeight;
+
+        double fMaxRadius = sqrt(xScale * xScale + yScale * yScale);
+        if (fMaxRadius < 1.0)
+            fMaxRadius = 1.0 / fMaxRadius;
+
+        for (int64_t y = 0; y < destHeight; ++y)
+        {
+            for (int64_t x = 0; x < destWidth; ++x)
+            {
+                double srcX = x * xScale;
+                double srcY = y * yScale;
+                int64_t srcXInt = static_cast<int64_t>(srcX);
+                int64_t srcYInt = static_cast<int64_t>(srcY);
+
+                double r = 0.0, g = 0.0, b = 0.0, a = 0.0;
+                double weightSum = 0.0;
+
+                for (int64_t j = (int64_t)(srcYInt - yScale / 2); j <= (int64_t)(srcYInt + yScale / 2); j++)
+                {
+                    for (int64_t i = (int64_t)(srcXInt - xScale / 2); i <= (int64_t)(srcXInt + xScale / 2); i++)
+                    {
+                        double xDiff = std::abs(srcX - i);
+                        double yDiff = std::abs(srcY - j);
+                        double fDist = sqrt(xDiff * xDiff + yDiff * yDiff);
+
+                        if (i >= 0 && i < srcWidth && j >= 0 && j < srcHeight && fDist <= fMaxRadius)
+                        {
+                            double weight = (fMaxRadius - fDist) / fMaxRadius;
+                            uint32_t pixel = srcBuffer[j * srcWidth + i];
+                            a += weight * ARGB_A(pixel);
+                            r += weight * ARGB_R(pixel);
+                            g += weight * ARGB_G(pixel);
+                            b += weight * ARGB_B(pixel);
+                            weightSum += weight;
+                        }
+                    }
+                }
+
+                if (weightSum > 0.0)
+                {
+                    a /= weightSum;
+                    r /= weightSum;
+                    g /= weightSum;
+                    b /= weightSum;
+                }
+
+                destBuffer[y * destWidth + x] = ARGB((uint32_t)a & 0xff, (uint32_t)r & 0xff, (uint32_t)g & 0xff, (uint32_t)b & 0xff);
+            }
+        }
+    }
+
+    void Scale()
+    {
+        ZBuffer source;
+        source.Init(kImageW, kImageH);
+        FillNoise(&source);
+
+        ZOUT("Scale from ", kImageW, "x", kImageH, "\n");
+
+        const ZPoint sizes[] = { ZPoint(256, 171), ZPoint(1920, 1280), ZPoint(4000, 2667) };
+        for (const ZPoint& size : sizes)
+        {
+            ZBuffer ref;
+            ref.Init(size.x, size.y);
+            int64_t nStart = gTimer.GetUSSinceEpoch();
+            ReferenceScale(&ref, &source);
+            int64_t nRefTime = gTimer.GetUSSinceEpoch() - nStart;
+
+            ZBuffer cur;
+            cur.Init(size.x, size.y);
+            nStart = gTimer.GetUSSinceEpoch();
+            cur.BltScaled(&source);
+            int64_t nCurTime = gTimer.GetUSSinceEpoch() - nStart;
+
+            ZOUT("  to ", size.x, "x", size.y, ": reference ", nRefTime / 1000, "ms  current ", nCurTime / 1000, "ms\n");
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Fill
+
+    // Previous ZBuffer::Fill / FillAlpha / FillGradient.  Per pixel loops, gradient through the rasterizer
+    static void ReferenceFill(ZBuffer* pBuf, uint32_t nCol)
+    {
+        uint32_t* pPixels = pBuf->GetPixels();
+        int64_t nPixels = pBuf->GetArea().Area();
+        for (int64_t i = 0; i < nPixels; i++)
+            pPixels[i] = nCol;
+        pBuf->MarkDirty();
+    }
+
+    static void ReferenceFillAlpha(ZBuffer* pBuf, uint32_t nCol)
+    {
+        uint32_t* pPixels = pBuf->GetPixels();
+        int64_t nPixels = pBuf->GetArea().Area();
+        for (int64_t i = 0; i < nPixels; i++)
+            pPixels[i] = COL::AlphaBlend_Col2Alpha(nCol, pPixels[i], ARGB_A(nCol));
+        pBuf->MarkDirty();
+    }
+
+    static void ReferenceFillGradient(ZBuffer* pBuf, uint32_t nCol[4])
+    {
+        tColorVertexArray array;
+        gRasterizer.RectToVerts(pBuf->GetArea(), array);
+        for (int i = 0; i < 4; i++)
+            array[i].mColor = nCol[i];
+        gRasterizer.Rasterize(pBuf, array);
+    }
+
+    void Fill()
+    {
+        const int64_t kIterations = 20;
+        uint32_t gradient[4] = { 0xffff0000, 0xff00ff00, 0xff0000ff, 0x80ffffff };
+
+        const ZPoint sizes[] = { ZPoint(256, 256), ZPoint(1920, 1080), ZPoint(kImageW, kImageH) };
+        for (const ZPoint& size : sizes)
+        {
+            ZOUT("Fill ", size.x, "x", size.y, " (avg of ", kIterations, ")\n");
+
+            ZBuffer ref;
+            ref.Init(size.x, size.y);
+            FillNoise(&ref);
+            ZBuffer cur(&ref);
+
+            int64_t nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                ReferenceFill(&ref, 0xff102030);
+            int64_t nRefTime = gTimer.GetUSSinceEpoch() - nStart;
+
+            nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                cur.Fill(0xff102030);
+            int64_t nCurTime = gTimer.GetUSSinceEpoch() - nStart;
+            ZOUT("  Fill: reference ", nRefTime / kIterations, "us  current ", nCurTime / kIterations, "us  ", Identical(&ref, &cur) ? "match" : "MISMATCH", "\n");
+
+            nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                ReferenceFillAlpha(&ref, 0x80405060);
+            nRefTime = gTimer.GetUSSinceEpoch() - nStart;
+
+            nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                cur.FillAlpha(0x80405060);
+            nCurTime = gTimer.GetUSSinceEpoch() - nStart;
+            ZOUT("  FillAlpha: reference ", nRefTime / kIterations, "us  current ", nCurTime / kIterations, "us  ", Identical(&ref, &cur) ? "match" : "MISMATCH", "\n");
+
+            // gradient interpolation differs slightly, so only timing is compared
+            nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                ReferenceFillGradient(&ref, gradient);
+            nRefTime = gTimer.GetUSSinceEpoch() - nStart;
+
+            nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                cur.FillGradient(gradient);
+            nCurTime = gTimer.GetUSSinceEpoch() - nStart;
+            ZOUT("  FillGradient: reference ", nRefTime / kIterations, "us  current ", nCurTime / kIterations, "us\n");
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // RasterizeSimple
+
+    // Previous RasterizeSimple.  Rectangle as a generic quad through the polygon rasterizer
+    static void ReferenceRasterizeSimple(ZBuffer* pDst, ZBuffer* pSrc, const ZRect& rDest, const ZRect& rSrc)
+    {
+        tUVVertexArray verts;
+        gRasterizer.RectToVerts(rDest, verts);
+        double w = (double)pSrc->GetArea().Width();
+        double h = (double)pSrc->GetArea().Height();
+        verts[0].u = verts[3].u = (double)rSrc.left / w;
+        verts[1].u = verts[2].u = (double)rSrc.right / w;
+        verts[0].v = verts[1].v = (double)rSrc.top / h;
+        verts[2].v = verts[3].v = (double)rSrc.bottom / h;
+
+        gRasterizer.mbAxisAlignedBlt = false;
+        gRasterizer.Rasterize(pDst, pSrc, verts);
+        gRasterizer.mbAxisAlignedBlt = true;
+    }
+
+    void RasterizeSimple()
+    {
+        const int64_t kIterations = 10;
+        const char* filterNames[] = { "nearest", "bilinear", "area" };
+
+        ZBuffer source;
+        source.Init(kImageW, kImageH);
+        FillNoise(&source);
+
+        // Viewer sizes, showing the whole image and a 200% zoom on its center
+        const ZPoint sizes[] = { ZPoint(1920, 1080), ZPoint(3840, 2160) };
+        for (const ZPoint& size : sizes)
+        {
+            ZRect rDest(0, 0, size.x, size.y);
+            ZRect rFit(0, 0, kImageW, kImageH);
+            ZRect rZoom(kImageW / 2 - size.x / 4, kImageH / 2 - size.y / 4, kImageW / 2 + size.x / 4, kImageH / 2 + size.y / 4);
+            const ZRect* views[] = { &rFit, &rZoom };
+            const char* viewNames[] = { "fit", "200%" };
+
+            for (int nView = 0; nView < 2; nView++)
+            {
+                ZOUT("RasterizeSimple ", kImageW, "x", kImageH, " to ", size.x, "x", size.y, " ", viewNames[nView], " (avg of ", kIterations, ")\n");
+
+                ZBuffer ref;
+                ref.Init(size.x, size.y);
+                int64_t nStart = gTimer.GetUSSinceEpoch();
+                for (int64_t i = 0; i < kIterations; i++)
+                    ReferenceRasterizeSimple(&ref, &source, rDest, *views[nView]);
+                int64_t nRefTime = gTimer.GetUSSinceEpoch() - nStart;
+                ZOUT("  reference ", nRefTime / kIterations, "us\n");
+
+                // nearest picks the same texels as the reference, the other filters are timing only
+                for (int f = ZRasterizer::kScaleNearest; f <= ZRasterizer::kScaleArea; f++)
+                {
+                    ZBuffer cur;
+                    cur.Init(size.x, size.y);
+                    nStart = gTimer.GetUSSinceEpoch();
+                    for (int64_t i = 0; i < kIterations; i++)
+                        gRasterizer.RasterizeSimple(&cur, &source, rDest, *views[nView], nullptr, (ZRasterizer::eScaleFilter)f);
+                    int64_t nCurTime = gTimer.GetUSSinceEpoch() - nStart;
+
+                    if (f == ZRasterizer::kScaleNearest)
+                        ZOUT("  ", filterNames[f], " ", nCurTime / kIterations, "us  ", Identical(&ref, &cur) ? "match" : "MISMATCH", "\n");
+                    else
+                        ZOUT("  ", filterNames[f], " ", nCurTime / kIterations, "us\n");
+                }
+            }
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // EdgeAntiAlias
+
+    void EdgeAntiAlias()
+    {
+        const int64_t kIterations = 10;
+        const int64_t kShards = 400;
+
+        ZBuffer source;
+        source.Init(1920, 1080);
+        FillNoise(&source);
+        ZBuffer dest;
+        dest.Init(1920, 1080);
+
+        // A rotated image transition, against supersampling every pixel as smooth edges were previously drawn
+        tUVVertexArray verts;
+        gRasterizer.RectToVerts(ZRect(240, 135, 1680, 945), verts);
+        for (ZUVVertex& v : verts)
+        {
+            double x = v.x - 960.0;
+            double y = v.y - 540.0;
+            v.x = 960.0 + x * cos(0.3) - y * sin(0.3);
+            v.y = 540.0 + x * sin(0.3) + y * cos(0.3);
+        }
+
+        ZOUT("EdgeAntiAlias rotated 1440x810 onto 1920x1080 (avg of ", kIterations, ")\n");
+        int64_t nStart = gTimer.GetUSSinceEpoch();
+        for (int64_t i = 0; i < kIterations; i++)
+            gRasterizer.MultiSampleRasterizeWithAlpha(&dest, &source, verts, nullptr, 4, 255);
+        ZOUT("  multisample 4x4 ", (gTimer.GetUSSinceEpoch() - nStart) / kIterations, "us\n");
+
+        const char* edgeNames[] = { "aliased", "anti-aliased" };
+        for (int e = ZRasterizer::kEdgeAliased; e <= ZRasterizer::kEdgeAntiAlias; e++)
+        {
+            nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                gRasterizer.RasterizeWithAlpha(&dest, &source, verts, nullptr, 255, (ZRasterizer::eEdgeMode)e);
+            ZOUT("  ", edgeNames[e], " ", (gTimer.GetUSSinceEpoch() - nStart) / kIterations, "us\n");
+        }
+
+        // Shattered quads, as ZAnimObject_BitmapShatterer draws them
+        ZOUT("EdgeAntiAlias ", kShards, " rotated shards (avg of ", kIterations, ")\n");
+        ZRasterizer::tBatchQuads quads[2];
+        for (int64_t n = 0; n < kShards; n++)
+        {
+            double fCenterX = (double)RANDI64(0, 1920);
+            double fCenterY = (double)RANDI64(0, 1080);
+            double fSize = (double)RANDI64(8, 64);
+            double fAngle = RANDDOUBLE(0.0, 6.28);
+
+            tUVVertexArray shard;
+            gRasterizer.RectToVerts(ZRect(0, 0, 1, 1), shard);
+            for (int64_t i = 0; i < 4; i++)
+            {
+                shard[i].x = fCenterX + fSize * cos(fAngle + i * 1.5708);
+                shard[i].y = fCenterY + fSize * sin(fAngle + i * 1.5708);
+            }
+            quads[0].push_back(ZRasterizer::BatchQuad(&source, shard, dest.GetArea(), 128, true, ZRasterizer::kEdgeAliased));
+            quads[1].push_back(ZRasterizer::BatchQuad(&source, shard, dest.GetArea(), 128, true, ZRasterizer::kEdgeAntiAlias));
+        }
+
+        for (int e = ZRasterizer::kEdgeAliased; e <= ZRasterizer::kEdgeAntiAlias; e++)
+        {
+            nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                gRasterizer.RasterizeBatch(&dest, quads[e]);
+            ZOUT("  ", edgeNames[e], " ", (gTimer.GetUSSinceEpoch() - nStart) / kIterations, "us\n");
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // SpanMatrix
+
+    // Times every specialized span loop through the call that selects it
+    void SpanMatrix()
+    {
+        const int64_t kIterations = 10;
+        const char* blendNames[] = { "copy", "alpha" };
+        const char* edgeNames[] = { "aliased", "anti-aliased" };
+        const char* filterNames[] = { "nearest", "bilinear", "area" };
+
+        ZBuffer source;
+        source.Init(1024, 1024);
+        FillNoise(&source);
+        ZBuffer dest;
+        dest.Init(1920, 1080);
+
+        auto timeIt = [&](const auto& draw) -> int64_t
+        {
+            int64_t nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                draw();
+            return (gTimer.GetUSSinceEpoch() - nStart) / kIterations;
+        };
+
+        // Rotated quad covering most of the destination
+        tUVVertexArray verts;
+        gRasterizer.RectToVerts(ZRect(360, 0, 1560, 1080), verts);
+        for (ZUVVertex& v : verts)
+        {
+            double x = v.x - 960.0;
+            double y = v.y - 540.0;
+            v.x = 960.0 + x * cos(0.2) - y * sin(0.2);
+            v.y = 540.0 + x * sin(0.2) + y * cos(0.2);
+        }
+
+        ZOUT("SpanMatrix polygon spans, 1024x1024 rotated onto 1920x1080 (avg of ", kIterations, ")\n");
+        for (int nSrcAlpha = 0; nSrcAlpha < 2; nSrcAlpha++)
+        {
+            source.mbHasAlphaPixels = nSrcAlpha != 0;
+            for (int e = ZRasterizer::kEdgeAliased; e <= ZRasterizer::kEdgeAntiAlias; e++)
+            {
+                for (int b = 0; b < 2; b++)
+                {
+                    int64_t nTime = timeIt([&]()
+                    {
+                        if (b == 0)
+                            gRasterizer.Rasterize(&dest, &source, verts, nullptr, (ZRasterizer::eEdgeMode)e);
+                        else
+                            gRasterizer.RasterizeWithAlpha(&dest, &source, verts, nullptr, 128, (ZRasterizer::eEdgeMode)e);
+                    });
+                    ZOUT("  ", blendNames[b], " ", edgeNames[e], " src alpha:", nSrcAlpha, "  ", nTime, "us\n");
+                }
+            }
+        }
+        source.mbHasAlphaPixels = false;
+
+        ZOUT("SpanMatrix scaled blt spans, 1024x1024 to 1920x1080 (avg of ", kIterations, ")\n");
+        for (int f = ZRasterizer::kScaleNearest; f <= ZRasterizer::kScaleArea; f++)
+        {
+            for (int b = 0; b < 2; b++)
+            {
+                int64_t nTime = timeIt([&]()
+                {
+                    if (b == 0)
+                        gRasterizer.RasterizeSimple(&dest, &source, dest.GetArea(), source.GetArea(), nullptr, (ZRasterizer::eScaleFilter)f);
+                    else
+                        gRasterizer.RasterizeWithAlphaSimple(&dest, &source, dest.GetArea(), source.GetArea(), nullptr, 128, (ZRasterizer::eScaleFilter)f);
+                });
+                ZOUT("  ", blendNames[b], " ", filterNames[f], "  ", nTime, "us\n");
+            }
+        }
+
+        // Zoomed in draws the source at 1920 wide, zoomed out shrinks it to a quarter
+        ZOUT("SpanMatrix multisample spans (avg of ", kIterations, ")\n");
+        tUVVertexArray zoomOut;
+        gRasterizer.RectToVerts(ZRect(0, 0, 256, 256), zoomOut);
+        const char* magNames[] = { "supersample", "bilinear", "bicubic" };
+        for (int m = ZRasterizer::kMagSupersample; m <= ZRasterizer::kMagBicubic; m++)
+        {
+            int64_t nTime = timeIt([&]() { gRasterizer.MultiSampleRasterizeWithAlpha(&dest, &source, verts, nullptr, 2, 255, ZRasterizer::kMinMipmapTrilinear, (ZRasterizer::eMagnification)m); });
+            ZOUT("  zoomed in ", magNames[m], "  ", nTime, "us\n");
+        }
+        const char* minNames[] = { "supersample", "mipmap", "trilinear" };
+        for (int m = ZRasterizer::kMinSupersample; m <= ZRasterizer::kMinMipmapTrilinear; m++)
+        {
+            int64_t nTime = timeIt([&]() { gRasterizer.MultiSampleRasterizeWithAlpha(&dest, &source, zoomOut, nullptr, 2, 255, (ZRasterizer::eMinification)m, ZRasterizer::kMagBilinear); });
+            ZOUT("  zoomed out ", minNames[m], "  ", nTime, "us\n");
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Lines
+
+    // Previous ZBuffer::DrawAlphaLine.  Scanline intersections and colors in double, thickness measured horizontally,
+    // no coverage at the edges or ends.
+    static bool ReferenceLineIntersection(double fScanLine, const ZColorVertex& v1, const ZColorVertex& v2, double& fIntersection, double& fR, double& fG, double& fB, double& fA)
+    {
+        if (v1.y == v2.y || v1.x == v2.x)
+        {
+            fIntersection = v1.x;
+            fA = (double)(v1.mColor >> 24);
+            fR = (double)((v1.mColor & 0x00ff0000) >> 16);
+            fG = (double)((v1.mColor & 0x0000ff00) >> 8);
+            fB = (double)((v1.mColor & 0x000000ff));
+            return false;
+        }
+
+        double fM = (double)((v1.y - v2.y) / (v1.x - v2.x));
+        fIntersection = (v2.x + (fScanLine - v2.y) / fM);
+
+        double fT = (fScanLine - v1.y) / (v2.y - v1.y);
+        fA = (double)ARGB_A(v1.mColor) + ((double)ARGB_A(v2.mColor) - (double)ARGB_A(v1.mColor)) * fT;
+        fR = (double)ARGB_R(v1.mColor) + ((double)ARGB_R(v2.mColor) - (double)ARGB_R(v1.mColor)) * fT;
+        fG = (double)ARGB_G(v1.mColor) + ((double)ARGB_G(v2.mColor) - (double)ARGB_G(v1.mColor)) * fT;
+        fB = (double)ARGB_B(v1.mColor) + ((double)ARGB_B(v2.mColor) - (double)ARGB_B(v1.mColor)) * fT;
+        return true;
+    }
+
+    static void ReferenceLineSpan(uint32_t* pDest, int64_t nNumPixels, double fR, double fG, double fB, double fA)
+    {
+        for (; nNumPixels > 0; nNumPixels--, pDest++)
+        {
+            uint8_t nCurA, nCurR, nCurG, nCurB;
+            TO_ARGB(*pDest, nCurA, nCurR, nCurG, nCurB);
+            uint8_t nDestR = static_cast<uint8_t>((uint32_t)((fR * fA + (nCurR * (255.0f - fA)))) >> 8);
+            uint8_t nDestG = static_cast<uint8_t>((uint32_t)((fG * fA + (nCurG * (255.0f - fA)))) >> 8);
+            uint8_t nDestB = static_cast<uint8_t>((uint32_t)((fB * fA + (nCurB * (255.0f - fA)))) >> 8);
+            *pDest = ARGB(255, nDestR, nDestG, nDestB);
+        }
+    }
+
+    static void ReferenceDrawAlphaLine(ZBuffer* pBuf, const ZColorVertex& v1, const ZColorVertex& v2, double thickness)
+    {
+        ZRect rLineRect;
+        rLineRect.top = (int64_t)min(v1.y, v2.y);
+        rLineRect.bottom = (int64_t)max(v1.y, v2.y);
+        rLineRect.left = (int64_t)min(v1.x - thickness / 2.0f, v2.x - thickness / 2.0f);
+        rLineRect.right = (int64_t)max(v1.x + thickness / 2.0f, v2.x + thickness / 2.0f);
+        rLineRect.Intersect(&pBuf->GetArea());
+
+        uint32_t* pSurface = pBuf->GetPixels();
+        int64_t nStride = pBuf->GetArea().right;
+
+        double fScanLine = (double)rLineRect.top;
+        double fIntersection, fR, fG, fB, fA;
+        double fPrevScanLineIntersection;
+        if (!ReferenceLineIntersection(fScanLine, v1, v2, fPrevScanLineIntersection, fR, fG, fB, fA) && v1.y == v2.y)
+            ReferenceLineSpan(pSurface + rLineRect.top * nStride + rLineRect.left, rLineRect.Width(), fR, fG, fB, fA);
+
+        for (int64_t nScanLine = rLineRect.top; nScanLine < rLineRect.bottom; nScanLine++)
+        {
+            ReferenceLineIntersection(fScanLine, v1, v2, fIntersection, fR, fG, fB, fA);
+            if (fA > 10.0f)
+            {
+                int64_t nStartPixel = (int64_t)min(fIntersection - thickness / 2.0f, fPrevScanLineIntersection - thickness / 2.0f);
+                nStartPixel = max(nStartPixel, rLineRect.left);
+                int64_t nEndPixel = (int64_t)max(fIntersection + thickness / 2.0f, fPrevScanLineIntersection + thickness / 2.0f);
+                nEndPixel = min(nEndPixel, rLineRect.right);
+                ReferenceLineSpan(pSurface + nScanLine * nStride + nStartPixel, nEndPixel - nStartPixel, fR, fG, fB, fA);
+            }
+            fPrevScanLineIntersection = fIntersection;
+            fScanLine += 1.0f;
+        }
+        pBuf->MarkDirty(&rLineRect);
+    }
+
+    // Random long and short lines at a few thicknesses. The reference measures thickness horizontally and has no
+    // anti-aliasing, so it touches fewer pixels than the current lines; images are not compared.
+    void Lines()
+    {
+        const int64_t kIterations = 5;
+        const int64_t kLongLines = 2000;
+        const int64_t kShortLines = 20000;
+
+        ZBuffer dest;
+        dest.Init(1920, 1080);
+        FillNoise(&dest);
+
+        auto timeIt = [&](const auto& draw) -> int64_t
+        {
+            int64_t nStart = gTimer.GetUSSinceEpoch();
+            for (int64_t i = 0; i < kIterations; i++)
+                draw();
+            return (gTimer.GetUSSinceEpoch() - nStart) / kIterations;
+        };
+
+        // vertex pairs. The long set is also drawn as one polyline.
+        tColorVertexArray longLines;
+        for (int64_t i = 0; i < kLongLines * 2; i++)
+            longLines.push_back(ZColorVertex(RANDDOUBLE(0.0, 1920.0), RANDDOUBLE(0.0, 1080.0), (uint32_t)RANDU64(0x80000000, 0xffffffff)));
+
+        tColorVertexArray shortLines;
+        for (int64_t i = 0; i < kShortLines; i++)
+        {
+            double x = RANDDOUBLE(0.0, 1900.0);
+            double y = RANDDOUBLE(0.0, 1060.0);
+            shortLines.push_back(ZColorVertex(x, y, 0xc0ffffff));
+            shortLines.push_back(ZColorVertex(x + RANDDOUBLE(0.0, 20.0), y + RANDDOUBLE(0.0, 20.0), 0xc0ffffff));
+        }
+
+        for (double fThickness : { 1.0, 2.0, 4.0, 16.0 })
+        {
+            ZOUT("Lines thickness ", fThickness, " (avg of ", kIterations, ")\n");
+
+            int64_t nRefTime = timeIt([&]()
+            {
+                for (size_t i = 0; i < longLines.size(); i += 2)
+                    ReferenceDrawAlphaLine(&dest, longLines[i], longLines[i + 1], fThickness);
+            });
+            int64_t nCurTime = timeIt([&]()
+            {
+                for (size_t i = 0; i < longLines.size(); i += 2)
+                    dest.DrawAlphaLine(longLines[i], longLines[i + 1], fThickness);
+            });
+            int64_t nBatchTime = timeIt([&]() { dest.DrawAlphaLines(longLines, fThickness); });
+            int64_t nPolyTime = timeIt([&]() { dest.DrawAlphaPolyline(longLines, fThickness); });
+            ZOUT("  ", kLongLines, " long gradient: reference ", nRefTime, "us  current ", nCurTime, "us  batched ", nBatchTime, "us  polyline (", kLongLines * 2 - 1, " segments) ", nPolyTime, "us\n");
+
+            nRefTime = timeIt([&]()
+            {
+                for (size_t i = 0; i < shortLines.size(); i += 2)
+                    ReferenceDrawAlphaLine(&dest, shortLines[i], shortLines[i + 1], fThickness);
+            });
+            nCurTime = timeIt([&]()
+            {
+                for (size_t i = 0; i < shortLines.size(); i += 2)
+                    dest.DrawAlphaLine(shortLines[i], shortLines[i + 1], fThickness);
+            });
+            nBatchTime = timeIt([&]() { dest.DrawAlphaLines(shortLines, fThickness); });
+            ZOUT("  ", kShortLines, " short: reference ", nRefTime, "us  current ", nCurTime, "us  batched ", nBatchTime, "us  (", (kShortLines * 1000) / max<int64_t>(nBatchTime, 1), " lines/ms)\n");
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Regions
+
+    // Per pixel reference for ZRegion on a small field, so rects land on each other's edges often
+    const int64_t kRegionField = 64;
+    typedef std::vector<uint8_t> tRegionMask;
+
+    static ZRect RandRegionRect()
+    {
+        int64_t l = RANDI64(0, kRegionField);
+        int64_t t = RANDI64(0, kRegionField);
+        int64_t w = RANDI64(0, kRegionField / 2);      // may be empty
+        int64_t h = RANDI64(0, kRegionField / 2);
+        return ZRect(l, t, min(l + w, kRegionField), min(t + h, kRegionField));
+    }
+
+    static void ReferenceRegionOp(tRegionMask& mask, const tRegionMask& rhs, int32_t nOp)
+    {
+        for (size_t i = 0; i < mask.size(); i++)
+        {
+            if (nOp == 0)
+                mask[i] |= rhs[i];
+            else if (nOp == 1)
+                mask[i] &= !rhs[i];
+            else
+                mask[i] &= rhs[i];
+        }
+    }
+
+    static tRegionMask RectMask(const ZRect& r)
+    {
+        tRegionMask mask(kRegionField * kRegionField, 0);
+        for (int64_t y = r.top; y < r.bottom; y++)
+            for (int64_t x = r.left; x < r.right; x++)
+                mask[y * kRegionField + x] = 1;
+        return mask;
+    }
+
+    static void RegionOp(ZRegion& region, const ZRegion& rhs, int32_t nOp)
+    {
+        if (nOp == 0)
+            region.Union(rhs);
+        else if (nOp == 1)
+            region.Subtract(rhs);
+        else
+            region.Intersect(rhs);
+    }
+
+    static void RegionOp(ZRegion& region, const ZRect& r, int32_t nOp)
+    {
+        if (nOp == 0)
+            region.Union(r);
+        else if (nOp == 1)
+            region.Subtract(r);
+        else
+            region.Intersect(r);
+    }
+
+    // Covers exactly mask, and keeps the banded form: bands sorted and disjoint, rects in a band sorted with gaps between
+    // them, vertically touching bands with identical spans merged, and bounds and area that agree with the rects
+    static bool RegionMatches(const ZRegion& region, const tRegionMask& mask)
+    {
+        const std::vector<ZRect>& rects = region.GetRects();
+        tRegionMask covered(mask.size(), 0);
+        ZRect rBounds;
+        int64_t nArea = 0;
+        size_t nBand = 0;
+        for (size_t i = 0; i < rects.size(); i++)
+        {
+            const ZRect& r = rects[i];
+            if (r.Width() <= 0 || r.Height() <= 0)
+                return false;
+
+            if (i > 0 && r.top == rects[i - 1].top)
+            {
+                if (r.bottom != rects[i - 1].bottom || r.left <= rects[i - 1].right)
+                    return false;
+            }
+            else if (i > 0)
+            {
+                if (r.top < rects[i - 1].bottom)
+                    return false;
+
+                // previous band touching this one can't have the same spans
+                size_t nEnd = i;
+                while (nEnd < rects.size() && rects[nEnd].top == r.top)
+                    nEnd++;
+                if (rects[nBand].bottom == r.top && i - nBand == nEnd - i)
+                {
+                    bool bSame = true;
+                    for (size_t k = 0; k < i - nBand; k++)
+                        bSame &= rects[nBand + k].left == rects[i + k].left && rects[nBand + k].right == rects[i + k].right;
+                    if (bSame)
+                        return false;
+                }
+                nBand = i;
+            }
+
+            for (int64_t y = r.top; y < r.bottom; y++)
+                for (int64_t x = r.left; x < r.right; x++)
+                    covered[y * kRegionField + x]++;
+
+            if (i == 0)
+                rBounds = r;
+            else
+                rBounds = ZRect(min(rBounds.left, r.left), min(rBounds.top, r.top), max(rBounds.right, r.right), max(rBounds.bottom, r.bottom));
+            nArea += r.Width() * r.Height();
+        }
+
+        return covered == mask && rBounds == region.GetBounds() && nArea == region.Area();
+    }
+
+    // Random regions built from random rect ops, combined pairwise with every op, against the per pixel reference
+    void Regions()
+    {
+        const int64_t kPairs = 20000;
+        const char* opNames[] = { "Union", "Subtract", "Intersect" };
+
+        int64_t nMismatches[3] = {};
+        int64_t nRectMismatches[3] = {};
+        int64_t nOpTime[3] = {};
+        int64_t nRects = 0;
+
+        auto randRegion = [&](ZRegion& region, tRegionMask& mask)
+        {
+            region.Clear();
+            mask.assign(kRegionField * kRegionField, 0);
+            int64_t nSteps = RANDI64(1, 17);
+            for (int64_t n = 0; n < nSteps; n++)
+            {
+                ZRect r(RandRegionRect());
+                int32_t nOp = (n == 0 || RANDI64(0, 3) < 2) ? 0 : 1;       // unions with some holes punched
+                RegionOp(region, r, nOp);
+                ReferenceRegionOp(mask, RectMask(r), nOp);
+            }
+        };
+
+        ZRegion a;
+        ZRegion b;
+        tRegionMask maskA;
+        tRegionMask maskB;
+        for (int64_t i = 0; i < kPairs; i++)
+        {
+            randRegion(a, maskA);
+            randRegion(b, maskB);
+            nRects += a.GetRects().size() + b.GetRects().size();
+
+            for (int32_t nOp = 0; nOp < 3; nOp++)
+            {
+                ZRegion result(a);
+                tRegionMask maskResult(maskA);
+                int64_t nStart = gTimer.GetUSSinceEpoch();
+                RegionOp(result, b, nOp);
+                nOpTime[nOp] += gTimer.GetUSSinceEpoch() - nStart;
+                ReferenceRegionOp(maskResult, maskB, nOp);
+                if (!RegionMatches(result, maskResult))
+                    nMismatches[nOp]++;
+
+                ZRect r(RandRegionRect());
+                ZRegion rectResult(a);
+                tRegionMask maskRectResult(maskA);
+                RegionOp(rectResult, r, nOp);
+                ReferenceRegionOp(maskRectResult, RectMask(r), nOp);
+                if (!RegionMatches(rectResult, maskRectResult))
+                    nRectMismatches[nOp]++;
+            }
+        }
+
+        ZOUT("Regions ", kPairs, " random pairs on ", kRegionField, "x", kRegionField, " (avg ", nRects / (kPairs * 2), " rects)\n");
+        for (int32_t nOp = 0; nOp < 3; nOp++)
+        {
+            if (nMismatches[nOp] == 0 && nRectMismatches[nOp] == 0)
+                ZOUT("  ", opNames[nOp], ": current ", (nOpTime[nOp] * 1000) / kPairs, "ns  match\n");
+            else
+                ZOUT("  ", opNames[nOp], ": current ", (nOpTime[nOp] * 1000) / kPairs, "ns  MISMATCH region:", nMismatches[nOp], " rect:", nRectMismatches[nOp], "\n");
+        }
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Visibility
+
+    const int64_t kVisibilityField = 96;
+
+    static ZRect RandWindowRect()
+    {
+        int64_t l = RANDI64(0, kVisibilityField);
+        int64_t t = RANDI64(0, kVisibilityField);
+        int64_t w = RANDI64(1, kVisibilityField / 2);
+        int64_t h = RANDI64(1, kVisibilityField / 2);
+        return ZRect(l, t, min(l + w, kVisibilityField), min(t + h, kVisibilityField));
+    }
+
+    // Every pixel is drawn once, from the topmost rect over it, at that rect's source offset
+    static bool VisibleRectsMatchPixels(const tScreenRectArray& stack, const tScreenRectArray& visible)
+    {
+        const int64_t kPixels = kVisibilityField * kVisibilityField;
+        std::vector<int32_t> owner(kPixels, -1);
+        for (size_t i = 0; i < stack.size(); i++)
+        {
+            const ZRect& r = stack[i].mrDest;
+            for (int64_t y = r.top; y < r.bottom; y++)
+                for (int64_t x = r.left; x < r.right; x++)
+                    owner[y * kVisibilityField + x] = (int32_t)i;
+        }
+
+        std::vector<uint8_t> drawn(kPixels, 0);
+        for (const ZScreenRect& piece : visible)
+        {
+            const ZRect& r = piece.mrDest;
+            for (int64_t y = r.top; y < r.bottom; y++)
+            {
+                for (int64_t x = r.left; x < r.right; x++)
+                {
+                    int64_t nPixel = y * kVisibilityField + x;
+                    if (drawn[nPixel]++ || owner[nPixel] < 0)
+                        return false;
+
+                    const ZScreenRect& top = stack[owner[nPixel]];
+                    if (piece.mpSourceBuffer != top.mpSourceBuffer ||
+                        piece.mSourcePt.x + x - r.left != top.mSourcePt.x + x - top.mrDest.left ||
+                        piece.mSourcePt.y + y - r.top != top.mSourcePt.y + y - top.mrDest.top)
+                        return false;
+                }
+            }
+        }
+
+        for (int64_t i = 0; i < kPixels; i++)
+        {
+            if ((owner[i] >= 0) != (drawn[i] != 0))
+                return false;
+        }
+        return true;
+    }
+
+    static bool SameVisibleRects(const tScreenRectArray& a, const tScreenRectArray& b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i].mpSourceBuffer != b[i].mpSourceBuffer || a[i].mrDest != b[i].mrDest || a[i].mSourcePt != b[i].mSourcePt)
+                return false;
+        }
+        return true;
+    }
+
+    // Random add, remove, move and restack edits to a window stack. After each one the incrementally resolved list is
+    // compared with a full resolve on a fresh screen buffer and with the per pixel topmost window.
+    void Visibility()
+    {
+        const int64_t kEdits = 20000;
+        const size_t kMaxWindows = 12;
+        const char* editNames[] = { "add", "remove", "move", "restack", "scroll" };
+
+        ZScreenBuffer incremental;
+        tScreenRectArray stack;         // bottom to top
+        tScreenRectArray incrementalRects;
+        tScreenRectArray fullRects;
+
+        int64_t nIncrementalTime = 0;
+        int64_t nFullTime = 0;
+        int64_t nListMismatches[5] = {};
+        int64_t nPixelMismatches[5] = {};
+        int64_t nEditCount[5] = {};
+
+        for (int64_t n = 0; n < kEdits; n++)
+        {
+            int32_t nEdit = (int32_t)RANDI64(0, 5);
+            if (stack.empty() || (nEdit == 1 && stack.size() == 1))
+                nEdit = 0;
+            else if (nEdit == 0 && stack.size() >= kMaxWindows)
+                nEdit = 1;
+
+            size_t nIndex = (size_t)RANDI64(0, (int64_t)stack.size());
+            switch (nEdit)
+            {
+            case 0:
+                {
+                    size_t nAt = (size_t)RANDI64(0, (int64_t)stack.size() + 1);
+                    stack.insert(stack.begin() + nAt, ZScreenRect(tZBufferPtr(new ZBuffer()), RandWindowRect(), ZPoint(0, 0)));
+                }
+                break;
+            case 1:
+                stack.erase(stack.begin() + nIndex);
+                break;
+            case 2:
+                {
+                    ZRect r(RandWindowRect());
+                    if (RANDBOOL)
+                        r = ZRect(r.left, r.top, r.left + stack[nIndex].mrDest.Width(), r.top + stack[nIndex].mrDest.Height());    // move without resizing
+                    r.right = min(r.right, kVisibilityField);
+                    r.bottom = min(r.bottom, kVisibilityField);
+                    stack[nIndex].mrDest = r;
+                }
+                break;
+            case 3:
+                {
+                    ZScreenRect sr(stack[nIndex]);
+                    stack.erase(stack.begin() + nIndex);
+                    stack.insert(stack.begin() + (size_t)RANDI64(0, (int64_t)stack.size() + 1), sr);
+                }
+                break;
+            case 4:
+                stack[nIndex].mSourcePt = ZPoint(RANDI64(0, 16), RANDI64(0, 16));   // same place on screen, different part of the source
+                break;
+            }
+            nEditCount[nEdit]++;
+
+            int64_t nStart = gTimer.GetUSSinceEpoch();
+            incremental.ResetVisibilityList();
+            for (const ZScreenRect& sr : stack)
+                incremental.AddScreenRectAndComputeVisibility(sr);
+            incremental.GetVisibleRects(incrementalRects);
+            nIncrementalTime += gTimer.GetUSSinceEpoch() - nStart;
+
+            nStart = gTimer.GetUSSinceEpoch();
+            ZScreenBuffer full;
+            for (const ZScreenRect& sr : stack)
+                full.AddScreenRectAndComputeVisibility(sr);
+            full.GetVisibleRects(fullRects);
+            nFullTime += gTimer.GetUSSinceEpoch() - nStart;
+
+            if (!SameVisibleRects(incrementalRects, fullRects))
+                nListMismatches[nEdit]++;
+            if (!VisibleRectsMatchPixels(stack, incrementalRects))
+                nPixelMismatches[nEdit]++;
+        }
+
+        ZOUT("Visibility ", kEdits, " random edits on ", kVisibilityField, "x", kVisibilityField, ": full resolve ", nFullTime / kEdits, "us  incremental ", nIncrementalTime / kEdits, "us\n");
+        for (int32_t e = 0; e < 5; e++)
+        {
+            if (nListMismatches[e] == 0 && nPixelMismatches[e] == 0)
+                ZOUT("  ", editNames[e], " (", nEditCount[e], "): match\n");
+            else
+                ZOUT("  ", editNames[e], " (", nEditCount[e], "): MISMATCH list:", nListMismatches[e], " pixels:", nPixelMismatches[e], "\n");
+        }
+    }
+
+
+    void RunAll()
+    {
+        Rotate();
+        Scale();
+        Fill();
+        RasterizeSimple();
+        EdgeAntiAlias();
+        SpanMatrix();
+        Lines();
+        Regions();
+        Visibility();
+    }
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ZTypes.h"
+#include <string>
+
+// Timing comparisons between the current ZBuffer/ZRasterizer paths and the implementations they replaced.
+// Results go to the debug console.  Kick off from the control panel ("Benchmarks" button)
+
+namespace Benchmarks
+{
+    const int64_t kImageW = 6000;     // 24MP, typical of a camera jpeg
+    const int64_t kImageH = 4000;
+
+    void RunAll();
+
+    void Rotate();
+    void Scale();
+    void Fill();
+    void RasterizeSimple();
+    void EdgeAntiAlias();
+    void SpanMatrix();
+    void Lines();
+    void Regions();
+    void Visibility();
+};
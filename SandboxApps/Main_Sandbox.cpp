@@ -16,6 +16,9 @@
 #include "3DTestWin.h"
 #include "ZChessWin.h"
 #include "Resources.h"
+#include "Benchmarks.h"
+#include "ZWinWatchPanel.h"
+#include "ZRasterStats.h"
 
 
 using namespace std;
@@ -25,6 +28,7 @@ using namespace std;
 ZMainWin*               gpMainWin;
 ZWinControlPanel*       gpControlPanel;
 ZWinDebugConsole*       gpDebugConsole;
+ZWinWatchPanel*         gpRasterStatsPanel = nullptr;
 
 ZAnimObject_StaticImage* gpOverlay;
 ZGraphicSystem          gGraphicSystem;
@@ -44,6 +48,7 @@ size_t                  gDebugHistoryCounter = 0;
 
 ZMessageSystem          gMessageSystem;
 ZTickManager            gTickManager;
+ZFrameClock             gFrameClock;
 ZAnimator               gAnimator;
 int64_t                 gnCheckerWindowCount = 8;
 int64_t                 gnLifeGridSize = 500;
@@ -109,6 +114,11 @@ void Sandbox::InitControlPanel()
     gpControlPanel->AddSpace(gnControlPanelButtonHeight / 2);
     gpControlPanel->Button("OnePageDoc", "OnePageDoc", "{initchildwindows;mode=11;target=MainAppMessageTarget}");
 
+    gpControlPanel->AddSpace(gnControlPanelButtonHeight / 2);
+    gpControlPanel->Button("Benchmarks", "Benchmarks", "{runbenchmarks;target=MainAppMessageTarget}");
+    gpControlPanel->Button("RasterStats", "Raster Stats", "{togglerasterstats;target=MainAppMessageTarget}");
+    gpControlPanel->Button("DumpRasterStats", "Dump Raster Stats", "{dumprasterstats;target=MainAppMessageTarget}");
+
     gpControlPanel->FitToControls();
 
     gpControlPanel->mTransformIn = ZWin::kToOrFrom;
@@ -181,6 +191,7 @@ void Sandbox::ToggleOverlay()
 
                 pPixels++;
             }
+            gpOverlay->mImage->MarkDirty();
 
 
             gAnimator.AddObject(gpOverlay);
@@ -196,6 +207,35 @@ void Sandbox::ToggleOverlay()
     }
 }
 
+void Sandbox::ToggleRasterStats()
+{
+    if (gpRasterStatsPanel)
+    {
+        gpMainWin->ChildDelete(gpRasterStatsPanel);
+        gpRasterStatsPanel = nullptr;
+        return;
+    }
+
+    // Last frame's totals, upper right
+    ZRasterStats::Frame& frame = ZRasterStats::Get().mLastFrame;
+    int64_t nPanelW = grFullArea.Width() / 6;
+    int64_t nPanelH = gnControlPanelButtonHeight * 10;
+
+    gpRasterStatsPanel = new ZWinWatchPanel();
+    gpRasterStatsPanel->SetArea(ZRect(grFullArea.right - nPanelW, grFullArea.top, grFullArea.right, grFullArea.top + nPanelH));
+    gpRasterStatsPanel->mIdleSleepMS = 250;
+    gpRasterStatsPanel->Init();
+    gpRasterStatsPanel->AddItem(WatchType::kLabel, "Rasterizer (last frame)", nullptr, ZGUI::ZTextLook(ZGUI::ZTextLook::kEmbossed, 0xff000000, 0xff000000));
+    gpRasterStatsPanel->AddItem(WatchType::kInt64, "frame us", &frame.nDurationUS);
+    gpRasterStatsPanel->AddItem(WatchType::kInt64, "pixels", &frame.nPixels);
+    gpRasterStatsPanel->AddItem(WatchType::kInt64, "texels", &frame.nTexels);
+    gpRasterStatsPanel->AddItem(WatchType::kInt64, "primitives", &frame.nPrimitives);
+    gpRasterStatsPanel->AddItem(WatchType::kInt64, "calls", &frame.nCalls);
+    gpRasterStatsPanel->AddItem(WatchType::kInt64, "call us", &frame.nCallUS);
+    gpRasterStatsPanel->AddItem(WatchType::kInt64, "threads", &frame.nMaxThreads);
+    gpMainWin->ChildAdd(gpRasterStatsPanel);
+}
+
 void Sandbox::InitChildWindows(Sandbox::eSandboxMode mode)
 {
     assert(gpControlPanel);     // needs to exist before this
@@ -380,6 +420,20 @@ public:
         {
             gpDebugConsole->SetVisible(!gpDebugConsole->mbVisible);
         }
+        else if (sType == "runbenchmarks")
+        {
+            std::thread(Benchmarks::RunAll).detach();     // results go to the debug console
+        }
+        else if (sType == "togglerasterstats")
+        {
+            Sandbox::ToggleRasterStats();
+        }
+        else if (sType == "dumprasterstats")
+        {
+            string sAppDataPath = gRegistry["appDataPath"];
+            ZRasterStats::Get().ReportToConsole();
+            ZRasterStats::Get().DumpCSV(sAppDataPath + "rasterstats.csv");
+        }
         else if (sType == "toggleoverlay")
         {
             if (gInput.IsKeyDown(VK_CONTROL))
@@ -9,6 +9,7 @@
 
 #include "ZMessageSystem.h"
 #include "ZTickManager.h"
+#include "ZFrameClock.h"
 #include "ZRasterizer.h"
 #include "ZPreferences.h"
 #include "ZAnimator.h"
@@ -37,6 +38,7 @@ namespace Sandbox
     void DeleteAllButControlPanelAndDebugConsole();
     void InitChildWindows(eSandboxMode mode);
     void ToggleOverlay();
+    void ToggleRasterStats();
 
 
     tWinList sandboxWins;
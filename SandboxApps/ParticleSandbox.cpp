@@ -169,22 +169,6 @@ void ParticleSandbox::DrawArrow(ZFPoint start, ZFPoint end, uint32_t col)
     double head_width = head_length*0.66 ;
 
 
-    tColorVertexArray shaft;
-    shaft.resize(4);
-
-    // Compute the rectangle points for the shaft
-    shaft[0].x = x0 - uy * shaft_width / 2;
-    shaft[0].y = y0 + ux * shaft_width / 2;
-    shaft[1].x = x0 + uy * shaft_width / 2;
-    shaft[1].y = y0 - ux * shaft_width / 2;
-    shaft[2].x = shaftx1 + uy * shaft_width / 2;
-    shaft[2].y = shafty1 - ux * shaft_width / 2;
-    shaft[3].x = shaftx1 - uy * shaft_width / 2;
-    shaft[3].y = shafty1 + ux * shaft_width / 2;
-
-    for (int i = 0; i < shaft.size(); i++)
-        shaft[i].mColor = col;
-
     tColorVertexArray head;
     head.resize(3);
 
@@ -200,7 +184,8 @@ void ParticleSandbox::DrawArrow(ZFPoint start, ZFPoint end, uint32_t col)
         head[i].mColor = col;
 
 
-    gRasterizer.Rasterize(mpSurface.get(), shaft);
+    // shaft as an anti-aliased line, head as a triangle
+    mpSurface->DrawAlphaLine(ZColorVertex(x0, y0, col), ZColorVertex(shaftx1, shafty1, col), shaft_width);
     gRasterizer.Rasterize(mpSurface.get(), head);
 }
 
@@ -660,6 +660,7 @@ void cProcessImageWin::NegativeImage(void* pContext)
             *(pJP->pDestImage->GetPixels() + (y * pJP->pThis->mrIntersectionWorkArea.Width()) + x) = ARGB(0xff, nR, nG, nB);
         }
     }
+    pJP->pDestImage->MarkDirty(&pJP->rArea);
 
 }
 
@@ -678,6 +679,7 @@ void cProcessImageWin::Mono(void* pContext)
             *(pJP->pDestImage->GetPixels() + (y * pJP->pThis->mrIntersectionWorkArea.Width()) + x) = ARGB(0xff, nV, nV, nV);
         }
     }
+    pJP->pDestImage->MarkDirty(&pJP->rArea);
 }
 
 
@@ -1549,6 +1549,7 @@ bool ChessPiece::LoadImage(std::string path, int64_t nSize, uint32_t col)
     }
 
     mpImage->mbHasAlphaPixels = true;
+    mpImage->MarkDirty();
 
     return true;
 }
@@ -438,9 +438,9 @@ namespace Z3D
         double scale = 1.0 / tan(angleOfView * 0.5 * M_PI / 180.0); // FOV scaling
         M[0][0] = scale / aspectRatio;  // Correct X scaling
         M[1][1] = scale;  // Y scaling
-        M[2][2] = fFar / (fFar - fNear);  // Depth remap (DirectX style)
+        M[2][2] = -fFar / (fFar - fNear);  // Depth remap to 0 at fNear and 1 at fFar (DirectX style)
         M[3][2] = (-fFar * fNear) / (fFar - fNear);  // Depth offset
-        M[2][3] = 1.0;  // Set W = +Z (not -Z)
+        M[2][3] = -1.0;  // Set W = -Z, LookAt cameras look down -Z
         M[3][3] = 0.0;
     }
 
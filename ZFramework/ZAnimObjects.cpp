@@ -291,6 +291,7 @@ bool ZCEAnimObject_Sparkler::Paint(ZBuffer* pDest)
 	uint32_t* pPixels = pRealDest->GetPixels();
 	int64_t  nStride = pRealDest->GetArea().Width();
     ZRect* pClip = &pRealDest->GetArea();
+    pRealDest->MarkDirty();
 	for (tSparkleList::iterator it = mSparkleList.begin(); it != mSparkleList.end(); it++)
 	{
 		sSparkle& sparkle = *it;
@@ -556,29 +557,32 @@ bool ZAnimObject_BitmapShatterer::Paint(ZBuffer* pDest)
     if (mpDestOverride)
         pRealDest = mpDestOverride.get();
 
+	// All shards go out as one batch
+	mBatch.clear();
 	for (tShatterQuadList::iterator it = mShatterQuadList.begin(); it != mShatterQuadList.end(); it++)
 	{
 		cShatterQuad& quad = *it;
-		cShatterQuad transformedQuad = quad;
+		ZRasterizer::BatchQuad transformedQuad(mpTexture.get(), quad.mVertices, pRealDest->GetArea(), 128, true, ZRasterizer::kEdgeAntiAlias);
 
 		double fCenterX = (quad.mVertices[0].x + quad.mVertices[1].x)/2.0f;
 		double fCenterY = (quad.mVertices[0].y + quad.mVertices[2].y)/2.0f;
+		const double cosAngle(::cos(quad.fRotation));
+		const double sinAngle(::sin(quad.fRotation));
 
 		for (int64_t i = 0; i < 4; i++)
 		{
 			const double x(quad.mVertices[i].x - fCenterX);
 			const double y(quad.mVertices[i].y - fCenterY);
-			const double cosAngle(::cos(quad.fRotation));
-			const double sinAngle(::sin(quad.fRotation));
 
-			transformedQuad.mVertices[i].x = fCenterX + transformedQuad.fScale*(x*cosAngle - y*sinAngle);
-			transformedQuad.mVertices[i].y = fCenterY + transformedQuad.fScale*(x*sinAngle + y*cosAngle);
+			transformedQuad.verts[i].x = fCenterX + quad.fScale*(x*cosAngle - y*sinAngle);
+			transformedQuad.verts[i].y = fCenterY + quad.fScale*(x*sinAngle + y*cosAngle);
 		}
 
-        ZRect* pClip = &pRealDest->GetArea();
-		mRasterizer.RasterizeWithAlpha(pRealDest, mpTexture.get(), transformedQuad.mVertices, pClip, 128);
+		mBatch.push_back(transformedQuad);
 	}
 
+	gRasterizer.RasterizeBatch(pRealDest, mBatch);
+
 	Process(pRealDest->GetArea());
 
 	return true;
@@ -601,7 +605,7 @@ void ZAnimObject_BitmapShatterer::Process(ZRect& rBoundingArea)
 		tShatterQuadList::iterator nextIt = it;
 		nextIt++;
 
-		ZRect rBounds = mRasterizer.GetBoundingRect(quad.mVertices);
+		ZRect rBounds = gRasterizer.GetBoundingRect(quad.mVertices);
 
 		if (rBoundingArea.Overlaps(&rBounds) || quad.fScale < 0.01f)
 		{
@@ -1080,7 +1084,7 @@ bool ZAnimObject_TransformingImage::Paint(ZBuffer* pDest)
         {
             assert(mpWorkingBuffer && mpBackground && mpWorkingBuffer->GetArea() == grFullArea && mpBackground->GetArea() == grFullArea);
             mpWorkingBuffer->CopyPixels(mpBackground.get());
-            gRasterizer.RasterizeWithAlpha(mpWorkingBuffer.get(), mpImage.get(), mVerts, nullptr, mCurTransform.mnAlpha);
+            gRasterizer.RasterizeWithAlpha(mpWorkingBuffer.get(), mpImage.get(), mVerts, nullptr, mCurTransform.mnAlpha, mCurTransform.mRotation != 0 ? ZRasterizer::kEdgeAntiAlias : ZRasterizer::kEdgeAliased);
 //            gpGraphicSystem->GetScreenBuffer()->RenderBuffer(mpWorkingBuffer.get(), grFullArea, grFullArea);
             gpGraphicSystem->GetScreenBuffer()->CopyPixels(mpWorkingBuffer.get());
             return true;
@@ -1114,7 +1118,7 @@ bool ZAnimObject_TransformingImage::Paint(ZBuffer* pDest)
                 if (mpBackground)
                     mpWorkingBuffer->CopyPixels(mpBackground.get());
 
-                gRasterizer.RasterizeWithAlpha(mpWorkingBuffer.get(), mpImage.get(), mVerts, nullptr, mCurTransform.mnAlpha);
+                gRasterizer.RasterizeWithAlpha(mpWorkingBuffer.get(), mpImage.get(), mVerts, nullptr, mCurTransform.mnAlpha, mCurTransform.mRotation != 0 ? ZRasterizer::kEdgeAntiAlias : ZRasterizer::kEdgeAliased);
                 pRealDest->Blt(mpWorkingBuffer.get(), mBounds, mBounds);
             }
         }
@@ -234,7 +234,7 @@ protected:
 
    tShatterQuadList mShatterQuadList;
    tZBufferPtr		mpTexture;
-   ZRasterizer	mRasterizer;
+   ZRasterizer::tBatchQuads mBatch;     // reused every frame
 };
 
 
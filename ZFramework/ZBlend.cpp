@@ -0,0 +1,485 @@
+#include "ZBlend.h"
+#include "ZColor.h"
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ZBLEND_AVX2
+#else
+#define ZBLEND_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef _DEBUG
+#define new new(_NORMAL_BLOCK, THIS_FILE, __LINE__)
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+namespace ZBlend
+{
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Scalar
+
+    template <uint32_t mode>
+    inline uint32_t BlendPixel(uint32_t nSrc, uint32_t nDst, uint32_t nAlpha)
+    {
+        if constexpr (mode == kDest)
+            return COL::AlphaBlend_Col2Alpha(nSrc, nDst, nAlpha);
+        else if constexpr (mode == kSource)
+            return COL::AlphaBlend_Col1Alpha(nSrc, nDst, nAlpha);
+        else
+            return COL::AlphaBlend_BlendAlpha(nSrc, nDst, nAlpha);
+    }
+
+    template <uint32_t mode>
+    inline void SrcAlphaTail(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount)
+    {
+        for (int64_t i = 0; i < nCount; i++)
+        {
+            uint32_t nAlpha = ARGB_A(pSrc[i]);
+            if (nAlpha > kOpaqueThreshold)
+                pDst[i] = pSrc[i];
+            else if (nAlpha > kClearThreshold)
+                pDst[i] = BlendPixel<mode>(pSrc[i], pDst[i], nAlpha);
+        }
+    }
+
+    template <uint32_t mode>
+    inline void ConstAlphaTail(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount, uint32_t nAlpha)
+    {
+        for (int64_t i = 0; i < nCount; i++)
+        {
+            if (ARGB_A(pSrc[i]) != 0)
+                pDst[i] = BlendPixel<mode>(pSrc[i], pDst[i], nAlpha);
+        }
+    }
+
+    template <uint32_t mode>
+    void SrcAlphaSpan_Scalar(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount)
+    {
+        SrcAlphaTail<mode>(pDst, pSrc, nCount);
+    }
+
+    template <uint32_t mode>
+    void ConstAlphaSpan_Scalar(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount, uint32_t nAlpha)
+    {
+        ConstAlphaTail<mode>(pDst, pSrc, nCount, nAlpha);
+    }
+
+    inline void ColorAlphaTail(uint32_t* pDst, int64_t nCount, uint32_t nCol, uint32_t nAlpha)
+    {
+        for (int64_t i = 0; i < nCount; i++)
+            pDst[i] = COL::AlphaBlend_Col2Alpha(nCol, pDst[i], nAlpha);
+    }
+
+    void ColorAlphaSpan_Scalar(uint32_t* pDst, int64_t nCount, uint32_t nCol, uint32_t nAlpha)
+    {
+        ColorAlphaTail(pDst, nCount, nCol, nAlpha);
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // SSE2 - 4 pixels per iteration
+
+    // (s*a + d*(255-a) + 128) >> 8 on 8 16bit channels. Max intermediate is 65153 so no overflow
+    inline __m128i LerpChannels_SSE2(__m128i s16, __m128i d16, __m128i a16)
+    {
+        const __m128i k255 = _mm_set1_epi16(255);
+        const __m128i k128 = _mm_set1_epi16(128);
+        __m128i inv16 = _mm_sub_epi16(k255, a16);
+        __m128i r = _mm_add_epi16(_mm_mullo_epi16(s16, a16), _mm_mullo_epi16(d16, inv16));
+        return _mm_srli_epi16(_mm_add_epi16(r, k128), 8);
+    }
+
+    // replicate each pixel's alpha into all four of its 16bit channels
+    inline __m128i SpreadAlpha_SSE2(__m128i c16)
+    {
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(c16, 0xff), 0xff);
+    }
+
+    // integer lerp of rgb.  Alpha channel taken from dst (kDest) or src (kSource)
+    // pAlpha16 == nullptr means use each src pixel's own alpha
+    template <uint32_t mode>
+    inline __m128i BlendLerp_SSE2(__m128i s, __m128i d, const __m128i* pAlpha16)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i kAlphaMask = _mm_set1_epi32(0xff000000);
+
+        __m128i sLo = _mm_unpacklo_epi8(s, zero);
+        __m128i sHi = _mm_unpackhi_epi8(s, zero);
+        __m128i dLo = _mm_unpacklo_epi8(d, zero);
+        __m128i dHi = _mm_unpackhi_epi8(d, zero);
+
+        __m128i aLo = pAlpha16 ? *pAlpha16 : SpreadAlpha_SSE2(sLo);
+        __m128i aHi = pAlpha16 ? *pAlpha16 : SpreadAlpha_SSE2(sHi);
+
+        __m128i rgb = _mm_packus_epi16(LerpChannels_SSE2(sLo, dLo, aLo), LerpChannels_SSE2(sHi, dHi, aHi));
+
+        __m128i alpha = (mode == kDest) ? d : s;
+        return _mm_or_si128(_mm_andnot_si128(kAlphaMask, rgb), _mm_and_si128(kAlphaMask, alpha));
+    }
+
+    // Same operations, in the same order, as COL::AlphaBlend_BlendAlpha so results match exactly
+    inline __m128i BlendAlpha_SSE2(__m128i s, __m128i d, __m128 fBlend)
+    {
+        const __m128i kFF = _mm_set1_epi32(0xff);
+        const __m128 k255 = _mm_set1_ps(255.0f);
+        const __m128 k65025 = _mm_set1_ps(65025.0f);
+        const __m128 kOne = _mm_set1_ps(1.0f);
+
+        __m128 sA = _mm_cvtepi32_ps(_mm_srli_epi32(s, 24));
+        __m128 sR = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(s, 16), kFF));
+        __m128 sG = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(s, 8), kFF));
+        __m128 sB = _mm_cvtepi32_ps(_mm_and_si128(s, kFF));
+
+        __m128 dA = _mm_cvtepi32_ps(_mm_srli_epi32(d, 24));
+        __m128 dR = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(d, 16), kFF));
+        __m128 dG = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(d, 8), kFF));
+        __m128 dB = _mm_cvtepi32_ps(_mm_and_si128(d, kFF));
+
+        __m128 alphaSrc = _mm_div_ps(_mm_mul_ps(fBlend, sA), k65025);
+        __m128 alphaDst = _mm_div_ps(dA, k255);
+        __m128 invSrc = _mm_sub_ps(kOne, alphaSrc);
+        __m128 alphaResult = _mm_add_ps(alphaSrc, _mm_mul_ps(alphaDst, invSrc));
+
+        __m128i a = _mm_cvttps_epi32(_mm_mul_ps(alphaResult, k255));
+        __m128i r = _mm_cvttps_epi32(_mm_div_ps(_mm_add_ps(_mm_mul_ps(sR, alphaSrc), _mm_mul_ps(_mm_mul_ps(dR, alphaDst), invSrc)), alphaResult));
+        __m128i g = _mm_cvttps_epi32(_mm_div_ps(_mm_add_ps(_mm_mul_ps(sG, alphaSrc), _mm_mul_ps(_mm_mul_ps(dG, alphaDst), invSrc)), alphaResult));
+        __m128i b = _mm_cvttps_epi32(_mm_div_ps(_mm_add_ps(_mm_mul_ps(sB, alphaSrc), _mm_mul_ps(_mm_mul_ps(dB, alphaDst), invSrc)), alphaResult));
+
+        __m128i out = _mm_slli_epi32(_mm_and_si128(a, kFF), 24);
+        out = _mm_or_si128(out, _mm_slli_epi32(_mm_and_si128(r, kFF), 16));
+        out = _mm_or_si128(out, _mm_slli_epi32(_mm_and_si128(g, kFF), 8));
+        return _mm_or_si128(out, _mm_and_si128(b, kFF));
+    }
+
+    template <uint32_t mode>
+    void SrcAlphaSpan_SSE2(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount)
+    {
+        const __m128i kOpaque = _mm_set1_epi32(kOpaqueThreshold);
+        const __m128i kClear = _mm_set1_epi32(kClearThreshold);
+
+        int64_t i = 0;
+        for (; i + 4 <= nCount; i += 4)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i*)(pSrc + i));
+            __m128i sA = _mm_srli_epi32(s, 24);
+
+            __m128i opaqueMask = _mm_cmpgt_epi32(sA, kOpaque);
+            __m128i visibleMask = _mm_cmpgt_epi32(sA, kClear);
+
+            int nOpaqueBits = _mm_movemask_epi8(opaqueMask);
+            if (nOpaqueBits == 0xffff)      // fully opaque run
+            {
+                _mm_storeu_si128((__m128i*)(pDst + i), s);
+                continue;
+            }
+            if (_mm_movemask_epi8(visibleMask) == 0)    // fully transparent run
+                continue;
+
+            __m128i d = _mm_loadu_si128((const __m128i*)(pDst + i));
+            __m128i blended;
+            if constexpr (mode == kBlend)
+                blended = BlendAlpha_SSE2(s, d, _mm_cvtepi32_ps(sA));
+            else
+                blended = BlendLerp_SSE2<mode>(s, d, nullptr);
+
+            __m128i blendMask = _mm_andnot_si128(opaqueMask, visibleMask);
+            __m128i out = _mm_or_si128(_mm_and_si128(opaqueMask, s), _mm_and_si128(blendMask, blended));
+            out = _mm_or_si128(out, _mm_andnot_si128(visibleMask, d));
+            _mm_storeu_si128((__m128i*)(pDst + i), out);
+        }
+
+        SrcAlphaTail<mode>(pDst + i, pSrc + i, nCount - i);
+    }
+
+    template <uint32_t mode>
+    void ConstAlphaSpan_SSE2(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount, uint32_t nAlpha)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i a16 = _mm_set1_epi16((short)nAlpha);
+        const __m128 fBlend = _mm_set1_ps((float)nAlpha);
+
+        int64_t i = 0;
+        for (; i + 4 <= nCount; i += 4)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i*)(pSrc + i));
+            __m128i clearMask = _mm_cmpeq_epi32(_mm_srli_epi32(s, 24), zero);
+
+            int nClearBits = _mm_movemask_epi8(clearMask);
+            if (nClearBits == 0xffff)       // fully transparent run
+                continue;
+
+            __m128i d = _mm_loadu_si128((const __m128i*)(pDst + i));
+            __m128i blended;
+            if constexpr (mode == kBlend)
+                blended = BlendAlpha_SSE2(s, d, fBlend);
+            else
+                blended = BlendLerp_SSE2<mode>(s, d, &a16);
+
+            if (nClearBits != 0)
+                blended = _mm_or_si128(_mm_andnot_si128(clearMask, blended), _mm_and_si128(clearMask, d));
+            _mm_storeu_si128((__m128i*)(pDst + i), blended);
+        }
+
+        ConstAlphaTail<mode>(pDst + i, pSrc + i, nCount - i, nAlpha);
+    }
+
+    void ColorAlphaSpan_SSE2(uint32_t* pDst, int64_t nCount, uint32_t nCol, uint32_t nAlpha)
+    {
+        const __m128i s = _mm_set1_epi32(nCol);
+        const __m128i a16 = _mm_set1_epi16((short)nAlpha);
+
+        int64_t i = 0;
+        for (; i + 4 <= nCount; i += 4)
+        {
+            __m128i d = _mm_loadu_si128((const __m128i*)(pDst + i));
+            _mm_storeu_si128((__m128i*)(pDst + i), BlendLerp_SSE2<kDest>(s, d, &a16));
+        }
+
+        ColorAlphaTail(pDst + i, nCount - i, nCol, nAlpha);
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // AVX2 - 8 pixels per iteration
+    // unpack/pack/shuffle all operate within 128 bit lanes so the SSE2 approach carries over directly
+
+    ZBLEND_AVX2 inline __m256i LerpChannels_AVX2(__m256i s16, __m256i d16, __m256i a16)
+    {
+        const __m256i k255 = _mm256_set1_epi16(255);
+        const __m256i k128 = _mm256_set1_epi16(128);
+        __m256i inv16 = _mm256_sub_epi16(k255, a16);
+        __m256i r = _mm256_add_epi16(_mm256_mullo_epi16(s16, a16), _mm256_mullo_epi16(d16, inv16));
+        return _mm256_srli_epi16(_mm256_add_epi16(r, k128), 8);
+    }
+
+    ZBLEND_AVX2 inline __m256i SpreadAlpha_AVX2(__m256i c16)
+    {
+        return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c16, 0xff), 0xff);
+    }
+
+    template <uint32_t mode>
+    ZBLEND_AVX2 inline __m256i BlendLerp_AVX2(__m256i s, __m256i d, const __m256i* pAlpha16)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i kAlphaMask = _mm256_set1_epi32(0xff000000);
+
+        __m256i sLo = _mm256_unpacklo_epi8(s, zero);
+        __m256i sHi = _mm256_unpackhi_epi8(s, zero);
+        __m256i dLo = _mm256_unpacklo_epi8(d, zero);
+        __m256i dHi = _mm256_unpackhi_epi8(d, zero);
+
+        __m256i aLo = pAlpha16 ? *pAlpha16 : SpreadAlpha_AVX2(sLo);
+        __m256i aHi = pAlpha16 ? *pAlpha16 : SpreadAlpha_AVX2(sHi);
+
+        __m256i rgb = _mm256_packus_epi16(LerpChannels_AVX2(sLo, dLo, aLo), LerpChannels_AVX2(sHi, dHi, aHi));
+
+        __m256i alpha = (mode == kDest) ? d : s;
+        return _mm256_or_si256(_mm256_andnot_si256(kAlphaMask, rgb), _mm256_and_si256(kAlphaMask, alpha));
+    }
+
+    ZBLEND_AVX2 inline __m256i BlendAlpha_AVX2(__m256i s, __m256i d, __m256 fBlend)
+    {
+        const __m256i kFF = _mm256_set1_epi32(0xff);
+        const __m256 k255 = _mm256_set1_ps(255.0f);
+        const __m256 k65025 = _mm256_set1_ps(65025.0f);
+        const __m256 kOne = _mm256_set1_ps(1.0f);
+
+        __m256 sA = _mm256_cvtepi32_ps(_mm256_srli_epi32(s, 24));
+        __m256 sR = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(s, 16), kFF));
+        __m256 sG = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(s, 8), kFF));
+        __m256 sB = _mm256_cvtepi32_ps(_mm256_and_si256(s, kFF));
+
+        __m256 dA = _mm256_cvtepi32_ps(_mm256_srli_epi32(d, 24));
+        __m256 dR = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(d, 16), kFF));
+        __m256 dG = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(d, 8), kFF));
+        __m256 dB = _mm256_cvtepi32_ps(_mm256_and_si256(d, kFF));
+
+        __m256 alphaSrc = _mm256_div_ps(_mm256_mul_ps(fBlend, sA), k65025);
+        __m256 alphaDst = _mm256_div_ps(dA, k255);
+        __m256 invSrc = _mm256_sub_ps(kOne, alphaSrc);
+        __m256 alphaResult = _mm256_add_ps(alphaSrc, _mm256_mul_ps(alphaDst, invSrc));
+
+        __m256i a = _mm256_cvttps_epi32(_mm256_mul_ps(alphaResult, k255));
+        __m256i r = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(sR, alphaSrc), _mm256_mul_ps(_mm256_mul_ps(dR, alphaDst), invSrc)), alphaResult));
+        __m256i g = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(sG, alphaSrc), _mm256_mul_ps(_mm256_mul_ps(dG, alphaDst), invSrc)), alphaResult));
+        __m256i b = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(sB, alphaSrc), _mm256_mul_ps(_mm256_mul_ps(dB, alphaDst), invSrc)), alphaResult));
+
+        __m256i out = _mm256_slli_epi32(_mm256_and_si256(a, kFF), 24);
+        out = _mm256_or_si256(out, _mm256_slli_epi32(_mm256_and_si256(r, kFF), 16));
+        out = _mm256_or_si256(out, _mm256_slli_epi32(_mm256_and_si256(g, kFF), 8));
+        return _mm256_or_si256(out, _mm256_and_si256(b, kFF));
+    }
+
+    template <uint32_t mode>
+    ZBLEND_AVX2 void SrcAlphaSpan_AVX2(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount)
+    {
+        const __m256i kOpaque = _mm256_set1_epi32(kOpaqueThreshold);
+        const __m256i kClear = _mm256_set1_epi32(kClearThreshold);
+
+        int64_t i = 0;
+        for (; i + 8 <= nCount; i += 8)
+        {
+            __m256i s = _mm256_loadu_si256((const __m256i*)(pSrc + i));
+            __m256i sA = _mm256_srli_epi32(s, 24);
+
+            __m256i opaqueMask = _mm256_cmpgt_epi32(sA, kOpaque);
+            __m256i visibleMask = _mm256_cmpgt_epi32(sA, kClear);
+
+            if (_mm256_movemask_epi8(opaqueMask) == -1)     // fully opaque run
+            {
+                _mm256_storeu_si256((__m256i*)(pDst + i), s);
+                continue;
+            }
+            if (_mm256_movemask_epi8(visibleMask) == 0)     // fully transparent run
+                continue;
+
+            __m256i d = _mm256_loadu_si256((const __m256i*)(pDst + i));
+            __m256i blended;
+            if constexpr (mode == kBlend)
+                blended = BlendAlpha_AVX2(s, d, _mm256_cvtepi32_ps(sA));
+            else
+                blended = BlendLerp_AVX2<mode>(s, d, nullptr);
+
+            __m256i out = _mm256_blendv_epi8(d, blended, visibleMask);
+            out = _mm256_blendv_epi8(out, s, opaqueMask);
+            _mm256_storeu_si256((__m256i*)(pDst + i), out);
+        }
+
+        SrcAlphaTail<mode>(pDst + i, pSrc + i, nCount - i);
+    }
+
+    template <uint32_t mode>
+    ZBLEND_AVX2 void ConstAlphaSpan_AVX2(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount, uint32_t nAlpha)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i a16 = _mm256_set1_epi16((short)nAlpha);
+        const __m256 fBlend = _mm256_set1_ps((float)nAlpha);
+
+        int64_t i = 0;
+        for (; i + 8 <= nCount; i += 8)
+        {
+            __m256i s = _mm256_loadu_si256((const __m256i*)(pSrc + i));
+            __m256i clearMask = _mm256_cmpeq_epi32(_mm256_srli_epi32(s, 24), zero);
+
+            int nClearBits = _mm256_movemask_epi8(clearMask);
+            if (nClearBits == -1)       // fully transparent run
+                continue;
+
+            __m256i d = _mm256_loadu_si256((const __m256i*)(pDst + i));
+            __m256i blended;
+            if constexpr (mode == kBlend)
+                blended = BlendAlpha_AVX2(s, d, fBlend);
+            else
+                blended = BlendLerp_AVX2<mode>(s, d, &a16);
+
+            if (nClearBits != 0)
+                blended = _mm256_blendv_epi8(blended, d, clearMask);
+            _mm256_storeu_si256((__m256i*)(pDst + i), blended);
+        }
+
+        ConstAlphaTail<mode>(pDst + i, pSrc + i, nCount - i, nAlpha);
+    }
+
+    ZBLEND_AVX2 void ColorAlphaSpan_AVX2(uint32_t* pDst, int64_t nCount, uint32_t nCol, uint32_t nAlpha)
+    {
+        const __m256i s = _mm256_set1_epi32(nCol);
+        const __m256i a16 = _mm256_set1_epi16((short)nAlpha);
+
+        int64_t i = 0;
+        for (; i + 8 <= nCount; i += 8)
+        {
+            __m256i d = _mm256_loadu_si256((const __m256i*)(pDst + i));
+            _mm256_storeu_si256((__m256i*)(pDst + i), BlendLerp_AVX2<kDest>(s, d, &a16));
+        }
+
+        ColorAlphaTail(pDst + i, nCount - i, nCol, nAlpha);
+    }
+
+
+    ////////////////////////////////////////////////////////////////////////////////////////
+    // Dispatch
+
+    const Kernels kScalarKernels =
+    {
+        kScalar,
+        { &SrcAlphaSpan_Scalar<kDest>, &SrcAlphaSpan_Scalar<kSource>, &SrcAlphaSpan_Scalar<kBlend> },
+        { &ConstAlphaSpan_Scalar<kDest>, &ConstAlphaSpan_Scalar<kSource>, &ConstAlphaSpan_Scalar<kBlend> },
+        &ColorAlphaSpan_Scalar
+    };
+
+    const Kernels kSSE2Kernels =
+    {
+        kSSE2,
+        { &SrcAlphaSpan_SSE2<kDest>, &SrcAlphaSpan_SSE2<kSource>, &SrcAlphaSpan_SSE2<kBlend> },
+        { &ConstAlphaSpan_SSE2<kDest>, &ConstAlphaSpan_SSE2<kSource>, &ConstAlphaSpan_SSE2<kBlend> },
+        &ColorAlphaSpan_SSE2
+    };
+
+    const Kernels kAVX2Kernels =
+    {
+        kAVX2,
+        { &SrcAlphaSpan_AVX2<kDest>, &SrcAlphaSpan_AVX2<kSource>, &SrcAlphaSpan_AVX2<kBlend> },
+        { &ConstAlphaSpan_AVX2<kDest>, &ConstAlphaSpan_AVX2<kSource>, &ConstAlphaSpan_AVX2<kBlend> },
+        &ColorAlphaSpan_AVX2
+    };
+
+    eISA DetectISA()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        int nMaxLeaf = info[0];
+
+        __cpuid(info, 1);
+        bool bOSXSave = (info[2] & (1 << 27)) != 0;
+        bool bAVX = (info[2] & (1 << 28)) != 0;
+
+        bool bAVX2 = false;
+        if (nMaxLeaf >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            bAVX2 = (info[1] & (1 << 5)) != 0;
+        }
+
+        // OS must be saving the YMM registers
+        if (bOSXSave && bAVX && bAVX2 && (_xgetbv(0) & 0x6) == 0x6)
+            return kAVX2;
+#else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return kAVX2;
+#endif
+        return kSSE2;   // baseline for x64
+    }
+
+    const char* ISAName(eISA isa)
+    {
+        switch (isa)
+        {
+        case kAVX2: return "AVX2";
+        case kSSE2: return "SSE2";
+        default:    return "Scalar";
+        }
+    }
+
+    const Kernels& Get(eISA isa)
+    {
+        static const eISA supported = DetectISA();
+        if (isa > supported)
+            isa = supported;
+
+        if (isa == kAVX2)
+            return kAVX2Kernels;
+        if (isa == kSSE2)
+            return kSSE2Kernels;
+        return kScalarKernels;
+    }
+
+    const Kernels& Get()
+    {
+        static const Kernels& kernels = Get(DetectISA());
+        return kernels;
+    }
+};
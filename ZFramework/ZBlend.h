@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ZTypes.h"
+
+// Span blending kernels used by ZBuffer::BltNoClip / BltAlphaNoClip / FillAlpha
+// Kernels are selected once (scalar, SSE2 or AVX2) based on what the CPU supports
+// Results are bit identical to the COL::AlphaBlend_XXX functions they replace
+
+namespace ZBlend
+{
+    // Thresholds shared by every implementation
+    const uint32_t kOpaqueThreshold = 250;       // src alpha above this copies
+    const uint32_t kClearThreshold  = 8;         // src alpha at or below this is skipped
+
+    // matches ZBuffer::eAlphaBlendType
+    enum eBlendMode : uint32_t
+    {
+        kDest       = 0,        // COL::AlphaBlend_Col2Alpha
+        kSource     = 1,        // COL::AlphaBlend_Col1Alpha
+        kBlend      = 2,        // COL::AlphaBlend_BlendAlpha
+        kNumModes   = 3
+    };
+
+    enum eISA : uint32_t
+    {
+        kScalar     = 0,
+        kSSE2       = 1,
+        kAVX2       = 2
+    };
+
+    // Blends using each source pixel's own alpha.  alpha > 250 copies, alpha <= 8 leaves dest untouched
+    typedef void (*tSrcAlphaSpanFunc)(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount);
+
+    // Blends using a constant alpha for every source pixel that has non-zero alpha
+    typedef void (*tConstAlphaSpanFunc)(uint32_t* pDst, const uint32_t* pSrc, int64_t nCount, uint32_t nAlpha);
+
+    // Blends a single color over every dest pixel, keeping dest alpha (COL::AlphaBlend_Col2Alpha)
+    typedef void (*tColorAlphaSpanFunc)(uint32_t* pDst, int64_t nCount, uint32_t nCol, uint32_t nAlpha);
+
+    struct Kernels
+    {
+        eISA                isa;
+        tSrcAlphaSpanFunc   srcAlpha[kNumModes];
+        tConstAlphaSpanFunc constAlpha[kNumModes];
+        tColorAlphaSpanFunc colorAlpha;
+    };
+
+    const Kernels&  Get();                      // resolved on first call
+    const Kernels&  Get(eISA isa);              // specific implementation (for comparing/benchmarking). Falls back if unsupported
+    eISA            DetectISA();
+    const char*     ISAName(eISA isa);
+};
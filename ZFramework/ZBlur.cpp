@@ -0,0 +1,295 @@
+#include "ZBlur.h"
+#include "ZColor.h"
+#include <vector>
+#include <future>
+#include <math.h>
+
+#ifdef _DEBUG
+#define new new(_NORMAL_BLOCK, THIS_FILE, __LINE__)
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+namespace ZBlur
+{
+    const uint32_t kFixedShift  = 16;
+    const uint32_t kFixedOne    = 1 << kFixedShift;
+    const uint32_t kFixedHalf   = kFixedOne >> 1;
+    const int64_t  kNumBoxes    = 3;
+    const int64_t  kColumnBlock = 16;           // columns the vertical pass moves per row access, one cache line of pixels
+
+    struct Kernel
+    {
+        bool                    bBox = false;
+
+        // gaussian
+        std::vector<uint32_t>   weights;            // fixed point, sum to kFixedOne
+        int64_t                 nRadius = 0;
+
+        // box approximation
+        int64_t                 boxRadius[kNumBoxes] = {};
+        uint32_t                boxRecip[kNumBoxes] = {};
+    };
+
+
+    static void BuildGaussian(Kernel& k, float fRadius, float fFalloff)
+    {
+        float sigma = fRadius / 3.0f;
+        int64_t kernelSize = int64_t(6 * sigma) + 1;
+        if (kernelSize % 2 == 0)
+            kernelSize++;
+
+        int64_t kernelRadius = kernelSize / 2;
+
+        std::vector<float> fWeights(kernelSize);
+        float sum = 0.0f;
+        for (int64_t i = 0; i < kernelSize; i++)
+        {
+            int64_t x = i - kernelRadius;
+            fWeights[i] = expf(-(x * x * fFalloff) / (2.0f * sigma * sigma));
+            sum += fWeights[i];
+        }
+
+        // quantize.  Center tap absorbs the rounding so the total is exactly kFixedOne
+        std::vector<uint32_t> weights(kernelSize);
+        uint32_t nTotal = 0;
+        for (int64_t i = 0; i < kernelSize; i++)
+        {
+            weights[i] = (uint32_t)(fWeights[i] / sum * kFixedOne + 0.5f);
+            nTotal += weights[i];
+        }
+        weights[kernelRadius] += (int32_t)(kFixedOne - nTotal);
+
+        // drop tails that quantized to nothing
+        int64_t nTrim = 0;
+        while (nTrim < kernelRadius && weights[nTrim] == 0)
+            nTrim++;
+
+        k.bBox = false;
+        k.nRadius = kernelRadius - nTrim;
+        k.weights.assign(weights.begin() + nTrim, weights.end() - nTrim);
+    }
+
+    // Box widths whose three successive passes best match a gaussian of sigma
+    // http://blog.ivank.net/fastest-gaussian-blur.html
+    static void BuildBoxes(Kernel& k, float fRadius, float fFalloff)
+    {
+        double sigma = (fRadius / 3.0) / sqrt(std::max<double>(fFalloff, 0.01));
+
+        double wIdeal = sqrt((12.0 * sigma * sigma / kNumBoxes) + 1.0);
+        int64_t wl = (int64_t)floor(wIdeal);
+        if (wl % 2 == 0)
+            wl--;
+        if (wl < 1)
+            wl = 1;
+        int64_t wu = wl + 2;
+
+        double mIdeal = (12.0 * sigma * sigma - kNumBoxes * wl * wl - 4.0 * kNumBoxes * wl - 3.0 * kNumBoxes) / (-4.0 * wl - 4.0);
+        int64_t m = (int64_t)round(mIdeal);
+
+        k.bBox = true;
+        for (int64_t i = 0; i < kNumBoxes; i++)
+        {
+            int64_t w = (i < m) ? wl : wu;
+            k.boxRadius[i] = (w - 1) / 2;
+            k.boxRecip[i] = kFixedOne / (uint32_t)w;      // rounded down so a full window of 255 can't exceed 255
+        }
+    }
+
+
+    static void GaussianLine(const uint32_t* pIn, uint32_t* pOut, int64_t nOutStride, int64_t nCount, const Kernel& k)
+    {
+        const uint32_t* pWeights = k.weights.data();
+        int64_t r = k.nRadius;
+
+        for (int64_t i = 0; i < nCount; i++)
+        {
+            int64_t nFirst = std::max<int64_t>(i - r, 0);
+            int64_t nLast = std::min<int64_t>(i + r, nCount - 1);
+
+            uint32_t a = kFixedHalf, red = kFixedHalf, g = kFixedHalf, b = kFixedHalf;
+            const uint32_t* pW = pWeights + (nFirst - (i - r));
+            for (int64_t j = nFirst; j <= nLast; j++)
+            {
+                uint32_t nCol = pIn[j];
+                uint32_t w = *pW++;
+                a   += ARGB_A(nCol) * w;
+                red += ARGB_R(nCol) * w;
+                g   += ARGB_G(nCol) * w;
+                b   += ARGB_B(nCol) * w;
+            }
+
+            pOut[i * nOutStride] = ARGB(a >> kFixedShift, red >> kFixedShift, g >> kFixedShift, b >> kFixedShift);
+        }
+    }
+
+    // sliding window sum.  Pixels beyond the ends count as zero
+    static void BoxLine(const uint32_t* pIn, uint32_t* pOut, int64_t nOutStride, int64_t nCount, int64_t r, uint32_t nRecip)
+    {
+        uint32_t a = 0, red = 0, g = 0, b = 0;
+        for (int64_t j = 0; j < r && j < nCount; j++)
+        {
+            uint32_t nCol = pIn[j];
+            a += ARGB_A(nCol);
+            red += ARGB_R(nCol);
+            g += ARGB_G(nCol);
+            b += ARGB_B(nCol);
+        }
+
+        for (int64_t i = 0; i < nCount; i++)
+        {
+            if (i + r < nCount)
+            {
+                uint32_t nCol = pIn[i + r];
+                a += ARGB_A(nCol);
+                red += ARGB_R(nCol);
+                g += ARGB_G(nCol);
+                b += ARGB_B(nCol);
+            }
+            if (i - r - 1 >= 0)
+            {
+                uint32_t nCol = pIn[i - r - 1];
+                a -= ARGB_A(nCol);
+                red -= ARGB_R(nCol);
+                g -= ARGB_G(nCol);
+                b -= ARGB_B(nCol);
+            }
+
+            pOut[i * nOutStride] = ARGB(
+                (a * nRecip + kFixedHalf) >> kFixedShift,
+                (red * nRecip + kFixedHalf) >> kFixedShift,
+                (g * nRecip + kFixedHalf) >> kFixedShift,
+                (b * nRecip + kFixedHalf) >> kFixedShift);
+        }
+    }
+
+    // Filters one strided line in place.  pScratch must hold 2*nCount pixels
+    static void FilterLine(uint32_t* pLine, int64_t nStride, int64_t nCount, const Kernel& k, uint32_t* pScratch)
+    {
+        uint32_t* pA = pScratch;
+        uint32_t* pB = pScratch + nCount;
+
+        for (int64_t i = 0; i < nCount; i++)
+            pA[i] = pLine[i * nStride];
+
+        if (k.bBox)
+        {
+            BoxLine(pA, pB, 1, nCount, k.boxRadius[0], k.boxRecip[0]);
+            BoxLine(pB, pA, 1, nCount, k.boxRadius[1], k.boxRecip[1]);
+            BoxLine(pA, pLine, nStride, nCount, k.boxRadius[2], k.boxRecip[2]);
+        }
+        else
+        {
+            GaussianLine(pA, pLine, nStride, nCount, k);
+        }
+    }
+
+    // lines [nFirst, nLast) each nCount long. Line n starts at pPixels + n*nLineStep
+    static void FilterLines(uint32_t* pPixels, int64_t nLineStep, int64_t nPixelStep, int64_t nCount, int64_t nFirst, int64_t nLast, const Kernel* pKernel)
+    {
+        std::vector<uint32_t> scratch(nCount * 2);
+        for (int64_t n = nFirst; n < nLast; n++)
+            FilterLine(pPixels + n * nLineStep, nPixelStep, nCount, *pKernel, scratch.data());
+    }
+
+    // Columns [nFirst, nLast), each nCount rows of nStride. Walking a column directly misses the cache on every tap, so
+    // blocks of adjacent columns are transposed into scratch a row at a time, filtered as contiguous lines and written back.
+    static void FilterColumns(uint32_t* pPixels, int64_t nStride, int64_t nCount, int64_t nFirst, int64_t nLast, const Kernel* pKernel)
+    {
+        std::vector<uint32_t> block(nCount * kColumnBlock);
+        std::vector<uint32_t> scratch(nCount * 2);
+        for (int64_t nCol = nFirst; nCol < nLast; nCol += kColumnBlock)
+        {
+            int64_t nCols = std::min<int64_t>(kColumnBlock, nLast - nCol);
+
+            for (int64_t y = 0; y < nCount; y++)
+            {
+                const uint32_t* pRow = pPixels + y * nStride + nCol;
+                for (int64_t c = 0; c < nCols; c++)
+                    block[c * nCount + y] = pRow[c];
+            }
+
+            for (int64_t c = 0; c < nCols; c++)
+                FilterLine(&block[c * nCount], 1, nCount, *pKernel, scratch.data());
+
+            for (int64_t y = 0; y < nCount; y++)
+            {
+                uint32_t* pRow = pPixels + y * nStride + nCol;
+                for (int64_t c = 0; c < nCols; c++)
+                    pRow[c] = block[c * nCount + y];
+            }
+        }
+    }
+
+    static void RunRows(uint32_t* pPixels, int64_t nStride, int64_t nWidth, int64_t nHeight, const Kernel& k, ThreadPool* pPool)
+    {
+        int64_t nTiles = 1;
+        if (pPool && nWidth * nHeight >= kMinPixelsToThread)
+            nTiles = std::min<int64_t>(nHeight, (int64_t)pPool->size() * 4);      // a few tiles per thread to even out the load
+
+        if (nTiles <= 1)
+        {
+            FilterLines(pPixels, nStride, 1, nWidth, 0, nHeight, &k);
+            return;
+        }
+
+        std::vector<std::future<void>> tiles;
+        tiles.reserve(nTiles);
+        for (int64_t t = 0; t < nTiles; t++)
+        {
+            int64_t nFirst = nHeight * t / nTiles;
+            int64_t nLast = nHeight * (t + 1) / nTiles;
+            tiles.emplace_back(pPool->enqueue(&FilterLines, pPixels, nStride, 1, nWidth, nFirst, nLast, &k));
+        }
+
+        for (auto& tile : tiles)
+            tile.wait();
+    }
+
+    static void RunColumns(uint32_t* pPixels, int64_t nStride, int64_t nWidth, int64_t nHeight, const Kernel& k, ThreadPool* pPool)
+    {
+        // tiles are whole column blocks so no two threads write the same cache line
+        int64_t nBlocks = (nWidth + kColumnBlock - 1) / kColumnBlock;
+        int64_t nTiles = 1;
+        if (pPool && nWidth * nHeight >= kMinPixelsToThread)
+            nTiles = std::min<int64_t>(nBlocks, (int64_t)pPool->size() * 4);
+
+        if (nTiles <= 1)
+        {
+            FilterColumns(pPixels, nStride, nHeight, 0, nWidth, &k);
+            return;
+        }
+
+        std::vector<std::future<void>> tiles;
+        tiles.reserve(nTiles);
+        for (int64_t t = 0; t < nTiles; t++)
+        {
+            int64_t nFirst = (nBlocks * t / nTiles) * kColumnBlock;
+            int64_t nLast = std::min<int64_t>((nBlocks * (t + 1) / nTiles) * kColumnBlock, nWidth);
+            tiles.emplace_back(pPool->enqueue(&FilterColumns, pPixels, nStride, nHeight, nFirst, nLast, &k));
+        }
+
+        for (auto& tile : tiles)
+            tile.wait();
+    }
+
+    bool Blur(uint32_t* pPixels, int64_t nStride, const ZRect& rArea, float fRadius, float fFalloff, ThreadPool* pPool)
+    {
+        if (!pPixels || rArea.Width() <= 0 || rArea.Height() <= 0 || fRadius <= 0.0f)
+            return false;
+
+        Kernel k;
+        if (fRadius >= kBoxApproxMinRadius)
+            BuildBoxes(k, fRadius, fFalloff);
+        else
+            BuildGaussian(k, fRadius, fFalloff);
+
+        uint32_t* pStart = pPixels + rArea.top * nStride + rArea.left;
+
+        // horizontal over rows, then vertical over column blocks
+        RunRows(pStart, nStride, rArea.Width(), rArea.Height(), k, pPool);
+        RunColumns(pStart, nStride, rArea.Width(), rArea.Height(), k, pPool);
+
+        return true;
+    }
+};
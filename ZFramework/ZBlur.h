@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ZTypes.h"
+#include "helpers/ThreadPool.h"
+
+// Separable blur engine used by ZBuffer::Blur
+// Horizontal pass over row tiles then vertical pass over tiles of column blocks, all in integer fixed point.
+// Small radii convolve with a gaussian kernel. Above kBoxApproxMinRadius the gaussian is approximated
+// with three sliding box passes whose cost per pixel doesn't depend on the radius.
+
+namespace ZBlur
+{
+    const float     kBoxApproxMinRadius = 12.0f;
+    const int64_t   kMinPixelsToThread  = 128 * 128;      // below this everything runs on the calling thread
+
+    // Blurs rArea of a 32bit ARGB surface in place. Taps outside of rArea contribute nothing.
+    // Falloff scales the gaussian exponent (higher is tighter).  pPool == nullptr runs single threaded
+    bool Blur(uint32_t* pPixels, int64_t nStride, const ZRect& rArea, float fRadius, float fFalloff = 1.0f, ThreadPool* pPool = nullptr);
+};
@@ -3,10 +3,18 @@
 #include <filesystem>
 #include "ZMemBuffer.h"
 #include "ZColor.h"
+#include "ZBlend.h"
+#include "ZBlur.h"
+#include "ZPixelPool.h"
+#include "ZJpeg.h"
 #include "helpers/StringHelpers.h"
 #include "ZRasterizer.h"
+#include "ZTimer.h"
 #include <math.h>
+#include <cfloat>
 #include <fstream>
+#include <functional>
+#include <future>
 #include "easyexif/exif.h"
 #include "lunasvg.h"
 #include "mio/mmap.hpp"
@@ -14,6 +22,11 @@
 #include <omp.h>
 #include <immintrin.h>
 
+// stb_image allocates through the pixel pool so a decoded image can be adopted as mpPixels without another copy
+#define STBI_MALLOC(sz)         ((void*)ZPixelPool::Alloc(std::max<int64_t>(((int64_t)(sz) + 3) / 4, 1)))
+#define STBI_REALLOC(p, newsz)  ((void*)ZPixelPool::Realloc((uint32_t*)(p), std::max<int64_t>(((int64_t)(newsz) + 3) / 4, 1)))
+#define STBI_FREE(p)            ZPixelPool::Free((uint32_t*)(p))
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -37,11 +50,41 @@ static char THIS_FILE[] = __FILE__;
 #endif
 
 
+// Splits [0, nCount) into ranges and runs them on the render pool.  Small jobs stay on the calling thread
+static void ParallelRanges(int64_t nCount, int64_t nWorkPixels, const std::function<void(int64_t, int64_t)>& func)
+{
+    const int64_t kMinPixelsToThread = 512 * 512;
+
+    int64_t nRanges = 1;
+    if (nWorkPixels >= kMinPixelsToThread)
+        nRanges = std::min<int64_t>(nCount, (int64_t)gRasterizer.renderPool.size() * 2);
+
+    if (nRanges <= 1)
+    {
+        func(0, nCount);
+        return;
+    }
+
+    std::vector<std::future<void>> results;
+    results.reserve(nRanges);
+    for (int64_t r = 0; r < nRanges; r++)
+        results.emplace_back(gRasterizer.renderPool.enqueue(func, nCount * r / nRanges, nCount * (r + 1) / nRanges));
+
+    for (auto& result : results)
+        result.wait();
+}
+
+
 ZBuffer::ZBuffer()
 {
 	mpPixels                = NULL;
     mRenderState            = kFreeToModify;
     mbHasAlphaPixels = false;
+    mbMipChainValid = false;
+    mnLoadReduction = 1;
+    mnTilesX = 0;
+    mnTilesY = 0;
+    mbTilesClassified = false;
 	mSurfaceArea.Set(0,0,0,0);
 }
 
@@ -62,26 +105,42 @@ bool ZBuffer::Init(int64_t nWidth, int64_t nHeight)
 {
     const std::lock_guard<std::recursive_mutex> lock(mMutex);
 
-
 	ZASSERT(nWidth > 0 && nHeight > 0);
+    if (!AllocPixels(nWidth, nHeight))
+        return false;
+
+    Fill(0);
+    return true;
+}
+
+// Sizes the surface without clearing it, for callers about to overwrite every pixel
+bool ZBuffer::AllocPixels(int64_t nWidth, int64_t nHeight)
+{
+    const std::lock_guard<std::recursive_mutex> lock(mMutex);
+    InvalidateMipChain();
+
 	if (nWidth > 0 && nHeight > 0)
 	{
         if (!mpPixels || nWidth * nHeight != mSurfaceArea.Width() * mSurfaceArea.Height())   // if the number of pixels hasn't changed, no need to reallocate
         {
-            delete[] mpPixels;
-            mpPixels = new uint32_t[nWidth * nHeight];
+            ZPixelPool::Free(mpPixels);
+            mpPixels = ZPixelPool::Alloc(nWidth * nHeight);
+            if (!mpPixels)
+            {
+                mSurfaceArea.Set(0, 0, 0, 0);
+                return false;
+            }
         }
 
 		mSurfaceArea.Set(0, 0, nWidth, nHeight);
-//        memset(mpPixels, 0, nWidth * nHeight * sizeof(uint32_t));
-        Fill(0);
         mbHasAlphaPixels = false;
+        ResetTileMap();
 
 		return true;
 	}
     else
     {
-        delete[] mpPixels;
+        ZPixelPool::Free(mpPixels);
         mpPixels = nullptr;
     }
 
@@ -89,12 +148,38 @@ bool ZBuffer::Init(int64_t nWidth, int64_t nHeight)
 	return false;
 }
 
+// Takes ownership of a ZPixelPool block holding nWidth x nHeight pixels
+bool ZBuffer::AdoptPixels(uint32_t* pPixels, int64_t nWidth, int64_t nHeight)
+{
+    const std::lock_guard<std::recursive_mutex> lock(mMutex);
+    InvalidateMipChain();
+
+    if (!pPixels || nWidth < 1 || nHeight < 1)
+        return false;
+
+    if (pPixels != mpPixels)
+        ZPixelPool::Free(mpPixels);
+
+    mpPixels = pPixels;
+    mSurfaceArea.Set(0, 0, nWidth, nHeight);
+    mbHasAlphaPixels = false;
+    ResetTileMap();
+    return true;
+}
+
 bool ZBuffer::Shutdown()
 {
     const std::lock_guard<std::recursive_mutex> lock(mMutex);
+    InvalidateMipChain();
+    mMipChain.clear();
+    mTileOpacity.reset();
+    mnTilesX = 0;
+    mnTilesY = 0;
+    mbTilesClassified = false;
+    mDepth.clear();
     if (mpPixels)
 	{
-		delete[] mpPixels;
+		ZPixelPool::Free(mpPixels);
 		mpPixels = NULL;
 	}
 
@@ -102,7 +187,45 @@ bool ZBuffer::Shutdown()
 };
 
 
-bool ZBuffer::LoadBuffer(const string& sFilename)
+// stb's RGBA byte order to ARGB in place.  Returns true if any pixel isn't fully opaque
+static bool SwizzleRGBAToARGB(uint32_t* pPixels, int64_t nCount)
+{
+    std::atomic<bool> bHasAlpha = false;
+
+    ParallelRanges(nCount / 4, nCount, [&](int64_t nFirst, int64_t nLast)
+    {
+        const __m128i agMask = _mm_set1_epi32(0xff00ff00);
+        const __m128i rbMask = _mm_set1_epi32(0x00ff00ff);
+        const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+        __m128i alphaAnd = alphaMask;
+
+        __m128i* p = (__m128i*)(pPixels + nFirst * 4);
+        __m128i* pEnd = (__m128i*)(pPixels + nLast * 4);
+        for (; p < pEnd; p++)
+        {
+            __m128i col = _mm_loadu_si128(p);
+            __m128i rb = _mm_and_si128(col, rbMask);
+            rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+            _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(col, agMask), rb));
+            alphaAnd = _mm_and_si128(alphaAnd, col);
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alphaAnd, alphaMask)) != 0xffff)
+            bHasAlpha = true;
+    });
+
+    for (int64_t i = (nCount / 4) * 4; i < nCount; i++)
+    {
+        uint32_t col = pPixels[i];
+        pPixels[i] = (col & 0xff00ff00) | ((col & 0x00ff0000) >> 16) | ((col & 0x000000ff) << 16);
+        if ((col & 0xff000000) != 0xff000000)
+            bHasAlpha = true;
+    }
+
+    return bHasAlpha;
+}
+
+bool ZBuffer::LoadBuffer(const string& sFilename, int64_t nMinWidth, int64_t nMinHeight)
 {
     std::filesystem::path filename(sFilename);
 
@@ -134,6 +257,9 @@ bool ZBuffer::LoadBuffer(const string& sFilename)
 //    imageBuf->seekp(nFileSize);
 
 
+    int64_t nStartTime = gTimer.GetUSSinceEpoch();
+    mLoadTimings = {};
+
     mio::mmap_source ro_mmap;
     std::error_code error;
     ro_mmap.map(sFilename, error);
@@ -149,53 +275,87 @@ bool ZBuffer::LoadBuffer(const string& sFilename)
     mEXIF.clear();
     if (sExt == ".jpg" || sExt == ".jpeg")
         mEXIF.parseFrom(pScanFileData, nFileSize);
-    
-
-
 
+    int64_t nTime = gTimer.GetUSSinceEpoch();
+    mLoadTimings.nOpenUS = nTime - nStartTime;
 
+    // the hint is in displayed orientation. EXIF orientations 5-8 swap the axes of the stored image
+    bool bSizeHint = nMinWidth > 0 || nMinHeight > 0;
+    if (mEXIF.Orientation >= kLeftAndVFlip)
+        std::swap(nMinWidth, nMinHeight);
 
-//    uint8_t* pImage = stbi_load(sFilename.c_str(), &width, &height, &channels, 4);
-    uint8_t* pImage = stbi_load_from_memory(pScanFileData, nFileSize, &width, &height, &channels, 4);
-    if (!pImage)
+    // reduced jpeg decode straight from the DCT coefficients
+    uint32_t* pImage = nullptr;
+    int64_t nReduction = 1;
+    if (bSizeHint && (sExt == ".jpg" || sExt == ".jpeg"))
     {
-        ZDEBUG_OUT("ZBuffer::LoadBuffer failed to load ", sFilename, "\n");
-        return false;
+        int64_t nJpegW;
+        int64_t nJpegH;
+        if (ZJpeg::ReadHeader(pScanFileData, nFileSize, nJpegW, nJpegH))
+        {
+            nReduction = ZJpeg::ReductionForSize(nJpegW, nJpegH, nMinWidth, nMinHeight);
+            if (nReduction > 1)
+            {
+                int64_t nReducedW;
+                int64_t nReducedH;
+                pImage = ZJpeg::DecodeReduced(pScanFileData, nFileSize, nReduction, nReducedW, nReducedH);
+                width = (int)nReducedW;
+                height = (int)nReducedH;
+            }
+        }
     }
 
-//    cout << "LoadBuffer() About to Shutdown\n";
-    Shutdown(); // Clear out any existing data
-
-    if (!Init(width, height))
+    bool bReducedDecode = (pImage != nullptr);
+    if (!bReducedDecode)
     {
-        stbi_image_free(pImage);
-        return false;
+        // stb allocates the RGBA result from the pixel pool, so it becomes mpPixels once swizzled in place
+        pImage = (uint32_t*)stbi_load_from_memory(pScanFileData, nFileSize, &width, &height, &channels, 4);
+        if (!pImage)
+        {
+            ZDEBUG_OUT("ZBuffer::LoadBuffer failed to load ", sFilename, "\n");
+            return false;
+        }
     }
-//    cout << "LoadBuffer() After init\n";
+    ro_mmap.unmap();
 
+    mLoadTimings.nDecodeUS = gTimer.GetUSSinceEpoch() - nTime;
+    nTime = gTimer.GetUSSinceEpoch();
 
-    mbHasAlphaPixels = false;
+    Shutdown(); // Clear out any existing data
+    AdoptPixels(pImage, width, height);
+    mnLoadReduction = 1;
 
-    uint32_t* pDest = mpPixels;
-    for (uint32_t* pSrc = (uint32_t*)pImage; pSrc < (uint32_t*)(pImage + width * height * 4); pSrc++)
+    if (bReducedDecode)
     {
-        uint32_t col = *pSrc;
-        uint32_t a = (col & 0xff000000);
-        uint32_t b = (col & 0x00ff0000) >> 16;
-        uint32_t r = (col & 0x000000ff) << 16;
-        uint32_t g = (col & 0x0000ff00);
-
-        uint32_t newCol = a | r | g | b;
+        mnLoadReduction = nReduction;   // already ARGB and opaque
+    }
+    else
+    {
+        mbHasAlphaPixels = SwizzleRGBAToARGB(mpPixels, (int64_t)width * (int64_t)height);
 
-        *pDest = newCol;
-        pDest++;
-        if (a != 0xff000000)
+        // formats without a reduced decode path are scaled down by the same power of two after the fact
+        nReduction = bSizeHint ? ZJpeg::ReductionForSize(width, height, nMinWidth, nMinHeight) : 1;
+        if (nReduction > 1)
         {
-            mbHasAlphaPixels = true;    // found a non fully opaque alpha
+            int64_t nReducedW = (width + nReduction - 1) / nReduction;
+            int64_t nReducedH = (height + nReduction - 1) / nReduction;
+            uint32_t* pReduced = ZPixelPool::Alloc(nReducedW * nReducedH);
+            if (pReduced && ZResample::Resample(mpPixels, width, height, width, pReduced, nReducedW, nReducedH, nReducedW, ZResample::kArea, &gRasterizer.renderPool))
+            {
+                bool bHasAlpha = mbHasAlphaPixels;
+                AdoptPixels(pReduced, nReducedW, nReducedH);
+                mbHasAlphaPixels = bHasAlpha;
+                mnLoadReduction = nReduction;
+            }
+            else
+            {
+                ZPixelPool::Free(pReduced);
+            }
         }
     }
 
-    stbi_image_free(pImage);
+    mLoadTimings.nSwizzleUS = gTimer.GetUSSinceEpoch() - nTime;
+    nTime = gTimer.GetUSSinceEpoch();
 
     if (mEXIF.Orientation != 0)
     {
@@ -213,6 +373,10 @@ bool ZBuffer::LoadBuffer(const string& sFilename)
         Rotate(reverse);
     }
 
+    mLoadTimings.nOrientUS = gTimer.GetUSSinceEpoch() - nTime;
+    mLoadTimings.nTotalUS = gTimer.GetUSSinceEpoch() - nStartTime;
+
+    ZDEBUG_OUT("LoadBuffer ", sFilename, " 1/", mnLoadReduction, " open:", mLoadTimings.nOpenUS, "us decode:", mLoadTimings.nDecodeUS, "us swizzle:", mLoadTimings.nSwizzleUS, "us orient:", mLoadTimings.nOrientUS, "us total:", mLoadTimings.nTotalUS, "us\n");
 
     return true;
 
@@ -323,7 +487,7 @@ bool ZBuffer::LoadFromSVG(const std::string& sName)
     int64_t h = (int64_t)svgbitmap.height();
     uint32_t s = svgbitmap.stride();
 
-    if (!Init(w, h))
+    if (!AllocPixels(w, h))
         return false;
 
     for (int64_t y = 0; y < h; y++)
@@ -593,122 +757,398 @@ bool ZBuffer::LoadBuffer(uint32_t nResourceID)
 #endif
 */
 
+const int64_t kOrientTileSize = 64;
+
+// Copies rows of 64x64 tiles in destination order.  dst(x,y) = pSrc[nOrigin + x*nStepX + y*nStepY]
+// so any EXIF orientation (including the compound ones) is a single pass
+static void OrientTileRows(uint32_t* pDst, int64_t nDstW, int64_t nDstH, const uint32_t* pSrc, int64_t nOrigin, int64_t nStepX, int64_t nStepY, int64_t nFirstTileRow, int64_t nLastTileRow)
+{
+    for (int64_t nTileRow = nFirstTileRow; nTileRow < nLastTileRow; nTileRow++)
+    {
+        int64_t nTop = nTileRow * kOrientTileSize;
+        int64_t nBottom = std::min<int64_t>(nTop + kOrientTileSize, nDstH);
+
+        for (int64_t nLeft = 0; nLeft < nDstW; nLeft += kOrientTileSize)
+        {
+            int64_t nTileW = std::min<int64_t>(kOrientTileSize, nDstW - nLeft);
+
+            for (int64_t y = nTop; y < nBottom; y++)
+            {
+                uint32_t* pD = pDst + y * nDstW + nLeft;
+                const uint32_t* pS = pSrc + nOrigin + nLeft * nStepX + y * nStepY;
+                for (int64_t x = 0; x < nTileW; x++)
+                {
+                    *pD++ = *pS;
+                    pS += nStepX;
+                }
+            }
+        }
+    }
+}
+
 bool ZBuffer::Rotate(eOrientation rotation)
 {
     const std::lock_guard<std::recursive_mutex> lock(mMutex);
 
-    uint32_t nPixels = (uint32_t) (mSurfaceArea.Width() * mSurfaceArea.Height());
+    int64_t nW = mSurfaceArea.Width();
+    int64_t nH = mSurfaceArea.Height();
+    int64_t nPixels = nW * nH;
 
-    if (nPixels < 1)
+    if (nPixels < 1 || !mpPixels)
         return false;
 
-    if (rotation == kLeft || rotation == kLeftAndVFlip)
-    {
-        ZRect rOldArea(mSurfaceArea);
-        uint32_t oldW = (uint32_t)rOldArea.Width();
-        uint32_t oldH = (uint32_t)rOldArea.Height();
-        uint32_t newW = oldH;
-        uint32_t newH = oldW;
-        ZRect rNewArea(0, 0, newW, newH);
+    MarkDirty();
+    uint32_t* pPixels = mpPixels;
 
-        ZBuffer newBuf;
-        newBuf.Init(newW, newH);
+    // Flips that keep the dimensions are done in place
+    if (rotation == kHFlip)
+    {
+        ParallelRanges(nH, nPixels, [=](int64_t nFirst, int64_t nLast)
+        {
+            for (int64_t y = nFirst; y < nLast; y++)
+                std::reverse(pPixels + y * nW, pPixels + (y + 1) * nW);
+        });
+        return true;
+    }
 
-        for (uint32_t y = 0; y < oldH; y++)
+    if (rotation == kVFlip || rotation == k180)
+    {
+        bool bMirror = (rotation == k180);
+        ParallelRanges(nH / 2, nPixels, [=](int64_t nFirst, int64_t nLast)
         {
-            for (uint32_t x = 0; x < oldW; x++)
+            for (int64_t y = nFirst; y < nLast; y++)
             {
-                newBuf.SetPixel(y, newH - x - 1, GetPixel(x, y));
+                uint32_t* pTop = pPixels + y * nW;
+                uint32_t* pBottom = pPixels + (nH - y - 1) * nW;
+                if (bMirror)
+                    std::swap_ranges(pTop, pTop + nW, std::reverse_iterator<uint32_t*>(pBottom + nW));
+                else
+                    std::swap_ranges(pTop, pTop + nW, pBottom);
             }
+        });
+
+        if (bMirror && (nH % 2) == 1)
+        {
+            uint32_t* pMiddle = pPixels + (nH / 2) * nW;
+            std::reverse(pMiddle, pMiddle + nW);
         }
+        return true;
+    }
+
+    // Remaining orientations swap width and height.  Express the source address of each destination pixel as nOrigin + x*nStepX + y*nStepY
+    int64_t nOrigin;
+    int64_t nStepX;
+    int64_t nStepY;
 
-        mSurfaceArea = rNewArea;
-        memcpy(mpPixels, newBuf.GetPixels(), nPixels * sizeof(uint32_t));
+    switch (rotation)
+    {
+    case kLeft:             // dst(x,y) = src(nW-1-y, x)
+        nOrigin = nW - 1;
+        nStepX = nW;
+        nStepY = -1;
+        break;
+    case kRight:            // dst(x,y) = src(y, nH-1-x)
+        nOrigin = (nH - 1) * nW;
+        nStepX = -nW;
+        nStepY = 1;
+        break;
+    case kLeftAndVFlip:     // dst(x,y) = src(y, x)
+        nOrigin = 0;
+        nStepX = nW;
+        nStepY = 1;
+        break;
+    case kRightAndVFlip:    // dst(x,y) = src(nW-1-y, nH-1-x)
+        nOrigin = (nH - 1) * nW + nW - 1;
+        nStepX = -nW;
+        nStepY = -1;
+        break;
+    default:
+        return true;        // kNone / kUnknown
     }
-    if (rotation == kRight || rotation == kRightAndVFlip)
+
+    int64_t nDstW = nH;
+    int64_t nDstH = nW;
+    uint32_t* pDst = ZPixelPool::Alloc(nPixels);
+    if (!pDst)
+        return false;
+
+    int64_t nTileRows = (nDstH + kOrientTileSize - 1) / kOrientTileSize;
+    ParallelRanges(nTileRows, nPixels, [=](int64_t nFirst, int64_t nLast)
     {
-        ZRect rOldArea(mSurfaceArea);
-        uint32_t oldW = (uint32_t)rOldArea.Width();
-        uint32_t oldH = (uint32_t)rOldArea.Height();
-        uint32_t newW = oldH;
-        uint32_t newH = oldW;
-        ZRect rNewArea(0, 0, newW, newH);
+        OrientTileRows(pDst, nDstW, nDstH, pPixels, nOrigin, nStepX, nStepY, nFirst, nLast);
+    });
+
+    ZPixelPool::Free(mpPixels);
+    mpPixels = pDst;
+    mSurfaceArea.Set(0, 0, nDstW, nDstH);
+    ResetTileMap();
+
+    return true;
+}
 
-        ZBuffer newBuf;
-        newBuf.Init(newW, newH);
+// Averages 2x2 blocks of source rows [nFirst, nLast) of the destination.  Odd trailing rows/columns are clamped to the edge
+static void DownsampleRows(const uint32_t* pSrc, int64_t nSrcW, int64_t nSrcH, uint32_t* pDst, int64_t nDstW, int64_t nFirst, int64_t nLast)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+    int64_t nPairs = nSrcW / 2;     // destination pixels with two source columns
+
+    for (int64_t y = nFirst; y < nLast; y++)
+    {
+        const uint32_t* pRow0 = pSrc + (y * 2) * nSrcW;
+        const uint32_t* pRow1 = pSrc + std::min<int64_t>(y * 2 + 1, nSrcH - 1) * nSrcW;
+        uint32_t* pOut = pDst + y * nDstW;
 
-        for (uint32_t y = 0; y < oldH; y++)
+        int64_t x = 0;
+        for (; x + 2 <= nPairs; x += 2)
         {
-            for (uint32_t x = 0; x < oldW; x++)
-            {
-                newBuf.SetPixel(newW - y - 1, x, GetPixel(x, y));
-            }
+            __m128i a = _mm_loadu_si128((const __m128i*)(pRow0 + x * 2));
+            __m128i b = _mm_loadu_si128((const __m128i*)(pRow1 + x * 2));
+
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));     // columns 0,1
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));     // columns 2,3
+
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+
+            _mm_storel_epi64((__m128i*)(pOut + x), _mm_packus_epi16(sum, zero));
         }
 
-        mSurfaceArea = rNewArea;
-        memcpy(mpPixels, newBuf.GetPixels(), nPixels * sizeof(uint32_t));
+        for (; x < nDstW; x++)
+        {
+            int64_t x0 = x * 2;
+            int64_t x1 = std::min<int64_t>(x0 + 1, nSrcW - 1);
+            uint32_t c0 = pRow0[x0];
+            uint32_t c1 = pRow0[x1];
+            uint32_t c2 = pRow1[x0];
+            uint32_t c3 = pRow1[x1];
+
+            pOut[x] = ARGB(
+                (ARGB_A(c0) + ARGB_A(c1) + ARGB_A(c2) + ARGB_A(c3) + 2) >> 2,
+                (ARGB_R(c0) + ARGB_R(c1) + ARGB_R(c2) + ARGB_R(c3) + 2) >> 2,
+                (ARGB_G(c0) + ARGB_G(c1) + ARGB_G(c2) + ARGB_G(c3) + 2) >> 2,
+                (ARGB_B(c0) + ARGB_B(c1) + ARGB_B(c2) + ARGB_B(c3) + 2) >> 2);
+        }
     }
-    if (rotation == k180)
+}
+
+int64_t ZBuffer::GetMipLevelCount()
+{
+    int64_t nW = mSurfaceArea.Width();
+    int64_t nH = mSurfaceArea.Height();
+    if (nW < 1 || nH < 1)
+        return 0;
+
+    int64_t nLevels = 1;
+    while (nW > 1 || nH > 1)
     {
-        ZBuffer newBuf;
-        uint32_t newW = (uint32_t)mSurfaceArea.Width();
-        uint32_t newH = (uint32_t)mSurfaceArea.Height();
-        newBuf.Init(newW, newH);
+        nW = (nW + 1) / 2;
+        nH = (nH + 1) / 2;
+        nLevels++;
+    }
+
+    return nLevels;
+}
+
+ZBuffer* ZBuffer::GetMipLevel(int64_t nLevel)
+{
+    if (nLevel < 1)
+        return this;
+
+    const std::lock_guard<std::recursive_mutex> lock(mMutex);
 
-        for (uint32_t y = 0; y < newH; y++)
+    if (!mbMipChainValid)
+    {
+        // flagged before building so that a write racing the build leaves the chain invalid
+        mbMipChainValid = true;
+        if (!BuildMipChain())
         {
-            for (uint32_t x = 0; x < newW; x++)
-            {
-                newBuf.SetPixel(newW - x - 1, newH - y - 1, GetPixel(x, y));
-            }
+            mbMipChainValid = false;
+            return this;
         }
-
-        memcpy(mpPixels, newBuf.GetPixels(), nPixels * sizeof(uint32_t));
     }
-    if (rotation == kVFlip || rotation == kLeftAndVFlip || rotation == kRightAndVFlip)
+
+    if (mMipChain.empty())
+        return this;
+
+    nLevel = std::min<int64_t>(nLevel, (int64_t)mMipChain.size());
+    return mMipChain[nLevel - 1].get();
+}
+
+bool ZBuffer::BuildMipChain()
+{
+    if (!mpPixels)
+        return false;
+
+    int64_t nLevels = GetMipLevelCount() - 1;
+
+    // existing levels are reused so that pointers handed out earlier stay valid
+    while ((int64_t)mMipChain.size() > nLevels)
+        mMipChain.pop_back();
+    while ((int64_t)mMipChain.size() < nLevels)
+        mMipChain.push_back(tZBufferPtr(new ZBuffer()));
+
+    ZBuffer* pSrc = this;
+    for (auto& pLevel : mMipChain)
     {
-        ZBuffer newBuf;
-        uint32_t newW = (uint32_t)mSurfaceArea.Width();
-        uint32_t newH = (uint32_t)mSurfaceArea.Height();
-        newBuf.Init(newW, newH);
+        int64_t nSrcW = pSrc->mSurfaceArea.Width();
+        int64_t nSrcH = pSrc->mSurfaceArea.Height();
+        int64_t nW = (nSrcW + 1) / 2;
+        int64_t nH = (nSrcH + 1) / 2;
 
-        for (uint32_t y = 0; y < newH; y++)
+        if (pLevel->mSurfaceArea.Width() != nW || pLevel->mSurfaceArea.Height() != nH)
+            pLevel->Init(nW, nH);
+
+        const uint32_t* pSrcPixels = pSrc->mpPixels;
+        uint32_t* pDstPixels = pLevel->mpPixels;
+        ParallelRanges(nH, nSrcW * nSrcH, [=](int64_t nFirst, int64_t nLast)
         {
-            for (uint32_t x = 0; x < newW; x++)
-            {
-                newBuf.SetPixel(x, newH - y - 1, GetPixel(x, y));
-            }
-        }
+            DownsampleRows(pSrcPixels, nSrcW, nSrcH, pDstPixels, nW, nFirst, nLast);
+        });
 
-        memcpy(mpPixels, newBuf.GetPixels(), nPixels * sizeof(uint32_t));
+        pLevel->InvalidateTiles();
+        pLevel->mbHasAlphaPixels = mbHasAlphaPixels;
+        pSrc = pLevel.get();
     }
-    if (rotation == kHFlip)
+
+    return true;
+}
+
+void ZBuffer::ResetTileMap()
+{
+    int64_t nTilesX = (mSurfaceArea.Width() + kTileSize - 1) / kTileSize;
+    int64_t nTilesY = (mSurfaceArea.Height() + kTileSize - 1) / kTileSize;
+
+    if (!mTileOpacity || nTilesX != mnTilesX || nTilesY != mnTilesY)
+    {
+        mTileOpacity.reset(new std::atomic<uint8_t>[nTilesX * nTilesY]);
+        mnTilesX = nTilesX;
+        mnTilesY = nTilesY;
+    }
+
+    for (int64_t i = 0; i < mnTilesX * mnTilesY; i++)
+        mTileOpacity[i].store(kTileUnknown, std::memory_order_relaxed);
+    mbTilesClassified = false;
+}
+
+void ZBuffer::InvalidateTiles(const ZRect* pRect)
+{
+    if (!mbTilesClassified)
+        return;
+
+    if (!pRect)
+    {
+        for (int64_t i = 0; i < mnTilesX * mnTilesY; i++)
+            mTileOpacity[i].store(kTileUnknown, std::memory_order_relaxed);
+        mbTilesClassified = false;
+        return;
+    }
+
+    ZRect r(*pRect);
+    r.Intersect(mSurfaceArea);
+    if (r.Width() <= 0 || r.Height() <= 0)
+        return;
+
+    for (int64_t nTileY = r.top / kTileSize; nTileY <= (r.bottom - 1) / kTileSize; nTileY++)
+    {
+        for (int64_t nTileX = r.left / kTileSize; nTileX <= (r.right - 1) / kTileSize; nTileX++)
+            mTileOpacity[nTileY * mnTilesX + nTileX].store(kTileUnknown, std::memory_order_relaxed);
+    }
+}
+
+void ZBuffer::ClearDepth(float fDepth)
+{
+    const std::lock_guard<std::recursive_mutex> lock(mMutex);
+    mDepth.assign(mSurfaceArea.Width() * mSurfaceArea.Height(), fDepth);
+}
+
+float* ZBuffer::GetDepth()
+{
+    if (mDepth.empty() || (int64_t)mDepth.size() != mSurfaceArea.Width() * mSurfaceArea.Height())
+        return nullptr;
+
+    return mDepth.data();
+}
+
+ZBuffer::eTileOpacity ZBuffer::GetTileOpacity(int64_t nTileX, int64_t nTileY)
+{
+    if (!mTileOpacity)
+        return kTileMixed;
+
+    ZASSERT(nTileX >= 0 && nTileX < mnTilesX && nTileY >= 0 && nTileY < mnTilesY);
+    std::atomic<uint8_t>& tile = mTileOpacity[nTileY * mnTilesX + nTileX];
+
+    eTileOpacity opacity = (eTileOpacity)tile.load(std::memory_order_relaxed);
+    if (opacity == kTileUnknown)
+    {
+        opacity = ClassifyTile(nTileX, nTileY);
+        mbTilesClassified = true;
+        tile.store(opacity, std::memory_order_relaxed);
+    }
+
+    return opacity;
+}
+
+// Min and max alpha over the tile, compared against the same thresholds the ZBlend span kernels use
+ZBuffer::eTileOpacity ZBuffer::ClassifyTile(int64_t nTileX, int64_t nTileY)
+{
+    int64_t nStride = mSurfaceArea.Width();
+    int64_t nLeft = nTileX * kTileSize;
+    int64_t nTop = nTileY * kTileSize;
+    int64_t nW = std::min<int64_t>(kTileSize, nStride - nLeft);
+    int64_t nH = std::min<int64_t>(kTileSize, mSurfaceArea.Height() - nTop);
+
+    const __m128i colorMask = _mm_set1_epi32(0x00ffffff);
+    __m128i minAlpha = _mm_set1_epi32(-1);
+    __m128i maxAlpha = _mm_setzero_si128();
+    uint32_t nMinAlpha = 255;
+    uint32_t nMaxAlpha = 0;
+
+    for (int64_t y = 0; y < nH; y++)
     {
-        ZBuffer newBuf;
-        uint32_t newW = (uint32_t) mSurfaceArea.Width();
-        uint32_t newH = (uint32_t) mSurfaceArea.Height();
-        newBuf.Init(newW, newH);
+        const uint32_t* pRow = mpPixels + (nTop + y) * nStride + nLeft;
 
-        for (uint32_t y = 0; y < newH; y++)
+        int64_t x = 0;
+        for (; x + 4 <= nW; x += 4)
         {
-            for (uint32_t x = 0; x < newW; x++)
-            {
-                newBuf.SetPixel(newW-x-1, y, GetPixel(x, y));
-            }
+            __m128i col = _mm_loadu_si128((const __m128i*)(pRow + x));
+            minAlpha = _mm_min_epu8(minAlpha, _mm_or_si128(col, colorMask));   // color bytes forced to 255 so only alpha can lower the min
+            maxAlpha = _mm_max_epu8(maxAlpha, col);                             // only the alpha byte is read back
+        }
+
+        for (; x < nW; x++)
+        {
+            uint32_t nAlpha = ARGB_A(pRow[x]);
+            nMinAlpha = std::min<uint32_t>(nMinAlpha, nAlpha);
+            nMaxAlpha = std::max<uint32_t>(nMaxAlpha, nAlpha);
         }
+    }
 
-        memcpy(mpPixels, newBuf.GetPixels(), nPixels * sizeof(uint32_t));
+    alignas(16) uint32_t mins[4];
+    alignas(16) uint32_t maxs[4];
+    _mm_store_si128((__m128i*)mins, minAlpha);
+    _mm_store_si128((__m128i*)maxs, maxAlpha);
+    for (int i = 0; i < 4; i++)
+    {
+        nMinAlpha = std::min<uint32_t>(nMinAlpha, mins[i] >> 24);
+        nMaxAlpha = std::max<uint32_t>(nMaxAlpha, maxs[i] >> 24);
     }
 
-    return true;
+    if (nMinAlpha > ZBlend::kOpaqueThreshold)
+        return kTileOpaque;
+    if (nMaxAlpha <= ZBlend::kClearThreshold)
+        return kTileClear;
+    return kTileMixed;
 }
 
 
 
 
 
+
 bool ZBuffer::BltNoClip(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, eAlphaBlendType type)
 {
+    MarkDirty(&rDst);
     int64_t nSW = pSrc->GetArea().Width();
     int64_t nDW = mSurfaceArea.Width();
 
@@ -719,39 +1159,41 @@ bool ZBuffer::BltNoClip(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, eAlphaBlendType
 
     if (pSrc->mbHasAlphaPixels)
     {
-        uint32_t* pSrcBits = pSrc->GetPixels() + (rSrc.top * pSrc->GetArea().Width()) + rSrc.left;
-        uint32_t* pDstBits = mpPixels + (rDst.top * mSurfaceArea.Width()) + rDst.left;
-    
-
-        auto alphaBlendFunction = (type == kAlphaDest)
-            ? &COL::AlphaBlend_Col2Alpha
-            : (type == kAlphaBlend)
-            ? &COL::AlphaBlend_BlendAlpha
-            : &COL::AlphaBlend_Col1Alpha;
+        // Walk the source a tile row at a time, grouping neighboring tiles with the same opacity into runs.
+        // Opaque runs are copied, clear runs skipped and only mixed runs blended
+        ZBlend::tSrcAlphaSpanFunc blendSpan = ZBlend::Get().srcAlpha[type];
+        int64_t nOffsetX = rDst.left - rSrc.left;
+        int64_t nOffsetY = rDst.top - rSrc.top;
 
-        for (int64_t y = 0; y < nBltHeight; y++)
+        for (int64_t nTileY = rSrc.top / kTileSize; nTileY * kTileSize < rSrc.bottom; nTileY++)
         {
-            for (int64_t x = 0; x < nBltWidth; x++)
+            int64_t nTop = std::max<int64_t>(rSrc.top, nTileY * kTileSize);
+            int64_t nBottom = std::min<int64_t>(rSrc.bottom, (nTileY + 1) * kTileSize);
+
+            int64_t x = rSrc.left;
+            while (x < rSrc.right)
             {
-#ifdef _DEBUG
-                //			CEASSERT_MESSAGE( pSrcBits < pSrc->GetPixels() + pSrc->GetArea().Width() * pSrc->GetArea().Height(), "Source buffer pointer out of range." );
-                //			CEASSERT_MESSAGE( pDstBits < mpPixels + mSurfaceArea.Width() * mSurfaceArea.Height(), "Dest buffer pointer out of range." );
-#endif
+                eTileOpacity opacity = pSrc->GetTileOpacity(x / kTileSize, nTileY);
+                int64_t nRunRight = std::min<int64_t>(rSrc.right, (x / kTileSize + 1) * kTileSize);
+                while (nRunRight < rSrc.right && pSrc->GetTileOpacity(nRunRight / kTileSize, nTileY) == opacity)
+                    nRunRight = std::min<int64_t>(rSrc.right, nRunRight + kTileSize);
 
-                uint8_t nAlpha = ARGB_A(*pSrcBits);
-                if (nAlpha > 250)
-                    *pDstBits = *pSrcBits;
-                else if (nAlpha > 8)
+                if (opacity != kTileClear)
                 {
-                    *pDstBits = alphaBlendFunction(*pSrcBits, *pDstBits, nAlpha);
+                    int64_t nRunWidth = nRunRight - x;
+                    for (int64_t y = nTop; y < nBottom; y++)
+                    {
+                        uint32_t* pSrcBits = pSrc->mpPixels + (y * nSW) + x;
+                        uint32_t* pDstBits = mpPixels + ((y + nOffsetY) * nDW) + x + nOffsetX;
+                        if (opacity == kTileOpaque)
+                            memcpy(pDstBits, pSrcBits, nRunWidth * 4);
+                        else
+                            blendSpan(pDstBits, pSrcBits, nRunWidth);
+                    }
                 }
 
-                pSrcBits++;
-                pDstBits++;
+                x = nRunRight;
             }
-
-            pSrcBits += (pSrc->GetArea().Width() - nBltWidth);  // Next line in the source buffer
-            pDstBits += (mSurfaceArea.Width() - nBltWidth);        // Next line in the destination buffer
         }
     }
     else
@@ -760,7 +1202,7 @@ bool ZBuffer::BltNoClip(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, eAlphaBlendType
         for (int64_t y = 0; y < nBltHeight; y++)
         {
             uint32_t* pSrcBits = pSrc->mpPixels + ((y + rSrc.top) * nSW) + rSrc.left;
-            uint32_t* pDstBits = mpPixels + ((y + rDst.top) * mSurfaceArea.Width()) + rDst.left;
+            uint32_t* pDstBits = mpPixels + ((y + rDst.top) * nDW) + rDst.left;
             memcpy(pDstBits, pSrcBits, nBltWidth * 4);
         }
     }
@@ -771,42 +1213,33 @@ bool ZBuffer::BltNoClip(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, eAlphaBlendType
 
 bool ZBuffer::BltAlphaNoClip(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, uint32_t nAlpha, eAlphaBlendType type)
 {
+    MarkDirty(&rDst);
     if (nAlpha < 8)     // If less than a small threshhold, we won't see anything from the source buffer anyway
         return true;
 
     //	if (nAlpha > 250)     // If close to 1, just do a plain blt
     //		return BltNoClip(pSrc, rSrc, rDst);
 
+    if (nAlpha > 255)
+        nAlpha = 255;
+
+    int64_t nSW = pSrc->GetArea().Width();
+    int64_t nDW = mSurfaceArea.Width();
+
     int64_t nBltWidth = rDst.Width();
     int64_t nBltHeight = rDst.Height();
 
-    uint32_t* pSrcBits = pSrc->GetPixels() + (rSrc.top * pSrc->GetArea().Width()) + rSrc.left;
-    uint32_t* pDstBits = mpPixels + (rDst.top * mSurfaceArea.Width()) + rDst.left;
+    uint32_t* pSrcBits = pSrc->GetPixels() + (rSrc.top * nSW) + rSrc.left;
+    uint32_t* pDstBits = mpPixels + (rDst.top * nDW) + rDst.left;
 
-    auto alphaBlendFunction = (type == kAlphaDest)
-        ? &COL::AlphaBlend_Col2Alpha
-        : (type == kAlphaBlend)
-        ? &COL::AlphaBlend_BlendAlpha
-        : &COL::AlphaBlend_Col1Alpha;
+    ZBlend::tConstAlphaSpanFunc blendSpan = ZBlend::Get().constAlpha[type];
 
     for (int64_t y = 0; y < nBltHeight; y++)
     {
-        for (int64_t x = 0; x < nBltWidth; x++)
-        {
-            uint32_t nColSrc = *pSrcBits;
-            uint32_t alpha = ARGB_A(nColSrc);
-
-            // Masked approach
-            *pDstBits = (alpha != 0)
-                ? alphaBlendFunction(nColSrc, *pDstBits, nAlpha)
-                : *pDstBits;
-
-            ++pSrcBits;
-            ++pDstBits;
-        }
+        blendSpan(pDstBits, pSrcBits, nBltWidth, nAlpha);
 
-        pSrcBits += (pSrc->GetArea().Width() - nBltWidth);
-        pDstBits += (mSurfaceArea.Width() - nBltWidth);
+        pSrcBits += nSW;
+        pDstBits += nDW;
     }
 
     return true;
@@ -814,6 +1247,7 @@ bool ZBuffer::BltAlphaNoClip(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, uint32_t n
 
 bool ZBuffer::CopyPixels(ZBuffer* pSrc)
 {
+    MarkDirty();
     if (pSrc->GetArea() != mSurfaceArea)
         return false;
 
@@ -823,6 +1257,7 @@ bool ZBuffer::CopyPixels(ZBuffer* pSrc)
 
 bool ZBuffer::CopyPixels(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, ZRect* pClip)
 {
+    MarkDirty();
     if (pSrc->GetArea() == mSurfaceArea && rSrc == mSurfaceArea && rDst == mSurfaceArea)
     {
         memcpy(mpPixels, pSrc->GetPixels(), mSurfaceArea.Width() * mSurfaceArea.Height() * 4);
@@ -910,44 +1345,103 @@ bool ZBuffer::BltAlpha(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, uint32_t nAlpha,
 	return false;
 }
 
-bool ZBuffer::Fill(uint32_t nCol, ZRect* pRect)
+// Fills bigger than this use streaming stores.  Larger than a typical per core L2, so caching the writes would only evict useful lines
+const int64_t kStreamingFillBytes = 1024 * 1024;
+
+// Stores nCol to nCount pixels.  With bStream the aligned middle bypasses the cache; caller issues the _mm_sfence
+static void FillSpan(uint32_t* pDst, int64_t nCount, uint32_t nCol, bool bStream)
 {
-    ZRect rDst;
-    if (pRect)
+    const __m128i col = _mm_set1_epi32(nCol);
+
+    int64_t i = 0;
+    if (bStream)
     {
-        rDst.Set(*pRect);
-        if (!Clip(rDst))
-            return false;
+        for (; i < nCount && ((uintptr_t)(pDst + i) & 15) != 0; i++)
+            pDst[i] = nCol;
+
+        for (; i + 16 <= nCount; i += 16)
+        {
+            _mm_stream_si128((__m128i*)(pDst + i), col);
+            _mm_stream_si128((__m128i*)(pDst + i + 4), col);
+            _mm_stream_si128((__m128i*)(pDst + i + 8), col);
+            _mm_stream_si128((__m128i*)(pDst + i + 12), col);
+        }
+        for (; i + 4 <= nCount; i += 4)
+            _mm_stream_si128((__m128i*)(pDst + i), col);
     }
     else
     {
-        rDst.Set(mSurfaceArea);
-/*        size_t numPixels = mSurfaceArea.Area();
-        __stosd((DWORD*)mpPixels, nCol, numPixels);
-        return true;*/
+        for (; i + 16 <= nCount; i += 16)
+        {
+            _mm_storeu_si128((__m128i*)(pDst + i), col);
+            _mm_storeu_si128((__m128i*)(pDst + i + 4), col);
+            _mm_storeu_si128((__m128i*)(pDst + i + 8), col);
+            _mm_storeu_si128((__m128i*)(pDst + i + 12), col);
+        }
+        for (; i + 4 <= nCount; i += 4)
+            _mm_storeu_si128((__m128i*)(pDst + i), col);
     }
 
-	int64_t nDstStride = mSurfaceArea.Width();
+    for (; i < nCount; i++)
+        pDst[i] = nCol;
+}
 
-	int64_t nFillWidth = rDst.Width();
-	int64_t nFillHeight = rDst.Height();
+// Bilinear blend of the corner colors (TL, TR, BR, BL) over rows [nFirst, nLast) of rDst.
+// Channels are 16.16 fixed point, one per 32 bit lane in memory order (B, G, R, A), stepped incrementally along each row
+static void FillGradientRows(uint32_t* pPixels, int64_t nStride, const ZRect& rDst, const uint32_t nCol[4], int64_t nFirst, int64_t nLast)
+{
+    int64_t nW = rDst.Width();
+    int64_t nH = rDst.Height();
 
+    for (int64_t y = nFirst; y < nLast; y++)
+    {
+        alignas(16) int32_t start[4];
+        alignas(16) int32_t step[4];
+        for (int c = 0; c < 4; c++)
+        {
+            int64_t nShift = c * 8;
+            int64_t nTL = (nCol[0] >> nShift) & 0xff;
+            int64_t nTR = (nCol[1] >> nShift) & 0xff;
+            int64_t nBR = (nCol[2] >> nShift) & 0xff;
+            int64_t nBL = (nCol[3] >> nShift) & 0xff;
+
+            int64_t nLeft = (nTL << 16) + ((nBL - nTL) << 16) * y / nH;
+            int64_t nRight = (nTR << 16) + ((nBR - nTR) << 16) * y / nH;
+            start[c] = (int32_t)nLeft;
+            step[c] = (int32_t)((nRight - nLeft) / nW);
+        }
 
-	// Fully opaque
-	for (int64_t y = 0; y < nFillHeight; y++)
-	{
-		uint32_t* pDstBits = (uint32_t*) (mpPixels + ((y + rDst.top) * nDstStride) + rDst.left);
-/*		for (int64_t x = 0; x < nFillWidth; x++)
-			*pDstBits++ = nCol;*/
-        __stosd((DWORD*)pDstBits, nCol, nFillWidth);
-	}
+        __m128i d1 = _mm_load_si128((const __m128i*)step);
+        __m128i v0 = _mm_load_si128((const __m128i*)start);
+        __m128i v1 = _mm_add_epi32(v0, d1);
+        __m128i v2 = _mm_add_epi32(v1, d1);
+        __m128i v3 = _mm_add_epi32(v2, d1);
+        __m128i d4 = _mm_slli_epi32(d1, 2);
 
-    mbHasAlphaPixels = ARGB_A(nCol) < 255;
+        uint32_t* pDst = pPixels + (y + rDst.top) * nStride + rDst.left;
+        int64_t x = 0;
+        for (; x + 4 <= nW; x += 4)
+        {
+            __m128i p01 = _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_srai_epi32(v1, 16));
+            __m128i p23 = _mm_packs_epi32(_mm_srai_epi32(v2, 16), _mm_srai_epi32(v3, 16));
+            _mm_storeu_si128((__m128i*)(pDst + x), _mm_packus_epi16(p01, p23));
+
+            v0 = _mm_add_epi32(v0, d4);
+            v1 = _mm_add_epi32(v1, d4);
+            v2 = _mm_add_epi32(v2, d4);
+            v3 = _mm_add_epi32(v3, d4);
+        }
 
-	return true;
+        for (; x < nW; x++)
+        {
+            __m128i p = _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_setzero_si128());
+            pDst[x] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+            v0 = _mm_add_epi32(v0, d1);
+        }
+    }
 }
 
-bool ZBuffer::FillAlpha(uint32_t nCol, ZRect* pRect)
+bool ZBuffer::Fill(uint32_t nCol, ZRect* pRect)
 {
     ZRect rDst;
     if (pRect)
@@ -958,37 +1452,65 @@ bool ZBuffer::FillAlpha(uint32_t nCol, ZRect* pRect)
     }
     else
         rDst.Set(mSurfaceArea);
-
+    MarkDirty(&rDst);
 
 	int64_t nDstStride = mSurfaceArea.Width();
+    bool bStream = rDst.Area() * 4 >= kStreamingFillBytes;
 
-	int64_t nFillWidth = rDst.Width();
-	int64_t nFillHeight = rDst.Height();
+    if (rDst == mSurfaceArea)
+    {
+        FillSpan(mpPixels, rDst.Area(), nCol, bStream);     // contiguous
+    }
+    else
+    {
+        for (int64_t y = rDst.top; y < rDst.bottom; y++)
+            FillSpan(mpPixels + y * nDstStride + rDst.left, rDst.Width(), nCol, bStream);
+    }
+
+    if (bStream)
+        _mm_sfence();
+
+    mbHasAlphaPixels = ARGB_A(nCol) < 255;
+
+	return true;
+}
+
+bool ZBuffer::FillAlpha(uint32_t nCol, ZRect* pRect)
+{
+    ZRect rDst;
+    if (pRect)
+    {
+        rDst.Set(*pRect);
+        if (!Clip(rDst))
+            return false;
+    }
+    else
+        rDst.Set(mSurfaceArea);
+    MarkDirty(&rDst);
+
+
+	int64_t nDstStride = mSurfaceArea.Width();
+
+	int64_t nFillWidth = rDst.Width();
+	int64_t nFillHeight = rDst.Height();
 
 
 	int64_t nAlpha = ARGB_A(nCol);
 	if (nAlpha > 250)
 	{
 		// Fully opaque
+        bool bStream = rDst.Area() * 4 >= kStreamingFillBytes;
 		for (int64_t y = 0; y < nFillHeight; y++)
-		{
-			uint32_t* pDstBits = (uint32_t*) (mpPixels + ((y + rDst.top) * nDstStride) + rDst.left);
-//			for (int64_t x = 0; x < nFillWidth; x++)
-//				*pDstBits++ = nCol;
-            __stosd((DWORD*)pDstBits, nCol, nFillWidth);
+            FillSpan(mpPixels + ((y + rDst.top) * nDstStride) + rDst.left, nFillWidth, nCol, bStream);
 
-		}
+        if (bStream)
+            _mm_sfence();
 	}
 	else if (nAlpha > 8)
 	{
+        ZBlend::tColorAlphaSpanFunc blendSpan = ZBlend::Get().colorAlpha;
 		for (int64_t y = 0; y < nFillHeight; y++)
-		{
-			uint32_t* pDstBits = (uint32_t*) (mpPixels + ((y + rDst.top) * nDstStride) + rDst.left);
-			for (int64_t x = 0; x < nFillWidth; x++)
-			{
-				*pDstBits++ = COL::AlphaBlend_Col2Alpha(nCol, *pDstBits, ARGB_A(nCol));
-			}
-		}
+            blendSpan(mpPixels + ((y + rDst.top) * nDstStride) + rDst.left, nFillWidth, nCol, (uint32_t)nAlpha);
 	}
 
 	return true;
@@ -1005,16 +1527,17 @@ bool ZBuffer::FillGradient(uint32_t nCol[4], ZRect* pRect)
     }
     else
         rDst.Set(mSurfaceArea);
+    MarkDirty(&rDst);
 
-    tColorVertexArray array;
-    gRasterizer.RectToVerts(rDst, array);
-
-    array[0].mColor = nCol[0];
-    array[1].mColor = nCol[1];
-    array[2].mColor = nCol[2];
-    array[3].mColor = nCol[3];
+    uint32_t* pPixels = mpPixels;
+    int64_t nStride = mSurfaceArea.Width();
+    const uint32_t cols[4] = { nCol[0], nCol[1], nCol[2], nCol[3] };
+    ParallelRanges(rDst.Height(), rDst.Area(), [=](int64_t nFirst, int64_t nLast)
+    {
+        FillGradientRows(pPixels, nStride, rDst, cols, nFirst, nLast);
+    });
 
-    return gRasterizer.Rasterize(this, array);
+    return true;
 }
 
 
@@ -1029,6 +1552,7 @@ bool ZBuffer::Colorize(uint32_t nH, uint32_t nS, ZRect* pRect)
     }
     else
         rDst.Set(mSurfaceArea);
+    MarkDirty(&rDst);
 
     int64_t nDstStride = mSurfaceArea.Width();
 
@@ -1060,6 +1584,7 @@ bool ZBuffer::Colorize(uint32_t nH, uint32_t nS, ZRect* pRect)
 
 void  ZBuffer::DrawRectAlpha(uint32_t nCol, ZRect rRect, eAlphaBlendType type)
 {
+    MarkDirty();
     // Bottom and right are inclusive, so -1
     rRect.right--;
     rRect.bottom--;
@@ -1131,6 +1656,7 @@ void  ZBuffer::DrawRectAlpha(uint32_t nCol, ZRect rRect, eAlphaBlendType type)
 
 void ZBuffer::DrawCircle(ZPoint center, int64_t radius, uint32_t col)
 {
+    MarkDirty();
     int64_t startScanline = center.y - radius;
     limit<int64_t>(startScanline, 0, mSurfaceArea.bottom);
 
@@ -1162,6 +1688,7 @@ void ZBuffer::DrawCircle(ZPoint center, int64_t radius, uint32_t col)
 
 void ZBuffer::DrawSphere(ZPoint center, int64_t radius, const Z3D::Vec3f& lightPos, const Z3D::Vec3f& viewPos, const Z3D::Vec3f& ambient, const Z3D::Vec3f& diffuse, const Z3D::Vec3f& specular, float shininess)
 {
+    MarkDirty();
     int64_t startScanline = center.y - radius;
 
     int64_t endScanline = center.y + radius;
@@ -1377,6 +1904,8 @@ uint32_t ZBuffer::GetPixel(int64_t x, int64_t y)
 inline
 void ZBuffer::SetPixel(int64_t x, int64_t y, uint32_t nCol)
 {
+    ZRect rPixel(x, y, x + 1, y + 1);
+    MarkDirty(&rPixel);
 	*(mpPixels + y * mSurfaceArea.right + x) = nCol;
 }
 
@@ -1577,47 +2106,6 @@ bool ZBuffer::BltEdge(ZBuffer* pSrc, ZRect& rEdgeRect, ZRect& rDst, uint32_t fla
 	return true;
 }
 
-inline
-bool ZBuffer::FloatScanLineIntersection(double fScanLine, const ZColorVertex& v1, const ZColorVertex& v2, double& fIntersection, double& fR, double& fG, double& fB, double& fA)
-{
-	if (v1.y == v2.y || v1.x == v2.x)	
-	{
-		fIntersection = v1.x;
-		fA = (double) (v1.mColor >> 24);
-		fR = (double) ((v1.mColor & 0x00ff0000) >> 16);
-		fG = (double) ((v1.mColor & 0x0000ff00) >> 8);
-		fB = (double) ((v1.mColor & 0x000000ff));
-		return false;			
-	}
-
-	// Calculate line intersection
-	double fM = (double)((v1.y - v2.y)/(v1.x - v2.x)); // slope
-	fIntersection = (v2.x + (fScanLine-v2.y)/fM);
-
-	double fT = (fScanLine - v1.y) / (v2.y - v1.y);  // how far along line (0.0 - 1.0)
-
-	// Calculate color at intersection
-	int64_t nA1 = (v1.mColor) >> 24;
-	int64_t nA2 = (v2.mColor) >> 24;
-
-	int64_t nR1 = (v1.mColor & 0x00ff0000) >> 16;
-	int64_t nR2 = (v2.mColor & 0x00ff0000) >> 16;
-
-	int64_t nG1 = (v1.mColor & 0x0000ff00) >> 8;
-	int64_t nG2 = (v2.mColor & 0x0000ff00) >> 8;
-
-	int64_t nB1 = (v1.mColor & 0x000000ff);
-	int64_t nB2 = (v2.mColor & 0x000000ff);
-
-
-	fA = (double) (nA1 + (nA2 - nA1) * fT);
-	fR = (double) (nR1 + (nR2 - nR1) * fT);
-	fG = (double) (nG1 + (nG2 - nG1) * fT);
-	fB = (double) (nB1 + (nB2 - nB1) * fT);
-
-	return true;
-}
-
 inline 
 void ZBuffer::FillInSpan(uint32_t* pDest, int64_t nNumPixels, double fR, double fG, double fB, double fA)
 {
@@ -1641,65 +2129,616 @@ void ZBuffer::FillInSpan(uint32_t* pDest, int64_t nNumPixels, double fR, double
 	} 
 }
 
-void ZBuffer::DrawAlphaLine(const ZColorVertex& v1, const ZColorVertex& v2, double thickness, ZRect* pClip)
+// Thick lines for DrawAlphaLine / DrawAlphaLines / DrawAlphaPolyline
+// Each segment is a capsule of radius thickness/2 with round caps. A pixel's coverage comes from the distance between its
+// center and the segment, ramping from 1 to 0 across the last pixel. Rows split into an interior run at full coverage and
+// the edge pixels around it. Everything is stepped: band edges down the rows, 16.16 distances along them. Only pixels past
+// the ends take a sqrt.
+const int64_t kLineFracBits = 16;
+const int64_t kLineOne = 1LL << kLineFracBits;
+const int64_t kLineSpanChunk = 256;
+const int64_t kLineMinKernelRun = 16;       // shorter interior runs blend inline rather than through a ZBlend kernel
+const double  kLineAxisEpsilon = 1e-7;      // direction components below this are treated as 0
+
+struct LineSegment
 {
-	ZRect rDest;
+    double      fX0;
+    double      fY0;
+    double      fX1;
+    double      fY1;
+    double      fUX;            // unit direction, (1,0) for a point
+    double      fUY;
+    double      fLength;
+    int64_t     nLength;        // 16.16 from here on
+    int64_t     nDN;            // per pixel steps in x of the distance across, the distance along and the 0-1 color position
+    int64_t     nDS;
+    int64_t     nDT;
+    uint32_t    nCol0;
+    uint32_t    nCol1;
+};
 
-	if (pClip)
-	{
-		rDest = *pClip;
-		rDest.Intersect(&mSurfaceArea);
-	}
-	else
-		rDest = mSurfaceArea;
+// floor without the library call. Clamped so far off coordinates convert.
+inline int64_t LineFloor(double f)
+{
+    f = std::clamp<double>(f, -1e15, 1e15);
+    int64_t n = (int64_t)f;
+    return (f < (double)n) ? n - 1 : n;
+}
 
-	ZRect rLineRect;
+inline int64_t LineCeil(double f)
+{
+    return -LineFloor(-f);
+}
 
-	rLineRect.top = (int64_t) min(v1.y, v2.y);
-	rLineRect.bottom = (int64_t) max(v1.y, v2.y);
-	rLineRect.left = (int64_t) min(v1.x - thickness /2.0f, v2.x - thickness /2.0f);
-	rLineRect.right = (int64_t) max(v1.x + thickness /2.0f, v2.x + thickness /2.0f);
+static void SetupLineSegment(LineSegment& seg, const ZColorVertex& v1, const ZColorVertex& v2)
+{
+    seg.fX0 = v1.x;
+    seg.fY0 = v1.y;
+    seg.fX1 = v2.x;
+    seg.fY1 = v2.y;
+    seg.nCol0 = v1.mColor;
+    seg.nCol1 = v2.mColor;
+
+    double fDX = v2.x - v1.x;
+    double fDY = v2.y - v1.y;
+    seg.fLength = sqrt(fDX * fDX + fDY * fDY);
+    if (seg.fLength > 1.0 / kLineOne)
+    {
+        seg.fUX = fDX / seg.fLength;
+        seg.fUY = fDY / seg.fLength;
+    }
+    else
+    {
+        seg.fLength = 0.0;
+        seg.fUX = 1.0;
+        seg.fUY = 0.0;
+    }
 
-	rLineRect.Intersect(/*&rLineRect, */&rDest);
+    seg.nLength = (int64_t)(seg.fLength * kLineOne);
+    seg.nDN = llround(-seg.fUY * kLineOne);
+    seg.nDS = llround(seg.fUX * kLineOne);
+    seg.nDT = seg.fLength > 0.0 ? llround(seg.fUX / seg.fLength * kLineOne) : 0;
+}
 
-	uint32_t* pSurface = GetPixels();
-	int64_t nStride = mSurfaceArea.right;
+inline int64_t LineDistance(int64_t n, int64_t s, int64_t nLength)
+{
+    if (s < 0)
+        return (int64_t)sqrt((double)n * n + (double)s * s);
+    if (s > nLength)
+    {
+        double fPast = (double)(s - nLength);
+        return (int64_t)sqrt((double)n * n + fPast * fPast);
+    }
+    return n < 0 ? -n : n;
+}
 
-	double fScanLine = (double) rLineRect.top;
-	double fIntersection;
-	double fR;
-	double fG;
-	double fB;
-	double fA;
+// t is the 0-kLineOne position between the two end colors
+inline uint32_t LerpLineColor(uint32_t nCol0, uint32_t nCol1, int64_t t)
+{
+    uint32_t nT = (uint32_t)(std::clamp<int64_t>(t, 0, kLineOne) >> (kLineFracBits - 8));
+    uint32_t nInv = 256 - nT;
+    uint32_t nRB = (((nCol0 & 0x00ff00ff) * nInv + (nCol1 & 0x00ff00ff) * nT) >> 8) & 0x00ff00ff;
+    uint32_t nAG = (((nCol0 >> 8) & 0x00ff00ff) * nInv + ((nCol1 >> 8) & 0x00ff00ff) * nT) & 0xff00ff00;
+    return nAG | nRB;
+}
 
-	double fPrevScanLineIntersection;
-	if (!FloatScanLineIntersection(fScanLine, v1, v2, fPrevScanLineIntersection, fR, fG, fB, fA) && v1.y == v2.y)
-	{
-		// Horizontal line is a special case:
-		uint32_t* pDest = pSurface + rLineRect.top * nStride + rLineRect.left;
-		FillInSpan(pDest, rLineRect.Width(), fR, fG, fB, fA);
-	}
+// Colors of nCount pixels of a gradient line starting at color position t (16.16, kept within 0-1 by the caller) and
+// stepping nDT. Channels are 16.16 fixed point, one per 32 bit lane like FillGradientRows.
+static void LineGradientSpan(uint32_t* pOut, int64_t nCount, uint32_t nCol0, uint32_t nCol1, int64_t t, int64_t nDT)
+{
+    alignas(16) int32_t start[4];
+    alignas(16) int32_t step[4];
+    for (int c = 0; c < 4; c++)
+    {
+        int64_t nShift = c * 8;
+        int64_t n0 = (nCol0 >> nShift) & 0xff;
+        int64_t n1 = (nCol1 >> nShift) & 0xff;
+        start[c] = (int32_t)((n0 << kLineFracBits) + (n1 - n0) * t);
+        step[c] = (int32_t)((n1 - n0) * nDT);
+    }
 
-    for (int64_t nScanLine = rLineRect.top; nScanLine < rLineRect.bottom; nScanLine++)
-	{
-		FloatScanLineIntersection(fScanLine, v1, v2, fIntersection, fR, fG, fB, fA);
+    __m128i d1 = _mm_load_si128((const __m128i*)step);
+    __m128i v0 = _mm_load_si128((const __m128i*)start);
+    __m128i v1 = _mm_add_epi32(v0, d1);
+    __m128i v2 = _mm_add_epi32(v1, d1);
+    __m128i v3 = _mm_add_epi32(v2, d1);
+    __m128i d4 = _mm_slli_epi32(d1, 2);
 
-		if (fA > 10.0f)		// Anything less is not really visible
-		{
-			int64_t nStartPixel = (int64_t) min(fIntersection - thickness /2.0f, fPrevScanLineIntersection - thickness /2.0f);
-			nStartPixel = max(nStartPixel, rLineRect.left);		// clip left
+    int64_t i = 0;
+    for (; i + 4 <= nCount; i += 4)
+    {
+        __m128i p01 = _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_srai_epi32(v1, 16));
+        __m128i p23 = _mm_packs_epi32(_mm_srai_epi32(v2, 16), _mm_srai_epi32(v3, 16));
+        _mm_storeu_si128((__m128i*)(pOut + i), _mm_packus_epi16(p01, p23));
+
+        v0 = _mm_add_epi32(v0, d4);
+        v1 = _mm_add_epi32(v1, d4);
+        v2 = _mm_add_epi32(v2, d4);
+        v3 = _mm_add_epi32(v3, d4);
+    }
 
-			int64_t nEndPixel = (int64_t) max(fIntersection + thickness /2.0f, fPrevScanLineIntersection + thickness /2.0f);
-			nEndPixel = min(nEndPixel, rLineRect.right);
+    for (; i < nCount; i++)
+    {
+        __m128i p = _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_setzero_si128());
+        pOut[i] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+        v0 = _mm_add_epi32(v0, d1);
+    }
+}
 
-			uint32_t* pDest = pSurface + nScanLine * nStride + nStartPixel;
+// Scales the alpha of nCount colors in pOut by how much of each pixel is within fReach of the segment. n and s are the
+// 16.16 distances across and along at the first pixel. Lanes are float so the distance past the ends is a branch free sqrt.
+static void LineCoverageSpan(uint32_t* pOut, int64_t nCount, const LineSegment& seg, int64_t n, int64_t s, double fReach)
+{
+    const float fScale = 1.0f / kLineOne;
+    float fN = (float)((double)n / kLineOne);
+    float fS = (float)((double)s / kLineOne);
+    float fDN = seg.nDN * fScale;
+    float fDS = seg.nDS * fScale;
+    float fLength = seg.nLength * fScale;
+
+    const __m128 vZero = _mm_setzero_ps();
+    const __m128 vOne = _mm_set1_ps(1.0f);
+    const __m128 v256 = _mm_set1_ps(256.0f);
+    const __m128 vReach = _mm_set1_ps((float)fReach);
+    const __m128 vLength = _mm_set1_ps(fLength);
+    const __m128i vRGB = _mm_set1_epi32(0x00ffffff);
+    const __m128 vLane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+
+    __m128 vN = _mm_add_ps(_mm_set1_ps(fN), _mm_mul_ps(vLane, _mm_set1_ps(fDN)));
+    __m128 vS = _mm_add_ps(_mm_set1_ps(fS), _mm_mul_ps(vLane, _mm_set1_ps(fDS)));
+    __m128 vDN4 = _mm_set1_ps(fDN * 4.0f);
+    __m128 vDS4 = _mm_set1_ps(fDS * 4.0f);
+
+    int64_t i = 0;
+    for (; i + 4 <= nCount; i += 4)
+    {
+        __m128 vPast = _mm_max_ps(_mm_max_ps(_mm_sub_ps(vZero, vS), _mm_sub_ps(vS, vLength)), vZero);
+        __m128 vDist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vN, vN), _mm_mul_ps(vPast, vPast)));
+        __m128 vCover = _mm_min_ps(_mm_max_ps(_mm_sub_ps(vReach, vDist), vZero), vOne);
+        __m128i nCover = _mm_cvttps_epi32(_mm_mul_ps(vCover, v256));
+
+        // alpha and coverage are both under 2^9, so the 16 bit multiply leaves the product in the low half of each lane
+        __m128i col = _mm_loadu_si128((const __m128i*)(pOut + i));
+        __m128i a = _mm_srli_epi32(_mm_mullo_epi16(_mm_srli_epi32(col, 24), nCover), 8);
+        _mm_storeu_si128((__m128i*)(pOut + i), _mm_or_si128(_mm_and_si128(col, vRGB), _mm_slli_epi32(a, 24)));
+
+        vN = _mm_add_ps(vN, vDN4);
+        vS = _mm_add_ps(vS, vDS4);
+    }
 
-			FillInSpan(pDest, nEndPixel - nStartPixel, fR, fG, fB, fA);
-		}
+    fN += fDN * i;
+    fS += fDS * i;
+    for (; i < nCount; i++, fN += fDN, fS += fDS)
+    {
+        float fPast = std::max<float>(std::max<float>(-fS, fS - fLength), 0.0f);
+        float fCover = std::clamp<float>((float)fReach - sqrtf(fN * fN + fPast * fPast), 0.0f, 1.0f);
+        uint32_t nAlpha = (ARGB_A(pOut[i]) * (uint32_t)(fCover * 256.0f)) >> 8;
+        pOut[i] = (pOut[i] & 0x00ffffff) | (nAlpha << 24);
+    }
+}
 
-		fPrevScanLineIntersection = fIntersection;
-		fScanLine += 1.0f;
-	}
+// One segment stepped down the rows. Bands are ranges of pixel center x: within fReach across the segment (outer), within
+// fInner across it (inner, fully covered) and between its ends (along). A direction with no y (x) component makes the across
+// (along) band all or nothing per row.
+struct LineRowWalk
+{
+    void Start(const LineSegment& seg, double fReach, double fInner, int64_t y)
+    {
+        mpSeg = &seg;
+        mfReach = fReach;
+        mfInner = fInner;
+        mfRY = (double)y + 0.5 - seg.fY0;
+        mfBoxLo = std::min<double>(seg.fX0, seg.fX1) - fReach;
+        mfBoxHi = std::max<double>(seg.fX0, seg.fX1) + fReach;
+
+        mbAcross = fabs(seg.fUY) > kLineAxisEpsilon;
+        mbAlong = fabs(seg.fUX) > kLineAxisEpsilon && seg.fLength > 0.0;
+        mfOutLo = mfOutHi = mfInLo = mfInHi = mfAlongLo = mfAlongHi = 0.0;
+        mfAcrossStep = mfAlongStep = 0.0;
+        if (mbAcross)
+        {
+            // x where the distance across, fRY*ux - (x - fX0)*uy, equals -r and +r
+            double fInvUY = 1.0 / seg.fUY;
+            double fHalfOut = fabs(fReach * fInvUY);
+            double fHalfIn = fabs(fInner * fInvUY);
+            double fCenter = seg.fX0 + mfRY * seg.fUX * fInvUY;
+            mfOutLo = fCenter - fHalfOut;
+            mfOutHi = fCenter + fHalfOut;
+            mfInLo = fCenter - fHalfIn;
+            mfInHi = fCenter + fHalfIn;
+            mfAcrossStep = seg.fUX * fInvUY;
+        }
+        if (mbAlong)
+        {
+            // x where the distance along, (x - fX0)*ux + fRY*uy, equals 0 and the length
+            double fInvUX = 1.0 / seg.fUX;
+            double fA = seg.fX0 - mfRY * seg.fUY * fInvUX;
+            double fB = fA + seg.fLength * fInvUX;
+            mfAlongLo = std::min<double>(fA, fB);
+            mfAlongHi = std::max<double>(fA, fB);
+            mfAlongStep = -seg.fUY * fInvUX;
+        }
+
+        // 16.16 distances and color position at the center of pixel 0,y
+        double fX = 0.5 - seg.fX0;
+        double fS = fX * seg.fUX + mfRY * seg.fUY;
+        mnRowN = LineFloor((mfRY * seg.fUX - fX * seg.fUY) * kLineOne + 0.5);
+        mnRowS = LineFloor(fS * kLineOne + 0.5);
+        mnRowT = seg.fLength > 0.0 ? LineFloor(fS / seg.fLength * kLineOne + 0.5) : 0;
+        mnStepN = llround(seg.fUX * kLineOne);
+        mnStepS = llround(seg.fUY * kLineOne);
+        mnStepT = seg.fLength > 0.0 ? llround(seg.fUY / seg.fLength * kLineOne) : 0;
+    }
+
+    void Next()
+    {
+        mfRY += 1.0;
+        mfOutLo += mfAcrossStep;
+        mfOutHi += mfAcrossStep;
+        mfInLo += mfAcrossStep;
+        mfInHi += mfAcrossStep;
+        mfAlongLo += mfAlongStep;
+        mfAlongHi += mfAlongStep;
+        mnRowN += mnStepN;
+        mnRowS += mnStepS;
+        mnRowT += mnStepT;
+    }
+
+    // Columns [nLeft, nRight) that can be within reach, the outer band cut to the capsule's bounding box. Near the ends this
+    // keeps a few pixels outside the caps, which come out with no coverage.
+    bool Extent(const ZRect& rClip, int64_t& nLeft, int64_t& nRight) const
+    {
+        double fLo = mfBoxLo;
+        double fHi = mfBoxHi;
+        if (mbAcross)
+        {
+            fLo = std::max<double>(fLo, mfOutLo);
+            fHi = std::min<double>(fHi, mfOutHi);
+        }
+        else if (fabs(mfRY) >= mfReach)
+        {
+            return false;
+        }
+
+        nLeft = std::max<int64_t>(rClip.left, LineFloor(fLo - 0.5));
+        nRight = std::min<int64_t>(rClip.right, LineCeil(fHi - 0.5));
+        return nLeft < nRight;
+    }
+
+    // Columns [nLeft, nRight) with centers inside the inner band and between the ends
+    bool Interior(int64_t& nLeft, int64_t& nRight) const
+    {
+        if (mfInner <= 0.0 || mpSeg->fLength <= 0.0)
+            return false;
+
+        double fLo = -DBL_MAX;
+        double fHi = DBL_MAX;
+        if (mbAcross)
+        {
+            fLo = mfInLo;
+            fHi = mfInHi;
+        }
+        else if (fabs(mfRY) > mfInner)
+        {
+            return false;
+        }
+
+        if (mbAlong)
+        {
+            fLo = std::max<double>(fLo, mfAlongLo);
+            fHi = std::min<double>(fHi, mfAlongHi);
+        }
+        else
+        {
+            double fS = mfRY * mpSeg->fUY;
+            if (fS < 0.0 || fS > mpSeg->fLength)
+                return false;
+        }
+
+        nLeft = LineCeil(fLo - 0.5);
+        nRight = LineFloor(fHi - 0.5) + 1;
+        return nLeft < nRight;
+    }
+
+    int64_t Distance(int64_t x) const
+    {
+        return LineDistance(mnRowN + x * mpSeg->nDN, mnRowS + x * mpSeg->nDS, mpSeg->nLength);
+    }
+
+    const LineSegment*  mpSeg;
+    double      mfReach;
+    double      mfInner;
+    double      mfRY;               // current row's pixel center y relative to the start
+    double      mfBoxLo;
+    double      mfBoxHi;
+    bool        mbAcross;
+    bool        mbAlong;
+    double      mfOutLo;
+    double      mfOutHi;
+    double      mfInLo;
+    double      mfInHi;
+    double      mfAlongLo;
+    double      mfAlongHi;
+    double      mfAcrossStep;
+    double      mfAlongStep;
+    int64_t     mnRowN;             // 16.16 at x = 0 on the current row
+    int64_t     mnRowS;
+    int64_t     mnRowT;
+    int64_t     mnStepN;
+    int64_t     mnStepS;
+    int64_t     mnStepT;
+};
+
+// With bJoined, pixels nearer a neighboring segment are left to it so polyline joints blend once
+template <bool bGradient, bool bJoined>
+static void DrawLineSegment(uint32_t* pPixels, int64_t nStride, const ZRect& rClip, double fHalfWidth, const LineSegment& seg, const LineSegment* pPrev, const LineSegment* pNext)
+{
+    double fReach = fHalfWidth + 0.5;
+    double fInner = fHalfWidth - 0.5;
+    int64_t nReach = (int64_t)(fReach * kLineOne);
+
+    int64_t nTop = std::max<int64_t>(rClip.top, LineFloor(std::min<double>(seg.fY0, seg.fY1) - fReach));
+    int64_t nBottom = std::min<int64_t>(rClip.bottom, LineCeil(std::max<double>(seg.fY0, seg.fY1) + fReach));
+    if (nTop >= nBottom)
+        return;
+
+    const ZBlend::Kernels& kernels = ZBlend::Get();
+    uint32_t span[kLineSpanChunk];
+
+    LineRowWalk walk;
+    LineRowWalk prevWalk;
+    LineRowWalk nextWalk;
+    walk.Start(seg, fReach, fInner, nTop);
+    if constexpr (bJoined)
+    {
+        if (pPrev)
+            prevWalk.Start(*pPrev, fReach, fInner, nTop);
+        if (pNext)
+            nextWalk.Start(*pNext, fReach, fInner, nTop);
+    }
+
+    // neighbor columns on the current row, for the joint test
+    int64_t nPrevLeft = 0, nPrevRight = 0, nNextLeft = 0, nNextRight = 0;
+
+    // Coverage weighted blend of the pixels [nFirst, nEnd) of a row, a span at a time
+    auto spanRun = [&](uint32_t* pRow, int64_t nFirst, int64_t nEnd)
+    {
+        for (int64_t nX = nFirst; nX < nEnd; nX += kLineSpanChunk)
+        {
+            int64_t nCount = std::min<int64_t>(kLineSpanChunk, nEnd - nX);
+            if constexpr (bGradient)
+            {
+                // past the ends the colors hold at the end colors, which the span can't do
+                int64_t t = walk.mnRowT + nX * seg.nDT;
+                int64_t tLast = t + (nCount - 1) * seg.nDT;
+                if (t >= 0 && t <= kLineOne && tLast >= 0 && tLast <= kLineOne)
+                {
+                    LineGradientSpan(span, nCount, seg.nCol0, seg.nCol1, t, seg.nDT);
+                }
+                else
+                {
+                    for (int64_t i = 0; i < nCount; i++, t += seg.nDT)
+                        span[i] = LerpLineColor(seg.nCol0, seg.nCol1, t);
+                }
+            }
+            else
+            {
+                std::fill(span, span + nCount, seg.nCol0);
+            }
+
+            LineCoverageSpan(span, nCount, seg, walk.mnRowN + nX * seg.nDN, walk.mnRowS + nX * seg.nDS, fReach);
+            kernels.srcAlpha[ZBlend::kDest](pRow + nX, span, nCount);
+        }
+    };
+
+    // Pixel by pixel version for rows shared with a neighbor
+    auto edgeRun = [&](uint32_t* pRow, int64_t nFirst, int64_t nEnd)
+    {
+        int64_t n = walk.mnRowN + nFirst * seg.nDN;
+        int64_t s = walk.mnRowS + nFirst * seg.nDS;
+        int64_t t = walk.mnRowT + nFirst * seg.nDT;
+        for (int64_t x = nFirst; x < nEnd; x++, n += seg.nDN, s += seg.nDS, t += seg.nDT)
+        {
+            int64_t nDist = LineDistance(n, s, seg.nLength);
+            if (nDist >= nReach)
+                continue;
+            if constexpr (bJoined)
+            {
+                if (x >= nPrevLeft && x < nPrevRight && prevWalk.Distance(x) <= nDist)
+                    continue;
+                if (x >= nNextLeft && x < nNextRight && nextWalk.Distance(x) < nDist)
+                    continue;
+            }
+
+            uint32_t nCoverage = (uint32_t)std::min<int64_t>((nReach - nDist) >> (kLineFracBits - 8), 256);
+            uint32_t nCol = seg.nCol0;
+            if constexpr (bGradient)
+                nCol = LerpLineColor(seg.nCol0, seg.nCol1, t);
+            uint32_t nAlpha = (ARGB_A(nCol) * nCoverage) >> 8;
+            if (nAlpha > 0)
+                pRow[x] = COL::AlphaBlend_Col2Alpha(nCol, pRow[x], nAlpha);
+        }
+    };
+
+    for (int64_t y = nTop; y < nBottom; y++)
+    {
+        if (y > nTop)
+        {
+            walk.Next();
+            if constexpr (bJoined)
+            {
+                if (pPrev)
+                    prevWalk.Next();
+                if (pNext)
+                    nextWalk.Next();
+            }
+        }
+
+        int64_t nLeft;
+        int64_t nRight;
+        if (!walk.Extent(rClip, nLeft, nRight))
+            continue;
+
+        int64_t nInLeft;
+        int64_t nInRight;
+        if (walk.Interior(nInLeft, nInRight))
+        {
+            nInLeft = std::clamp<int64_t>(nInLeft, nLeft, nRight);
+            nInRight = std::clamp<int64_t>(nInRight, nInLeft, nRight);
+        }
+        else
+        {
+            nInLeft = nInRight = nRight;
+        }
+
+        uint32_t* pRow = pPixels + y * nStride;
+        if constexpr (bJoined)
+        {
+            // columns shared with a neighbor go pixel by pixel
+            if (!pPrev || !prevWalk.Extent(rClip, nPrevLeft, nPrevRight))
+                nPrevLeft = nPrevRight = 0;
+            if (!pNext || !nextWalk.Extent(rClip, nNextLeft, nNextRight))
+                nNextLeft = nNextRight = 0;
+
+            int64_t nSharedLeft = nRight;
+            int64_t nSharedRight = nLeft;
+            if (nPrevLeft < nRight && nPrevRight > nLeft)
+            {
+                nSharedLeft = std::max<int64_t>(nLeft, nPrevLeft);
+                nSharedRight = std::min<int64_t>(nRight, nPrevRight);
+            }
+            if (nNextLeft < nRight && nNextRight > nLeft)
+            {
+                nSharedLeft = std::min<int64_t>(nSharedLeft, std::max<int64_t>(nLeft, nNextLeft));
+                nSharedRight = std::max<int64_t>(nSharedRight, std::min<int64_t>(nRight, nNextRight));
+            }
+
+            if (nSharedLeft < nSharedRight)
+            {
+                spanRun(pRow, nLeft, nSharedLeft);
+                edgeRun(pRow, nSharedLeft, nSharedRight);
+                spanRun(pRow, nSharedRight, nRight);
+                continue;
+            }
+        }
+
+        // short rows are one span, long ones fill the fully covered middle without coverage
+        int64_t nInCount = nInRight - nInLeft;
+        if (nInCount < kLineMinKernelRun)
+        {
+            spanRun(pRow, nLeft, nRight);
+            continue;
+        }
+
+        spanRun(pRow, nLeft, nInLeft);
+        if constexpr (bGradient)
+        {
+            int64_t t = walk.mnRowT + nInLeft * seg.nDT;
+            for (int64_t nX = nInLeft; nX < nInRight; nX += kLineSpanChunk)
+            {
+                int64_t nCount = std::min<int64_t>(kLineSpanChunk, nInRight - nX);
+                LineGradientSpan(span, nCount, seg.nCol0, seg.nCol1, t, seg.nDT);
+                kernels.srcAlpha[ZBlend::kDest](pRow + nX, span, nCount);
+                t += nCount * seg.nDT;
+            }
+        }
+        else
+        {
+            kernels.colorAlpha(pRow + nInLeft, nInCount, seg.nCol0, ARGB_A(seg.nCol0));
+        }
+        spanRun(pRow, nInRight, nRight);
+    }
+}
+
+void ZBuffer::DrawLineSegments(const ZColorVertex* pVerts, size_t nVerts, double thickness, ZRect* pClip, bool bPolyline, bool bClosed)
+{
+    if (!mpPixels || thickness <= 0.0 || nVerts < 2)
+        return;
+
+    ZRect rDest;
+    if (pClip)
+    {
+        rDest = *pClip;
+        rDest.Intersect(&mSurfaceArea);
+    }
+    else
+        rDest = mSurfaceArea;
+    if (rDest.Width() <= 0 || rDest.Height() <= 0)
+        return;
+
+    std::vector<LineSegment> segments;
+    if (bPolyline)
+    {
+        size_t nSegments = bClosed && nVerts > 2 ? nVerts : nVerts - 1;
+        segments.resize(nSegments);
+        for (size_t i = 0; i < nSegments; i++)
+            SetupLineSegment(segments[i], pVerts[i], pVerts[(i + 1) % nVerts]);
+    }
+    else
+    {
+        segments.resize(nVerts / 2);
+        for (size_t i = 0; i < segments.size(); i++)
+            SetupLineSegment(segments[i], pVerts[i * 2], pVerts[i * 2 + 1]);
+    }
+
+    double fHalfWidth = thickness / 2.0;
+    double fMinX = DBL_MAX, fMinY = DBL_MAX, fMaxX = -DBL_MAX, fMaxY = -DBL_MAX;
+    for (size_t i = 0; i < nVerts; i++)
+    {
+        fMinX = std::min<double>(fMinX, pVerts[i].x);
+        fMinY = std::min<double>(fMinY, pVerts[i].y);
+        fMaxX = std::max<double>(fMaxX, pVerts[i].x);
+        fMaxY = std::max<double>(fMaxY, pVerts[i].y);
+    }
+    ZRect rBounds(LineFloor(fMinX - fHalfWidth - 1.0), LineFloor(fMinY - fHalfWidth - 1.0), LineCeil(fMaxX + fHalfWidth + 1.0), LineCeil(fMaxY + fHalfWidth + 1.0));
+    rBounds.Intersect(&rDest);
+    if (rBounds.Width() <= 0 || rBounds.Height() <= 0)
+        return;
+
+    MarkDirty(&rBounds);
+
+    int64_t nStride = mSurfaceArea.Width();
+    size_t nSegments = segments.size();
+    for (size_t i = 0; i < nSegments; i++)
+    {
+        const LineSegment& seg = segments[i];
+        if (!bPolyline && ARGB_A(seg.nCol0) == 0 && ARGB_A(seg.nCol1) == 0)
+            continue;
+
+        bool bGradient = seg.nCol0 != seg.nCol1;
+        if (bPolyline && nSegments > 1)
+        {
+            const LineSegment* pPrev = (i > 0) ? &segments[i - 1] : (bClosed ? &segments[nSegments - 1] : nullptr);
+            const LineSegment* pNext = (i + 1 < nSegments) ? &segments[i + 1] : (bClosed ? &segments[0] : nullptr);
+            if (bGradient)
+                DrawLineSegment<true, true>(mpPixels, nStride, rBounds, fHalfWidth, seg, pPrev, pNext);
+            else
+                DrawLineSegment<false, true>(mpPixels, nStride, rBounds, fHalfWidth, seg, pPrev, pNext);
+        }
+        else
+        {
+            if (bGradient)
+                DrawLineSegment<true, false>(mpPixels, nStride, rBounds, fHalfWidth, seg, nullptr, nullptr);
+            else
+                DrawLineSegment<false, false>(mpPixels, nStride, rBounds, fHalfWidth, seg, nullptr, nullptr);
+        }
+    }
+}
+
+void ZBuffer::DrawAlphaLine(const ZColorVertex& v1, const ZColorVertex& v2, double thickness, ZRect* pClip)
+{
+    const ZColorVertex verts[2] = { v1, v2 };
+    DrawLineSegments(verts, 2, thickness, pClip, false, false);
+}
+
+void ZBuffer::DrawAlphaLines(const tColorVertexArray& lines, double thickness, ZRect* pClip)
+{
+    DrawLineSegments(lines.data(), lines.size(), thickness, pClip, false, false);
+}
+
+void ZBuffer::DrawAlphaPolyline(const tColorVertexArray& points, double thickness, ZRect* pClip, bool bClosed)
+{
+    DrawLineSegments(points.data(), points.size(), thickness, pClip, true, bClosed);
 }
 
 
@@ -1716,6 +2755,7 @@ inline void TransformPoint(ZFPoint& pt, const ZFPoint& ptOrigin, double angle, d
 
 bool ZBuffer::BltRotated(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, double fAngle, double fScale, ZRect* pClip)
 {
+    MarkDirty();
 /*	ZUVVertex vert;
 	vert.mfX = rSrc.left;
 	vert.mfY = rSrc.
@@ -1930,85 +2970,21 @@ bool ZBuffer::BltRotated(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, double fAngle,
 
 
 
-bool ZBuffer::BltScaled(ZBuffer* pSrc)
+bool ZBuffer::BltScaled(ZBuffer* pSrc, ZResample::eFilter filter)
 {
-    //const uint32_t* srcBuffer, int srcWidth, int srcHeight, uint32_t* destBuffer, int destWidth, int destHeight
-    uint32_t* srcBuffer = pSrc->mpPixels;
-    int64_t srcWidth = pSrc->GetArea().Width();
-    int64_t srcHeight = pSrc->GetArea().Height();
-    uint32_t* destBuffer = mpPixels;
-    int64_t destWidth = mSurfaceArea.right;
-    int64_t destHeight = mSurfaceArea.bottom;
-
-    double xScale = static_cast<double>(srcWidth) / destWidth;
-    double yScale = static_cast<double>(srcHeight) / destHeight;
-
-    
-    double fMaxRadius = sqrt(xScale * xScale + yScale * yScale);
-
-    // if scaling up, we need to look at inverse radius
-    if (fMaxRadius < 1.0)
-        fMaxRadius = 1.0 / fMaxRadius;
-
-    for (int y = 0; y < destHeight; ++y) 
-    {
-        for (int x = 0; x < destWidth; ++x) 
-        {
-            double srcX = x * xScale;
-            double srcY = y * yScale;
-
-            int srcXInt = static_cast<int>(srcX);
-            int srcYInt = static_cast<int>(srcY);
-
-            double r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
-            double weightSum = 0.0f;
-
-            for (int32_t j = (int32_t)(srcYInt - yScale/2); j <= (int32_t)(srcYInt + yScale/2); j++)
-            {
-                for (int32_t i = (int32_t)(srcXInt - xScale/2); i <= (int32_t)(srcXInt + xScale/2); i++)
-                {
-
-                    double xDiff = std::abs(srcX - i);
-                    double yDiff = std::abs(srcY - j);
-                    double fDist = (sqrt(xDiff * xDiff + yDiff * yDiff));
-
-                    if (i >= 0 && i < srcWidth && j >= 0 && j < srcHeight && fDist <= fMaxRadius) 
-                    {
-                        double weight = (fMaxRadius - fDist)/ fMaxRadius;
-
-                        uint32_t pixel = srcBuffer[j * srcWidth + i];
-                        double pixelA = static_cast<double>((pixel >> 24) & 0xFF);
-                        double pixelR = static_cast<double>((pixel >> 16) & 0xFF);
-                        double pixelG = static_cast<double>((pixel >> 8) & 0xFF);
-                        double pixelB = static_cast<double>(pixel & 0xFF);
-
-                        a += weight * pixelA;
-                        r += weight * pixelR;
-                        g += weight * pixelG;
-                        b += weight * pixelB;
-
-                        weightSum += weight;
-                    }
-                }
-            }
-
-            if (weightSum > 0.0f) 
-            {
-                a /= weightSum;
-                r /= weightSum;
-                g /= weightSum;
-                b /= weightSum;
-            }
+    MarkDirty();
+    if (!pSrc || !pSrc->mpPixels || !mpPixels)
+        return false;
 
-            uint32_t destPixel = ((static_cast<uint32_t>(a) & 0xFF) << 24) |
-                ((static_cast<uint32_t>(r) & 0xFF) << 16) |
-                ((static_cast<uint32_t>(g) & 0xFF) << 8) |
-                (static_cast<uint32_t>(b) & 0xFF);
+    int64_t nSrcW = pSrc->GetArea().Width();
+    int64_t nSrcH = pSrc->GetArea().Height();
+    int64_t nDstW = mSurfaceArea.Width();
+    int64_t nDstH = mSurfaceArea.Height();
 
-            destBuffer[y * destWidth + x] = destPixel;
-        }
-    }
+    if (!ZResample::Resample(pSrc->mpPixels, nSrcW, nSrcH, nSrcW, mpPixels, nDstW, nDstH, nDstW, filter, &gRasterizer.renderPool))
+        return false;
 
+    mbHasAlphaPixels = pSrc->mbHasAlphaPixels;
     return true;
 }
 
@@ -2039,6 +3015,7 @@ ZRect ZBuffer::FindContentBounds(const ZRect& searchArea)
 
 void ZBuffer::Blur(float radius, float falloff, ZRect* pRect)
 {
+    MarkDirty();
     ZRect rArea(mSurfaceArea);
     if (pRect)
         rArea = *pRect;
@@ -2046,101 +3023,11 @@ void ZBuffer::Blur(float radius, float falloff, ZRect* pRect)
     assert(rArea.left >= mSurfaceArea.left && rArea.right <= mSurfaceArea.right && rArea.top >= mSurfaceArea.top && rArea.bottom <= mSurfaceArea.bottom);
 
     rArea = FindContentBounds(rArea);
+    if (rArea.Width() <= 0 || rArea.Height() <= 0)     // nothing to blur
+        return;
+
     rArea.Inflate(radius/2, radius/2);
     rArea.Intersect(mSurfaceArea);
 
-    int64_t srcStride = mSurfaceArea.Width();
-    int64_t tempStride = rArea.Width();
-
-    ZBuffer temp;
-    temp.Init(rArea.Width(), rArea.Height());
-
-    float sigma = radius / 3.0f;
-
-    // Calculate the size of the kernel based on sigma (standard deviation)
-    int64_t kernelSize = int64_t(6 * sigma) + 1;
-    if (kernelSize % 2 == 0) 
-    {
-        kernelSize++; // Ensure an odd-sized kernel for symmetry
-    }
-
-    // Calculate the radius of the kernel
-    int64_t kernelRadius = kernelSize / 2;
-
-    // Create a 1D Gaussian kernel
-    std::vector<float> kernel(kernelSize);
-    float sum = 0.0f;
-    for (int64_t i = 0; i < kernelSize; i++)
-    {
-        int64_t x = i - kernelRadius;
-        kernel[i] = expf(-(x * x * falloff) / (2.0f * sigma * sigma));
-        sum += kernel[i];
-    }
-
-    // Normalize the kernel
-    for (int64_t i = 0; i < kernelSize; i++)
-    {
-        kernel[i] /= sum;
-    }
-
-    // Perform horizontal convolution
-    for (int64_t tempy = 0; tempy < rArea.Height(); tempy++)
-    {
-        for (int64_t tempx = 0; tempx < rArea.Width(); tempx++)
-        {
-            float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
-            int64_t srcy = rArea.top + tempy;
-
-            for (int64_t i = -kernelRadius; i <= kernelRadius; i++)
-            {
-                int64_t srcx = rArea.left + tempx + i;  // Vary X for horizontal
-                if (srcx < rArea.left || srcx > rArea.right - 1)
-                {
-                    continue;
-                }
-                uint32_t pixel = mpPixels[srcy * srcStride + srcx];
-                float weight = kernel[i + kernelRadius];
-                r += ((pixel >> 16) & 0xFF) * weight;
-                g += ((pixel >> 8) & 0xFF) * weight;
-                b += (pixel & 0xFF) * weight;
-                a += ((pixel >> 24) & 0xFF) * weight;
-            }
-            temp.mpPixels[tempy * tempStride + tempx] = ((uint32_t(a) & 0xFF) << 24) |
-                ((uint32_t(r) & 0xFF) << 16) |
-                ((uint32_t(g) & 0xFF) << 8) |
-                (uint32_t(b) & 0xFF);
-        }
-    }
-
-    // Perform vertical convolution
-    for (int64_t tempx = 0; tempx < rArea.Width(); tempx++)
-    {
-        for (int64_t tempy = 0; tempy < rArea.Height(); tempy++)
-        {
-            float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
-
-            for (int64_t i = -kernelRadius; i <= kernelRadius; i++)
-            {
-                int64_t tempSourceY = tempy + i;  // Vary Y for vertical
-                if (tempSourceY < 0 || tempSourceY >= rArea.Height())  // Bounds in temp coordinates
-                {
-                    continue;
-                }
-                uint32_t pixel = temp.mpPixels[tempSourceY * tempStride + tempx];  // Read from offset position
-                float weight = kernel[i + kernelRadius];
-                r += ((pixel >> 16) & 0xFF) * weight;
-                g += ((pixel >> 8) & 0xFF) * weight;
-                b += (pixel & 0xFF) * weight;
-                a += ((pixel >> 24) & 0xFF) * weight;
-            }
-
-            int64_t dstx = tempx + rArea.left;
-            int64_t dsty = tempy + rArea.top;
-            assert(dstx >= 0 && dstx < mSurfaceArea.right && dsty >= 0 && dsty < mSurfaceArea.bottom);
-            mpPixels[dsty * srcStride + dstx] = ((uint32_t(a) & 0xFF) << 24) |
-                ((uint32_t(r) & 0xFF) << 16) |
-                ((uint32_t(g) & 0xFF) << 8) |
-                (uint32_t(b) & 0xFF);
-        }
-    }
+    ZBlur::Blur(mpPixels, mSurfaceArea.Width(), rArea, radius, falloff, &gRasterizer.renderPool);
 }
@@ -5,8 +5,12 @@
 #include "ZColor.h"
 #include <string>
 #include <mutex>
+#include <vector>
+#include <atomic>
+#include <memory>
 #include "easyexif/exif.h"
 #include "Z3DMath.h"
+#include "ZResample.h"
 
 typedef std::shared_ptr<class ZBuffer> tZBufferPtr;
 
@@ -69,6 +73,31 @@ public:
 
     virtual uint32_t*       GetPixels() { return mpPixels; }
 
+    // Pixel writes through ZBuffer drop what's derived from the pixels (mip chain, tile opacity).
+    // Code that writes mpPixels directly must call MarkDirty() with the rect it wrote.
+    void                    MarkDirty(const ZRect* pRect = nullptr) { InvalidateMipChain(); InvalidateTiles(pRect); }     // whole buffer if null
+
+    // Mip chain for minified sampling.  Each level is a 2x2 box filter of the one above, down to 1x1. Built on first request.
+    ZBuffer*                GetMipLevel(int64_t nLevel);        // level 0 is this buffer. Levels past the end return the 1x1 level
+    int64_t                 GetMipLevelCount();                 // including level 0
+
+    // Coarse opacity map so BltNoClip can copy opaque tiles, skip clear ones and only blend the rest.
+    // Tiles are classified lazily against the ZBlend copy/skip thresholds, so results are identical to blending every pixel.
+    enum eTileOpacity : uint8_t
+    {
+        kTileUnknown    = 0,
+        kTileOpaque     = 1,        // every alpha above ZBlend::kOpaqueThreshold
+        kTileClear      = 2,        // every alpha at or below ZBlend::kClearThreshold
+        kTileMixed      = 3
+    };
+    static const int64_t    kTileSize = 32;
+    eTileOpacity            GetTileOpacity(int64_t nTileX, int64_t nTileY);     // classifies the tile if needed
+
+    // Depth plane for ZRasterizer::RasterizeMesh, one float per pixel where smaller is nearer.
+    // Allocated by the first ClearDepth and dropped when the surface changes size.
+    void                    ClearDepth(float fDepth = 1.0f);
+    float*                  GetDepth();         // null until cleared at the current size
+
     virtual easyexif::EXIFInfo& GetEXIF() { return mEXIF; }
     static bool             ReadEXIFFromFile(const std::string& sName, easyexif::EXIFInfo& info);
 
@@ -92,10 +121,13 @@ public:
 
 	virtual bool            BltRotated(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst, double fAngle, double fScale, ZRect* pClip = NULL);
 
-    virtual bool            BltScaled(ZBuffer* pSrc);
+    virtual bool            BltScaled(ZBuffer* pSrc, ZResample::eFilter filter = ZResample::kAuto);     // resamples all of pSrc into this whole buffer
 
 
+    // Anti-aliased lines with round caps, colors blended along each segment and over dest keeping dest alpha
 	virtual void            DrawAlphaLine(const ZColorVertex& v1, const ZColorVertex& v2, double thickness = 2.0, ZRect* pClip = NULL);
+    virtual void            DrawAlphaLines(const tColorVertexArray& lines, double thickness = 2.0, ZRect* pClip = NULL);     // vertex pairs, one segment each
+    virtual void            DrawAlphaPolyline(const tColorVertexArray& points, double thickness = 2.0, ZRect* pClip = NULL, bool bClosed = false);     // joints blend once
     virtual void            DrawRectAlpha(uint32_t nCol, ZRect rDst, eAlphaBlendType type = kAlphaDest);
 
     virtual void            DrawCircle(ZPoint center, int64_t radius, uint32_t col);
@@ -103,12 +135,23 @@ public:
 
 
     // Load/Save
-	virtual bool            LoadBuffer(const std::string& sName);
+	virtual bool            LoadBuffer(const std::string& sName, int64_t nMinWidth = 0, int64_t nMinHeight = 0);     // with a size hint, large images may load reduced by 2, 4 or 8 while staying at least that big
     virtual bool            SaveBuffer(const std::string& sName);
 #ifdef _WIN64
 //	virtual bool            LoadBuffer(uint32_t nResourceID);
 #endif
 
+    struct LoadTimings
+    {
+        int64_t     nOpenUS;            // map + EXIF
+        int64_t     nDecodeUS;
+        int64_t     nSwizzleUS;         // RGBA->ARGB, alpha scan and any post decode reduction
+        int64_t     nOrientUS;          // EXIF rotation
+        int64_t     nTotalUS;
+    };
+    LoadTimings             mLoadTimings = {};     // from the last LoadBuffer
+    int64_t                 mnLoadReduction;        // 1, 2, 4 or 8 from the last LoadBuffer size hint
+
     // Thread Safety
     virtual std::recursive_mutex& GetMutex() { return mMutex; }
 
@@ -122,12 +165,19 @@ public:
 #endif
 
 protected:
-    bool                    FloatScanLineIntersection(double fScanLine, const ZColorVertex& v1, const ZColorVertex& v2, double& fIntersection, double& fR, double& fG, double& fB, double& fA);
+    void                    DrawLineSegments(const ZColorVertex* pVerts, size_t nVerts, double thickness, ZRect* pClip, bool bPolyline, bool bClosed);
     void                    FillInSpan(uint32_t* pDest, int64_t nNumPixels, double fR, double fG, double fB, double fA);
 
     bool                    LoadFromSVG(const std::string& sName);
+    bool                    AllocPixels(int64_t nWidth, int64_t nHeight);                       // Init without clearing
+    bool                    AdoptPixels(uint32_t* pPixels, int64_t nWidth, int64_t nHeight);    // takes a ZPixelPool block
     uint32_t                ComputePixelBlur(ZBuffer* pBuffer, int64_t nX, int64_t nY, int64_t nRadius);
     ZRect                   FindContentBounds(const ZRect& searchArea);
+    bool                    BuildMipChain();
+    void                    ResetTileMap();     // sizes the tile map for mSurfaceArea with every tile unknown
+    void                    InvalidateTiles(const ZRect* pRect = nullptr);      // whole map if null
+    void                    InvalidateMipChain() { if (mbMipChainValid) mbMipChainValid = false; }
+    eTileOpacity            ClassifyTile(int64_t nTileX, int64_t nTileY);
 
 public:
 	uint32_t*                   mpPixels;        // The color data
@@ -136,4 +186,15 @@ public:
     std::recursive_mutex        mMutex;
     bool                        mbHasAlphaPixels;
     std::atomic<eRenderState>   mRenderState;
+
+protected:
+    std::vector<tZBufferPtr>    mMipChain;          // levels 1..n
+    std::atomic<bool>           mbMipChainValid;
+
+    std::unique_ptr<std::atomic<uint8_t>[]> mTileOpacity;     // eTileOpacity, mnTilesX * mnTilesY
+    int64_t                     mnTilesX;
+    int64_t                     mnTilesY;
+    std::atomic<bool>           mbTilesClassified;  // any tile not unknown, lets invalidation skip the map
+
+    std::vector<float>          mDepth;
 };
@@ -912,6 +912,7 @@ namespace ZD3D
                     pResult->mpPixels[iout] = ARGB(a, r, g, b);
                 }
             }
+            pResult->MarkDirty();
 
             mD3DContext->Unmap(pStaging, 0);
         }
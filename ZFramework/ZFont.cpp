@@ -526,6 +526,8 @@ void ZFont::DrawCharNoClip(ZBuffer* pBuffer, uint8_t c, uint32_t nCol, int64_t n
 	uint32_t* pDest = (pBuffer->GetPixels()) + (nY * nDestStride) + nX;
 
 	int64_t nCharWidth = mCharDescriptors[c].nCharWidth;
+    ZRect rChar(nX, nY, nX + nCharWidth, nY + mFontHeight);
+    pBuffer->MarkDirty(&rChar);     // glyphs are written straight into the pixels
 
     uint8_t nDrawAlpha = nCol >> 24;
 
@@ -608,6 +610,8 @@ void ZFont::DrawCharClipped(ZBuffer* pBuffer, uint8_t c, uint32_t nCol, int64_t
 	uint32_t* pDest = (pBuffer->GetPixels()) + (nY * nDestStride) + nX;
 
 	int64_t nCharWidth = mCharDescriptors[c].nCharWidth;
+    ZRect rChar(nX, nY, nX + nCharWidth, nY + mFontHeight);
+    pBuffer->MarkDirty(&rChar);     // glyphs are written straight into the pixels
     uint8_t nDrawAlpha = nCol >> 24;
 
 
@@ -693,6 +697,8 @@ void ZFont::DrawCharGradient(ZBuffer* pBuffer, uint8_t c, std::vector<uint32_t>&
 	uint32_t* pDest = (pBuffer->GetPixels()) + (nY * nDestStride) + nX;
 
 	int64_t nCharWidth = mCharDescriptors[c].nCharWidth;
+    ZRect rChar(nX, nY, nX + nCharWidth, nY + mFontHeight);
+    pBuffer->MarkDirty(&rChar);     // glyphs are written straight into the pixels
 
 	int64_t nScanlineOffset = 0;
 	int64_t nScanLine = 0;
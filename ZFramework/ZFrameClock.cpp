@@ -0,0 +1,90 @@
+#include "ZFrameClock.h"
+#include "ZWin.H"
+#include "ZTimer.h"
+#include <algorithm>
+
+#ifdef _DEBUG
+#define new new(_NORMAL_BLOCK, THIS_FILE, __LINE__)
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+
+ZFrameClock::ZFrameClock()
+{
+    mnTargetFPS = kDefaultTargetFPS;
+    mnFrame = 0;
+    mnNextFrameUS = 0;
+}
+
+ZFrameClock::~ZFrameClock()
+{
+}
+
+void ZFrameClock::SetTargetFPS(int64_t nFPS)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    mnTargetFPS = std::max<int64_t>(nFPS, 0);
+    mnNextFrameUS = 0;      // restart the cadence at the next Tick
+}
+
+void ZFrameClock::RequestFrame(ZWin* pWin)
+{
+    // Already queued for the coming frame. Tick clears the flag under mMutex before it releases the window,
+    // so a request racing with the release either lands in the release or queues for the frame after.
+    if (pWin->mbFrameRequested.exchange(true))
+        return;
+
+    // Shutdown sets mbShutdownFlag before RemoveWindow takes mMutex, so checking it here means a window can't be queued
+    // again once RemoveWindow has run, even if it's invalidated while its children are being torn down.
+    const std::lock_guard<std::mutex> lock(mMutex);
+    if (pWin->mbShutdownFlag)
+    {
+        pWin->mbFrameRequested = false;
+        return;
+    }
+    mRequests.push_back(pWin);
+}
+
+void ZFrameClock::RemoveWindow(ZWin* pWin)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    mRequests.erase(std::remove(mRequests.begin(), mRequests.end(), pWin), mRequests.end());
+    pWin->mbFrameRequested = false;
+}
+
+bool ZFrameClock::Tick()
+{
+    int64_t nNowUS = gTimer.GetUSSinceEpoch();
+
+    const std::lock_guard<std::mutex> lock(mMutex);
+    if (mRequests.empty())
+        return false;
+
+    if (mnTargetFPS > 0)
+    {
+        if (nNowUS < mnNextFrameUS)
+            return false;
+
+        // Keep a steady cadence, unless the clock was idle or fell a whole frame behind
+        int64_t nIntervalUS = 1000000 / mnTargetFPS;
+        mnNextFrameUS += nIntervalUS;
+        if (mnNextFrameUS <= nNowUS)
+            mnNextFrameUS = nNowUS + nIntervalUS;
+    }
+
+    mnFrame++;
+    mReleasing.swap(mRequests);
+    for (ZWin* pWin : mReleasing)
+    {
+        pWin->mbFrameRequested = false;
+        {
+            const std::lock_guard<std::mutex> winLock(pWin->mMessageQueueMutex);
+            pWin->mbFrameDue = true;
+        }
+        pWin->mWorkToDoCV.notify_one();
+    }
+    mReleasing.clear();
+
+    return true;
+}
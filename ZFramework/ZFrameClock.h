@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ZTypes.h"
+#include <vector>
+#include <mutex>
+
+class ZWin;
+
+typedef std::vector<ZWin*> tFrameWinList;
+
+// Paces window painting to the display loop.
+// Invalidate() and animating windows request a frame instead of spinning their threads. Requests made during one frame
+// are coalesced, and the main loop's Tick() releases all of them together once the target frame interval has passed,
+// so windows paint in phase with the compositor and at most once per frame. Windows with no request block until a
+// message or a frame wakes them.
+
+class ZFrameClock
+{
+public:
+    ZFrameClock();
+    ~ZFrameClock();
+
+    static const int64_t kDefaultTargetFPS = 60;
+
+    void            SetTargetFPS(int64_t nFPS);         // 0 releases requests every Tick
+    int64_t         GetTargetFPS() const { return mnTargetFPS; }
+    int64_t         GetFrame() const { return mnFrame; }
+
+    void            RequestFrame(ZWin* pWin);           // pWin paints at the next frame. Repeated requests before then coalesce. Ignored once pWin is shutting down
+    void            RemoveWindow(ZWin* pWin);           // drops any pending request, for windows shutting down
+
+    bool            Tick();                             // called by the main loop. Returns true if a frame was released
+
+protected:
+    std::mutex      mMutex;
+    tFrameWinList   mRequests;
+    tFrameWinList   mReleasing;         // swapped with mRequests each frame
+    int64_t         mnTargetFPS;
+    int64_t         mnFrame;
+    int64_t         mnNextFrameUS;
+};
+
+extern ZFrameClock gFrameClock;
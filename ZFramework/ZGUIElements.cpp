@@ -74,6 +74,7 @@ namespace ZGUI
                         *pStart = (*pStart | 0xff000000); // all alpha values to full opaque
                         pStart++;
                     }
+                    renderedBuf.MarkDirty();
 
                     renderedBuf.FillAlpha(style.bgCol, &rRenLabel);
                     renderedBuf.Blur(blurBackground, 3.0f, &rRenLabel);
@@ -285,6 +286,7 @@ namespace ZGUI
 
             *pDstCol++ = ARGB(destAlpha, 0, 0, 0);
         }
+        pDst->MarkDirty();
     }
 
 
@@ -314,6 +316,7 @@ namespace ZGUI
                 *pStart = (*pStart & 0xff000000); // all colors to gray scale with alpha
                 pStart++;
             }
+            renderedShadow->MarkDirty();
 
             if (radius > 1.0)
             {
@@ -362,6 +365,7 @@ namespace ZGUI
                 *pStart = (*pStart & 0xff000000) | (col &0x00ffffff);
                 pStart++;
             }
+            renderedShadow->MarkDirty();
         }
 
         ZRect rSrc(renderedShadow->GetArea());
@@ -7,6 +7,12 @@
 
 class ZScreenBuffer;
 
+// Windows builds present the screen buffer through GDI. Other platforms, and Windows builds with ZFRAME_HEADLESS defined,
+// composite into the screen buffer's own memory and never touch a window (see platforms/headless/Main_Headless.cpp).
+#if defined(_WIN64) && !defined(ZFRAME_HEADLESS)
+#define ZFRAME_GDI_PRESENT
+#endif
+
 
 class ZGraphicSystem
 {
@@ -0,0 +1,687 @@
+#include "ZJpeg.h"
+#include "ZPixelPool.h"
+#include "ZColor.h"
+#include <vector>
+#include <math.h>
+#include <string.h>
+
+#ifdef _DEBUG
+#define new new(_NORMAL_BLOCK, THIS_FILE, __LINE__)
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+namespace ZJpeg
+{
+    const int       kFastBits       = 9;
+    const int       kMaxComponents  = 3;
+
+    // zigzag index -> natural (row major) index
+    static const uint8_t kZigZag[64] =
+    {
+         0,  1,  8, 16,  9,  2,  3, 10,
+        17, 24, 32, 25, 18, 11,  4,  5,
+        12, 19, 26, 33, 40, 48, 41, 34,
+        27, 20, 13,  6,  7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36,
+        29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46,
+        53, 60, 61, 54, 47, 55, 62, 63
+    };
+
+    // Tables start out decoding nothing, so a stream that reaches one it never defined can only fail
+    struct Huffman
+    {
+        Huffman() { memset(fast, 255, sizeof(fast)); }
+
+        uint8_t     fast[1 << kFastBits];       // index into values for codes of kFastBits or fewer, 255 otherwise
+        uint16_t    code[256] = {};
+        uint8_t     values[256] = {};
+        uint8_t     size[257] = {};
+        uint32_t    maxcode[18] = {};           // one past the last code of each length, left justified to 16 bits
+        int32_t     delta[17] = {};             // values index - code for each length
+        bool        bDefined = false;           // set by a DHT
+    };
+
+    struct Component
+    {
+        int32_t                 id;
+        int32_t                 h;
+        int32_t                 v;
+        int32_t                 tq;
+        int32_t                 td;
+        int32_t                 ta;
+        int32_t                 dcPred;
+        int64_t                 nPlaneW;
+        int64_t                 nPlaneH;
+        std::vector<uint8_t>    plane;          // reduced samples, padded out to whole MCUs
+    };
+
+    struct Decoder
+    {
+        const uint8_t*  p;
+        const uint8_t*  pEnd;
+
+        uint16_t        quant[4][64] = {};      // zigzag order
+        bool            quantDefined[4] = {};   // set by a DQT
+        Huffman         dc[4];
+        Huffman         ac[4];
+
+        Component       comps[kMaxComponents];
+        int32_t         nComps = 0;
+        int64_t         nWidth = 0;
+        int64_t         nHeight = 0;
+        int32_t         hMax = 1;
+        int32_t         vMax = 1;
+        int32_t         nRestartInterval = 0;
+        bool            bAdobeRGB = false;
+
+        int32_t         scanComps[kMaxComponents];
+        int32_t         nScanComps = 0;
+
+        // entropy coded bits, left justified
+        uint32_t        bits = 0;
+        int32_t         nBits = 0;
+        bool            bMarker = false;
+    };
+
+
+    static bool BuildHuffman(Huffman& h, const uint8_t* pCounts)
+    {
+        int32_t k = 0;
+        for (int32_t i = 0; i < 16; i++)
+            for (int32_t j = 0; j < pCounts[i]; j++)
+                h.size[k++] = (uint8_t)(i + 1);
+        h.size[k] = 0;
+
+        uint32_t code = 0;
+        k = 0;
+        for (int32_t j = 1; j <= 16; j++)
+        {
+            h.delta[j] = k - (int32_t)code;
+            if (h.size[k] == j)
+            {
+                while (h.size[k] == j)
+                    h.code[k++] = (uint16_t)code++;
+                if (code - 1 >= (1u << j))
+                    return false;   // more codes than bits
+            }
+            h.maxcode[j] = code << (16 - j);
+            code <<= 1;
+        }
+        h.maxcode[17] = 0xffffffff;
+
+        memset(h.fast, 255, sizeof(h.fast));
+        for (int32_t i = 0; i < k; i++)
+        {
+            int32_t s = h.size[i];
+            if (s <= kFastBits)
+            {
+                int32_t c = h.code[i] << (kFastBits - s);
+                int32_t m = 1 << (kFastBits - s);
+                for (int32_t j = 0; j < m; j++)
+                    h.fast[c + j] = (uint8_t)i;
+            }
+        }
+        return true;
+    }
+
+
+    static inline uint32_t Read16(const uint8_t* p)
+    {
+        return (p[0] << 8) | p[1];
+    }
+
+    // Parses markers up to the start of the first scan, or just through the frame header when bFrameOnly
+    static bool ParseHeaders(Decoder& d, bool bFrameOnly)
+    {
+        if (d.pEnd - d.p < 4 || d.p[0] != 0xff || d.p[1] != 0xd8)
+            return false;
+        d.p += 2;
+
+        bool bFrame = false;
+        while (d.p < d.pEnd)
+        {
+            if (*d.p != 0xff)
+            {
+                d.p++;          // junk between segments
+                continue;
+            }
+            while (d.p < d.pEnd && *d.p == 0xff)
+                d.p++;
+            if (d.p >= d.pEnd)
+                return false;
+
+            uint8_t marker = *d.p++;
+            if (marker == 0xd9)     // EOI before any scan
+                return false;
+            if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+                continue;           // no length
+
+            if (d.pEnd - d.p < 2)
+                return false;
+            uint32_t nLen = Read16(d.p);
+            if (nLen < 2 || d.p + nLen > d.pEnd)
+                return false;
+            const uint8_t* pSeg = d.p + 2;
+            const uint8_t* pSegEnd = d.p + nLen;
+            d.p = pSegEnd;
+
+            switch (marker)
+            {
+            case 0xdb:      // DQT
+                while (pSeg < pSegEnd)
+                {
+                    int32_t nPrecision = *pSeg >> 4;
+                    int32_t nTable = *pSeg & 3;
+                    pSeg++;
+                    if (pSeg + (nPrecision ? 128 : 64) > pSegEnd)
+                        return false;
+                    for (int32_t i = 0; i < 64; i++)
+                    {
+                        d.quant[nTable][i] = nPrecision ? (uint16_t)Read16(pSeg) : *pSeg;
+                        pSeg += nPrecision ? 2 : 1;
+                    }
+                    d.quantDefined[nTable] = true;
+                }
+                break;
+
+            case 0xc4:      // DHT
+                while (pSeg < pSegEnd)
+                {
+                    int32_t nClass = *pSeg >> 4;
+                    int32_t nTable = *pSeg & 3;
+                    pSeg++;
+                    if (pSeg + 16 > pSegEnd)
+                        return false;
+                    const uint8_t* pCounts = pSeg;
+                    int32_t nTotal = 0;
+                    for (int32_t i = 0; i < 16; i++)
+                        nTotal += pCounts[i];
+                    pSeg += 16;
+                    if (nTotal > 256 || pSeg + nTotal > pSegEnd)
+                        return false;
+
+                    Huffman& h = nClass ? d.ac[nTable] : d.dc[nTable];
+                    if (!BuildHuffman(h, pCounts))
+                        return false;
+                    memcpy(h.values, pSeg, nTotal);
+                    h.bDefined = true;
+                    pSeg += nTotal;
+                }
+                break;
+
+            case 0xc0:      // SOF0 baseline
+            case 0xc1:      // SOF1 extended sequential, huffman
+                {
+                    if (pSegEnd - pSeg < 6 || pSeg[0] != 8)
+                        return false;       // 12 bit
+                    d.nHeight = Read16(pSeg + 1);
+                    d.nWidth = Read16(pSeg + 3);
+                    d.nComps = pSeg[5];
+                    pSeg += 6;
+
+                    if (d.nWidth == 0 || d.nHeight == 0 || (d.nComps != 1 && d.nComps != 3) || pSeg + d.nComps * 3 > pSegEnd)
+                        return false;       // DNL defined height, CMYK
+
+                    for (int32_t i = 0; i < d.nComps; i++)
+                    {
+                        Component& c = d.comps[i];
+                        c.id = pSeg[0];
+                        c.h = pSeg[1] >> 4;
+                        c.v = pSeg[1] & 15;
+                        c.tq = pSeg[2] & 3;
+                        pSeg += 3;
+                        if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4)
+                            return false;
+                        d.hMax = std::max<int32_t>(d.hMax, c.h);
+                        d.vMax = std::max<int32_t>(d.vMax, c.v);
+                    }
+
+                    // chroma has to be an integer fraction of luma
+                    for (int32_t i = 0; i < d.nComps; i++)
+                    {
+                        if (d.hMax % d.comps[i].h != 0 || d.vMax % d.comps[i].v != 0)
+                            return false;
+                    }
+                    if (d.nComps == 1)
+                        d.hMax = d.vMax = d.comps[0].h = d.comps[0].v = 1;     // single component scans are never interleaved
+
+                    bFrame = true;
+                    if (bFrameOnly)
+                        return true;
+                }
+                break;
+
+            case 0xc2: case 0xc3: case 0xc5: case 0xc6: case 0xc7:
+            case 0xc9: case 0xca: case 0xcb: case 0xcd: case 0xce: case 0xcf:
+                return false;       // progressive, lossless, hierarchical or arithmetic
+
+            case 0xdd:      // DRI
+                if (pSegEnd - pSeg < 2)
+                    return false;
+                d.nRestartInterval = Read16(pSeg);
+                break;
+
+            case 0xee:      // APP14. Adobe transform 0 with three components is RGB, not YCbCr
+                if (pSegEnd - pSeg >= 12 && memcmp(pSeg, "Adobe", 5) == 0 && pSeg[11] == 0)
+                    d.bAdobeRGB = true;
+                break;
+
+            case 0xda:      // SOS
+                {
+                    if (!bFrame || pSegEnd - pSeg < 1)
+                        return false;
+                    d.nScanComps = *pSeg++;
+                    if (d.nScanComps != d.nComps || pSeg + d.nScanComps * 2 + 3 > pSegEnd)
+                        return false;       // components split across scans
+
+                    for (int32_t i = 0; i < d.nScanComps; i++)
+                    {
+                        int32_t nIndex = -1;
+                        for (int32_t c = 0; c < d.nComps; c++)
+                        {
+                            if (d.comps[c].id == pSeg[0])
+                                nIndex = c;
+                        }
+                        if (nIndex < 0)
+                            return false;
+
+                        Component& c = d.comps[nIndex];
+                        d.scanComps[i] = nIndex;
+                        c.td = (pSeg[1] >> 4) & 3;
+                        c.ta = pSeg[1] & 3;
+                        pSeg += 2;
+
+                        if (!d.quantDefined[c.tq] || !d.dc[c.td].bDefined || !d.ac[c.ta].bDefined)
+                            return false;       // references a table the stream never defined
+                    }
+                    return true;
+                }
+
+            default:        // APPn, COM and anything else with a length
+                break;
+            }
+        }
+
+        return false;
+    }
+
+
+    static void FillBits(Decoder& d)
+    {
+        while (d.nBits <= 24)
+        {
+            uint32_t b = 0;
+            if (!d.bMarker && d.p < d.pEnd)
+            {
+                b = *d.p;
+                if (b == 0xff)
+                {
+                    if (d.p + 1 < d.pEnd && d.p[1] == 0x00)
+                    {
+                        d.p += 2;   // stuffed byte
+                    }
+                    else
+                    {
+                        d.bMarker = true;   // leave the marker for the restart handling.  Feed zeros from here
+                        b = 0;
+                    }
+                }
+                else
+                {
+                    d.p++;
+                }
+            }
+            d.bits |= b << (24 - d.nBits);
+            d.nBits += 8;
+        }
+    }
+
+    static inline int32_t DecodeHuffman(Decoder& d, const Huffman& h)
+    {
+        if (d.nBits < 16)
+            FillBits(d);
+
+        int32_t k = h.fast[d.bits >> (32 - kFastBits)];
+        if (k < 255)
+        {
+            int32_t s = h.size[k];
+            d.bits <<= s;
+            d.nBits -= s;
+            return h.values[k];
+        }
+
+        uint32_t temp = d.bits >> 16;
+        for (k = kFastBits + 1; k < 17; k++)
+        {
+            if (temp < h.maxcode[k])
+                break;
+        }
+        if (k == 17)
+            return -1;
+
+        int32_t c = (int32_t)((d.bits >> (32 - k)) & ((1u << k) - 1)) + h.delta[k];
+        if (c < 0 || c > 255)
+            return -1;
+        d.bits <<= k;
+        d.nBits -= k;
+        return h.values[c];
+    }
+
+    static inline int32_t ReceiveExtend(Decoder& d, int32_t n)
+    {
+        if (d.nBits < n)
+            FillBits(d);
+
+        uint32_t v = d.bits >> (32 - n);
+        d.bits <<= n;
+        d.nBits -= n;
+
+        if (v < (1u << (n - 1)))
+            return (int32_t)v - (1 << n) + 1;
+        return (int32_t)v;
+    }
+
+    // Entropy decodes one block, keeping only the dequantized coefficients in the low frequency N x N corner
+    static bool DecodeBlock(Decoder& d, Component& c, int32_t N, float* pCoef)
+    {
+        const uint16_t* pQuant = d.quant[c.tq];
+        memset(pCoef, 0, sizeof(float) * N * N);
+
+        int32_t t = DecodeHuffman(d, d.dc[c.td]);
+        if (t < 0 || t > 15)
+            return false;
+        if (t)
+            c.dcPred += ReceiveExtend(d, t);
+        pCoef[0] = (float)(c.dcPred * pQuant[0]);
+
+        const Huffman& ac = d.ac[c.ta];
+        for (int32_t k = 1; k < 64; k++)
+        {
+            int32_t rs = DecodeHuffman(d, ac);
+            if (rs < 0)
+                return false;
+
+            int32_t r = rs >> 4;
+            int32_t s = rs & 15;
+            if (s == 0)
+            {
+                if (r != 15)
+                    break;          // EOB
+                k += 15;            // ZRL
+                continue;
+            }
+
+            k += r;
+            if (k > 63)
+                return false;
+
+            int32_t nValue = ReceiveExtend(d, s);
+            int32_t nNatural = kZigZag[k];
+            int32_t u = nNatural & 7;
+            int32_t v = nNatural >> 3;
+            if (u < N && v < N)
+                pCoef[v * N + u] = (float)(nValue * pQuant[k]);
+        }
+
+        return true;
+    }
+
+    // basis[x][u] = c(u)/2 * cos((2x+1)u*pi/2N).  The N point inverse of the low N coefficients of an 8 point DCT
+    struct ReducedIDCT
+    {
+        float basis[4][4];
+
+        ReducedIDCT(int32_t N)
+        {
+            for (int32_t x = 0; x < N; x++)
+            {
+                for (int32_t u = 0; u < N; u++)
+                {
+                    double cu = (u == 0) ? sqrt(0.5) : 1.0;
+                    basis[x][u] = (float)(cu / 2.0 * cos((2 * x + 1) * u * 3.14159265358979323846 / (2.0 * N)));
+                }
+            }
+        }
+    };
+
+    static void InverseTransform(const float* pCoef, int32_t N, const ReducedIDCT& idct, uint8_t* pOut, int64_t nStride)
+    {
+        float rows[16];     // [v][x]
+        for (int32_t v = 0; v < N; v++)
+        {
+            for (int32_t x = 0; x < N; x++)
+            {
+                float f = 0.0f;
+                for (int32_t u = 0; u < N; u++)
+                    f += idct.basis[x][u] * pCoef[v * N + u];
+                rows[v * N + x] = f;
+            }
+        }
+
+        for (int32_t y = 0; y < N; y++)
+        {
+            for (int32_t x = 0; x < N; x++)
+            {
+                float f = 128.5f;
+                for (int32_t v = 0; v < N; v++)
+                    f += idct.basis[y][v] * rows[v * N + x];
+
+                int32_t n = (f > 0.0f) ? (int32_t)f : 0;       // truncation is floor once negatives are out
+                pOut[y * nStride + x] = (uint8_t)(n > 255 ? 255 : n);
+            }
+        }
+    }
+
+    // Resyncs on the next RSTn marker and resets the predictors
+    static void Restart(Decoder& d)
+    {
+        d.bits = 0;
+        d.nBits = 0;
+        d.bMarker = false;
+
+        while (d.p + 1 < d.pEnd)
+        {
+            if (d.p[0] == 0xff && d.p[1] >= 0xd0 && d.p[1] <= 0xd7)
+            {
+                d.p += 2;
+                break;
+            }
+            d.p++;
+        }
+
+        for (int32_t i = 0; i < d.nComps; i++)
+            d.comps[i].dcPred = 0;
+    }
+
+    static bool DecodeScan(Decoder& d, int32_t N)
+    {
+        ReducedIDCT idct(N);
+        float coef[16];
+
+        int64_t nMCUsX = (d.nWidth + 8 * d.hMax - 1) / (8 * d.hMax);
+        int64_t nMCUsY = (d.nHeight + 8 * d.vMax - 1) / (8 * d.vMax);
+
+        for (int32_t i = 0; i < d.nComps; i++)
+        {
+            Component& c = d.comps[i];
+            c.nPlaneW = nMCUsX * c.h * N;
+            c.nPlaneH = nMCUsY * c.v * N;
+            c.plane.assign(c.nPlaneW * c.nPlaneH, 0);
+            c.dcPred = 0;
+        }
+
+        int64_t nRestartsLeft = d.nRestartInterval;
+
+        if (d.nScanComps == 1)
+        {
+            // non interleaved. MCU is a single block and the block count isn't padded to the sampling factors
+            Component& c = d.comps[d.scanComps[0]];
+            int64_t nBlocksX = ((d.nWidth * c.h + d.hMax - 1) / d.hMax + 7) / 8;
+            int64_t nBlocksY = ((d.nHeight * c.v + d.vMax - 1) / d.vMax + 7) / 8;
+
+            for (int64_t by = 0; by < nBlocksY; by++)
+            {
+                for (int64_t bx = 0; bx < nBlocksX; bx++)
+                {
+                    if (!DecodeBlock(d, c, N, coef))
+                        return false;
+                    InverseTransform(coef, N, idct, c.plane.data() + (by * N) * c.nPlaneW + bx * N, c.nPlaneW);
+
+                    if (d.nRestartInterval && --nRestartsLeft == 0)
+                    {
+                        Restart(d);
+                        nRestartsLeft = d.nRestartInterval;
+                    }
+                }
+            }
+            return true;
+        }
+
+        for (int64_t my = 0; my < nMCUsY; my++)
+        {
+            for (int64_t mx = 0; mx < nMCUsX; mx++)
+            {
+                for (int32_t i = 0; i < d.nScanComps; i++)
+                {
+                    Component& c = d.comps[d.scanComps[i]];
+                    for (int32_t v = 0; v < c.v; v++)
+                    {
+                        for (int32_t h = 0; h < c.h; h++)
+                        {
+                            if (!DecodeBlock(d, c, N, coef))
+                                return false;
+
+                            int64_t bx = mx * c.h + h;
+                            int64_t by = my * c.v + v;
+                            InverseTransform(coef, N, idct, c.plane.data() + (by * N) * c.nPlaneW + bx * N, c.nPlaneW);
+                        }
+                    }
+                }
+
+                if (d.nRestartInterval && --nRestartsLeft == 0)
+                {
+                    Restart(d);
+                    nRestartsLeft = d.nRestartInterval;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    static inline uint32_t Clamp255(int32_t n)
+    {
+        return (uint32_t)(n < 0 ? 0 : (n > 255 ? 255 : n));
+    }
+
+    // Planes to ARGB.  Chroma is replicated from its (possibly subsampled) plane
+    static void ConvertPlanes(const Decoder& d, uint32_t* pDst, int64_t nDstW, int64_t nDstH)
+    {
+        const Component& c0 = d.comps[0];
+        if (d.nComps == 1)
+        {
+            for (int64_t y = 0; y < nDstH; y++)
+            {
+                const uint8_t* pY = c0.plane.data() + y * c0.nPlaneW;
+                uint32_t* pOut = pDst + y * nDstW;
+                for (int64_t x = 0; x < nDstW; x++)
+                    pOut[x] = ARGB(0xffu, (uint32_t)pY[x], (uint32_t)pY[x], (uint32_t)pY[x]);
+            }
+            return;
+        }
+
+        const Component& c1 = d.comps[1];
+        const Component& c2 = d.comps[2];
+        int32_t nRatioX[3] = { d.hMax / c0.h, d.hMax / c1.h, d.hMax / c2.h };
+        int32_t nRatioY[3] = { d.vMax / c0.v, d.vMax / c1.v, d.vMax / c2.v };
+
+        for (int64_t y = 0; y < nDstH; y++)
+        {
+            const uint8_t* p0 = c0.plane.data() + (y / nRatioY[0]) * c0.nPlaneW;
+            const uint8_t* p1 = c1.plane.data() + (y / nRatioY[1]) * c1.nPlaneW;
+            const uint8_t* p2 = c2.plane.data() + (y / nRatioY[2]) * c2.nPlaneW;
+            uint32_t* pOut = pDst + y * nDstW;
+
+            if (d.bAdobeRGB)
+            {
+                for (int64_t x = 0; x < nDstW; x++)
+                    pOut[x] = ARGB(0xffu, (uint32_t)p0[x / nRatioX[0]], (uint32_t)p1[x / nRatioX[1]], (uint32_t)p2[x / nRatioX[2]]);
+                continue;
+            }
+
+            for (int64_t x = 0; x < nDstW; x++)
+            {
+                // JFIF YCbCr in 16.16
+                int32_t Y = ((int32_t)p0[x / nRatioX[0]] << 16) + 32768;
+                int32_t cb = (int32_t)p1[x / nRatioX[1]] - 128;
+                int32_t cr = (int32_t)p2[x / nRatioX[2]] - 128;
+
+                uint32_t r = Clamp255((Y + 91881 * cr) >> 16);
+                uint32_t g = Clamp255((Y - 22554 * cb - 46802 * cr) >> 16);
+                uint32_t b = Clamp255((Y + 116130 * cb) >> 16);
+                pOut[x] = ARGB(0xffu, r, g, b);
+            }
+        }
+    }
+
+
+    int64_t ReductionForSize(int64_t nWidth, int64_t nHeight, int64_t nMinWidth, int64_t nMinHeight)
+    {
+        int64_t nReduction = 1;
+        while (nReduction < 8 &&
+               (nWidth + nReduction * 2 - 1) / (nReduction * 2) >= nMinWidth &&
+               (nHeight + nReduction * 2 - 1) / (nReduction * 2) >= nMinHeight)
+        {
+            nReduction *= 2;
+        }
+        return nReduction;
+    }
+
+    bool ReadHeader(const uint8_t* pData, size_t nBytes, int64_t& nWidth, int64_t& nHeight)
+    {
+        Decoder d;
+        d.p = pData;
+        d.pEnd = pData + nBytes;
+        if (!ParseHeaders(d, true))
+            return false;
+
+        nWidth = d.nWidth;
+        nHeight = d.nHeight;
+        return true;
+    }
+
+    uint32_t* DecodeReduced(const uint8_t* pData, size_t nBytes, int64_t nReduction, int64_t& nWidth, int64_t& nHeight)
+    {
+        int32_t N;
+        if (nReduction == 2)
+            N = 4;
+        else if (nReduction == 4)
+            N = 2;
+        else if (nReduction == 8)
+            N = 1;
+        else
+            return nullptr;
+
+        Decoder d;
+        d.p = pData;
+        d.pEnd = pData + nBytes;
+
+        if (!ParseHeaders(d, false))
+            return nullptr;
+
+        if (!DecodeScan(d, N))
+            return nullptr;
+
+        nWidth = (d.nWidth + nReduction - 1) / nReduction;
+        nHeight = (d.nHeight + nReduction - 1) / nReduction;
+
+        uint32_t* pPixels = ZPixelPool::Alloc(nWidth * nHeight);
+        if (!pPixels)
+            return nullptr;
+
+        ConvertPlanes(d, pPixels, nWidth, nHeight);
+        return pPixels;
+    }
+};
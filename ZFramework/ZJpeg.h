@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ZTypes.h"
+
+// Reduced resolution JPEG decoder used by ZBuffer::LoadBuffer when a size hint is given
+// Scales in the DCT domain: each 8x8 block is inverse transformed from its low frequency NxN corner straight to
+// N x N pixels (N = 4, 2 or 1), so the full resolution image is never materialized.
+// Handles baseline and extended sequential huffman JPEGs with one (gray) or three (YCbCr) components, any sampling
+// factors and restart intervals. Progressive, arithmetic, 12 bit and CMYK files return nullptr so the caller can fall back.
+
+namespace ZJpeg
+{
+    // Largest of 1, 2, 4 or 8 that keeps nWidth x nHeight at or above nMinWidth x nMinHeight
+    int64_t     ReductionForSize(int64_t nWidth, int64_t nHeight, int64_t nMinWidth, int64_t nMinHeight);
+
+    // Frame dimensions from the SOF marker. False if the data isn't a JPEG the reduced path can decode
+    bool        ReadHeader(const uint8_t* pData, size_t nBytes, int64_t& nWidth, int64_t& nHeight);
+
+    // Decodes at 1/nReduction (2, 4 or 8) into a ZPixelPool block of opaque ARGB pixels, nWidth x nHeight
+    uint32_t*   DecodeReduced(const uint8_t* pData, size_t nBytes, int64_t nReduction, int64_t& nWidth, int64_t& nHeight);
+};
@@ -26,6 +26,7 @@ using namespace std;
 ZMainWin::ZMainWin()
 {
 	msWinName = "mainwin";
+    mIdleSleepMS = kIdleForever;     // no polling work, only messages and frames
 }
 
 bool ZMainWin::Init()
@@ -0,0 +1,310 @@
+#include "ZPixelPool.h"
+#include "ZDebug.h"
+#include <mutex>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <bit>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN64
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#ifdef _DEBUG
+#define new new(_NORMAL_BLOCK, THIS_FILE, __LINE__)
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+namespace ZPixelPool
+{
+    struct Block
+    {
+        size_t  nBytes;         // size class
+        bool    bOSPages;
+        bool    bLargePages;
+    };
+
+    struct Pool
+    {
+        std::mutex                                      mutex;
+        std::map<size_t, std::vector<uint32_t*>>        freeBlocks;         // by size class
+        std::unordered_map<uint32_t*, Block>            blocks;             // every live or retained block
+        Stats                                           stats = {};
+        size_t                                          nMaxRetainedBytes = kDefaultMaxRetainedBytes;
+        bool                                            bLargePages = false;
+        size_t                                          nLargePageSize = 0;
+    };
+
+    // Never destroyed. ZBuffers held in globals can still free into it during static destruction
+    static Pool& GetPool()
+    {
+        static Pool* pPool = new Pool();
+        return *pPool;
+    }
+
+    static size_t SizeClass(size_t nBytes)
+    {
+        if (nBytes <= kSmallBlockBytes)
+            return std::max<size_t>((nBytes + 4095) & ~(size_t)4095, 4096);
+
+        // eight classes per power of two, so at most 12.5% over
+        size_t nStep = (size_t)1 << (std::bit_width(nBytes - 1) - 4);
+        return (nBytes + nStep - 1) & ~(nStep - 1);
+    }
+
+
+#ifdef _WIN64
+    static bool EnableLockMemoryPrivilege()
+    {
+        HANDLE hToken;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+            return false;
+
+        TOKEN_PRIVILEGES tp;
+        tp.PrivilegeCount = 1;
+        tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        bool bSuccess = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid) &&
+                        AdjustTokenPrivileges(hToken, FALSE, &tp, 0, nullptr, nullptr) &&
+                        GetLastError() == ERROR_SUCCESS;       // ERROR_NOT_ALL_ASSIGNED when the account doesn't hold it
+        CloseHandle(hToken);
+        return bSuccess;
+    }
+
+    static void* OSAlloc(size_t nBytes, bool bTryLargePages, size_t nLargePageSize, bool& bLargePages)
+    {
+        bLargePages = false;
+        if (bTryLargePages && nLargePageSize > 0 && (nBytes % nLargePageSize) == 0)
+        {
+            void* p = VirtualAlloc(nullptr, nBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (p)
+            {
+                bLargePages = true;
+                return p;
+            }
+        }
+
+        return VirtualAlloc(nullptr, nBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    static void OSFree(void* p, size_t)
+    {
+        VirtualFree(p, 0, MEM_RELEASE);
+    }
+
+    static void* AlignedAlloc(size_t nBytes)    { return _aligned_malloc(nBytes, kAlignment); }
+    static void AlignedFree(void* p)            { _aligned_free(p); }
+#else
+    static bool EnableLockMemoryPrivilege()
+    {
+        return true;        // transparent huge pages are requested per mapping
+    }
+
+    static void* OSAlloc(size_t nBytes, bool bTryLargePages, size_t, bool& bLargePages)
+    {
+        void* p = mmap(nullptr, nBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return nullptr;
+
+        bLargePages = false;
+#ifdef MADV_HUGEPAGE
+        if (bTryLargePages)
+            bLargePages = madvise(p, nBytes, MADV_HUGEPAGE) == 0;
+#endif
+        return p;
+    }
+
+    static void OSFree(void* p, size_t nBytes)
+    {
+        munmap(p, nBytes);
+    }
+
+    static void* AlignedAlloc(size_t nBytes)    { return aligned_alloc(kAlignment, nBytes); }
+    static void AlignedFree(void* p)            { free(p); }
+#endif
+
+    // must hold pool.mutex
+    static void ReleaseBlock(Pool& pool, uint32_t* pPixels)
+    {
+        auto it = pool.blocks.find(pPixels);
+        ZASSERT(it != pool.blocks.end());
+
+        if (it->second.bLargePages)
+            pool.stats.nLargePageBytes -= it->second.nBytes;
+
+        if (it->second.bOSPages)
+            OSFree(pPixels, it->second.nBytes);
+        else
+            AlignedFree(pPixels);
+
+        pool.blocks.erase(it);
+    }
+
+    uint32_t* Alloc(int64_t nPixels)
+    {
+        if (nPixels <= 0)
+            return nullptr;
+
+        size_t nBytes = SizeClass((size_t)nPixels * sizeof(uint32_t));
+
+        Pool& pool = GetPool();
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.stats.nAllocs++;
+
+        auto freeIt = pool.freeBlocks.find(nBytes);
+        if (freeIt != pool.freeBlocks.end() && !freeIt->second.empty())
+        {
+            uint32_t* pPixels = freeIt->second.back();
+            freeIt->second.pop_back();
+
+            pool.stats.nPoolHits++;
+            pool.stats.nBytesRetained -= nBytes;
+            pool.stats.nBytesInUse += nBytes;
+            return pPixels;
+        }
+
+        Block block;
+        block.nBytes = nBytes;
+        block.bOSPages = nBytes >= kLargeBlockBytes;
+        block.bLargePages = false;
+
+        uint32_t* pPixels;
+        if (block.bOSPages)
+            pPixels = (uint32_t*)OSAlloc(nBytes, pool.bLargePages, pool.nLargePageSize, block.bLargePages);
+        else
+            pPixels = (uint32_t*)AlignedAlloc(nBytes);
+
+        if (!pPixels)
+        {
+            ZERROR("ZPixelPool::Alloc failed for ", nBytes, " bytes\n");
+            return nullptr;
+        }
+
+        pool.blocks[pPixels] = block;
+        if (block.bLargePages)
+            pool.stats.nLargePageBytes += nBytes;
+
+        pool.stats.nBytesInUse += nBytes;
+        pool.stats.nHighWaterBytes = std::max<uint64_t>(pool.stats.nHighWaterBytes, pool.stats.nBytesInUse + pool.stats.nBytesRetained);
+        return pPixels;
+    }
+
+    void Free(uint32_t* pPixels)
+    {
+        if (!pPixels)
+            return;
+
+        Pool& pool = GetPool();
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+
+        auto it = pool.blocks.find(pPixels);
+        ZASSERT(it != pool.blocks.end());
+        if (it == pool.blocks.end())
+            return;
+
+        size_t nBytes = it->second.nBytes;
+        pool.stats.nFrees++;
+        pool.stats.nBytesInUse -= nBytes;
+
+        if (pool.stats.nBytesRetained + nBytes > pool.nMaxRetainedBytes)
+        {
+            ReleaseBlock(pool, pPixels);
+            return;
+        }
+
+        pool.freeBlocks[nBytes].push_back(pPixels);
+        pool.stats.nBytesRetained += nBytes;
+    }
+
+    uint32_t* Realloc(uint32_t* pPixels, int64_t nPixels)
+    {
+        if (!pPixels)
+            return Alloc(nPixels);
+
+        if (nPixels <= 0)
+        {
+            Free(pPixels);
+            return nullptr;
+        }
+
+        size_t nOldBytes;
+        {
+            Pool& pool = GetPool();
+            const std::lock_guard<std::mutex> lock(pool.mutex);
+            auto it = pool.blocks.find(pPixels);
+            ZASSERT(it != pool.blocks.end());
+            if (it == pool.blocks.end())
+                return nullptr;
+            nOldBytes = it->second.nBytes;
+        }
+
+        size_t nNewBytes = SizeClass((size_t)nPixels * sizeof(uint32_t));
+        if (nNewBytes == nOldBytes)
+            return pPixels;
+
+        uint32_t* pNew = Alloc(nPixels);
+        if (!pNew)
+            return nullptr;         // original block is left alone, as with realloc
+
+        memcpy(pNew, pPixels, std::min<size_t>(nOldBytes, nNewBytes));
+        Free(pPixels);
+        return pNew;
+    }
+
+    size_t Trim(size_t nKeepBytes)
+    {
+        Pool& pool = GetPool();
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+
+        size_t nReleased = 0;
+        for (auto it = pool.freeBlocks.rbegin(); it != pool.freeBlocks.rend() && pool.stats.nBytesRetained > nKeepBytes; it++)
+        {
+            std::vector<uint32_t*>& blocks = it->second;
+            while (!blocks.empty() && pool.stats.nBytesRetained > nKeepBytes)
+            {
+                ReleaseBlock(pool, blocks.back());
+                blocks.pop_back();
+
+                pool.stats.nBytesRetained -= it->first;
+                nReleased += it->first;
+            }
+        }
+
+        pool.stats.nTrimmedBytes += nReleased;
+        return nReleased;
+    }
+
+    void SetMaxRetainedBytes(size_t nBytes)
+    {
+        Pool& pool = GetPool();
+        {
+            const std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.nMaxRetainedBytes = nBytes;
+        }
+        Trim(nBytes);
+    }
+
+    void EnableLargePages(bool bEnable)
+    {
+        Pool& pool = GetPool();
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+
+        pool.bLargePages = bEnable && EnableLockMemoryPrivilege();
+#ifdef _WIN64
+        pool.nLargePageSize = pool.bLargePages ? GetLargePageMinimum() : 0;
+#endif
+        if (bEnable && !pool.bLargePages)
+            ZDEBUG_OUT("ZPixelPool large pages not available\n");
+    }
+
+    Stats GetStats()
+    {
+        Pool& pool = GetPool();
+        const std::lock_guard<std::mutex> lock(pool.mutex);
+        return pool.stats;
+    }
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ZTypes.h"
+
+// Pooled allocator for ZBuffer pixel storage
+// Requests are rounded up to size classes (eight per power of two above kSmallBlockBytes) and freed blocks are kept
+// for reuse instead of going back to the heap, so loading and unloading large images doesn't churn the allocator.
+// Every block is at least 64 byte aligned. Blocks of kLargeBlockBytes or more come straight from the OS, page aligned,
+// and can optionally be backed by large pages.
+
+namespace ZPixelPool
+{
+    const size_t    kAlignment                  = 64;
+    const size_t    kSmallBlockBytes            = 64 * 1024;                    // rounded to 4k below this
+    const size_t    kLargeBlockBytes            = 2 * 1024 * 1024;              // OS page allocations at or above this
+    const size_t    kDefaultMaxRetainedBytes    = 512ULL * 1024 * 1024;         // freed blocks beyond this go back to the OS immediately
+
+    struct Stats
+    {
+        uint64_t    nAllocs;            // calls to Alloc
+        uint64_t    nPoolHits;          // allocs satisfied from a retained block
+        uint64_t    nFrees;
+        uint64_t    nBytesInUse;        // size class bytes handed out and not yet freed
+        uint64_t    nBytesRetained;     // freed bytes held for reuse
+        uint64_t    nHighWaterBytes;    // peak of in use + retained
+        uint64_t    nTrimmedBytes;      // total released by Trim
+        uint64_t    nLargePageBytes;    // in use + retained that is large page backed
+    };
+
+    uint32_t*   Alloc(int64_t nPixels);                         // nullptr on failure. Contents are undefined
+    void        Free(uint32_t* pPixels);                        // nullptr is ignored
+    uint32_t*   Realloc(uint32_t* pPixels, int64_t nPixels);    // keeps the block if it is already the right size class. Contents up to the smaller size are preserved
+
+    size_t      Trim(size_t nKeepBytes = 0);                    // releases retained blocks, largest first, until no more than nKeepBytes remain. Returns bytes released
+    void        SetMaxRetainedBytes(size_t nBytes);
+    void        EnableLargePages(bool bEnable);                 // only affects future allocations. Silently falls back to normal pages when not permitted
+
+    Stats       GetStats();
+};
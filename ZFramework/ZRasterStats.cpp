@@ -0,0 +1,220 @@
+#include "ZRasterStats.h"
+#include "ZTimer.h"
+#include "ZDebug.h"
+#include <algorithm>
+#include <fstream>
+
+#ifdef _DEBUG
+#define new new(_NORMAL_BLOCK, THIS_FILE, __LINE__)
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+
+// One per thread, on its own cache line. Only the owning thread adds, EndFrame swaps the totals out.
+struct alignas(64) ZRasterStats::ThreadCounters
+{
+    ThreadCounters()
+    {
+        for (uint32_t c = 0; c < kCounterCount; c++)
+            counts[c] = 0;
+        nMaxThreads = 0;
+        ZRasterStats::Get().Register(this);
+    }
+
+    ~ThreadCounters()
+    {
+        ZRasterStats::Get().Unregister(this);
+    }
+
+    std::atomic<int64_t>    counts[kCounterCount];
+    std::atomic<int64_t>    nMaxThreads;
+};
+
+static ZRasterStats::ThreadCounters& LocalCounters()
+{
+    static thread_local ZRasterStats::ThreadCounters counters;
+    return counters;
+}
+
+
+ZRasterStats::ZRasterStats()
+{
+    for (uint32_t c = 0; c < kCounterCount; c++)
+        mRetired[c] = 0;
+    mnRetiredMaxThreads = 0;
+    mnNextFrame = 0;
+    mnFrameCount = 0;
+    mnFrameStartUS = gTimer.GetUSSinceEpoch();
+    mLastFrame = {};
+    mFrames.reserve(kFrameHistory);
+}
+
+ZRasterStats& ZRasterStats::Get()
+{
+    // never destroyed, render pool threads unregister during static destruction
+    static ZRasterStats* pStats = new ZRasterStats();
+    return *pStats;
+}
+
+void ZRasterStats::Add(eCounter counter, int64_t nAmount)
+{
+    LocalCounters().counts[counter].fetch_add(nAmount, std::memory_order_relaxed);
+}
+
+void ZRasterStats::NoteThreads(int64_t nThreads)
+{
+    std::atomic<int64_t>& nMax = LocalCounters().nMaxThreads;
+    int64_t nCur = nMax.load(std::memory_order_relaxed);
+    while (nThreads > nCur && !nMax.compare_exchange_weak(nCur, nThreads, std::memory_order_relaxed));
+}
+
+ZRasterStats::ScopedCall::ScopedCall(int64_t nPrimitives)
+{
+    mnStartUS = gTimer.GetUSSinceEpoch();
+    Add(kCalls, 1);
+    Add(kPrimitives, nPrimitives);
+}
+
+ZRasterStats::ScopedCall::~ScopedCall()
+{
+    Add(kCallUS, gTimer.GetUSSinceEpoch() - mnStartUS);
+}
+
+void ZRasterStats::Register(ThreadCounters* pCounters)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+    mThreads.push_back(pCounters);
+}
+
+void ZRasterStats::Unregister(ThreadCounters* pCounters)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    // keep whatever the thread counted since the last frame
+    for (uint32_t c = 0; c < kCounterCount; c++)
+        mRetired[c] += pCounters->counts[c].load(std::memory_order_relaxed);
+    mnRetiredMaxThreads = std::max<int64_t>(mnRetiredMaxThreads, pCounters->nMaxThreads.load(std::memory_order_relaxed));
+
+    mThreads.erase(std::remove(mThreads.begin(), mThreads.end(), pCounters), mThreads.end());
+}
+
+void ZRasterStats::EndFrame()
+{
+    int64_t nNowUS = gTimer.GetUSSinceEpoch();
+
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    int64_t totals[kCounterCount];
+    int64_t nMaxThreads = mnRetiredMaxThreads;
+    for (uint32_t c = 0; c < kCounterCount; c++)
+    {
+        totals[c] = mRetired[c];
+        mRetired[c] = 0;
+    }
+    mnRetiredMaxThreads = 0;
+
+    for (ThreadCounters* pCounters : mThreads)
+    {
+        for (uint32_t c = 0; c < kCounterCount; c++)
+            totals[c] += pCounters->counts[c].exchange(0, std::memory_order_relaxed);
+        nMaxThreads = std::max<int64_t>(nMaxThreads, pCounters->nMaxThreads.exchange(0, std::memory_order_relaxed));
+    }
+
+    Frame frame;
+    frame.nFrame = mnFrameCount++;
+    frame.nStartUS = mnFrameStartUS;
+    frame.nDurationUS = nNowUS - mnFrameStartUS;
+    frame.nPixels = totals[kPixels];
+    frame.nTexels = totals[kTexels];
+    frame.nPrimitives = totals[kPrimitives];
+    frame.nCalls = totals[kCalls];
+    frame.nCallUS = totals[kCallUS];
+    frame.nMaxThreads = nMaxThreads;
+    mnFrameStartUS = nNowUS;
+
+    if (mFrames.size() < kFrameHistory)
+        mFrames.push_back(frame);
+    else
+        mFrames[mnNextFrame] = frame;
+    mnNextFrame = (mnNextFrame + 1) % kFrameHistory;
+
+    mLastFrame = frame;
+}
+
+void ZRasterStats::GetFrames(std::vector<Frame>& frames)
+{
+    const std::lock_guard<std::mutex> lock(mMutex);
+
+    frames.clear();
+    if (mFrames.size() < kFrameHistory)
+    {
+        frames = mFrames;
+        return;
+    }
+
+    frames.reserve(kFrameHistory);
+    frames.insert(frames.end(), mFrames.begin() + mnNextFrame, mFrames.end());
+    frames.insert(frames.end(), mFrames.begin(), mFrames.begin() + mnNextFrame);
+}
+
+bool ZRasterStats::DumpCSV(const std::string& sFilename)
+{
+    std::vector<Frame> frames;
+    GetFrames(frames);
+
+    std::ofstream outFile(sFilename, std::ios::trunc);
+    if (!outFile)
+    {
+        ZERROR("ZRasterStats::DumpCSV couldn't open:", sFilename, "\n");
+        return false;
+    }
+
+    outFile << "frame,start_us,duration_us,pixels,texels,primitives,calls,call_us,max_threads\n";
+    for (const Frame& f : frames)
+        outFile << f.nFrame << "," << f.nStartUS << "," << f.nDurationUS << "," << f.nPixels << "," << f.nTexels << "," << f.nPrimitives << "," << f.nCalls << "," << f.nCallUS << "," << f.nMaxThreads << "\n";
+
+    ZOUT("Raster stats for ", frames.size(), " frames written to ", sFilename, "\n");
+    return true;
+}
+
+void ZRasterStats::ReportToConsole()
+{
+    std::vector<Frame> frames;
+    GetFrames(frames);
+    if (frames.empty())
+    {
+        ZOUT("Raster stats: no frames yet\n");
+        return;
+    }
+
+    Frame sum = {};
+    Frame peak = {};
+    for (const Frame& f : frames)
+    {
+        sum.nDurationUS += f.nDurationUS;
+        sum.nPixels += f.nPixels;
+        sum.nTexels += f.nTexels;
+        sum.nPrimitives += f.nPrimitives;
+        sum.nCalls += f.nCalls;
+        sum.nCallUS += f.nCallUS;
+
+        peak.nDurationUS = std::max(peak.nDurationUS, f.nDurationUS);
+        peak.nPixels = std::max(peak.nPixels, f.nPixels);
+        peak.nTexels = std::max(peak.nTexels, f.nTexels);
+        peak.nPrimitives = std::max(peak.nPrimitives, f.nPrimitives);
+        peak.nCalls = std::max(peak.nCalls, f.nCalls);
+        peak.nCallUS = std::max(peak.nCallUS, f.nCallUS);
+        peak.nMaxThreads = std::max(peak.nMaxThreads, f.nMaxThreads);
+    }
+
+    int64_t n = (int64_t)frames.size();
+    ZOUT("Raster stats over ", n, " frames (avg / peak)\n");
+    ZOUT("  frame us:   ", sum.nDurationUS / n, " / ", peak.nDurationUS, "\n");
+    ZOUT("  pixels:     ", sum.nPixels / n, " / ", peak.nPixels, "\n");
+    ZOUT("  texels:     ", sum.nTexels / n, " / ", peak.nTexels, "\n");
+    ZOUT("  primitives: ", sum.nPrimitives / n, " / ", peak.nPrimitives, "\n");
+    ZOUT("  calls:      ", sum.nCalls / n, " / ", peak.nCalls, "\n");
+    ZOUT("  call us:    ", sum.nCallUS / n, " / ", peak.nCallUS, "\n");
+    ZOUT("  threads:    ", peak.nMaxThreads, " max\n");
+}
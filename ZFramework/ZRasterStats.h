@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ZTypes.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Rasterizer instrumentation
+// Work is counted per thread (window paint threads and render pool helpers alike) without locks, and folded into one
+// Frame record each time the render loop calls EndFrame(). The most recent frames are kept in a ring for display
+// (ZWinWatchPanel items on mLastFrame) and can be written out as CSV.
+
+class ZRasterStats
+{
+public:
+    enum eCounter : uint32_t
+    {
+        kPixels         = 0,        // pixels written
+        kTexels         = 1,        // texel reads, including every tap of a filter
+        kPrimitives     = 2,        // triangles, quads or blts
+        kCalls          = 3,        // top level rasterizer calls
+        kCallUS         = 4,        // time inside top level calls, summed over calling threads
+        kCounterCount   = 5
+    };
+
+    struct Frame
+    {
+        int64_t     nFrame;
+        int64_t     nStartUS;
+        int64_t     nDurationUS;
+        int64_t     nPixels;
+        int64_t     nTexels;
+        int64_t     nPrimitives;
+        int64_t     nCalls;
+        int64_t     nCallUS;
+        int64_t     nMaxThreads;    // widest fan out of any call
+    };
+
+    static const size_t kFrameHistory = 600;
+
+    static ZRasterStats& Get();
+
+    // Counting, from any thread
+    static void     Add(eCounter counter, int64_t nAmount);
+    static void     NoteThreads(int64_t nThreads);
+
+    // Times one top level call on the calling thread and counts it with its primitives
+    class ScopedCall
+    {
+    public:
+        ScopedCall(int64_t nPrimitives);
+        ~ScopedCall();
+    private:
+        int64_t     mnStartUS;
+    };
+
+    // Called once per frame by the render loop. Folds every thread's counters into a new Frame.
+    void            EndFrame();
+
+    void            GetFrames(std::vector<Frame>& frames);        // oldest first
+    bool            DumpCSV(const std::string& sFilename);
+    void            ReportToConsole();                          // averages and peaks of the recent frames
+
+    Frame           mLastFrame;         // copy of the newest frame, for watches
+
+    // per thread slots register themselves on first use
+    struct ThreadCounters;
+    void            Register(ThreadCounters* pCounters);
+    void            Unregister(ThreadCounters* pCounters);
+
+private:
+    ZRasterStats();
+
+    std::mutex                      mMutex;
+    std::vector<ThreadCounters*>    mThreads;
+    int64_t                         mRetired[kCounterCount];     // counts of threads that exited since the last frame
+    int64_t                         mnRetiredMaxThreads;
+
+    std::vector<Frame>              mFrames;
+    size_t                          mnNextFrame;
+    int64_t                         mnFrameCount;
+    int64_t                         mnFrameStartUS;
+};
@@ -1,11 +1,13 @@
 #include "ZRasterizer.h"
 #include "ZTypes.h"
-
-uint64_t	ZRasterizer::mnProcessedVertices;	// for debugging
-uint64_t	ZRasterizer::mnDrawnPixels;
-uint64_t	ZRasterizer::mnTimeStamp;
-uint64_t	ZRasterizer::mnPeakProcessedVertices;
-uint64_t	ZRasterizer::mnPeakDrawnPixels;
+#include "ZBlend.h"
+#include "ZRasterStats.h"
+#include <math.h>
+#include <algorithm>
+#include <immintrin.h>
+#include <atomic>
+#include <future>
+#include <bit>
 
 #ifdef _DEBUG
 #define new new(_NORMAL_BLOCK, THIS_FILE, __LINE__)
@@ -14,118 +16,753 @@ static char THIS_FILE[] = __FILE__;
 #endif
 
 
-bool ZRasterizer::FindScanlineIntersection(double fScanY, ZUVVertex& v1, ZUVVertex& v2, ZUVVertex& vIntersection)
+// Edge function rasterization
+//
+// Polygons are split into a fan of triangles. Each triangle's vertices are snapped to 1/256 pixel and its coverage is
+// decided by three integer edge functions sampled at pixel centers, with a top-left rule so that pixels on an edge shared
+// by two triangles are drawn exactly once. The bounding box is walked in 8x8 tiles: tiles outside any edge are rejected
+// and tiles inside all three edges are accepted without per pixel tests. Since a triangle covers one run of pixels per
+// row, the tiles of a tile row reduce to one span per row. Spans go out in 64 pixel wide blocks down the 8 rows so that
+// texture reads for rotated quads stay local. Attributes step in 16.16 fixed point.
+static const int64_t kSubPixelBits = 8;
+static const int64_t kSubPixelOne = 1LL << kSubPixelBits;
+static const int64_t kRasterTileSize = 8;
+static const int64_t kAttribFracBits = 16;
+static const int64_t kSpanBlock = 64;
+
+struct AttributePlane
 {
-	// if the segment is entirely above or below the scanline, no intersection
-	if (v1.y < fScanY && v2.y < fScanY ||
-		v1.y > fScanY && v2.y > fScanY)
-		return false;
+    int64_t nAt;        // value at the center of pixel 0,0
+    int64_t nDX;        // change per pixel step
+    int64_t nDY;
 
-	// If the line is horizontal
-	if (v1.y == v2.y)
-		return false;
+    int64_t At(int64_t x, int64_t y) const { return nAt + nDX * x + nDY * y; }
+};
 
-	vIntersection.y = fScanY;
+// Fits a 16.16 plane through an attribute at three vertices. Fails for degenerate triangles.
+static bool MakePlane(const double* pX, const double* pY, const double* pA, AttributePlane& plane)
+{
+    double fDet = (pX[1] - pX[0]) * (pY[2] - pY[0]) - (pX[2] - pX[0]) * (pY[1] - pY[0]);
+    if (fabs(fDet) < 1e-9)
+        return false;
 
-	// if the line is vertical
-	if (v1.x == v2.x)
-	{
-		vIntersection.x = v1.x;
-	}
-	else
-	{
-		double fSlope = (double)((v1.y - v2.y)/(v1.x - v2.x));       //Calculate the intersection between the current
-		vIntersection.x = (v2.x + (fScanY-v2.y)/fSlope); //line and the current scan-line.
-	}
+    double fDX = ((pA[1] - pA[0]) * (pY[2] - pY[0]) - (pA[2] - pA[0]) * (pY[1] - pY[0])) / fDet;
+    double fDY = ((pA[2] - pA[0]) * (pX[1] - pX[0]) - (pA[1] - pA[0]) * (pX[2] - pX[0])) / fDet;
+    double fAt = pA[0] + fDX * (0.5 - pX[0]) + fDY * (0.5 - pY[0]);
 
-	double fT = (vIntersection.y - v1.y)/(v2.y - v1.y);
+    const double kScale = (double)(1LL << kAttribFracBits);
+    plane.nAt = llround(fAt * kScale);
+    plane.nDX = llround(fDX * kScale);
+    plane.nDY = llround(fDY * kScale);
+    return true;
+}
 
-	vIntersection.u = v1.u + (v2.u - v1.u)*fT;
-	vIntersection.v = v1.v + (v2.v - v1.v)*fT;
+// Calls span(y, left, right) for each run of pixels covered by the triangle within rClip. Returns the pixels covered.
+template <typename SpanFunc>
+static int64_t RasterizeTriangle(const double* pX, const double* pY, const ZRect& rClip, SpanFunc&& span)
+{
+    int64_t nX[3];
+    int64_t nY[3];
+    for (int i = 0; i < 3; i++)
+    {
+        nX[i] = llround(pX[i] * kSubPixelOne);
+        nY[i] = llround(pY[i] * kSubPixelOne);
+    }
 
-	return true;
+    // Wind consistently so that the inside of every edge is positive
+    int64_t nArea = (nX[1] - nX[0]) * (nY[2] - nY[0]) - (nY[1] - nY[0]) * (nX[2] - nX[0]);
+    if (nArea == 0)
+        return 0;
+    if (nArea < 0)
+    {
+        std::swap(nX[1], nX[2]);
+        std::swap(nY[1], nY[2]);
+    }
+
+    int64_t nMinX = std::max<int64_t>(rClip.left, std::min({ nX[0], nX[1], nX[2] }) >> kSubPixelBits);
+    int64_t nMinY = std::max<int64_t>(rClip.top, std::min({ nY[0], nY[1], nY[2] }) >> kSubPixelBits);
+    int64_t nMaxX = std::min<int64_t>(rClip.right, (std::max({ nX[0], nX[1], nX[2] }) >> kSubPixelBits) + 1);
+    int64_t nMaxY = std::min<int64_t>(rClip.bottom, (std::max({ nY[0], nY[1], nY[2] }) >> kSubPixelBits) + 1);
+    if (nMinX >= nMaxX || nMinY >= nMaxY)
+        return 0;
+
+    // E(px,py) = nE[i] + nStepX[i]*px + nStepY[i]*py, evaluated at pixel centers
+    int64_t nE[3];
+    int64_t nStepX[3];
+    int64_t nStepY[3];
+    for (int i = 0; i < 3; i++)
+    {
+        int j = (i + 1) % 3;
+        int64_t nA = nY[i] - nY[j];
+        int64_t nB = nX[j] - nX[i];
+        bool bTopLeft = nA > 0 || (nA == 0 && nB > 0);
+
+        nE[i] = nA * (kSubPixelOne / 2 - nX[i]) + nB * (kSubPixelOne / 2 - nY[i]) - (bTopLeft ? 0 : 1);
+        nStepX[i] = nA * kSubPixelOne;
+        nStepY[i] = nB * kSubPixelOne;
+    }
+
+    int64_t nCovered = 0;
+    int64_t nTileLeft = nMinX - (nMinX % kRasterTileSize);
+    for (int64_t nTileTop = nMinY - (nMinY % kRasterTileSize); nTileTop < nMaxY; nTileTop += kRasterTileSize)
+    {
+        int64_t nTop = std::max(nTileTop, nMinY);
+        int64_t nBottom = std::min(nTileTop + kRasterTileSize, nMaxY);
+        int64_t nRows = nBottom - nTop;
+
+        int64_t spanLeft[kRasterTileSize];
+        int64_t spanRight[kRasterTileSize];
+        for (int64_t r = 0; r < nRows; r++)
+        {
+            spanLeft[r] = nMaxX;
+            spanRight[r] = nMinX;
+        }
+
+        for (int64_t nTileX = nTileLeft; nTileX < nMaxX; nTileX += kRasterTileSize)
+        {
+            int64_t nLeft = std::max(nTileX, nMinX);
+            int64_t nRight = std::min(nTileX + kRasterTileSize, nMaxX);
+
+            // Corner tests: the largest value of each edge over the tile decides reject, the smallest decides accept
+            bool bReject = false;
+            bool bAccept = true;
+            int64_t nCorner[3];
+            for (int i = 0; i < 3; i++)
+            {
+                nCorner[i] = nE[i] + nStepX[i] * nLeft + nStepY[i] * nTop;
+                int64_t nSpanX = nStepX[i] * (nRight - nLeft - 1);
+                int64_t nSpanY = nStepY[i] * (nRows - 1);
+                int64_t nMax = nCorner[i] + std::max<int64_t>(nSpanX, 0) + std::max<int64_t>(nSpanY, 0);
+                int64_t nMin = nCorner[i] + std::min<int64_t>(nSpanX, 0) + std::min<int64_t>(nSpanY, 0);
+                if (nMax < 0)
+                {
+                    bReject = true;
+                    break;
+                }
+                if (nMin < 0)
+                    bAccept = false;
+            }
+
+            if (bReject)
+                continue;
+
+            if (bAccept)
+            {
+                for (int64_t r = 0; r < nRows; r++)
+                {
+                    spanLeft[r] = std::min(spanLeft[r], nLeft);
+                    spanRight[r] = std::max(spanRight[r], nRight);
+                }
+                continue;
+            }
+
+            for (int64_t r = 0; r < nRows; r++)
+            {
+                int64_t e0 = nCorner[0] + nStepY[0] * r;
+                int64_t e1 = nCorner[1] + nStepY[1] * r;
+                int64_t e2 = nCorner[2] + nStepY[2] * r;
+                for (int64_t x = nLeft; x < nRight; x++)
+                {
+                    if ((e0 | e1 | e2) >= 0)
+                    {
+                        spanLeft[r] = std::min(spanLeft[r], x);
+                        spanRight[r] = std::max(spanRight[r], x + 1);
+                    }
+                    e0 += nStepX[0];
+                    e1 += nStepX[1];
+                    e2 += nStepX[2];
+                }
+            }
+        }
+
+        int64_t nBandLeft = nMaxX;
+        int64_t nBandRight = nMinX;
+        for (int64_t r = 0; r < nRows; r++)
+        {
+            if (spanLeft[r] < spanRight[r])
+            {
+                nBandLeft = std::min(nBandLeft, spanLeft[r]);
+                nBandRight = std::max(nBandRight, spanRight[r]);
+                nCovered += spanRight[r] - spanLeft[r];
+            }
+        }
+
+        for (int64_t nBlock = nBandLeft; nBlock < nBandRight; nBlock += kSpanBlock)
+        {
+            int64_t nBlockRight = nBlock + kSpanBlock;
+            for (int64_t r = 0; r < nRows; r++)
+            {
+                int64_t nLeft = std::max(spanLeft[r], nBlock);
+                int64_t nRight = std::min(spanRight[r], nBlockRight);
+                if (nLeft < nRight)
+                    span(nTop + r, nLeft, nRight);
+            }
+        }
+    }
+
+    return nCovered;
+}
+
+// Anti-aliased edges
+//
+// Coverage comes from the polygon outline: each outline edge is sampled at 16 points per pixel and a pixel's coverage is
+// the samples inside all of them, so the polygon must be convex. The fan triangles only decide which triangle shades a
+// pixel, by testing pixel centers against the fan diagonals with the top-left rule, so each touched pixel is shaded once
+// for triangles and quads. Per row, each edge solves for the pixels it fully covers and the pixels it touches at all;
+// only the pixels between those bounds are sampled and interiors are shaded once without coverage.
+static const int64_t kCoverageSamples = 16;
+static const size_t kMaxOutlineEdges = 8;
+
+// Sample offsets in 1/16 pixel from the pixel center, one per row and column (the standard 16x pattern)
+static const int8_t kCoveragePattern[kCoverageSamples][2] =
+{
+    {  1,  1 }, { -1, -3 }, { -3,  2 }, {  4, -1 }, { -5, -2 }, {  2,  5 }, {  5,  3 }, {  3, -5 },
+    { -2,  6 }, {  0, -7 }, { -4, -6 }, { -6,  4 }, { -8,  0 }, {  7, -4 }, {  6,  7 }, { -7, -8 }
+};
+
+static inline int64_t FloorDiv(int64_t nNum, int64_t nDen)     // nDen > 0
+{
+    return (nNum >= 0) ? nNum / nDen : -((nDen - 1 - nNum) / nDen);
 }
 
-bool ZRasterizer::FindScanlineIntersection(double fScanY, ZColorVertex& v1, ZColorVertex& v2, ZColorVertex& vIntersection)
+// Narrows [nLeft,nRight) to the px where nStep*px + nValue >= 0
+static inline void RestrictSpan(int64_t nStep, int64_t nValue, int64_t& nLeft, int64_t& nRight)
 {
-    // if the segment is entirely above or below the scanline, no intersection
-    if (v1.y < fScanY && v2.y < fScanY ||
-        v1.y > fScanY && v2.y > fScanY)
+    if (nStep > 0)
+        nLeft = std::max(nLeft, -FloorDiv(nValue, nStep));
+    else if (nStep < 0)
+        nRight = std::min(nRight, FloorDiv(nValue, -nStep) + 1);
+    else if (nValue < 0)
+        nRight = nLeft;
+}
+
+// Which edges of fan triangle (v0, vn-1, vn) lie on the outline of an nVerts polygon. Bit i is the edge from vertex i to i+1.
+static inline uint32_t FanOutline(size_t n, size_t nVerts)
+{
+    return (n == 2 ? 1 : 0) | 2 | (n == nVerts - 1 ? 4 : 0);
+}
+
+// Outline edge functions of a polygon, E(px,py) = nStepX*px + nStepY*py + nE at the top left corner of pixel px,py.
+// nInside/nTouch are the offsets to the smallest/largest value over the pixel square.
+struct CoverageOutline
+{
+    size_t  nEdges;
+    int64_t nMinY;
+    int64_t nMaxY;      // exclusive
+    int64_t nE[kMaxOutlineEdges];
+    int64_t nStepX[kMaxOutlineEdges];
+    int64_t nStepY[kMaxOutlineEdges];
+    int64_t nInside[kMaxOutlineEdges];
+    int64_t nTouch[kMaxOutlineEdges];
+    int64_t nSample[kMaxOutlineEdges][kCoverageSamples];
+};
+
+// Fails for polygons that are degenerate, concave or have more than kMaxOutlineEdges vertices
+template <typename Vertex>
+static bool SetupCoverageOutline(const Vertex* pVerts, size_t nVerts, CoverageOutline& outline)
+{
+    if (nVerts < 3 || nVerts > kMaxOutlineEdges)
         return false;
 
-    // If the line is horizontal
-    if (v1.y == v2.y)
+    int64_t nX[kMaxOutlineEdges];
+    int64_t nY[kMaxOutlineEdges];
+    int64_t nArea = 0;
+    for (size_t i = 0; i < nVerts; i++)
+    {
+        nX[i] = llround(pVerts[i].x * kSubPixelOne);
+        nY[i] = llround(pVerts[i].y * kSubPixelOne);
+    }
+    for (size_t i = 0; i < nVerts; i++)
+    {
+        size_t j = (i + 1) % nVerts;
+        nArea += nX[i] * nY[j] - nX[j] * nY[i];
+    }
+    if (nArea == 0)
         return false;
 
-    vIntersection.y = fScanY;
+    // Every turn has to go the same way as the winding
+    for (size_t i = 0; i < nVerts; i++)
+    {
+        size_t j = (i + 1) % nVerts;
+        size_t k = (i + 2) % nVerts;
+        int64_t nTurn = (nX[j] - nX[i]) * (nY[k] - nY[j]) - (nY[j] - nY[i]) * (nX[k] - nX[j]);
+        if ((nTurn < 0 && nArea > 0) || (nTurn > 0 && nArea < 0))
+            return false;
+    }
+
+    outline.nEdges = nVerts;
+    outline.nMinY = *std::min_element(nY, nY + nVerts) >> kSubPixelBits;
+    outline.nMaxY = (*std::max_element(nY, nY + nVerts) >> kSubPixelBits) + 1;
+    for (size_t i = 0; i < nVerts; i++)
+    {
+        size_t j = (i + 1) % nVerts;
+        int64_t nA = nY[i] - nY[j];
+        int64_t nB = nX[j] - nX[i];
+        if (nArea < 0)
+        {
+            nA = -nA;
+            nB = -nB;
+        }
+        bool bTopLeft = nA > 0 || (nA == 0 && nB > 0);
+
+        outline.nE[i] = -nA * nX[i] - nB * nY[i] - (bTopLeft ? 0 : 1);
+        outline.nStepX[i] = nA * kSubPixelOne;
+        outline.nStepY[i] = nB * kSubPixelOne;
+        outline.nInside[i] = std::min<int64_t>(outline.nStepX[i], 0) + std::min<int64_t>(outline.nStepY[i], 0);
+        outline.nTouch[i] = std::max<int64_t>(outline.nStepX[i], 0) + std::max<int64_t>(outline.nStepY[i], 0);
+        for (int64_t s = 0; s < kCoverageSamples; s++)
+            outline.nSample[i][s] = nA * (kSubPixelOne / 2 + kCoveragePattern[s][0] * kSubPixelOne / 16) + nB * (kSubPixelOne / 2 + kCoveragePattern[s][1] * kSubPixelOne / 16);
+    }
+
+    return true;
+}
+
+// Calls span(y, left, right, pCoverage) for each run of pixels of the outline's polygon within rClip that this fan
+// triangle shades. nOutline marks the triangle's edges that are on the outline (see FanOutline), the others are
+// diagonals. pCoverage is null for fully covered runs, otherwise it holds 0-256 per pixel of the run (at most kSpanBlock
+// long). Returns the pixels touched.
+template <typename SpanFunc>
+static int64_t RasterizeTriangleAA(const double* pX, const double* pY, uint32_t nOutline, const CoverageOutline& outline, const ZRect& rClip, SpanFunc&& span)
+{
+    int64_t nX[3];
+    int64_t nY[3];
+    for (int i = 0; i < 3; i++)
+    {
+        nX[i] = llround(pX[i] * kSubPixelOne);
+        nY[i] = llround(pY[i] * kSubPixelOne);
+    }
+
+    int64_t nArea = (nX[1] - nX[0]) * (nY[2] - nY[0]) - (nY[1] - nY[0]) * (nX[2] - nX[0]);
+    if (nArea == 0)
+        return 0;
+    if (nArea < 0)
+    {
+        // reversing the winding reverses the edges too: 0-1 becomes edge 2 and 2-0 becomes edge 0
+        std::swap(nX[1], nX[2]);
+        std::swap(nY[1], nY[2]);
+        nOutline = ((nOutline & 1) << 2) | (nOutline & 2) | ((nOutline & 4) >> 2);
+    }
+
+    // Diagonals test pixel centers, as in RasterizeTriangle
+    int64_t nDiagonals = 0;
+    int64_t nDiagE[3];
+    int64_t nDiagStepX[3];
+    int64_t nDiagStepY[3];
+    for (int i = 0; i < 3; i++)
+    {
+        if (nOutline & (1 << i))
+            continue;
+
+        int j = (i + 1) % 3;
+        int64_t nA = nY[i] - nY[j];
+        int64_t nB = nX[j] - nX[i];
+        bool bTopLeft = nA > 0 || (nA == 0 && nB > 0);
+
+        nDiagE[nDiagonals] = nA * (kSubPixelOne / 2 - nX[i]) + nB * (kSubPixelOne / 2 - nY[i]) - (bTopLeft ? 0 : 1);
+        nDiagStepX[nDiagonals] = nA * kSubPixelOne;
+        nDiagStepY[nDiagonals] = nB * kSubPixelOne;
+        nDiagonals++;
+    }
+
+    int64_t nMinY = std::max<int64_t>(rClip.top, outline.nMinY);
+    int64_t nMaxY = std::min<int64_t>(rClip.bottom, outline.nMaxY);
+    if (rClip.left >= rClip.right || nMinY >= nMaxY)
+        return 0;
+
+    int64_t nCovered = 0;
+    int64_t nRow[kMaxOutlineEdges];
+    uint16_t coverage[kSpanBlock];
+    for (int64_t y = nMinY; y < nMaxY; y++)
+    {
+        int64_t nTouchLeft = rClip.left;
+        int64_t nTouchRight = rClip.right;
+        for (int64_t d = 0; d < nDiagonals; d++)
+            RestrictSpan(nDiagStepX[d], nDiagStepY[d] * y + nDiagE[d], nTouchLeft, nTouchRight);
+
+        int64_t nFullLeft = nTouchLeft;
+        int64_t nFullRight = nTouchRight;
+        for (size_t i = 0; i < outline.nEdges; i++)
+        {
+            nRow[i] = outline.nStepY[i] * y + outline.nE[i];
+            RestrictSpan(outline.nStepX[i], nRow[i] + outline.nInside[i], nFullLeft, nFullRight);
+            RestrictSpan(outline.nStepX[i], nRow[i] + outline.nTouch[i], nTouchLeft, nTouchRight);
+        }
+        if (nTouchLeft >= nTouchRight)
+            continue;
+
+        if (nFullLeft >= nFullRight)
+        {
+            nFullLeft = nTouchRight;
+            nFullRight = nTouchRight;
+        }
+
+        // partially covered pixels on either side of the interior
+        auto sampleRun = [&](int64_t nLeft, int64_t nRight)
+        {
+            for (int64_t nBlock = nLeft; nBlock < nRight; nBlock += kSpanBlock)
+            {
+                int64_t nCount = std::min<int64_t>(kSpanBlock, nRight - nBlock);
+                for (int64_t p = 0; p < nCount; p++)
+                {
+                    uint32_t nMask = 0xffff;
+                    for (size_t i = 0; i < outline.nEdges; i++)
+                    {
+                        int64_t e = outline.nStepX[i] * (nBlock + p) + nRow[i];
+                        if (e + outline.nInside[i] >= 0)
+                            continue;
+
+                        uint32_t nEdgeMask = 0;
+                        for (int64_t s = 0; s < kCoverageSamples; s++)
+                            nEdgeMask |= (uint32_t)(e + outline.nSample[i][s] >= 0) << s;
+                        nMask &= nEdgeMask;
+                    }
+                    coverage[p] = (uint16_t)(std::popcount(nMask) * (kSubPixelOne / kCoverageSamples));
+                    nCovered += (nMask != 0);
+                }
+                span(y, nBlock, nBlock + nCount, coverage);
+            }
+        };
+
+        sampleRun(nTouchLeft, nFullLeft);
+        if (nFullLeft < nFullRight)
+        {
+            span(y, nFullLeft, nFullRight, (const uint16_t*)nullptr);
+            nCovered += nFullRight - nFullLeft;
+        }
+        sampleRun(nFullRight, nTouchRight);
+    }
+
+    return nCovered;
+}
+
+// Fixed point texel lookup for the textured span functions
+struct TexelWalker
+{
+    const uint32_t* pPixels;
+    int64_t         nStride;
+    int64_t         nMaxX;
+    int64_t         nMaxY;
+    AttributePlane  u;          // texel coordinates, not 0-1
+    AttributePlane  v;
+
+    void Gather(int64_t x, int64_t y, int64_t nCount, uint32_t* pOut) const
+    {
+        int64_t nU = u.At(x, y);
+        int64_t nV = v.At(x, y);
+
+        // Both coordinates are linear along the span, so if the ends are inside the texture everything between is
+        int64_t nEndU = nU + u.nDX * (nCount - 1);
+        int64_t nEndV = nV + v.nDX * (nCount - 1);
+        if (std::min(nU, nEndU) >= 0 && std::max(nU, nEndU) >> kAttribFracBits <= nMaxX &&
+            std::min(nV, nEndV) >= 0 && std::max(nV, nEndV) >> kAttribFracBits <= nMaxY)
+        {
+            for (int64_t i = 0; i < nCount; i++)
+            {
+                pOut[i] = pPixels[(nV >> kAttribFracBits) * nStride + (nU >> kAttribFracBits)];
+                nU += u.nDX;
+                nV += v.nDX;
+            }
+            return;
+        }
+
+        for (int64_t i = 0; i < nCount; i++)
+        {
+            int64_t nTX = std::clamp<int64_t>(nU >> kAttribFracBits, 0, nMaxX);
+            int64_t nTY = std::clamp<int64_t>(nV >> kAttribFracBits, 0, nMaxY);
+            pOut[i] = pPixels[nTY * nStride + nTX];
+            nU += u.nDX;
+            nV += v.nDX;
+        }
+    }
+};
+
+// Sets up the walker for one triangle with UVs mapped to texel coordinates of pTexture. Fails for degenerate triangles.
+static bool SetupTexturedTriangle(ZBuffer* pTexture, const ZUVVertex& v0, const ZUVVertex& v1, const ZUVVertex& v2, TexelWalker& walker, double* pX, double* pY)
+{
+    walker.pPixels = pTexture->GetPixels();
+    walker.nStride = pTexture->GetArea().Width();
+    walker.nMaxX = pTexture->GetArea().Width() - 1;
+    walker.nMaxY = pTexture->GetArea().Height() - 1;
+    double fTextureW = (double)pTexture->GetArea().Width();
+    double fTextureH = (double)pTexture->GetArea().Height();
+
+    const ZUVVertex* pV[3] = { &v0, &v1, &v2 };
+    double u[3], v[3];
+    for (int i = 0; i < 3; i++)
+    {
+        pX[i] = pV[i]->x;
+        pY[i] = pV[i]->y;
+        u[i] = pV[i]->u * fTextureW;
+        v[i] = pV[i]->v * fTextureH;
+    }
+
+    return MakePlane(pX, pY, u, walker.u) && MakePlane(pX, pY, v, walker.v);
+}
+
+// Calls func(walker, triangle x, triangle y, outline edges) for each triangle of the fan
+template <typename TriangleFunc>
+static void ForEachTexturedTriangle(ZBuffer* pTexture, tUVVertexArray& vertexArray, TriangleFunc&& func)
+{
+    for (size_t n = 2; n < vertexArray.size(); n++)
+    {
+        TexelWalker walker;
+        double x[3], y[3];
+        if (SetupTexturedTriangle(pTexture, vertexArray[0], vertexArray[n - 1], vertexArray[n], walker, x, y))
+            func(walker, x, y, FanOutline(n, vertexArray.size()));
+    }
+}
+
+// Span writers
+//
+// Blend type, alpha source and whether clear texels need skipping are template parameters, so that each primitive picks
+// its loops once (callers know the blend, SelectCoverageSpan picks the rest) and the per pixel loops only branch on pixel
+// data. pDst is the first dest pixel of the span at nX,nY.
+enum eSpanBlend : uint32_t
+{
+    kSpanCopy           = 0,        // replaces color and keeps dest alpha (Rasterize)
+    kSpanConstAlpha     = 1         // COL::AlphaBlend_Col2Alpha at nAlpha for texels with any alpha (RasterizeWithAlpha)
+};
 
-    // if the line is vertical
-    if (v1.x == v2.x)
+// Writes nCount samples, at most kSpanBlock
+template <eSpanBlend blend>
+static inline void WriteSpan(uint32_t* pDst, const uint32_t* pSamples, int64_t nCount, uint32_t nAlpha)
+{
+    if constexpr (blend == kSpanCopy)
     {
-        vIntersection.x = v1.x;
+        for (int64_t i = 0; i < nCount; i++)
+            pDst[i] = (pDst[i] & 0xff000000) | (pSamples[i] & 0x00ffffff);
     }
     else
     {
-        double fSlope = (double)((v1.y - v2.y) / (v1.x - v2.x));       //Calculate the intersection between the current
-        vIntersection.x = (v2.x + (fScanY - v2.y) / fSlope); //line and the current scan-line.
+        // same kernel as constant alpha blts
+        ZBlend::Get().constAlpha[ZBlend::kDest](pDst, pSamples, nCount, nAlpha);
     }
+}
 
-    double fT = (vIntersection.y - v1.y) / (v2.y - v1.y);
+template <eSpanBlend blend>
+static void TexelSpan(const TexelWalker& walker, uint32_t* pDst, int64_t nX, int64_t nY, int64_t nCount, uint32_t nAlpha)
+{
+    uint32_t texels[kSpanBlock];
+    for (int64_t nDone = 0; nDone < nCount; nDone += kSpanBlock)
+    {
+        int64_t nChunk = std::min<int64_t>(kSpanBlock, nCount - nDone);
+        walker.Gather(nX + nDone, nY, nChunk, texels);
+        WriteSpan<blend>(pDst + nDone, texels, nChunk, nAlpha);
+    }
+}
 
-    double fA1 = (double)ARGB_A(v1.mColor);
-    double fR1 = (double)ARGB_R(v1.mColor);
-    double fG1 = (double)ARGB_G(v1.mColor);
-    double fB1 = (double)ARGB_B(v1.mColor);
+typedef void (*tTexelSpanFunc)(const TexelWalker& walker, uint32_t* pDst, int64_t nX, int64_t nY, int64_t nCount, uint32_t nAlpha);
 
-    double fA2 = (double)ARGB_A(v2.mColor);
-    double fR2 = (double)ARGB_R(v2.mColor);
-    double fG2 = (double)ARGB_G(v2.mColor);
-    double fB2 = (double)ARGB_B(v2.mColor);
+// Partially covered pixels from RasterizeTriangleAA, where the alpha comes per pixel from coverage (0-256) scaled by
+// nAlpha. Copies ignore texel alpha and treat full coverage like kSpanCopy. Blends skip clear texels only when the texture
+// has any (bSrcAlpha). nCount is at most kSpanBlock.
+template <eSpanBlend blend, bool bSrcAlpha>
+static void CoverageSpan(const TexelWalker& walker, uint32_t* pDst, int64_t nX, int64_t nY, int64_t nCount, const uint16_t* pCoverage, uint32_t nAlpha)
+{
+    uint32_t texels[kSpanBlock];
+    walker.Gather(nX, nY, nCount, texels);
+    for (int64_t i = 0; i < nCount; i++)
+    {
+        uint32_t nCoverage = pCoverage[i];
+        if (nCoverage == 0)
+            continue;
 
-    double fA = fA1 + (fA2 - fA1) * fT;
-    double fR = fR1 + (fR2 - fR1) * fT;
-    double fG = fG1 + (fG2 - fG1) * fT;
-    double fB = fB1 + (fB2 - fB1) * fT;
+        if constexpr (blend == kSpanCopy)
+        {
+            if (nCoverage == kSubPixelOne)
+                pDst[i] = (pDst[i] & 0xff000000) | (texels[i] & 0x00ffffff);
+            else
+                pDst[i] = COL::AlphaBlend_Col2Alpha(texels[i], pDst[i], (255 * nCoverage) >> kSubPixelBits);
+        }
+        else
+        {
+            if constexpr (bSrcAlpha)
+            {
+                if (ARGB_A(texels[i]) == 0)
+                    continue;
+            }
+            pDst[i] = COL::AlphaBlend_Col2Alpha(texels[i], pDst[i], (nAlpha * nCoverage) >> kSubPixelBits);
+        }
+    }
+}
 
-    vIntersection.mColor = ARGB((uint32_t)fA, (uint32_t)fR, (uint32_t)fG, (uint32_t)fB);
+typedef void (*tCoverageSpanFunc)(const TexelWalker& walker, uint32_t* pDst, int64_t nX, int64_t nY, int64_t nCount, const uint16_t* pCoverage, uint32_t nAlpha);
 
-    return true;
+static tCoverageSpanFunc SelectCoverageSpan(eSpanBlend blend, const ZBuffer* pTexture)
+{
+    if (blend == kSpanCopy)
+        return &CoverageSpan<kSpanCopy, false>;
+    if (pTexture->mbHasAlphaPixels)
+        return &CoverageSpan<kSpanConstAlpha, true>;
+    return &CoverageSpan<kSpanConstAlpha, false>;
 }
 
 
-inline void ZRasterizer::SetupRasterization(ZBuffer* pDestination, tColorVertexArray& vertexArray, ZRect& rDest, ZRect* pClip, double& fClipLeft, double& fClipRight, int64_t& nTopScanline, int64_t& nBottomScanline)
+// Axis aligned scaled blt
+//
+// A quad whose edges are parallel to the axes, with u changing only along x and v only along y, is a scaled copy of a
+// texel rectangle. Coverage uses the same snapped edges and top-left rule as RasterizeTriangle, so the same pixels are
+// drawn, but texel addresses come from per column and per row tables built once per call instead of plane steps.
+// Rows go out in bands from a shared counter like MultiSampleRasterizeWithAlpha.
+
+// Texel taps along one axis for each output pixel
+struct ScaleAxis
 {
-    ZASSERT(pDestination);
+    std::vector<int32_t>    first;      // nearest texel, or the left/top texel of the bilinear pair, or the first area texel
+    std::vector<int32_t>    frac;       // bilinear weight of first+1, 0-256
+    std::vector<int32_t>    count;      // area texels and where their weights start
+    std::vector<int32_t>    offset;
+    std::vector<float>      weights;
+};
+
+// Output pixels nFirst..nFirst+nCount-1 along an axis where dest coordinate fDstLo maps to texel coordinate fSrcLo and
+// each pixel steps fStep texels
+static void BuildScaleAxis(ZRasterizer::eScaleFilter filter, double fDstLo, double fSrcLo, double fStep, int64_t nFirst, int64_t nCount, int64_t nTexels, ScaleAxis& axis)
+{
+    axis.first.resize(nCount);
 
-    if (pClip)
-        rDest.Intersect(pClip);
+    if (filter == ZRasterizer::kScaleArea)
+    {
+        axis.count.resize(nCount);
+        axis.offset.resize(nCount);
+        axis.weights.clear();
+        axis.weights.reserve(nCount * ((int64_t)ceil(fabs(fStep)) + 1));
+
+        for (int64_t i = 0; i < nCount; i++)
+        {
+            double fEdge0 = fSrcLo + fStep * ((double)(nFirst + i) - fDstLo);
+            double fEdge1 = fEdge0 + fStep;
+            double fLo = std::clamp(std::min(fEdge0, fEdge1), 0.0, (double)nTexels);
+            double fHi = std::clamp(std::max(fEdge0, fEdge1), 0.0, (double)nTexels);
+
+            axis.offset[i] = (int32_t)axis.weights.size();
+            if (fHi - fLo < 1e-9)
+            {
+                // pixel lies past the texture edge, repeat the edge texel
+                axis.first[i] = (int32_t)std::clamp<int64_t>((int64_t)floor(fLo), 0, nTexels - 1);
+                axis.count[i] = 1;
+                axis.weights.push_back(1.0f);
+                continue;
+            }
 
-    // Find the first and last scanline
-    nTopScanline = rDest.bottom;			// start with top scan line at the bottom of our draw area
-    nBottomScanline = rDest.top;			// start with bottom scan line at the top
-    int64_t nNumVertices = vertexArray.size();
+            int64_t nLo = std::min<int64_t>((int64_t)floor(fLo), nTexels - 1);
+            int64_t nHi = std::max<int64_t>((int64_t)ceil(fHi), nLo + 1);
+            axis.first[i] = (int32_t)nLo;
+            axis.count[i] = (int32_t)(nHi - nLo);
+            for (int64_t k = nLo; k < nHi; k++)
+                axis.weights.push_back((float)((std::min(fHi, (double)(k + 1)) - std::max(fLo, (double)k)) / (fHi - fLo)));
+        }
+        return;
+    }
 
-    for (int nVertexIndex = 0; nVertexIndex < nNumVertices; nVertexIndex++)
+    // 16.16 texel coordinate at pixel centers, set up as MakePlane does so that nearest picks the polygon path's texels
+    const double kScale = (double)(1LL << kAttribFracBits);
+    int64_t nAt = llround((fSrcLo + fStep * (0.5 - fDstLo)) * kScale);
+    int64_t nStep = llround(fStep * kScale);
+
+    if (filter == ZRasterizer::kScaleNearest)
     {
-        ZColorVertex& vertex = vertexArray[nVertexIndex];
+        for (int64_t i = 0; i < nCount; i++)
+            axis.first[i] = (int32_t)std::clamp<int64_t>((nAt + nStep * (nFirst + i)) >> kAttribFracBits, 0, nTexels - 1);
+        return;
+    }
 
-        int64_t nY = (int64_t)(vertex.y + 0.5);
-        if (nY <= nTopScanline)
-            nTopScanline = nY;
-        if (nY > nBottomScanline)
-            nBottomScanline = nY;
+    // Bilinear, texel centers on integers. Past either edge the pair is pinned so that all weight is on the edge texel.
+    axis.frac.resize(nCount);
+    nAt -= 1LL << (kAttribFracBits - 1);
+    for (int64_t i = 0; i < nCount; i++)
+    {
+        int64_t nPos = nAt + nStep * (nFirst + i);
+        int64_t nTexel = nPos >> kAttribFracBits;
+        if (nPos < 0)
+        {
+            axis.first[i] = 0;
+            axis.frac[i] = 0;
+        }
+        else if (nTexel >= nTexels - 1)
+        {
+            axis.first[i] = (int32_t)(nTexels - 2);
+            axis.frac[i] = 256;
+        }
+        else
+        {
+            axis.first[i] = (int32_t)nTexel;
+            axis.frac[i] = (int32_t)(nPos >> (kAttribFracBits - 8)) & 0xff;
+        }
     }
+}
+
+// Recognizes a four vertex quad that ScaledBlt can draw, filling pDest/pSrc with left < right and top < bottom
+static bool FindAxisAlignedMapping(ZBuffer* pTexture, const tUVVertexArray& vertexArray, double* pDest, double* pSrc)
+{
+    if (vertexArray.size() != 4)
+        return false;
 
-    if (nTopScanline < rDest.top)
-        nTopScanline = rDest.top;
-    if (nBottomScanline > rDest.bottom)
-        nBottomScanline = rDest.bottom;
+    // Either v0-v1 is horizontal (v1-v2 vertical) or the other way around
+    const ZUVVertex* pV = vertexArray.data();
+    int nH = (pV[0].y == pV[1].y) ? 0 : 1;     // first vertex of a horizontal edge
+    const ZUVVertex& h0 = pV[nH];
+    const ZUVVertex& h1 = pV[nH + 1];
+    const ZUVVertex& h2 = pV[nH + 2];
+    const ZUVVertex& h3 = pV[(nH + 3) % 4];
 
-    fClipLeft = (double)rDest.left;
-    fClipRight = (double)rDest.right;
+    if (h0.y != h1.y || h1.x != h2.x || h2.y != h3.y || h3.x != h0.x)
+        return false;
+    if (h0.v != h1.v || h2.v != h3.v || h1.u != h2.u || h3.u != h0.u)
+        return false;
+    if (h0.x == h1.x || h1.y == h2.y)
+        return false;
+
+    double fW = (double)pTexture->GetArea().Width();
+    double fH = (double)pTexture->GetArea().Height();
+    bool bSwapX = h0.x > h1.x;
+    bool bSwapY = h1.y > h2.y;
+
+    pDest[0] = bSwapX ? h1.x : h0.x;
+    pDest[2] = bSwapX ? h0.x : h1.x;
+    pSrc[0] = (bSwapX ? h1.u : h0.u) * fW;
+    pSrc[2] = (bSwapX ? h0.u : h1.u) * fW;
+
+    pDest[1] = bSwapY ? h2.y : h1.y;
+    pDest[3] = bSwapY ? h1.y : h2.y;
+    pSrc[1] = (bSwapY ? h2.v : h1.v) * fH;
+    pSrc[3] = (bSwapY ? h1.v : h2.v) * fH;
+    return true;
 }
 
 
+bool ZRasterizer::FindScanlineIntersection(double fScanY, ZUVVertex& v1, ZUVVertex& v2, ZUVVertex& vIntersection)
+{
+	// if the segment is entirely above or below the scanline, no intersection
+	if (v1.y < fScanY && v2.y < fScanY ||
+		v1.y > fScanY && v2.y > fScanY)
+		return false;
+
+	// If the line is horizontal
+	if (v1.y == v2.y)
+		return false;
+
+	vIntersection.y = fScanY;
+
+	// if the line is vertical
+	if (v1.x == v2.x)
+	{
+		vIntersection.x = v1.x;
+	}
+	else
+	{
+		double fSlope = (double)((v1.y - v2.y)/(v1.x - v2.x));       //Calculate the intersection between the current
+		vIntersection.x = (v2.x + (fScanY-v2.y)/fSlope); //line and the current scan-line.
+	}
+
+	double fT = (vIntersection.y - v1.y)/(v2.y - v1.y);
+
+	vIntersection.u = v1.u + (v2.u - v1.u)*fT;
+	vIntersection.v = v1.v + (v2.v - v1.v)*fT;
+
+	return true;
+}
+
 inline void ZRasterizer::SetupRasterization(ZBuffer* pDestination, tUVVertexArray& vertexArray, ZRect& rDest, ZRect* pClip, double& fClipLeft, double& fClipRight, int64_t& nTopScanline, int64_t& nBottomScanline)
 {
 	ZASSERT(pDestination);
@@ -239,188 +876,57 @@ inline void ZRasterizer::SetupScanline(double fScanLine, double& fClipLeft, doub
 }
 
 
-inline void ZRasterizer::SetupScanline(double fScanLine, double& fClipLeft, double& fClipRight, ZColorVertex& scanLineMin, ZColorVertex& scanLineMax, tColorVertexArray& vertexArray, double& fScanLineLength, double& fA, double& fR, double& fG, double& fB, double& fDA, double& fDR, double& fDG, double& fDB)
+bool ZRasterizer::RasterizeWithAlpha(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip, uint8_t nAlpha, eEdgeMode edges)
 {
-    // Calculate min and max intersection on the scanline.
-    scanLineMin.x = fClipRight;
-    scanLineMin.y = fScanLine;
-
-    scanLineMax.x = fClipLeft;
-    scanLineMax.y = fScanLine;
-
-    double fA1 = (double)ARGB_A(scanLineMin.mColor);
-    double fR1 = (double)ARGB_R(scanLineMin.mColor);
-    double fG1 = (double)ARGB_G(scanLineMin.mColor);
-    double fB1 = (double)ARGB_B(scanLineMin.mColor);
-
-    double fA2 = (double)ARGB_A(scanLineMax.mColor);
-    double fR2 = (double)ARGB_R(scanLineMax.mColor);
-    double fG2 = (double)ARGB_G(scanLineMax.mColor);
-    double fB2 = (double)ARGB_B(scanLineMax.mColor);
+    if (nAlpha < 8)
+        return true;
 
+    ZRasterStats::ScopedCall call(vertexArray.size() - 2);
+    pDestination->MarkDirty();
 
+	ZRect rDest = pDestination->GetArea();
+	if (pClip)
+		rDest.Intersect(pClip);
+	int64_t nDestStride = pDestination->GetArea().Width();
+	uint32_t* pDestPixels = pDestination->GetPixels();
+    ZASSERT(pDestPixels != nullptr);
 
+    double fBltDest[4];
+    double fBltSrc[4];
+    if (edges == kEdgeAliased && mbAxisAlignedBlt && FindAxisAlignedMapping(pTexture, vertexArray, fBltDest, fBltSrc))
+        return ScaledBlt(pDestination, pTexture, fBltDest, fBltSrc, rDest, true, nAlpha, kScaleNearest);
 
-    int64_t nNumVertices = vertexArray.size();
+    // concave outlines fall back to aliased edges
+    CoverageOutline outline;
+    bool bAntiAlias = edges == kEdgeAntiAlias && SetupCoverageOutline(vertexArray.data(), vertexArray.size(), outline);
+    tCoverageSpanFunc coverageSpan = SelectCoverageSpan(kSpanConstAlpha, pTexture);
 
-    // For each line segment
-    for (int nVertexIndex = 0; nVertexIndex < nNumVertices; nVertexIndex++)
+    int64_t nDrawn = 0;
+    ForEachTexturedTriangle(pTexture, vertexArray, [&](const TexelWalker& walker, const double* x, const double* y, uint32_t nOutline)
     {
-        ZColorVertex& v1 = vertexArray[nVertexIndex];
-        ZColorVertex v2;
-        if (nVertexIndex < nNumVertices - 1)
-            v2 = vertexArray[nVertexIndex + 1];
-        else
-            v2 = vertexArray[0];
-
-        ZColorVertex vIntersection;
-        if (FindScanlineIntersection(fScanLine, v1, v2, vIntersection))
-        {
-            // If the linesegment intersects the scanline && it's < curMin set the curMin vertex to the intersection
-            // calculate how far along the linesegment the intersection, and lerp the texture coords along that linesegment
-            if (vIntersection.x < scanLineMin.x)
-                scanLineMin = vIntersection;
-            // if the linesegment intersects the scanline && it's > curMax set the curMax vertex to the intersection
-            // calculate how far along the linesegment the intersection and lerp the texture coords along that line segment
-            if (vIntersection.x > scanLineMax.x)
-                scanLineMax = vIntersection;
-        }
-        else if (v1.y == v2.y && (int64_t)v1.y == (int64_t)fScanLine)
+        if (bAntiAlias)
         {
-            if (v1.x < v2.x)
+            nDrawn += RasterizeTriangleAA(x, y, nOutline, outline, rDest, [&](int64_t nY, int64_t nLeft, int64_t nRight, const uint16_t* pCoverage)
             {
-                scanLineMin = v1;
-                scanLineMax = v2;
-            }
-            else
-            {
-                scanLineMin = v2;
-                scanLineMax = v1;
-            }
+                uint32_t* pDst = pDestPixels + nY * nDestStride + nLeft;
+                if (pCoverage)
+                    coverageSpan(walker, pDst, nLeft, nY, nRight - nLeft, pCoverage, nAlpha);
+                else
+                    TexelSpan<kSpanConstAlpha>(walker, pDst, nLeft, nY, nRight - nLeft, nAlpha);
+            });
+            return;
         }
-    }
-
-    // Clip left?
-    if (scanLineMin.x < fClipLeft)
-    {
-        double fAmountToClip = fClipLeft - scanLineMin.x;
-        double fT = (scanLineMax.x - scanLineMin.x) / fAmountToClip;
 
-        scanLineMin.x = fClipLeft;
-//        scanLineMin.u = scanLineMin.u + (scanLineMax.u - scanLineMin.u) / fT;
-//        scanLineMin.v = scanLineMin.v + (scanLineMax.v - scanLineMin.v) / fT;
+        nDrawn += RasterizeTriangle(x, y, rDest, [&](int64_t nY, int64_t nLeft, int64_t nRight)
+        {
+            TexelSpan<kSpanConstAlpha>(walker, pDestPixels + nY * nDestStride + nLeft, nLeft, nY, nRight - nLeft, nAlpha);
+        });
+    });
 
-        double fA = fA1 + (fA2 - fA1) / fT;
-        double fR = fR1 + (fR2 - fR1) / fT;
-        double fG = fG1 + (fG2 - fG1) / fT;
-        double fB = fB1 + (fB2 - fB1) / fT;
-
-        scanLineMin.mColor = ARGB((uint32_t)fA, (uint32_t)fR, (uint32_t)fG, (uint32_t)fB);
-    }
-
-    // Clip right?
-    if (scanLineMax.x > fClipRight)
-    {
-        double fAmountToClip = scanLineMax.x - fClipRight;
-        double fT = (scanLineMax.x - scanLineMin.x) / fAmountToClip;
-
-        scanLineMax.x = fClipRight;
-//        scanLineMax.u = scanLineMax.u - (scanLineMax.u - scanLineMin.u) / fT;
-//        scanLineMax.v = scanLineMax.v - (scanLineMax.v - scanLineMin.v) / fT;
-
-        double fA = fA2 - (fA2 - fA1) / fT;
-        double fR = fR2 - (fR2 - fR1) / fT;
-        double fG = fG2 - (fG2 - fG1) / fT;
-        double fB = fB2 - (fB2 - fB1) / fT;
-
-        scanLineMax.mColor = ARGB((uint32_t)fA, (uint32_t)fR, (uint32_t)fG, (uint32_t)fB);
-
-    }
-
-
-    // Calculate the color walker based on lerp from curMin to curMax
-    fScanLineLength = ((double)scanLineMax.x - (double)scanLineMin.x);
-
-    //    fTextureU = scanLineMin.u;
-    //    fTextureV = scanLineMin.v;
-    fA = (double)ARGB_A(scanLineMin.mColor);
-    fR = (double)ARGB_R(scanLineMin.mColor);
-    fG = (double)ARGB_G(scanLineMin.mColor);
-    fB = (double)ARGB_B(scanLineMin.mColor);
-
-    //fTextureDX = (scanLineMax.u - scanLineMin.u) / fScanLineLength;
-    //fTextureDV = (scanLineMax.v - scanLineMin.v) / fScanLineLength;
-    fDA = ((double)ARGB_A(scanLineMax.mColor) - (double)ARGB_A(scanLineMin.mColor)) / fScanLineLength;
-    fDR = ((double)ARGB_R(scanLineMax.mColor) - (double)ARGB_R(scanLineMin.mColor)) / fScanLineLength;
-    fDG = ((double)ARGB_G(scanLineMax.mColor) - (double)ARGB_G(scanLineMin.mColor)) / fScanLineLength;
-    fDB = ((double)ARGB_B(scanLineMax.mColor) - (double)ARGB_B(scanLineMin.mColor)) / fScanLineLength;
-}
-
-
-bool ZRasterizer::RasterizeWithAlpha(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip, uint8_t nAlpha)
-{
-    if (nAlpha < 8)
-        return true;
-
-	ZRect rDest = pDestination->GetArea();
-	int64_t nDestStride = pDestination->GetArea().Width();
-	double fTextureW = (double) pTexture->GetArea().Width() - 0.5;
-	double fTextureH = (double) pTexture->GetArea().Height() - 0.5;
-	uint32_t* pSourcePixels = pTexture->GetPixels();
-	int64_t nTextureStride = pTexture->GetArea().Width();
-	double fClipLeft;
-	double fClipRight;
-	int64_t nTopScanLine;
-	int64_t nBottomScanLine;
-
-    ZASSERT(pDestination->GetPixels() != nullptr);
-	SetupRasterization(pDestination, vertexArray, rDest, pClip, fClipLeft, fClipRight, nTopScanLine, nBottomScanLine);
-
-	// For each scanline
-	for (int64_t nScanLine = nTopScanLine; nScanLine < nBottomScanLine; nScanLine++)
-	{
-		ZUVVertex scanLineMin;
-		ZUVVertex scanLineMax;
-
-		double fScanLineLength;
-
-		double fTextureU;
-		double fTextureV;
-		double fTextureDX;
-		double fTextureDV;
-
-		SetupScanline((double) nScanLine, fClipLeft, fClipRight, scanLineMin, scanLineMax, vertexArray, fScanLineLength, fTextureU, fTextureV, fTextureDX, fTextureDV);
-
-		// Rasterize the scanline using textureWalker as the source color
-		int64_t nStartX = (int64_t) scanLineMin.x;
-		int64_t nScanLinePixels = (int64_t) scanLineMax.x - (int64_t) scanLineMin.x;
-		uint32_t* pDestPixels = pDestination->GetPixels() + nScanLine*nDestStride + nStartX;
-
-
-//		int64_t nRand = pDestination->GetArea().Width() * pDestination->GetArea().Height();
-
-		ZASSERT(nStartX + nScanLinePixels <= rDest.right);
-
-        ZASSERT(pDestination->GetPixels() != nullptr);
-
-		for (int64_t nCount = 0; nCount < nScanLinePixels; nCount++)
-		{
-            int64_t nTextureX = (int64_t) (fTextureU * fTextureW);
-			int64_t nTextureY = (int64_t) (fTextureV * fTextureH);
-			uint32_t nSourceCol = *(pSourcePixels + nTextureY*nTextureStride + nTextureX);
-			if (ARGB_A(nSourceCol) > 0)
-				*pDestPixels = COL::AlphaBlend_Col2Alpha(nSourceCol, *pDestPixels, nAlpha);
-			pDestPixels++;
-			fTextureU += fTextureDX;
-			fTextureV += fTextureDV;
-		}
-
-		mnDrawnPixels += nScanLinePixels;
-	}
-
-	mnProcessedVertices += vertexArray.size();
-	return true;
-}
+    ZRasterStats::Add(ZRasterStats::kPixels, nDrawn);
+    ZRasterStats::Add(ZRasterStats::kTexels, nDrawn);
+	return true;
+}
 
 
 
@@ -556,9 +1062,194 @@ uint32_t ZRasterizer::SampleTexture_ZoomedOut(ZBuffer* pTexture, double fTexture
     return nFinalCol;
 }
 
-bool ZRasterizer::MultiSampleRasterizeRange(ZBuffer* pTexture, ZBuffer* pDestination, int64_t nTop, int64_t nBottom, double fClipLeft, double fClipRight, tUVVertexArray& vertexArray, bool isZoomedIn, uint32_t nSubsamples, uint8_t nAlpha)
+// Per channel lerp of two colors, nWeight 0-256 toward nCol2.  Two channels at a time in the 0x00ff00ff lanes
+static inline uint32_t LerpARGB(uint32_t nCol1, uint32_t nCol2, uint32_t nWeight)
 {
-    // For each scanline
+    uint32_t nInv = 256 - nWeight;
+    uint32_t rb = (((nCol1 & 0x00ff00ff) * nInv + (nCol2 & 0x00ff00ff) * nWeight) >> 8) & 0x00ff00ff;
+    uint32_t ag = (((nCol1 >> 8) & 0x00ff00ff) * nInv + ((nCol2 >> 8) & 0x00ff00ff) * nWeight) & 0xff00ff00;
+    return ag | rb;
+}
+
+// Bilinear sample with texel centers at half integers, clamped at the edges
+uint32_t ZRasterizer::SampleMipLevel(const MipLevel& level, double fTextureU, double fTextureV)
+{
+    double fX = fTextureU * (double)level.nWidth - 0.5;
+    double fY = fTextureV * (double)level.nHeight - 0.5;
+    limit<double>(fX, 0.0, (double)(level.nWidth - 1));
+    limit<double>(fY, 0.0, (double)(level.nHeight - 1));
+
+    int64_t x0 = (int64_t)fX;
+    int64_t y0 = (int64_t)fY;
+    int64_t x1 = std::min<int64_t>(x0 + 1, level.nWidth - 1);
+    int64_t y1 = std::min<int64_t>(y0 + 1, level.nHeight - 1);
+    uint32_t nFracX = (uint32_t)((fX - (double)x0) * 256.0);
+    uint32_t nFracY = (uint32_t)((fY - (double)y0) * 256.0);
+
+    const uint32_t* pRow0 = level.pPixels + y0 * level.nWidth;
+    const uint32_t* pRow1 = level.pPixels + y1 * level.nWidth;
+
+    return LerpARGB(LerpARGB(pRow0[x0], pRow0[x1], nFracX), LerpARGB(pRow1[x0], pRow1[x1], nFracX), nFracY);
+}
+
+// Bilinear filter of two 2x2 footprints at once (pA and pB point at their top left texels). Horizontal lerps go first so
+// that results match LerpARGB(LerpARGB(), LerpARGB()). Returns A in the low 32 bits and B above it.
+static inline __m128i Bilerp2SSE2(const uint32_t* pA, const uint32_t* pB, int64_t nStride, uint32_t nFracXA, uint32_t nFracYA, uint32_t nFracXB, uint32_t nFracYB)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i k256 = _mm_set1_epi16(256);
+    __m128i topA = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)pA), zero);
+    __m128i bottomA = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pA + nStride)), zero);
+    __m128i topB = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)pB), zero);
+    __m128i bottomB = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pB + nStride)), zero);
+
+    // 255 * 256 still fits an unsigned 16 bit lane
+    __m128i wxA = _mm_set1_epi16((short)nFracXA);
+    __m128i wxB = _mm_set1_epi16((short)nFracXB);
+    __m128i hA = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi64(topA, bottomA), _mm_sub_epi16(k256, wxA)), _mm_mullo_epi16(_mm_unpackhi_epi64(topA, bottomA), wxA));
+    __m128i hB = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi64(topB, bottomB), _mm_sub_epi16(k256, wxB)), _mm_mullo_epi16(_mm_unpackhi_epi64(topB, bottomB), wxB));
+    hA = _mm_srli_epi16(hA, 8);
+    hB = _mm_srli_epi16(hB, 8);
+
+    __m128i wy = _mm_unpacklo_epi64(_mm_set1_epi16((short)nFracYA), _mm_set1_epi16((short)nFracYB));
+    __m128i v = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi64(hA, hB), _mm_sub_epi16(k256, wy)), _mm_mullo_epi16(_mm_unpackhi_epi64(hA, hB), wy));
+    v = _mm_srli_epi16(v, 8);
+    return _mm_packus_epi16(v, v);
+}
+
+void ZRasterizer::SampleSpanBilinear(const MipLevel& level, int64_t nU, int64_t nV, int64_t nDU, int64_t nDV, int64_t nCount, uint32_t* pOut)
+{
+    int64_t nMaxX = level.nWidth - 1;
+    int64_t nMaxY = level.nHeight - 1;
+
+    int64_t i = 0;
+    for (; i + 2 <= nCount; i += 2)
+    {
+        int64_t nU1 = nU + nDU;
+        int64_t nV1 = nV + nDV;
+        int64_t xA = nU >> 16;
+        int64_t yA = nV >> 16;
+        int64_t xB = nU1 >> 16;
+        int64_t yB = nV1 >> 16;
+
+        if ((uint64_t)xA >= (uint64_t)nMaxX || (uint64_t)yA >= (uint64_t)nMaxY || (uint64_t)xB >= (uint64_t)nMaxX || (uint64_t)yB >= (uint64_t)nMaxY)
+            break;      // footprints near the edge finish below
+
+        const uint32_t* pA = level.pPixels + yA * level.nWidth + xA;
+        const uint32_t* pB = level.pPixels + yB * level.nWidth + xB;
+        _mm_storel_epi64((__m128i*)(pOut + i), Bilerp2SSE2(pA, pB, level.nWidth, (uint32_t)(nU >> 8) & 0xff, (uint32_t)(nV >> 8) & 0xff, (uint32_t)(nU1 >> 8) & 0xff, (uint32_t)(nV1 >> 8) & 0xff));
+
+        nU = nU1 + nDU;
+        nV = nV1 + nDV;
+    }
+
+    for (; i < nCount; i++)
+    {
+        // clamp each tap into a local 2x2
+        int64_t x0 = nU >> 16;
+        int64_t y0 = nV >> 16;
+        int64_t x1 = std::clamp<int64_t>(x0 + 1, 0, nMaxX);
+        int64_t y1 = std::clamp<int64_t>(y0 + 1, 0, nMaxY);
+        x0 = std::clamp<int64_t>(x0, 0, nMaxX);
+        y0 = std::clamp<int64_t>(y0, 0, nMaxY);
+
+        uint32_t footprint[4] = { level.pPixels[y0 * level.nWidth + x0], level.pPixels[y0 * level.nWidth + x1], level.pPixels[y1 * level.nWidth + x0], level.pPixels[y1 * level.nWidth + x1] };
+        uint32_t nFracX = (uint32_t)(nU >> 8) & 0xff;
+        uint32_t nFracY = (uint32_t)(nV >> 8) & 0xff;
+        pOut[i] = (uint32_t)_mm_cvtsi128_si32(Bilerp2SSE2(footprint, footprint, 2, nFracX, nFracY, nFracX, nFracY));
+
+        nU += nDU;
+        nV += nDV;
+    }
+}
+
+// Catmull-Rom weights for the four taps around a sample at fraction fT
+static inline void CubicWeights(float fT, float* pW)
+{
+    float fT2 = fT * fT;
+    float fT3 = fT2 * fT;
+    pW[0] = 0.5f * (-fT3 + 2.0f * fT2 - fT);
+    pW[1] = 0.5f * (3.0f * fT3 - 5.0f * fT2 + 2.0f);
+    pW[2] = 0.5f * (-3.0f * fT3 + 4.0f * fT2 + fT);
+    pW[3] = 0.5f * (fT3 - fT2);
+}
+
+static inline __m128 TexelToFloats(uint32_t nCol)
+{
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)nCol), zero), zero));
+}
+
+void ZRasterizer::SampleSpanBicubic(const MipLevel& level, int64_t nU, int64_t nV, int64_t nDU, int64_t nDV, int64_t nCount, uint32_t* pOut)
+{
+    int64_t nMaxX = level.nWidth - 1;
+    int64_t nMaxY = level.nHeight - 1;
+    const float kFracScale = 1.0f / 65536.0f;
+
+    for (int64_t i = 0; i < nCount; i++)
+    {
+        int64_t x = nU >> 16;
+        int64_t y = nV >> 16;
+
+        float wx[4];
+        float wy[4];
+        CubicWeights((float)(nU & 0xffff) * kFracScale, wx);
+        CubicWeights((float)(nV & 0xffff) * kFracScale, wy);
+
+        int64_t taps[4];
+        for (int t = 0; t < 4; t++)
+            taps[t] = std::clamp<int64_t>(x - 1 + t, 0, nMaxX);
+
+        __m128 sum = _mm_setzero_ps();
+        for (int r = 0; r < 4; r++)
+        {
+            const uint32_t* pRow = level.pPixels + std::clamp<int64_t>(y - 1 + r, 0, nMaxY) * level.nWidth;
+            __m128 row = _mm_mul_ps(TexelToFloats(pRow[taps[0]]), _mm_set1_ps(wx[0]));
+            row = _mm_add_ps(row, _mm_mul_ps(TexelToFloats(pRow[taps[1]]), _mm_set1_ps(wx[1])));
+            row = _mm_add_ps(row, _mm_mul_ps(TexelToFloats(pRow[taps[2]]), _mm_set1_ps(wx[2])));
+            row = _mm_add_ps(row, _mm_mul_ps(TexelToFloats(pRow[taps[3]]), _mm_set1_ps(wx[3])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(row, _mm_set1_ps(wy[r])));
+        }
+
+        // packs/packus clamp the overshoot back to 0-255
+        __m128i n = _mm_cvtps_epi32(sum);
+        n = _mm_packs_epi32(n, n);
+        pOut[i] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(n, n));
+
+        nU += nDU;
+        nV += nDV;
+    }
+}
+
+template <ZRasterizer::eSpanSampler sampler>
+int64_t ZRasterizer::MultiSampleRasterizeRange(ZBuffer* pTexture, ZBuffer* pDestination, int64_t nTop, int64_t nBottom, double fClipLeft, double fClipRight, tUVVertexArray& vertexArray, uint32_t nSubsamples, uint8_t nAlpha, const tMipLevels* pMips)
+{
+    // Filtered magnification samples at pixel centers using the UV plane of the first three vertices, walking each span
+    // in 16.16 texel coordinates
+    AttributePlane planeU;
+    AttributePlane planeV;
+    MipLevel base = { pTexture->GetPixels(), pTexture->GetArea().Width(), pTexture->GetArea().Height() };
+    if constexpr (sampler == kSampleBilinear || sampler == kSampleBicubic)
+    {
+        double x[3], y[3], u[3], v[3];
+        for (int i = 0; i < 3; i++)
+        {
+            x[i] = vertexArray[i].x;
+            y[i] = vertexArray[i].y;
+            u[i] = vertexArray[i].u * (double)base.nWidth - 0.5;
+            v[i] = vertexArray[i].v * (double)base.nHeight - 0.5;
+        }
+        if (!MakePlane(x, y, u, planeU) || !MakePlane(x, y, v, planeV))
+            return MultiSampleRasterizeRange<kSampleSuperIn>(pTexture, pDestination, nTop, nBottom, fClipLeft, fClipRight, vertexArray, nSubsamples, nAlpha, pMips);
+    }
+    ZBlend::tConstAlphaSpanFunc blendSpan = ZBlend::Get().constAlpha[ZBlend::kDest];
+    int64_t nDestStride = pDestination->GetArea().Width();
+    int64_t nDrawn = 0;
+
+    ZASSERT(pDestination->GetPixels() != nullptr);
+
+    // Every sampler fills a block of samples that is blended in one go
+    uint32_t samples[kSpanBlock];
     for (int64_t nScanLine = nTop; nScanLine < nBottom; nScanLine++)
     {
         ZUVVertex scanLineMin;
@@ -573,56 +1264,81 @@ bool ZRasterizer::MultiSampleRasterizeRange(ZBuffer* pTexture, ZBuffer* pDestina
 
         SetupScanline((double)nScanLine, fClipLeft, fClipRight, scanLineMin, scanLineMax, vertexArray, fScanLineLength, fTextureU, fTextureV, fTextureDU, fTextureDV);
 
-        // Rasterize the scanline using textureWalker as the source color
         int64_t nStartX = (int64_t)scanLineMin.x;
         int64_t nScanLinePixels = (int64_t)scanLineMax.x - (int64_t)scanLineMin.x;
-        int64_t nDestStride = pDestination->GetArea().Width();
         uint32_t* pDestPixels = pDestination->GetPixels() + nScanLine * nDestStride + nStartX;
 
+        // level of detail from the texel footprint of one destination pixel along the scanline
+        const MipLevel* pFine = nullptr;
+        const MipLevel* pCoarse = nullptr;
+        uint32_t nBlend = 0;
+        if constexpr (sampler == kSampleMip || sampler == kSampleMipTrilinear)
+        {
+            const MipLevel& level0 = (*pMips)[0];
+            double fFootprint = sqrt((fTextureDU * level0.nWidth) * (fTextureDU * level0.nWidth) + (fTextureDV * level0.nHeight) * (fTextureDV * level0.nHeight));
+            double fLOD = (fFootprint > 1.0) ? log2(fFootprint) : 0.0;
 
-        //		int64_t nRand = pDestination->GetArea().Width() * pDestination->GetArea().Height();
-
-        //ZASSERT(nStartX + nScanLinePixels <= rDest.right);
-
-        ZASSERT(pDestination->GetPixels() != nullptr);
+            int64_t nLastLevel = (int64_t)pMips->size() - 1;
+            int64_t nLevel;
+            if constexpr (sampler == kSampleMipTrilinear)
+            {
+                nLevel = std::min<int64_t>((int64_t)fLOD, nLastLevel);
+                if (nLevel < nLastLevel)
+                    nBlend = (uint32_t)((fLOD - (double)nLevel) * 256.0);
+            }
+            else
+            {
+                nLevel = std::min<int64_t>((int64_t)(fLOD + 0.5), nLastLevel);
+            }
 
+            pFine = &(*pMips)[nLevel];
+            pCoarse = &(*pMips)[std::min<int64_t>(nLevel + 1, nLastLevel)];
+        }
 
-        if (isZoomedIn)
+        for (int64_t nX = 0; nX < nScanLinePixels; nX += kSpanBlock)
         {
-            for (int64_t nCount = 0; nCount < nScanLinePixels; nCount++)
+            int64_t nCount = std::min<int64_t>(kSpanBlock, nScanLinePixels - nX);
+            if constexpr (sampler == kSampleBilinear)
             {
-                uint32_t nSampled = SampleTexture_ZoomedIn(pTexture, fTextureU, fTextureV, fTextureDU, fTextureDV, nSubsamples);
-                if (ARGB_A(nSampled) > 0)
-                    *pDestPixels = COL::AlphaBlend_Col2Alpha(nSampled, *pDestPixels, nAlpha);
-                pDestPixels++;
-                fTextureU += fTextureDU;
-                fTextureV += fTextureDV;
+                SampleSpanBilinear(base, planeU.At(nStartX + nX, nScanLine), planeV.At(nStartX + nX, nScanLine), planeU.nDX, planeV.nDX, nCount, samples);
             }
-        }
-        else
-        {
-            for (int64_t nCount = 0; nCount < nScanLinePixels; nCount++)
+            else if constexpr (sampler == kSampleBicubic)
+            {
+                SampleSpanBicubic(base, planeU.At(nStartX + nX, nScanLine), planeV.At(nStartX + nX, nScanLine), planeU.nDX, planeV.nDX, nCount, samples);
+            }
+            else
             {
-                uint32_t nSampled = SampleTexture_ZoomedOut(pTexture, fTextureU, fTextureV, fTextureDU, fTextureDV, nSubsamples);
-                if (ARGB_A(nSampled) > 0)
-                    *pDestPixels = COL::AlphaBlend_Col2Alpha(nSampled, *pDestPixels, nAlpha);
-                pDestPixels++;
-                fTextureU += fTextureDU;
-                fTextureV += fTextureDV;
+                for (int64_t i = 0; i < nCount; i++)
+                {
+                    if constexpr (sampler == kSampleSuperIn)
+                        samples[i] = SampleTexture_ZoomedIn(pTexture, fTextureU, fTextureV, fTextureDU, fTextureDV, nSubsamples);
+                    else if constexpr (sampler == kSampleSuperOut)
+                        samples[i] = SampleTexture_ZoomedOut(pTexture, fTextureU, fTextureV, fTextureDU, fTextureDV, nSubsamples);
+                    else if constexpr (sampler == kSampleMip)
+                        samples[i] = SampleMipLevel(*pFine, fTextureU, fTextureV);
+                    else
+                        samples[i] = LerpARGB(SampleMipLevel(*pFine, fTextureU, fTextureV), SampleMipLevel(*pCoarse, fTextureU, fTextureV), nBlend);
+                    fTextureU += fTextureDU;
+                    fTextureV += fTextureDV;
+                }
             }
+            blendSpan(pDestPixels + nX, samples, nCount, nAlpha);
         }
 
-        mnDrawnPixels += nScanLinePixels;
+        nDrawn += nScanLinePixels;
     }
 
-    return true;
+    return nDrawn;
 }
 
-bool ZRasterizer::MultiSampleRasterizeWithAlpha(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip, uint32_t nSubsamples, uint8_t nAlpha)
+bool ZRasterizer::MultiSampleRasterizeWithAlpha(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip, uint32_t nSubsamples, uint8_t nAlpha, eMinification minification, eMagnification magnification)
 {
     if (nAlpha < 8)
         return true;
 
+    ZRasterStats::ScopedCall call(vertexArray.size() - 2);
+    pDestination->MarkDirty();
+
     ZRect rDest = pDestination->GetArea();
     int64_t nDestStride = pDestination->GetArea().Width();
     double fTextureW = (double)pTexture->GetArea().Width() - 0.5;
@@ -651,183 +1367,1146 @@ bool ZRasterizer::MultiSampleRasterizeWithAlpha(ZBuffer* pDestination, ZBuffer*
     // Determine if we're zoomed in or zoomed out
     bool isZoomedIn = (screenDist > textureDist);
 
-    int64_t threadCount = renderPool.size();
-    int64_t scanLinesPerThread = (nBottomScanLine - nTopScanLine) / threadCount;
+    // resolve the mip chain here so that the lazy build happens once, before fanning out
+    tMipLevels mips;
+    if (!isZoomedIn && minification != kMinSupersample)
+    {
+        int64_t nLevels = pTexture->GetMipLevelCount();
+        mips.reserve(nLevels);
+        for (int64_t nLevel = 0; nLevel < nLevels; nLevel++)
+        {
+            ZBuffer* pLevel = pTexture->GetMipLevel(nLevel);
+            mips.push_back({ pLevel->GetPixels(), pLevel->GetArea().Width(), pLevel->GetArea().Height() });
+        }
+    }
+    bool bTrilinear = (minification == kMinMipmapTrilinear);
 
-    std::vector< std::shared_future<bool> > threadRenderResults;
+    int64_t nRows = nBottomScanLine - nTopScanLine;
+    if (nRows <= 0)
+        return true;
+
+    // Estimated work in texel reads decides how far to fan out. Small primitives stay on the calling thread.
+    int64_t nTapsPerPixel = nSubsamples * nSubsamples;
+    if (isZoomedIn && magnification == kMagBilinear)
+        nTapsPerPixel = 4;
+    else if (isZoomedIn && magnification == kMagBicubic)
+        nTapsPerPixel = 16;
+    else if (!isZoomedIn && !mips.empty())
+        nTapsPerPixel = bTrilinear ? 8 : 4;
+
+    // One instantiation for the whole call
+    eSpanSampler sampler = kSampleSuperOut;
+    if (isZoomedIn)
+    {
+        sampler = kSampleSuperIn;
+        if (vertexArray.size() >= 3 && magnification == kMagBilinear)
+            sampler = kSampleBilinear;
+        else if (vertexArray.size() >= 3 && magnification == kMagBicubic)
+            sampler = kSampleBicubic;
+    }
+    else if (!mips.empty())
+    {
+        sampler = bTrilinear ? kSampleMipTrilinear : kSampleMip;
+    }
 
-    for (uint32_t i = 0; i < threadCount; i++)
+    static const tRasterizeRangeFunc rangeFuncs[kSamplerCount] =
     {
-        int64_t nTop = nTopScanLine + i * scanLinesPerThread;
-        int64_t nBottom = nTop + scanLinesPerThread;
+        &MultiSampleRasterizeRange<kSampleSuperIn>,
+        &MultiSampleRasterizeRange<kSampleSuperOut>,
+        &MultiSampleRasterizeRange<kSampleMip>,
+        &MultiSampleRasterizeRange<kSampleMipTrilinear>,
+        &MultiSampleRasterizeRange<kSampleBilinear>,
+        &MultiSampleRasterizeRange<kSampleBicubic>
+    };
+    tRasterizeRangeFunc rasterizeRange = rangeFuncs[sampler];
+
+    ZRect rWork(GetBoundingRect(vertexArray));
+    rWork.Intersect(&rDest);
+    int64_t nWork = rWork.Area() * nTapsPerPixel;
+
+    int64_t nHelpers = 0;
+    if (nWork >= kMinTapsToThread)
+        nHelpers = std::min<int64_t>((int64_t)renderPool.size(), kMaxRasterHelpers);
+
+    // Bands are handed out from a shared counter, several per thread, so that a thread that lands on cheap rows
+    // (clear texels, clipped spans) picks up more of them.  The calling thread works bands too.
+    int64_t nBandRows = std::max<int64_t>(kMinBandRows, nRows / ((nHelpers + 1) * 4));
+    int64_t nBands = (nRows + nBandRows - 1) / nBandRows;
+    nHelpers = std::min<int64_t>(nHelpers, nBands - 1);
+    ZRasterStats::NoteThreads(nHelpers + 1);
+
+    // each thread counts its own work
+    std::atomic<int64_t> nNextBand = 0;
+    auto worker = [&]()
+    {
+        int64_t nDrawn = 0;
+        for (int64_t nBand = nNextBand++; nBand < nBands; nBand = nNextBand++)
+        {
+            int64_t nTop = nTopScanLine + nBand * nBandRows;
+            int64_t nBottom = std::min<int64_t>(nTop + nBandRows, nBottomScanLine);
+            nDrawn += rasterizeRange(pTexture, pDestination, nTop, nBottom, fClipLeft, fClipRight, vertexArray, nSubsamples, nAlpha, &mips);
+        }
+        ZRasterStats::Add(ZRasterStats::kPixels, nDrawn);
+        ZRasterStats::Add(ZRasterStats::kTexels, nDrawn * nTapsPerPixel);
+    };
+
+    std::future<void> helpers[kMaxRasterHelpers];
+    for (int64_t i = 0; i < nHelpers; i++)
+        helpers[i] = renderPool.enqueue(worker);
+
+    worker();
+
+    for (int64_t i = 0; i < nHelpers; i++)
+        helpers[i].wait();
+
+    return true;
+}
+
+
+
+bool ZRasterizer::Rasterize(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip, eEdgeMode edges)
+{
+    ZRasterStats::ScopedCall call(vertexArray.size() - 2);
+    pDestination->MarkDirty();
+	ZRect rDest = pDestination->GetArea();
+	if (pClip)
+		rDest.Intersect(pClip);
+	int64_t nDestStride = pDestination->GetArea().Width();
+	uint32_t* pDestPixels = pDestination->GetPixels();
+
+    double fBltDest[4];
+    double fBltSrc[4];
+    if (edges == kEdgeAliased && mbAxisAlignedBlt && FindAxisAlignedMapping(pTexture, vertexArray, fBltDest, fBltSrc))
+        return ScaledBlt(pDestination, pTexture, fBltDest, fBltSrc, rDest, false, 255, kScaleNearest);
+
+    // concave outlines fall back to aliased edges
+    CoverageOutline outline;
+    bool bAntiAlias = edges == kEdgeAntiAlias && SetupCoverageOutline(vertexArray.data(), vertexArray.size(), outline);
+
+    int64_t nDrawn = 0;
+    ForEachTexturedTriangle(pTexture, vertexArray, [&](const TexelWalker& walker, const double* x, const double* y, uint32_t nOutline)
+    {
+        if (bAntiAlias)
+        {
+            nDrawn += RasterizeTriangleAA(x, y, nOutline, outline, rDest, [&](int64_t nY, int64_t nLeft, int64_t nRight, const uint16_t* pCoverage)
+            {
+                uint32_t* pDst = pDestPixels + nY * nDestStride + nLeft;
+                if (pCoverage)
+                    CoverageSpan<kSpanCopy, false>(walker, pDst, nLeft, nY, nRight - nLeft, pCoverage, 255);
+                else
+                    TexelSpan<kSpanCopy>(walker, pDst, nLeft, nY, nRight - nLeft, 255);
+            });
+            return;
+        }
+
+        nDrawn += RasterizeTriangle(x, y, rDest, [&](int64_t nY, int64_t nLeft, int64_t nRight)
+        {
+            TexelSpan<kSpanCopy>(walker, pDestPixels + nY * nDestStride + nLeft, nLeft, nY, nRight - nLeft, 255);
+        });
+    });
+
+    ZRasterStats::Add(ZRasterStats::kPixels, nDrawn);
+    ZRasterStats::Add(ZRasterStats::kTexels, nDrawn);
+	return true;
+}
+
+bool ZRasterizer::Rasterize(ZBuffer* pDestination, tColorVertexArray& vertexArray, ZRect* pClip, eEdgeMode edges)
+{
+    ZRasterStats::ScopedCall call(vertexArray.size() - 2);
+    pDestination->MarkDirty();
+    ZRect rDest = pDestination->GetArea();
+    if (pClip)
+        rDest.Intersect(pClip);
+    int64_t nDestStride = pDestination->GetArea().Width();
+    uint32_t* pDestPixels = pDestination->GetPixels();
+
+    // concave outlines fall back to aliased edges
+    CoverageOutline outline;
+    bool bAntiAlias = edges == kEdgeAntiAlias && SetupCoverageOutline(vertexArray.data(), vertexArray.size(), outline);
+
+    int64_t nDrawn = 0;
+    for (size_t n = 2; n < vertexArray.size(); n++)
+    {
+        const ZColorVertex* pV[3] = { &vertexArray[0], &vertexArray[n - 1], &vertexArray[n] };
+        double x[3], y[3];
+        for (int i = 0; i < 3; i++)
+        {
+            x[i] = pV[i]->x;
+            y[i] = pV[i]->y;
+        }
+
+        // One plane per channel, in B,G,R,A order to match the pixel layout
+        AttributePlane channel[4];
+        bool bValid = true;
+        for (int c = 0; c < 4 && bValid; c++)
+        {
+            double a[3];
+            for (int i = 0; i < 3; i++)
+                a[i] = (double)((pV[i]->mColor >> (c * 8)) & 0xff);
+            bValid = MakePlane(x, y, a, channel[c]);
+        }
+        if (!bValid)
+            continue;
+
+        // pCoverage null writes the span, otherwise each pixel lerps toward its color by coverage
+        auto colorSpan = [&](int64_t nY, int64_t nLeft, int64_t nRight, const uint16_t* pCoverage)
+        {
+            __m128i v = _mm_setr_epi32((int32_t)channel[0].At(nLeft, nY), (int32_t)channel[1].At(nLeft, nY), (int32_t)channel[2].At(nLeft, nY), (int32_t)channel[3].At(nLeft, nY));
+            __m128i d = _mm_setr_epi32((int32_t)channel[0].nDX, (int32_t)channel[1].nDX, (int32_t)channel[2].nDX, (int32_t)channel[3].nDX);
+
+            uint32_t* pDst = pDestPixels + nY * nDestStride + nLeft;
+            for (int64_t i = 0; i < nRight - nLeft; i++)
+            {
+                __m128i p = _mm_packs_epi32(_mm_srai_epi32(v, kAttribFracBits), _mm_setzero_si128());
+                uint32_t nCol = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+                if (!pCoverage || pCoverage[i] == kSubPixelOne)
+                    pDst[i] = nCol;
+                else if (pCoverage[i])
+                    pDst[i] = LerpARGB(pDst[i], nCol, pCoverage[i]);
+                v = _mm_add_epi32(v, d);
+            }
+        };
+
+        if (bAntiAlias)
+            nDrawn += RasterizeTriangleAA(x, y, FanOutline(n, vertexArray.size()), outline, rDest, colorSpan);
+        else
+            nDrawn += RasterizeTriangle(x, y, rDest, [&](int64_t nY, int64_t nLeft, int64_t nRight) { colorSpan(nY, nLeft, nRight, nullptr); });
+    }
+
+    ZRasterStats::Add(ZRasterStats::kPixels, nDrawn);
+    return true;
+}
+
+bool ZRasterizer::RasterizeBatch(ZBuffer* pDestination, const tBatchQuads& quads)
+{
+    if (quads.empty())
+        return true;
+
+    ZRasterStats::ScopedCall call(quads.size());
+    pDestination->MarkDirty();
+
+    ZRect rDestArea(pDestination->GetArea());
+    int64_t nDestStride = rDestArea.Width();
+    uint32_t* pDestPixels = pDestination->GetPixels();
+    ZASSERT(pDestPixels != nullptr);
+
+    // Setup once per quad, not once per tile: texel planes for both triangles and the clipped screen bounds
+    struct QuadSetup
+    {
+        TexelWalker         walker[2];
+        double              x[2][3];
+        double              y[2][3];
+        ZRect               rBounds;        // empty if the quad draws nothing
+        bool                bAntiAlias;
+        CoverageOutline     outline;
+        tTexelSpanFunc      interiorSpan;   // picked once per quad from its blend and texture
+        tCoverageSpanFunc   edgeSpan;
+    };
+    std::vector<QuadSetup> setups(quads.size());
+
+    int64_t nTilesX = (rDestArea.Width() + kBatchTileSize - 1) / kBatchTileSize;
+    int64_t nTilesY = (rDestArea.Height() + kBatchTileSize - 1) / kBatchTileSize;
+    std::vector<int64_t> tileStart(nTilesX * nTilesY + 1, 0);
+    int64_t nWork = 0;
+
+    for (size_t i = 0; i < quads.size(); i++)
+    {
+        const BatchQuad& quad = quads[i];
+        QuadSetup& setup = setups[i];
+        setup.rBounds.Set(0, 0, 0, 0);
+
+        if (!quad.pTexture || !quad.pTexture->GetPixels() || (quad.bBlend && quad.nAlpha < 8))
+            continue;
+
+        double fLeft = quad.verts[0].x;
+        double fTop = quad.verts[0].y;
+        double fRight = quad.verts[0].x;
+        double fBottom = quad.verts[0].y;
+        for (int v = 1; v < 4; v++)
+        {
+            fLeft = std::min(fLeft, quad.verts[v].x);
+            fTop = std::min(fTop, quad.verts[v].y);
+            fRight = std::max(fRight, quad.verts[v].x);
+            fBottom = std::max(fBottom, quad.verts[v].y);
+        }
+
+        ZRect rBounds((int64_t)floor(fLeft), (int64_t)floor(fTop), (int64_t)ceil(fRight) + 1, (int64_t)ceil(fBottom) + 1);
+        rBounds.Intersect(quad.rClip);
+        rBounds.Intersect(rDestArea);
+        if (rBounds.Width() <= 0 || rBounds.Height() <= 0)
+            continue;
+
+        if (!SetupTexturedTriangle(quad.pTexture, quad.verts[0], quad.verts[1], quad.verts[2], setup.walker[0], setup.x[0], setup.y[0]) ||
+            !SetupTexturedTriangle(quad.pTexture, quad.verts[0], quad.verts[2], quad.verts[3], setup.walker[1], setup.x[1], setup.y[1]))
+            continue;
+
+        setup.bAntiAlias = quad.edges == kEdgeAntiAlias && SetupCoverageOutline(quad.verts, 4, setup.outline);
+        setup.interiorSpan = quad.bBlend ? &TexelSpan<kSpanConstAlpha> : &TexelSpan<kSpanCopy>;
+        setup.edgeSpan = SelectCoverageSpan(quad.bBlend ? kSpanConstAlpha : kSpanCopy, quad.pTexture);
+        setup.rBounds = rBounds;
+        nWork += rBounds.Area();
+
+        for (int64_t ty = (rBounds.top - rDestArea.top) / kBatchTileSize; ty <= (rBounds.bottom - 1 - rDestArea.top) / kBatchTileSize; ty++)
+            for (int64_t tx = (rBounds.left - rDestArea.left) / kBatchTileSize; tx <= (rBounds.right - 1 - rDestArea.left) / kBatchTileSize; tx++)
+                tileStart[ty * nTilesX + tx + 1]++;
+    }
 
-        // last thread? take the rest of the scanlines
-        if (i == threadCount - 1)
-            nBottom = nBottomScanLine;
+    // Counting sort of quad indices into per tile lists, keeping submission order within each tile
+    for (size_t t = 1; t < tileStart.size(); t++)
+        tileStart[t] += tileStart[t - 1];
 
-        ZASSERT(nBottom <= pDestination->GetArea().bottom);
-        threadRenderResults.emplace_back(renderPool.enqueue(&MultiSampleRasterizeRange, pTexture, pDestination, nTop, nBottom, fClipLeft, fClipRight, vertexArray, isZoomedIn, nSubsamples, nAlpha));
+    std::vector<int32_t> tileQuads(tileStart.back());
+    std::vector<int64_t> tileFill(tileStart.begin(), tileStart.end() - 1);
+    std::vector<int64_t> activeTiles;
+    for (size_t i = 0; i < quads.size(); i++)
+    {
+        const ZRect& rBounds = setups[i].rBounds;
+        if (rBounds.Width() <= 0)
+            continue;
+
+        for (int64_t ty = (rBounds.top - rDestArea.top) / kBatchTileSize; ty <= (rBounds.bottom - 1 - rDestArea.top) / kBatchTileSize; ty++)
+            for (int64_t tx = (rBounds.left - rDestArea.left) / kBatchTileSize; tx <= (rBounds.right - 1 - rDestArea.left) / kBatchTileSize; tx++)
+                tileQuads[tileFill[ty * nTilesX + tx]++] = (int32_t)i;
     }
 
-    for (const auto& result : threadRenderResults)
+    for (int64_t t = 0; t < nTilesX * nTilesY; t++)
     {
-        result.get();
+        if (tileStart[t + 1] > tileStart[t])
+            activeTiles.push_back(t);
     }
 
-    mnProcessedVertices += vertexArray.size();
+    auto rasterizeTile = [&](int64_t nTile) -> int64_t
+    {
+        int64_t nTileX = nTile % nTilesX;
+        int64_t nTileY = nTile / nTilesX;
+        ZRect rTile(rDestArea.left + nTileX * kBatchTileSize, rDestArea.top + nTileY * kBatchTileSize, 0, 0);
+        rTile.right = std::min<int64_t>(rTile.left + kBatchTileSize, rDestArea.right);
+        rTile.bottom = std::min<int64_t>(rTile.top + kBatchTileSize, rDestArea.bottom);
+
+        const int32_t* pList = &tileQuads[tileStart[nTile]];
+        int64_t nCount = tileStart[nTile + 1] - tileStart[nTile];
+
+        // Quads that don't overlap within this tile can't depend on draw order, so group them by texture
+        int32_t sorted[kMaxSortedPerTile];
+        if (nCount > 1 && nCount <= kMaxSortedPerTile)
+        {
+            bool bOverlap = false;
+            for (int64_t a = 0; a < nCount && !bOverlap; a++)
+            {
+                ZRect rA(setups[pList[a]].rBounds);
+                rA.Intersect(rTile);
+                for (int64_t b = a + 1; b < nCount && !bOverlap; b++)
+                    bOverlap = rA.Overlaps(setups[pList[b]].rBounds);
+            }
+
+            if (!bOverlap)
+            {
+                std::copy(pList, pList + nCount, sorted);
+                std::stable_sort(sorted, sorted + nCount, [&](int32_t a, int32_t b) { return quads[a].pTexture < quads[b].pTexture; });
+                pList = sorted;
+            }
+        }
+
+        int64_t nDrawn = 0;
+        for (int64_t n = 0; n < nCount; n++)
+        {
+            const BatchQuad& quad = quads[pList[n]];
+            const QuadSetup& setup = setups[pList[n]];
+
+            ZRect rClip(setup.rBounds);
+            if (!rClip.Intersect(rTile) || rClip.Width() <= 0 || rClip.Height() <= 0)
+                continue;
+
+            uint32_t nAlpha = quad.bBlend ? quad.nAlpha : 255;
+            for (int t = 0; t < 2; t++)
+            {
+                const TexelWalker& walker = setup.walker[t];
+                if (setup.bAntiAlias)
+                {
+                    nDrawn += RasterizeTriangleAA(setup.x[t], setup.y[t], FanOutline(t + 2, 4), setup.outline, rClip, [&](int64_t nY, int64_t nLeft, int64_t nRight, const uint16_t* pCoverage)
+                    {
+                        uint32_t* pDst = pDestPixels + nY * nDestStride + nLeft;
+                        if (pCoverage)
+                            setup.edgeSpan(walker, pDst, nLeft, nY, nRight - nLeft, pCoverage, nAlpha);
+                        else
+                            setup.interiorSpan(walker, pDst, nLeft, nY, nRight - nLeft, nAlpha);
+                    });
+                    continue;
+                }
+
+                nDrawn += RasterizeTriangle(setup.x[t], setup.y[t], rClip, [&](int64_t nY, int64_t nLeft, int64_t nRight)
+                {
+                    setup.interiorSpan(walker, pDestPixels + nY * nDestStride + nLeft, nLeft, nY, nRight - nLeft, nAlpha);
+                });
+            }
+        }
+
+        return nDrawn;
+    };
+
+    // Tiles are handed out from a shared counter as in MultiSampleRasterizeWithAlpha
+    int64_t nTiles = (int64_t)activeTiles.size();
+    int64_t nHelpers = 0;
+    if (nWork >= kMinTapsToThread)
+        nHelpers = std::min<int64_t>({ (int64_t)renderPool.size(), kMaxRasterHelpers, nTiles - 1 });
+
+    ZRasterStats::NoteThreads(nHelpers + 1);
+
+    std::atomic<int64_t> nNextTile = 0;
+    auto worker = [&]()
+    {
+        int64_t nDrawn = 0;
+        for (int64_t nTile = nNextTile++; nTile < nTiles; nTile = nNextTile++)
+            nDrawn += rasterizeTile(activeTiles[nTile]);
+        ZRasterStats::Add(ZRasterStats::kPixels, nDrawn);
+        ZRasterStats::Add(ZRasterStats::kTexels, nDrawn);
+    };
+
+    std::future<void> helpers[kMaxRasterHelpers];
+    for (int64_t i = 0; i < nHelpers; i++)
+        helpers[i] = renderPool.enqueue(worker);
+
+    worker();
+
+    for (int64_t i = 0; i < nHelpers; i++)
+        helpers[i].wait();
+
     return true;
 }
 
+// Depth buffered meshes
+//
+// Each triangle is set up once in clip space: rejected when all three vertices are outside one frustum plane, clipped at
+// the near plane and at a guard band (so that snapped edge functions stay in range), divided by w and culled by winding.
+// Depth z/w, 1/w and attributes over w are all linear in screen space, so pixels interpolate those and divide once.
+static const float kMeshGuardBand = 16.0f;          // multiple of w beyond which x,y are clipped
+static const size_t kMeshClipVerts = 3 + 5;         // a triangle after the near plane and four guard band edges
+static const size_t kMeshPlanes = 6;                // z/w, 1/w, then u,v or B,G,R,A over w
 
+enum eMeshOutcode : uint32_t
+{
+    kOutLeft            = 1,
+    kOutRight           = 2,
+    kOutBottom          = 4,
+    kOutTop             = 8,
+    kOutNear            = 16,
+    kOutFar             = 32,
+    kOutFrustum         = 63,
+    kOutGuardBand       = 64
+};
+
+// Clip space position and attributes (u,v in texels or B,G,R,A 0-255), lerped together while clipping
+struct MeshClipPoint
+{
+    float   p[4];
+    float   a[4];
+};
 
-bool ZRasterizer::Rasterize(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip)
+static inline uint32_t MeshOutcode(const MeshClipPoint& pt)
 {
-	ZRect rDest = pDestination->GetArea();
-	int64_t nDestStride = pDestination->GetArea().Width();
-	double fTextureW = (double) pTexture->GetArea().Width() - 0.5;
-	double fTextureH = (double) pTexture->GetArea().Height() - 0.5;
-	uint32_t* pSourcePixels = pTexture->GetPixels();
-	int64_t nTextureStride = pTexture->GetArea().Width();
-	double fClipLeft;
-	double fClipRight;
-	int64_t nTopScanLine;
-	int64_t nBottomScanLine;
-
-	SetupRasterization(pDestination, vertexArray, rDest, pClip, fClipLeft, fClipRight, nTopScanLine, nBottomScanLine);
-
-	// For each scanline
-	for (int64_t nScanLine = nTopScanLine; nScanLine < nBottomScanLine; nScanLine++)
-	{
-		ZUVVertex scanLineMin;
-		ZUVVertex scanLineMax;
+    float x = pt.p[0];
+    float y = pt.p[1];
+    float z = pt.p[2];
+    float w = pt.p[3];
+
+    uint32_t nCode = 0;
+    if (x < -w)
+        nCode |= kOutLeft;
+    if (x > w)
+        nCode |= kOutRight;
+    if (y < -w)
+        nCode |= kOutBottom;
+    if (y > w)
+        nCode |= kOutTop;
+    if (z < 0.0f)
+        nCode |= kOutNear;
+    if (z > w)
+        nCode |= kOutFar;
+    if (fabsf(x) > kMeshGuardBand * w || fabsf(y) > kMeshGuardBand * w)
+        nCode |= kOutGuardBand;
+    return nCode;
+}
 
-		double fScanLineLength;
+// Distance inside clip plane n: the near plane, then the guard band left, right, bottom and top
+static inline float MeshPlaneDistance(const MeshClipPoint& pt, int n)
+{
+    switch (n)
+    {
+    case 0:     return pt.p[2];
+    case 1:     return pt.p[0] + kMeshGuardBand * pt.p[3];
+    case 2:     return kMeshGuardBand * pt.p[3] - pt.p[0];
+    case 3:     return pt.p[1] + kMeshGuardBand * pt.p[3];
+    default:    return kMeshGuardBand * pt.p[3] - pt.p[1];
+    }
+}
 
-		double fTextureU;
-		double fTextureV;
-		double fTextureDU;
-		double fTextureDV;
+// Sutherland-Hodgman against the planes the outcodes call for. Returns the vertices left in pPoly.
+static size_t ClipMeshPolygon(MeshClipPoint* pPoly, size_t nCount, uint32_t nOutcodes)
+{
+    MeshClipPoint clipped[kMeshClipVerts];
+    for (int n = 0; n < 5 && nCount >= 3; n++)
+    {
+        if (!(nOutcodes & (n == 0 ? kOutNear : kOutGuardBand)))
+            continue;
 
-		SetupScanline((double) nScanLine, fClipLeft, fClipRight, scanLineMin, scanLineMax, vertexArray, fScanLineLength, fTextureU, fTextureV, fTextureDU, fTextureDV);
+        size_t nOut = 0;
+        for (size_t i = 0; i < nCount; i++)
+        {
+            const MeshClipPoint& a = pPoly[i];
+            const MeshClipPoint& b = pPoly[(i + 1) % nCount];
+            float fA = MeshPlaneDistance(a, n);
+            float fB = MeshPlaneDistance(b, n);
+            if (fA >= 0.0f)
+                clipped[nOut++] = a;
+
+            if ((fA >= 0.0f) != (fB >= 0.0f))
+            {
+                // always lerp from the inside end so that triangles sharing the edge get the same point
+                const MeshClipPoint& in = (fA >= 0.0f) ? a : b;
+                const MeshClipPoint& out = (fA >= 0.0f) ? b : a;
+                float fIn = (fA >= 0.0f) ? fA : fB;
+                float fOut = (fA >= 0.0f) ? fB : fA;
+                float fT = fIn / (fIn - fOut);
+
+                MeshClipPoint& pt = clipped[nOut++];
+                for (int k = 0; k < 4; k++)
+                {
+                    pt.p[k] = in.p[k] + (out.p[k] - in.p[k]) * fT;
+                    pt.a[k] = in.a[k] + (out.a[k] - in.a[k]) * fT;
+                }
+            }
+        }
 
-		// Rasterize the scanline using textureWalker as the source color
-		int64_t nStartX = (int64_t) scanLineMin.x;
-		int64_t nScanLinePixels = (int64_t) scanLineMax.x - (int64_t) scanLineMin.x;
-		uint32_t* pDestPixels = pDestination->GetPixels() + nScanLine*nDestStride + nStartX;
+        std::copy(clipped, clipped + nOut, pPoly);
+        nCount = nOut;
+    }
 
-		ZASSERT(nStartX + nScanLinePixels <= rDest.right);
+    return nCount;
+}
 
-		for (int64_t nCount = 0; nCount < nScanLinePixels; nCount++)
-		{
-			int64_t nTextureX = (int64_t) (fTextureU * fTextureW);
-			int64_t nTextureY = (int64_t) (fTextureV * fTextureH);
-			uint32_t nSourceCol = *(pSourcePixels + nTextureY*nTextureStride + nTextureX);
-			*pDestPixels = (*pDestPixels&0xff000000)|(nSourceCol&0x00ffffff);
-			pDestPixels++;
-
-			fTextureU += fTextureDU;
-			fTextureV += fTextureDV;
-		}
+// One screen space triangle, ready to bin. Planes hold the value at the center of pixel nLeft,nTop and the x and y steps.
+struct MeshTriangle
+{
+    float       x[3];
+    float       y[3];
+    int32_t     nLeft;
+    int32_t     nTop;
+    int32_t     nRight;
+    int32_t     nBottom;
+    float       plane[kMeshPlanes][3];
+};
+
+struct MeshSetup
+{
+    const ZRasterizer::ClipVertex*  pVerts;
+    size_t                          nVerts;
+    const uint32_t*                 pIndices;
+    ZRect                           rClip;
+    double                          fViewLeft;
+    double                          fViewTop;
+    double                          fViewHalfW;
+    double                          fViewHalfH;
+    double                          fTextureW;      // 0 for vertex colors
+    double                          fTextureH;
+    ZRasterizer::eCullMode          cull;
+};
+
+// Appends the screen triangles of mesh triangle nTri, none if it is culled and up to kMeshClipVerts - 2 if it is clipped
+static void SetupMeshTriangle(const MeshSetup& setup, size_t nTri, std::vector<MeshTriangle>& out)
+{
+    MeshClipPoint poly[kMeshClipVerts];
+    uint32_t nAllOut = kOutFrustum;
+    uint32_t nAnyOut = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        uint32_t nIndex = setup.pIndices[nTri * 3 + i];
+        if (nIndex >= setup.nVerts)
+            return;
+
+        const ZRasterizer::ClipVertex& v = setup.pVerts[nIndex];
+        MeshClipPoint& pt = poly[i];
+        pt.p[0] = v.x;
+        pt.p[1] = v.y;
+        pt.p[2] = v.z;
+        pt.p[3] = v.w;
+        if (setup.fTextureW > 0.0)
+        {
+            pt.a[0] = (float)(v.u * setup.fTextureW);
+            pt.a[1] = (float)(v.v * setup.fTextureH);
+            pt.a[2] = 0.0f;
+            pt.a[3] = 0.0f;
+        }
+        else
+        {
+            for (int c = 0; c < 4; c++)
+                pt.a[c] = (float)((v.mColor >> (c * 8)) & 0xff);
+        }
 
-		mnDrawnPixels += nScanLinePixels;
-	}
+        uint32_t nCode = MeshOutcode(pt);
+        nAllOut &= nCode;
+        nAnyOut |= nCode;
+    }
 
-	mnProcessedVertices += vertexArray.size();
-	return true;
+    if (nAllOut)
+        return;
+
+    size_t nCount = 3;
+    if (nAnyOut & (kOutNear | kOutGuardBand))
+        nCount = ClipMeshPolygon(poly, nCount, nAnyOut);
+    if (nCount < 3)
+        return;
+
+    // textured triangles only interpolate u and v
+    size_t nPlanes = (setup.fTextureW > 0.0) ? 4 : kMeshPlanes;
+
+    double x[kMeshClipVerts];
+    double y[kMeshClipVerts];
+    double a[kMeshPlanes][kMeshClipVerts];
+    for (size_t i = 0; i < nCount; i++)
+    {
+        const MeshClipPoint& pt = poly[i];
+        if (pt.p[3] <= 0.0f)
+            return;
+
+        double fInvW = 1.0 / pt.p[3];
+        x[i] = setup.fViewLeft + (pt.p[0] * fInvW + 1.0) * setup.fViewHalfW;
+        y[i] = setup.fViewTop + (1.0 - pt.p[1] * fInvW) * setup.fViewHalfH;
+        a[0][i] = pt.p[2] * fInvW;
+        a[1][i] = fInvW;
+        for (size_t k = 2; k < nPlanes; k++)
+            a[k][i] = pt.a[k - 2] * fInvW;
+    }
+
+    // Clipping keeps the winding, so the whole polygon is culled or not. Positive area is clockwise with y down.
+    double fArea = 0.0;
+    for (size_t i = 0; i < nCount; i++)
+    {
+        size_t j = (i + 1) % nCount;
+        fArea += x[i] * y[j] - x[j] * y[i];
+    }
+    if (fArea == 0.0 || (setup.cull == ZRasterizer::kCullClockwise && fArea > 0.0) || (setup.cull == ZRasterizer::kCullCounterClockwise && fArea < 0.0))
+        return;
+
+    for (size_t n = 2; n < nCount; n++)
+    {
+        size_t fan[3] = { 0, n - 1, n };
+        double fx[3], fy[3];
+        for (int i = 0; i < 3; i++)
+        {
+            fx[i] = x[fan[i]];
+            fy[i] = y[fan[i]];
+        }
+
+        ZRect rBounds((int64_t)floor(std::min({ fx[0], fx[1], fx[2] })), (int64_t)floor(std::min({ fy[0], fy[1], fy[2] })),
+                      (int64_t)ceil(std::max({ fx[0], fx[1], fx[2] })) + 1, (int64_t)ceil(std::max({ fy[0], fy[1], fy[2] })) + 1);
+        rBounds.Intersect(setup.rClip);
+        if (rBounds.Width() <= 0 || rBounds.Height() <= 0)
+            continue;
+
+        // MakePlane's gradients in float, anchored at the top left pixel and sharing the determinant
+        double fDet = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fx[2] - fx[0]) * (fy[1] - fy[0]);
+        if (fabs(fDet) < 1e-9)
+            continue;
+
+        double fInvDet = 1.0 / fDet;
+        double fCenterX = rBounds.left + 0.5 - fx[0];
+        double fCenterY = rBounds.top + 0.5 - fy[0];
+
+        MeshTriangle tri;
+        for (size_t p = 0; p < nPlanes; p++)
+        {
+            double fA0 = a[p][fan[0]];
+            double fA1 = a[p][fan[1]] - fA0;
+            double fA2 = a[p][fan[2]] - fA0;
+            double fDX = (fA1 * (fy[2] - fy[0]) - fA2 * (fy[1] - fy[0])) * fInvDet;
+            double fDY = (fA2 * (fx[1] - fx[0]) - fA1 * (fx[2] - fx[0])) * fInvDet;
+            tri.plane[p][0] = (float)(fA0 + fDX * fCenterX + fDY * fCenterY);
+            tri.plane[p][1] = (float)fDX;
+            tri.plane[p][2] = (float)fDY;
+        }
+
+        for (int i = 0; i < 3; i++)
+        {
+            tri.x[i] = (float)fx[i];
+            tri.y[i] = (float)fy[i];
+        }
+        tri.nLeft = (int32_t)rBounds.left;
+        tri.nTop = (int32_t)rBounds.top;
+        tri.nRight = (int32_t)rBounds.right;
+        tri.nBottom = (int32_t)rBounds.bottom;
+        out.push_back(tri);
+    }
 }
 
-bool ZRasterizer::Rasterize(ZBuffer* pDestination, tColorVertexArray& vertexArray, ZRect* pClip)
+struct MeshTarget
 {
-    ZRect rDest = pDestination->GetArea();
-    int64_t nDestStride = pDestination->GetArea().Width();
-    double fClipLeft;
-    double fClipRight;
-    int64_t nTopScanLine;
-    int64_t nBottomScanLine;
+    uint32_t*       pPixels;
+    float*          pDepth;
+    int64_t         nStride;
+    const uint32_t* pTexels;        // null for vertex colors
+    int64_t         nTextureStride;
+    int64_t         nTextureMaxX;
+    int64_t         nTextureMaxY;
+};
+
+struct MeshScratch
+{
+    std::vector<std::vector<MeshTriangle>>  chunks;         // setup output per chunk of kMeshSetupChunk triangles
+    std::vector<int64_t>                    tileStart;
+    std::vector<int64_t>                    tileFill;
+    std::vector<uint32_t>                   tileTriangles;
+    std::vector<int64_t>                    activeTiles;
+};
+
+// Depth tests and shades one span of a triangle. Returns the pixels written.
+template <bool bTextured>
+static int64_t MeshSpan(const MeshTriangle& tri, const MeshTarget& target, int64_t nY, int64_t nLeft, int64_t nRight)
+{
+    float fDX = (float)(nLeft - tri.nLeft);
+    float fDY = (float)(nY - tri.nTop);
+    const size_t nPlanes = bTextured ? 4 : kMeshPlanes;
+    float v[kMeshPlanes];
+    for (size_t p = 0; p < nPlanes; p++)
+        v[p] = tri.plane[p][0] + tri.plane[p][1] * fDX + tri.plane[p][2] * fDY;
+
+    float* pZ = target.pDepth + nY * target.nStride + nLeft;
+    uint32_t* pDst = target.pPixels + nY * target.nStride + nLeft;
+    int64_t nCount = nRight - nLeft;
+    int64_t nWritten = 0;
+    for (int64_t i = 0; i < nCount; i++)
+    {
+        float fI = (float)i;
+        float fZ = v[0] + tri.plane[0][1] * fI;
+        if (fZ >= pZ[i])
+            continue;
+
+        pZ[i] = fZ;
+        float fW = 1.0f / (v[1] + tri.plane[1][1] * fI);
+        if constexpr (bTextured)
+        {
+            int64_t nTX = std::clamp<int64_t>((int64_t)((v[2] + tri.plane[2][1] * fI) * fW), 0, target.nTextureMaxX);
+            int64_t nTY = std::clamp<int64_t>((int64_t)((v[3] + tri.plane[3][1] * fI) * fW), 0, target.nTextureMaxY);
+            pDst[i] = (pDst[i] & 0xff000000) | (target.pTexels[nTY * target.nTextureStride + nTX] & 0x00ffffff);
+        }
+        else
+        {
+            uint32_t nCol = 0;
+            for (int c = 0; c < 4; c++)
+                nCol |= (uint32_t)std::clamp<int32_t>((int32_t)((v[2 + c] + tri.plane[2 + c][1] * fI) * fW + 0.5f), 0, 255) << (c * 8);
+            pDst[i] = nCol;
+        }
+        nWritten++;
+    }
 
-    SetupRasterization(pDestination, vertexArray, rDest, pClip, fClipLeft, fClipRight, nTopScanLine, nBottomScanLine);
+    return nWritten;
+}
+
+bool ZRasterizer::RasterizeMesh(ZBuffer* pDestination, const ZRect& rViewport, const tClipVertexArray& verts, const std::vector<uint32_t>& indices, ZBuffer* pTexture, eCullMode cull, ZRect* pClip)
+{
+    size_t nTriangles = indices.size() / 3;
+    if (nTriangles == 0)
+        return true;
 
-    // For each scanline
-    for (int64_t nScanLine = nTopScanLine; nScanLine < nBottomScanLine; nScanLine++)
+    if (pTexture && !pTexture->GetPixels())
     {
-        ZColorVertex scanLineMin;
-        ZColorVertex scanLineMax;
+        ZERROR("RasterizeMesh texture has no pixels\n");
+        return false;
+    }
 
-        double fScanLineLength;
-        double fA, fR, fG, fB;
-        double fDA, fDR, fDG, fDB;
+    ZRasterStats::ScopedCall call(nTriangles);
+    pDestination->MarkDirty();
 
-        SetupScanline((double)nScanLine, fClipLeft, fClipRight, scanLineMin, scanLineMax, vertexArray, fScanLineLength, fA, fR, fG, fB, fDA, fDR, fDG, fDB);
+    ZRect rDestArea(pDestination->GetArea());
+    ZRect rDest(rDestArea);
+    if (pClip)
+        rDest.Intersect(pClip);
+    if (rDest.Width() <= 0 || rDest.Height() <= 0 || rViewport.Width() <= 0 || rViewport.Height() <= 0)
+        return true;
 
-        // Rasterize the scanline using textureWalker as the source color
-        int64_t nStartX = (int64_t)scanLineMin.x;
-        int64_t nScanLinePixels = (int64_t)scanLineMax.x - (int64_t)scanLineMin.x;
-        uint32_t* pDestPixels = pDestination->GetPixels() + nScanLine * nDestStride + nStartX;
+    MeshTarget target;
+    target.pPixels = pDestination->GetPixels();
+    target.pDepth = pDestination->GetDepth();
+    target.nStride = rDestArea.Width();
+    ZASSERT(target.pPixels != nullptr);
+    if (!target.pDepth)
+    {
+        pDestination->ClearDepth();
+        target.pDepth = pDestination->GetDepth();
+    }
 
-        ZASSERT(nStartX + nScanLinePixels <= rDest.right);
+    MeshSetup setup;
+    setup.pVerts = verts.data();
+    setup.nVerts = verts.size();
+    setup.pIndices = indices.data();
+    setup.rClip = rDest;
+    setup.fViewLeft = (double)rViewport.left;
+    setup.fViewTop = (double)rViewport.top;
+    setup.fViewHalfW = rViewport.Width() / 2.0;
+    setup.fViewHalfH = rViewport.Height() / 2.0;
+    setup.fTextureW = 0.0;
+    setup.fTextureH = 0.0;
+    setup.cull = cull;
+
+    target.pTexels = nullptr;
+    if (pTexture)
+    {
+        target.pTexels = pTexture->GetPixels();
+        target.nTextureStride = pTexture->GetArea().Width();
+        target.nTextureMaxX = pTexture->GetArea().Width() - 1;
+        target.nTextureMaxY = pTexture->GetArea().Height() - 1;
+        setup.fTextureW = (double)pTexture->GetArea().Width();
+        setup.fTextureH = (double)pTexture->GetArea().Height();
+    }
 
-        for (int64_t nCount = 0; nCount < nScanLinePixels; nCount++)
+    // Jobs are handed out from a shared counter as in MultiSampleRasterizeWithAlpha
+    auto fanOut = [&](int64_t nJobs, int64_t nHelpers, auto&& job)
+    {
+        std::atomic<int64_t> nNextJob = 0;
+        auto worker = [&]()
+        {
+            for (int64_t nJob = nNextJob++; nJob < nJobs; nJob = nNextJob++)
+                job(nJob);
+        };
+
+        std::future<void> helpers[kMaxRasterHelpers];
+        for (int64_t i = 0; i < nHelpers; i++)
+            helpers[i] = renderPool.enqueue(worker);
+
+        worker();
+
+        for (int64_t i = 0; i < nHelpers; i++)
+            helpers[i].wait();
+    };
+
+    // Scratch is kept per calling thread so that a mesh drawn every frame doesn't reallocate. Helpers reach it through
+    // these references, since naming a thread_local on a helper would give the helper's own.
+    // Binned triangles are referenced as chunk << 16 | index within the chunk.
+    static thread_local MeshScratch localScratch;
+    std::vector<std::vector<MeshTriangle>>& chunks = localScratch.chunks;
+    std::vector<int64_t>& tileStart = localScratch.tileStart;
+    std::vector<int64_t>& tileFill = localScratch.tileFill;
+    std::vector<uint32_t>& tileTriangles = localScratch.tileTriangles;
+    std::vector<int64_t>& activeTiles = localScratch.activeTiles;
+
+    int64_t nChunks = ((int64_t)nTriangles + kMeshSetupChunk - 1) / kMeshSetupChunk;
+    ZASSERT(nChunks <= 0x10000 && kMeshSetupChunk * (kMeshClipVerts - 2) <= 0x10000);
+    if ((int64_t)chunks.size() < nChunks)
+        chunks.resize(nChunks);
+
+    int64_t nSetupHelpers = std::min<int64_t>({ (int64_t)renderPool.size(), kMaxRasterHelpers, nChunks - 1 });
+    fanOut(nChunks, nSetupHelpers, [&](int64_t nChunk)
+    {
+        std::vector<MeshTriangle>& out = chunks[nChunk];
+        out.clear();
+        size_t nEnd = std::min<size_t>(nTriangles, (nChunk + 1) * kMeshSetupChunk);
+        for (size_t nTri = nChunk * kMeshSetupChunk; nTri < nEnd; nTri++)
+            SetupMeshTriangle(setup, nTri, out);
+    });
+
+    // Counting sort into per tile lists, keeping submission order within each tile
+    int64_t nTilesX = (rDestArea.Width() + kMeshTileSize - 1) / kMeshTileSize;
+    int64_t nTilesY = (rDestArea.Height() + kMeshTileSize - 1) / kMeshTileSize;
+    tileStart.assign(nTilesX * nTilesY + 1, 0);
+    int64_t nWork = 0;
+    for (int64_t c = 0; c < nChunks; c++)
+    {
+        for (const MeshTriangle& tri : chunks[c])
         {
-            *pDestPixels = ARGB((uint32_t) fA, (uint32_t) fR, (uint32_t) fG, (uint32_t) fB);
-            pDestPixels++;
+            nWork += (int64_t)(tri.nRight - tri.nLeft) * (tri.nBottom - tri.nTop);
+            for (int64_t ty = (tri.nTop - rDestArea.top) / kMeshTileSize; ty <= (tri.nBottom - 1 - rDestArea.top) / kMeshTileSize; ty++)
+                for (int64_t tx = (tri.nLeft - rDestArea.left) / kMeshTileSize; tx <= (tri.nRight - 1 - rDestArea.left) / kMeshTileSize; tx++)
+                    tileStart[ty * nTilesX + tx + 1]++;
+        }
+    }
+
+    for (size_t t = 1; t < tileStart.size(); t++)
+        tileStart[t] += tileStart[t - 1];
 
-            fA += fDA;
-            fR += fDR;
-            fG += fDG;
-            fB += fDB;
+    tileTriangles.resize(tileStart.back());
+    tileFill.assign(tileStart.begin(), tileStart.end() - 1);
+    for (int64_t c = 0; c < nChunks; c++)
+    {
+        const std::vector<MeshTriangle>& tris = chunks[c];
+        for (size_t i = 0; i < tris.size(); i++)
+        {
+            const MeshTriangle& tri = tris[i];
+            for (int64_t ty = (tri.nTop - rDestArea.top) / kMeshTileSize; ty <= (tri.nBottom - 1 - rDestArea.top) / kMeshTileSize; ty++)
+                for (int64_t tx = (tri.nLeft - rDestArea.left) / kMeshTileSize; tx <= (tri.nRight - 1 - rDestArea.left) / kMeshTileSize; tx++)
+                    tileTriangles[tileFill[ty * nTilesX + tx]++] = (uint32_t)(c << 16 | (int64_t)i);
         }
+    }
 
-        mnDrawnPixels += nScanLinePixels;
+    activeTiles.clear();
+    for (int64_t t = 0; t < nTilesX * nTilesY; t++)
+    {
+        if (tileStart[t + 1] > tileStart[t])
+            activeTiles.push_back(t);
     }
 
-    mnProcessedVertices += vertexArray.size();
+    // Each tile owns its pixels and depths, so tiles need no locking
+    std::atomic<int64_t> nWritten = 0;
+    auto rasterizeTile = [&](int64_t nActive)
+    {
+        int64_t nTile = activeTiles[nActive];
+        int64_t nTileX = nTile % nTilesX;
+        int64_t nTileY = nTile / nTilesX;
+        ZRect rTile(rDestArea.left + nTileX * kMeshTileSize, rDestArea.top + nTileY * kMeshTileSize, 0, 0);
+        rTile.right = std::min<int64_t>(rTile.left + kMeshTileSize, rDestArea.right);
+        rTile.bottom = std::min<int64_t>(rTile.top + kMeshTileSize, rDestArea.bottom);
+
+        int64_t nDrawn = 0;
+        for (int64_t n = tileStart[nTile]; n < tileStart[nTile + 1]; n++)
+        {
+            uint32_t nRef = tileTriangles[n];
+            const MeshTriangle& tri = chunks[nRef >> 16][nRef & 0xffff];
+
+            ZRect rClip(tri.nLeft, tri.nTop, tri.nRight, tri.nBottom);
+            if (!rClip.Intersect(rTile) || rClip.Width() <= 0 || rClip.Height() <= 0)
+                continue;
+
+            double x[3] = { tri.x[0], tri.x[1], tri.x[2] };
+            double y[3] = { tri.y[0], tri.y[1], tri.y[2] };
+            if (target.pTexels)
+                RasterizeTriangle(x, y, rClip, [&](int64_t nY, int64_t nLeft, int64_t nRight) { nDrawn += MeshSpan<true>(tri, target, nY, nLeft, nRight); });
+            else
+                RasterizeTriangle(x, y, rClip, [&](int64_t nY, int64_t nLeft, int64_t nRight) { nDrawn += MeshSpan<false>(tri, target, nY, nLeft, nRight); });
+        }
+
+        nWritten += nDrawn;
+    };
+
+    int64_t nTiles = (int64_t)activeTiles.size();
+    int64_t nTileHelpers = 0;
+    if (nWork >= kMinTapsToThread)
+        nTileHelpers = std::min<int64_t>({ (int64_t)renderPool.size(), kMaxRasterHelpers, nTiles - 1 });
+
+    ZRasterStats::NoteThreads(std::max(nSetupHelpers, nTileHelpers) + 1);
+    fanOut(nTiles, nTileHelpers, rasterizeTile);
+
+    ZRasterStats::Add(ZRasterStats::kPixels, nWritten);
+    if (pTexture)
+        ZRasterStats::Add(ZRasterStats::kTexels, nWritten);
     return true;
 }
 
-bool ZRasterizer::RasterizeSimple(ZBuffer* pDestination, ZBuffer* pTexture, ZRect rDest, ZRect rSrc, ZRect* pClip)
+// ScaledBlt rows, specialized per filter and blend. The setup is built once per call.
+struct ScaledBltSetup
+{
+    const uint32_t*     pTexels;
+    int64_t             nTextureW;
+    uint32_t*           pDst;           // first pixel of output row 0
+    int64_t             nDestStride;
+    int64_t             nWidth;
+    uint32_t            nAlpha;
+    const ScaleAxis*    pCols;
+    const ScaleAxis*    pRows;
+};
+
+// Fills pOut with nCount samples of output row r starting at output column c
+template <ZRasterizer::eScaleFilter filter>
+static inline void SampleScaledSpan(const ScaledBltSetup& blt, int64_t r, int64_t c, int64_t nCount, uint32_t* pOut)
+{
+    const ScaleAxis& cols = *blt.pCols;
+    const ScaleAxis& rows = *blt.pRows;
+    int64_t nTextureW = blt.nTextureW;
+
+    if constexpr (filter == ZRasterizer::kScaleNearest)
+    {
+        const uint32_t* pRow = blt.pTexels + rows.first[r] * nTextureW;
+        const int32_t* pCol = &cols.first[c];
+        for (int64_t i = 0; i < nCount; i++)
+            pOut[i] = pRow[pCol[i]];
+    }
+    else if constexpr (filter == ZRasterizer::kScaleBilinear)
+    {
+        const uint32_t* pRow = blt.pTexels + rows.first[r] * nTextureW;
+        uint32_t nFracY = (uint32_t)rows.frac[r];
+        const int32_t* pCol = &cols.first[c];
+        const int32_t* pFrac = &cols.frac[c];
+
+        int64_t i = 0;
+        for (; i + 2 <= nCount; i += 2)
+            _mm_storel_epi64((__m128i*)(pOut + i), Bilerp2SSE2(pRow + pCol[i], pRow + pCol[i + 1], nTextureW, pFrac[i], nFracY, pFrac[i + 1], nFracY));
+        if (i < nCount)
+            pOut[i] = (uint32_t)_mm_cvtsi128_si32(Bilerp2SSE2(pRow + pCol[i], pRow + pCol[i], nTextureW, pFrac[i], nFracY, pFrac[i], nFracY));
+    }
+    else
+    {
+        const float* pWeightY = &rows.weights[rows.offset[r]];
+        for (int64_t i = 0; i < nCount; i++)
+        {
+            const float* pWeightX = &cols.weights[cols.offset[c + i]];
+            const uint32_t* pTap = blt.pTexels + rows.first[r] * nTextureW + cols.first[c + i];
+            int32_t nTapsX = cols.count[c + i];
+
+            // two accumulators per row so that consecutive taps don't wait on each other's adds
+            __m128 sum = _mm_setzero_ps();
+            for (int32_t y = 0; y < rows.count[r]; y++)
+            {
+                __m128 row0 = _mm_setzero_ps();
+                __m128 row1 = _mm_setzero_ps();
+                int32_t x = 0;
+                for (; x + 2 <= nTapsX; x += 2)
+                {
+                    row0 = _mm_add_ps(row0, _mm_mul_ps(TexelToFloats(pTap[x]), _mm_set1_ps(pWeightX[x])));
+                    row1 = _mm_add_ps(row1, _mm_mul_ps(TexelToFloats(pTap[x + 1]), _mm_set1_ps(pWeightX[x + 1])));
+                }
+                if (x < nTapsX)
+                    row0 = _mm_add_ps(row0, _mm_mul_ps(TexelToFloats(pTap[x]), _mm_set1_ps(pWeightX[x])));
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_add_ps(row0, row1), _mm_set1_ps(pWeightY[y])));
+                pTap += nTextureW;
+            }
+
+            __m128i n = _mm_cvtps_epi32(sum);
+            n = _mm_packs_epi32(n, n);
+            pOut[i] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(n, n));
+        }
+    }
+}
+
+template <ZRasterizer::eScaleFilter filter, eSpanBlend blend>
+static void BltScaledRows(const ScaledBltSetup& blt, int64_t nFirstRow, int64_t nEndRow)
+{
+    uint32_t texels[kSpanBlock];
+    for (int64_t r = nFirstRow; r < nEndRow; r++)
+    {
+        uint32_t* pDst = blt.pDst + r * blt.nDestStride;
+        for (int64_t c = 0; c < blt.nWidth; c += kSpanBlock)
+        {
+            int64_t nChunk = std::min<int64_t>(kSpanBlock, blt.nWidth - c);
+            SampleScaledSpan<filter>(blt, r, c, nChunk, texels);
+            WriteSpan<blend>(pDst + c, texels, nChunk, blt.nAlpha);
+        }
+    }
+}
+
+typedef void (*tScaledBltRowsFunc)(const ScaledBltSetup& blt, int64_t nFirstRow, int64_t nEndRow);
+
+static tScaledBltRowsFunc SelectScaledBltRows(ZRasterizer::eScaleFilter filter, eSpanBlend blend)
 {
-    tUVVertexArray verts;
-    gRasterizer.RectToVerts(rDest, verts);
+    static const tScaledBltRowsFunc funcs[3][2] =
+    {
+        { &BltScaledRows<ZRasterizer::kScaleNearest, kSpanCopy>,    &BltScaledRows<ZRasterizer::kScaleNearest, kSpanConstAlpha> },
+        { &BltScaledRows<ZRasterizer::kScaleBilinear, kSpanCopy>,   &BltScaledRows<ZRasterizer::kScaleBilinear, kSpanConstAlpha> },
+        { &BltScaledRows<ZRasterizer::kScaleArea, kSpanCopy>,       &BltScaledRows<ZRasterizer::kScaleArea, kSpanConstAlpha> }
+    };
+    return funcs[filter][blend];
+}
+
+bool ZRasterizer::ScaledBlt(ZBuffer* pDestination, ZBuffer* pTexture, const double* pDest, const double* pSrc, const ZRect& rClip, bool bBlend, uint8_t nAlpha, eScaleFilter filter)
+{
+    const uint32_t* pTexels = pTexture->GetPixels();
+    uint32_t* pDestPixels = pDestination->GetPixels();
+    if (!pTexels || !pDestPixels)
+        return false;
 
-    double w = (double)pTexture->GetArea().Width();
-    double h = (double)pTexture->GetArea().Height();
+    // First covered pixel is the first center at or right of the snapped edge: ceil((edge - half) / one)
+    const int64_t kHalf = kSubPixelOne / 2;
+    int64_t nLeft = std::max<int64_t>(rClip.left, (llround(pDest[0] * kSubPixelOne) - kHalf + kSubPixelOne - 1) >> kSubPixelBits);
+    int64_t nTop = std::max<int64_t>(rClip.top, (llround(pDest[1] * kSubPixelOne) - kHalf + kSubPixelOne - 1) >> kSubPixelBits);
+    int64_t nRight = std::min<int64_t>(rClip.right, (llround(pDest[2] * kSubPixelOne) - kHalf + kSubPixelOne - 1) >> kSubPixelBits);
+    int64_t nBottom = std::min<int64_t>(rClip.bottom, (llround(pDest[3] * kSubPixelOne) - kHalf + kSubPixelOne - 1) >> kSubPixelBits);
+    if (nLeft >= nRight || nTop >= nBottom || pDest[2] <= pDest[0] || pDest[3] <= pDest[1])
+        return true;
 
-    verts[0].u = (double)rSrc.left / w;
-    verts[0].v = (double)rSrc.top / h;
+    int64_t nTextureW = pTexture->GetArea().Width();
+    int64_t nTextureH = pTexture->GetArea().Height();
+    if (filter == kScaleBilinear && (nTextureW < 2 || nTextureH < 2))
+        filter = kScaleNearest;
+
+    int64_t nWidth = nRight - nLeft;
+    int64_t nRows = nBottom - nTop;
+    double fStepX = (pSrc[2] - pSrc[0]) / (pDest[2] - pDest[0]);
+    double fStepY = (pSrc[3] - pSrc[1]) / (pDest[3] - pDest[1]);
+
+    ScaleAxis cols;
+    ScaleAxis rows;
+    BuildScaleAxis(filter, pDest[0], pSrc[0], fStepX, nLeft, nWidth, nTextureW, cols);
+    BuildScaleAxis(filter, pDest[1], pSrc[1], fStepY, nTop, nRows, nTextureH, rows);
+
+    ScaledBltSetup blt;
+    blt.pTexels = pTexels;
+    blt.nTextureW = nTextureW;
+    blt.pDst = pDestPixels + nTop * pDestination->GetArea().Width() + nLeft;
+    blt.nDestStride = pDestination->GetArea().Width();
+    blt.nWidth = nWidth;
+    blt.nAlpha = nAlpha;
+    blt.pCols = &cols;
+    blt.pRows = &rows;
+    tScaledBltRowsFunc bltRows = SelectScaledBltRows(filter, bBlend ? kSpanConstAlpha : kSpanCopy);
+
+    int64_t nTapsPerPixel = 1;
+    if (filter == kScaleBilinear)
+        nTapsPerPixel = 4;
+    else if (filter == kScaleArea)
+        nTapsPerPixel = (int64_t)((ceil(fabs(fStepX)) + 1) * (ceil(fabs(fStepY)) + 1));
+    int64_t nWork = nWidth * nRows * nTapsPerPixel;
+
+    int64_t nHelpers = 0;
+    if (nWork >= kMinTapsToThread)
+        nHelpers = std::min<int64_t>((int64_t)renderPool.size(), kMaxRasterHelpers);
+
+    int64_t nBandRows = std::max<int64_t>(kMinBandRows, nRows / ((nHelpers + 1) * 4));
+    int64_t nBands = (nRows + nBandRows - 1) / nBandRows;
+    nHelpers = std::min<int64_t>(nHelpers, nBands - 1);
+    ZRasterStats::NoteThreads(nHelpers + 1);
+
+    std::atomic<int64_t> nNextBand = 0;
+    auto worker = [&]()
+    {
+        int64_t nBltRows = 0;
+        for (int64_t nBand = nNextBand++; nBand < nBands; nBand = nNextBand++)
+        {
+            int64_t nFirstRow = nBand * nBandRows;
+            int64_t nEndRow = std::min<int64_t>(nFirstRow + nBandRows, nRows);
+            bltRows(blt, nFirstRow, nEndRow);
+            nBltRows += nEndRow - nFirstRow;
+        }
+        ZRasterStats::Add(ZRasterStats::kPixels, nBltRows * nWidth);
+        ZRasterStats::Add(ZRasterStats::kTexels, nBltRows * nWidth * nTapsPerPixel);
+    };
 
-    verts[1].u = (double)rSrc.right / w;
-    verts[1].v = (double)rSrc.top /h;
+    std::future<void> helpers[kMaxRasterHelpers];
+    for (int64_t i = 0; i < nHelpers; i++)
+        helpers[i] = renderPool.enqueue(worker);
 
-    verts[2].u = (double)rSrc.right / w;
-    verts[2].v = (double)rSrc.bottom / h;
+    worker();
 
-    verts[3].u = (double)rSrc.left / w;
-    verts[3].v = (double)rSrc.bottom / h;
+    for (int64_t i = 0; i < nHelpers; i++)
+        helpers[i].wait();
 
-    return gRasterizer.Rasterize(pDestination, pTexture, verts, pClip);
+    return true;
 }
 
-bool ZRasterizer::RasterizeWithAlphaSimple(ZBuffer* pDestination, ZBuffer* pTexture, ZRect rDest, ZRect rSrc, ZRect* pClip, uint8_t nAlpha)
+bool ZRasterizer::RasterizeSimple(ZBuffer* pDestination, ZBuffer* pTexture, ZRect rDest, ZRect rSrc, ZRect* pClip, eScaleFilter filter)
 {
-    tUVVertexArray verts;
-    gRasterizer.RectToVerts(rDest, verts);
+    ZRasterStats::ScopedCall call(1);
+    pDestination->MarkDirty();
 
-    double w = (double)pTexture->GetArea().Width();
-    double h = (double)pTexture->GetArea().Height();
+    ZRect rClip(pDestination->GetArea());
+    if (pClip)
+        rClip.Intersect(pClip);
 
-    verts[0].u = (double)rSrc.left / w;
-    verts[0].v = (double)rSrc.top / h;
+    double dest[4] = { (double)rDest.left, (double)rDest.top, (double)rDest.right, (double)rDest.bottom };
+    double src[4] = { (double)rSrc.left, (double)rSrc.top, (double)rSrc.right, (double)rSrc.bottom };
+    return ScaledBlt(pDestination, pTexture, dest, src, rClip, false, 255, filter);
+}
 
-    verts[1].u = (double)rSrc.right / w;
-    verts[1].v = (double)rSrc.top / h;
+bool ZRasterizer::RasterizeWithAlphaSimple(ZBuffer* pDestination, ZBuffer* pTexture, ZRect rDest, ZRect rSrc, ZRect* pClip, uint8_t nAlpha, eScaleFilter filter)
+{
+    if (nAlpha < 8)
+        return true;
 
-    verts[2].u = (double)rSrc.right / w;
-    verts[2].v = (double)rSrc.bottom / h;
+    ZRasterStats::ScopedCall call(1);
+    pDestination->MarkDirty();
 
-    verts[3].u = (double)rSrc.left / w;
-    verts[3].v = (double)rSrc.bottom / h;
+    ZRect rClip(pDestination->GetArea());
+    if (pClip)
+        rClip.Intersect(pClip);
 
-    return gRasterizer.RasterizeWithAlpha(pDestination, pTexture, verts, pClip, nAlpha);
+    double dest[4] = { (double)rDest.left, (double)rDest.top, (double)rDest.right, (double)rDest.bottom };
+    double src[4] = { (double)rSrc.left, (double)rSrc.top, (double)rSrc.right, (double)rSrc.bottom };
+    return ScaledBlt(pDestination, pTexture, dest, src, rClip, true, nAlpha, filter);
 }
 
 
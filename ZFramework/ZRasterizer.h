@@ -10,15 +10,98 @@
 class ZRasterizer
 {
 public:
-	bool    Rasterize(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip = NULL);
-    bool    Rasterize(ZBuffer* pDestination, tColorVertexArray& vertexArray, ZRect* pClip = NULL);
+    // How MultiSampleRasterizeWithAlpha samples a texture that is drawn smaller than its native size
+    enum eMinification : uint32_t
+    {
+        kMinSupersample         = 0,        // nSubsamples x nSubsamples point samples per pixel
+        kMinMipmap              = 1,        // bilinear from the nearest mip level
+        kMinMipmapTrilinear     = 2         // bilinear from the two nearest mip levels, blended by the fractional level
+    };
+
+    // How MultiSampleRasterizeWithAlpha samples a texture that is drawn larger than its native size
+    enum eMagnification : uint32_t
+    {
+        kMagSupersample         = 0,        // nSubsamples x nSubsamples point samples per pixel
+        kMagBilinear            = 1,        // 2x2 texels, fixed point weights
+        kMagBicubic             = 2         // 4x4 texels, Catmull-Rom weights
+    };
+
+    // How RasterizeSimple / RasterizeWithAlphaSimple sample the source rectangle
+    enum eScaleFilter : uint32_t
+    {
+        kScaleNearest           = 0,        // same texels the polygon path picks
+        kScaleBilinear          = 1,        // 2x2 texels, fixed point weights
+        kScaleArea              = 2         // average of the covered texels, for reductions
+    };
+
+    // How Rasterize / RasterizeWithAlpha / RasterizeBatch treat polygon outlines
+    enum eEdgeMode : uint32_t
+    {
+        kEdgeAliased            = 0,        // pixels whose centers are inside
+        kEdgeAntiAlias          = 1         // outline pixels weighted by 16 sample coverage, interiors shaded once
+    };
+
+	bool    Rasterize(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip = NULL, eEdgeMode edges = kEdgeAliased);
+    bool    Rasterize(ZBuffer* pDestination, tColorVertexArray& vertexArray, ZRect* pClip = NULL, eEdgeMode edges = kEdgeAliased);
    
-    bool    RasterizeWithAlpha(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip = NULL, uint8_t nAlpha = 255);
-    bool    MultiSampleRasterizeWithAlpha(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip, uint32_t nSubsamples, uint8_t nAlpha = 255);
+    bool    RasterizeWithAlpha(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip = NULL, uint8_t nAlpha = 255, eEdgeMode edges = kEdgeAliased);
+    bool    MultiSampleRasterizeWithAlpha(ZBuffer* pDestination, ZBuffer* pTexture, tUVVertexArray& vertexArray, ZRect* pClip, uint32_t nSubsamples, uint8_t nAlpha = 255, eMinification minification = kMinMipmapTrilinear, eMagnification magnification = kMagBilinear);
+
+    // One textured quad of a RasterizeBatch call
+    struct BatchQuad
+    {
+        BatchQuad() : pTexture(nullptr), nAlpha(255), bBlend(false), edges(kEdgeAliased) {}
+        BatchQuad(ZBuffer* _pTexture, const tUVVertexArray& _verts, const ZRect& _rClip, uint8_t _nAlpha = 255, bool _bBlend = false, eEdgeMode _edges = kEdgeAliased) : pTexture(_pTexture), rClip(_rClip), nAlpha(_nAlpha), bBlend(_bBlend), edges(_edges)
+        {
+            ZASSERT(_verts.size() == 4);
+            for (int i = 0; i < 4; i++)
+                verts[i] = _verts[i];
+        }
+
+        ZBuffer*    pTexture;
+        ZUVVertex   verts[4];
+        ZRect       rClip;
+        uint8_t     nAlpha;
+        bool        bBlend;         // false copies color like Rasterize, true blends at nAlpha like RasterizeWithAlpha
+        eEdgeMode   edges;
+    };
+    typedef std::vector<BatchQuad> tBatchQuads;
+
+    // Draws many quads in one pass. Quads are binned into screen tiles that are rasterized in parallel. Within a tile
+    // quads draw in submission order, or grouped by texture when none of them overlap there.
+    bool    RasterizeBatch(ZBuffer* pDestination, const tBatchQuads& quads);
+
+    // Which triangles RasterizeMesh drops by their winding as seen on the destination (y down)
+    enum eCullMode : uint32_t
+    {
+        kCullNone               = 0,
+        kCullClockwise          = 1,
+        kCullCounterClockwise   = 2
+    };
+
+    // One RasterizeMesh vertex in clip space, as a row vector times a projection matrix gives it.
+    // Visible points have -w <= x,y <= w and 0 <= z <= w.
+    struct ClipVertex
+    {
+        float       x;
+        float       y;
+        float       z;
+        float       w;
+        float       u;          // 0.0-1.0 across the texture
+        float       v;
+        uint32_t    mColor;     // used when there is no texture
+    };
+    typedef std::vector<ClipVertex> tClipVertexArray;
+
+    // Depth buffered triangles, three indices each. Triangles are culled against the frustum and by winding, clipped at the
+    // near plane, and x,y in -1..1 map to rViewport with +y up. Depth z/w is tested against the destination's depth plane
+    // (see ZBuffer::ClearDepth) and u,v or colors are interpolated perspective correct. Setup runs in parallel chunks and
+    // triangles are binned into screen tiles that rasterize in parallel like RasterizeBatch.
+    bool    RasterizeMesh(ZBuffer* pDestination, const ZRect& rViewport, const tClipVertexArray& verts, const std::vector<uint32_t>& indices, ZBuffer* pTexture = nullptr, eCullMode cull = kCullCounterClockwise, ZRect* pClip = nullptr);
 
     // helper functions
-    bool    RasterizeSimple(ZBuffer* pDestination, ZBuffer* pTexture, ZRect rDest, ZRect rSrc, ZRect* pClip = NULL);
-    bool    RasterizeWithAlphaSimple(ZBuffer* pDestination, ZBuffer* pTexture, ZRect rDest, ZRect rSrc, ZRect* pClip = NULL, uint8_t nAlpha = 255);
+    bool    RasterizeSimple(ZBuffer* pDestination, ZBuffer* pTexture, ZRect rDest, ZRect rSrc, ZRect* pClip = NULL, eScaleFilter filter = kScaleNearest);
+    bool    RasterizeWithAlphaSimple(ZBuffer* pDestination, ZBuffer* pTexture, ZRect rDest, ZRect rSrc, ZRect* pClip = NULL, uint8_t nAlpha = 255, eScaleFilter filter = kScaleNearest);
     ZRect   GetBoundingRect(tUVVertexArray& vertexArray);
     void    RectToVerts(const ZRect& r, tUVVertexArray& vertexArray);     // returns the default vertex array with LTRB and UVs at 0.0-1.0
     void    RectToVerts(const ZRect& r, tColorVertexArray& vertexArray);     // returns the default vertex array with LTRB
@@ -26,31 +109,63 @@ public:
     static uint32_t SampleTexture_ZoomedIn(ZBuffer* pTexture, double fTexturePixelU, double fTexturePixelV, double fTexturePixelDU, double fTexturePixelDV, uint32_t nSampleSubdivisions);
     static uint32_t SampleTexture_ZoomedOut(ZBuffer* pTexture, double fTexturePixelU, double fTexturePixelV, double fTexturePixelDU, double fTexturePixelDV, uint32_t nSampleSubdivisions);
 private:
+    // MultiSampleRasterizeWithAlpha fan out
+    static const int64_t kMinTapsToThread   = 256 * 256 * 4;    // about a 256x256 bilinear quad
+    static const int64_t kMinBandRows       = 8;
+    static const int64_t kMaxRasterHelpers  = 64;
+
+    // RasterizeBatch binning
+    static const int64_t kBatchTileSize     = 128;
+    static const int64_t kMaxSortedPerTile  = 32;       // tiles with more quads than this keep submission order
+
+    // RasterizeMesh
+    static const int64_t kMeshTileSize      = 64;
+    static const int64_t kMeshSetupChunk    = 4096;     // triangles per setup job
+
+    struct MipLevel
+    {
+        const uint32_t* pPixels;
+        int64_t         nWidth;
+        int64_t         nHeight;
+    };
+    typedef std::vector<MipLevel> tMipLevels;
+
     // UV
 
     static bool    FindScanlineIntersection(double fScanY, ZUVVertex& v1, ZUVVertex& v2, ZUVVertex& vIntersection);
     static void    SetupRasterization(ZBuffer* pDestination, tUVVertexArray& vertexArray, ZRect& rDest, ZRect* pClip, double& fClipLeft, double& fClipRight, int64_t& nTopScanline, int64_t& nBottomScanline);
     static void    SetupScanline(double fScanLine, double& fClipLeft, double& fClipRight, ZUVVertex& scanLineMin, ZUVVertex& scanLineMax, tUVVertexArray& vertexArray, double& fScanLineLength, double& fTextureU, double& fTextureV, double& fTextureDX, double& fTextureDV);
 
-    // Color
-    bool    FindScanlineIntersection(double fScanY, ZColorVertex& v1, ZColorVertex& v2, ZColorVertex& vIntersection);
-    void    SetupRasterization(ZBuffer* pDestination, tColorVertexArray& vertexArray, ZRect& rDest, ZRect* pClip, double& fClipLeft, double& fClipRight, int64_t& nTopScanline, int64_t& nBottomScanline);
-    void    SetupScanline(double fScanLine, double& fClipLeft, double& fClipRight, ZColorVertex& scanLineMin, ZColorVertex& scanLineMax, tColorVertexArray& vertexArray, double& fScanLineLength, double& fA, double& fR, double& fG, double& fB, double& fDA, double& fDR, double& fDG, double& fDB);
+    // How MultiSampleRasterizeRange samples, picked once per call from the zoom and the filter settings
+    enum eSpanSampler : uint32_t
+    {
+        kSampleSuperIn          = 0,        // SampleTexture_ZoomedIn
+        kSampleSuperOut         = 1,        // SampleTexture_ZoomedOut
+        kSampleMip              = 2,        // bilinear from the nearest mip level
+        kSampleMipTrilinear     = 3,
+        kSampleBilinear         = 4,        // SampleSpanBilinear
+        kSampleBicubic          = 5,        // SampleSpanBicubic
+        kSamplerCount           = 6
+    };
 
-    static bool MultiSampleRasterizeRange(ZBuffer* pTexture, ZBuffer* pDestination, int64_t nTop, int64_t nBottom, double fClipLeft, double fClipRight, tUVVertexArray& vertexArray, bool isZoomedIn, uint32_t nSubsamples, uint8_t nAlpha);
+    // returns the pixels drawn
+    template <eSpanSampler sampler>
+    static int64_t MultiSampleRasterizeRange(ZBuffer* pTexture, ZBuffer* pDestination, int64_t nTop, int64_t nBottom, double fClipLeft, double fClipRight, tUVVertexArray& vertexArray, uint32_t nSubsamples, uint8_t nAlpha, const tMipLevels* pMips);
+    typedef int64_t (*tRasterizeRangeFunc)(ZBuffer* pTexture, ZBuffer* pDestination, int64_t nTop, int64_t nBottom, double fClipLeft, double fClipRight, tUVVertexArray& vertexArray, uint32_t nSubsamples, uint8_t nAlpha, const tMipLevels* pMips);
+    static uint32_t SampleMipLevel(const MipLevel& level, double fTextureU, double fTextureV);
 
+    // Fill pOut with nCount filtered samples starting at texel nU,nV and stepping nDU,nDV (16.16, texel centers on integers)
+    static void     SampleSpanBilinear(const MipLevel& level, int64_t nU, int64_t nV, int64_t nDU, int64_t nDV, int64_t nCount, uint32_t* pOut);
+    static void     SampleSpanBicubic(const MipLevel& level, int64_t nU, int64_t nV, int64_t nDU, int64_t nDV, int64_t nCount, uint32_t* pOut);
 
-public:
-
-	static uint64_t	mnProcessedVertices;	// for debugging
-	static uint64_t	mnDrawnPixels;
-	static uint64_t	mnTimeStamp;
-
-	static uint64_t	mnPeakProcessedVertices;
-	static uint64_t	mnPeakDrawnPixels;
+    // Axis aligned scaled blt behind the Simple helpers and unrotated Rasterize / RasterizeWithAlpha quads.
+    // pDest is LTRB in destination pixels, pSrc the texel coordinates at those edges (src right < left mirrors).
+    bool    ScaledBlt(ZBuffer* pDestination, ZBuffer* pTexture, const double* pDest, const double* pSrc, const ZRect& rClip, bool bBlend, uint8_t nAlpha, eScaleFilter filter);
 
 
+public:
     ThreadPool  renderPool;
+    bool        mbAxisAlignedBlt = true;     // unrotated quads take ScaledBlt. Off to time or compare against the polygon path.
 };
 
 extern ZRasterizer gRasterizer;
\ No newline at end of file
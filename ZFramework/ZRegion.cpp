@@ -0,0 +1,362 @@
+#include "ZRegion.h"
+#include <algorithm>
+
+#ifdef _DEBUG
+#define new new(_NORMAL_BLOCK, THIS_FILE, __LINE__)
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using namespace std;
+
+static const size_t kNoBand = (size_t)-1;
+
+inline const ZRect* BandEnd(const ZRect* p, const ZRect* pEnd)
+{
+    const ZRect* q = p;
+    while (q < pEnd && q->top == p->top)
+        q++;
+    return q;
+}
+
+void ZRegion::Set(const ZRect& r)
+{
+    mRects.clear();
+    mBounds = ZRect();
+    if (r.Width() > 0 && r.Height() > 0)
+    {
+        mRects.push_back(r);
+        mBounds = r;
+    }
+}
+
+int64_t ZRegion::Area() const
+{
+    int64_t nArea = 0;
+    for (const ZRect& r : mRects)
+        nArea += r.Width() * r.Height();
+    return nArea;
+}
+
+void ZRegion::Union(const ZRegion& rhs)
+{
+    if (&rhs == this)
+        return;
+    Combine(rhs.mRects.data(), rhs.mRects.data() + rhs.mRects.size(), rhs.mBounds, kUnion);
+}
+
+void ZRegion::Union(const ZRect& r)
+{
+    ZRect rCopy(r);     // r may be one of our own rects
+    bool bEmpty = rCopy.Width() <= 0 || rCopy.Height() <= 0;
+    Combine(&rCopy, bEmpty ? &rCopy : &rCopy + 1, rCopy, kUnion);
+}
+
+void ZRegion::Subtract(const ZRegion& rhs)
+{
+    if (&rhs == this)
+    {
+        Clear();
+        return;
+    }
+    Combine(rhs.mRects.data(), rhs.mRects.data() + rhs.mRects.size(), rhs.mBounds, kSubtract);
+}
+
+void ZRegion::Subtract(const ZRect& r)
+{
+    ZRect rCopy(r);     // r may be one of our own rects
+    bool bEmpty = rCopy.Width() <= 0 || rCopy.Height() <= 0;
+    Combine(&rCopy, bEmpty ? &rCopy : &rCopy + 1, rCopy, kSubtract);
+}
+
+void ZRegion::Intersect(const ZRegion& rhs)
+{
+    if (&rhs == this)
+        return;
+    Combine(rhs.mRects.data(), rhs.mRects.data() + rhs.mRects.size(), rhs.mBounds, kIntersect);
+}
+
+void ZRegion::Intersect(const ZRect& r)
+{
+    ZRect rCopy(r);     // r may be one of our own rects
+    bool bEmpty = rCopy.Width() <= 0 || rCopy.Height() <= 0;
+    Combine(&rCopy, bEmpty ? &rCopy : &rCopy + 1, rCopy, kIntersect);
+}
+
+// Copies the spans of one band clipped to nTop-nBottom
+void ZRegion::AppendBand(const ZRect* pFirst, const ZRect* pEnd, int64_t nTop, int64_t nBottom)
+{
+    for (const ZRect* p = pFirst; p < pEnd; p++)
+        mScratch.emplace_back(p->left, nTop, p->right, nBottom);
+}
+
+// Spans where a band of each operand shares rows
+void ZRegion::OverlapBand(const ZRect* pA, const ZRect* pAEnd, const ZRect* pB, const ZRect* pBEnd, int64_t nTop, int64_t nBottom, eOp op)
+{
+    if (op == kUnion)
+    {
+        // merge by left edge, joining spans that overlap or touch
+        int64_t nLeft = 0;
+        int64_t nRight = 0;
+        bool bOpen = false;
+        while (pA < pAEnd || pB < pBEnd)
+        {
+            const ZRect* pNext;
+            if (pB >= pBEnd || (pA < pAEnd && pA->left <= pB->left))
+                pNext = pA++;
+            else
+                pNext = pB++;
+
+            if (bOpen && pNext->left <= nRight)
+            {
+                nRight = std::max<int64_t>(nRight, pNext->right);
+                continue;
+            }
+            if (bOpen)
+                mScratch.emplace_back(nLeft, nTop, nRight, nBottom);
+            nLeft = pNext->left;
+            nRight = pNext->right;
+            bOpen = true;
+        }
+        if (bOpen)
+            mScratch.emplace_back(nLeft, nTop, nRight, nBottom);
+    }
+    else if (op == kIntersect)
+    {
+        while (pA < pAEnd && pB < pBEnd)
+        {
+            int64_t nLeft = std::max<int64_t>(pA->left, pB->left);
+            int64_t nRight = std::min<int64_t>(pA->right, pB->right);
+            if (nLeft < nRight)
+                mScratch.emplace_back(nLeft, nTop, nRight, nBottom);
+
+            if (pA->right < pB->right)
+                pA++;
+            else if (pB->right < pA->right)
+                pB++;
+            else
+            {
+                pA++;
+                pB++;
+            }
+        }
+    }
+    else
+    {
+        // B spans only move forward, one can cut several A spans
+        for (; pA < pAEnd; pA++)
+        {
+            int64_t nLeft = pA->left;
+            while (pB < pBEnd && pB->right <= nLeft)
+                pB++;
+
+            const ZRect* pCut = pB;
+            while (pCut < pBEnd && pCut->left < pA->right)
+            {
+                if (pCut->left > nLeft)
+                    mScratch.emplace_back(nLeft, nTop, pCut->left, nBottom);
+                nLeft = std::max<int64_t>(nLeft, pCut->right);
+                if (pCut->right >= pA->right)
+                    break;
+                pCut++;
+            }
+
+            if (nLeft < pA->right)
+                mScratch.emplace_back(nLeft, nTop, pA->right, nBottom);
+        }
+    }
+}
+
+// Folds the band starting at nCurBand into the previous one when it continues it with the same spans
+void ZRegion::Coalesce(size_t& nPrevBand, size_t nCurBand)
+{
+    size_t nEnd = mScratch.size();
+    if (nCurBand == nEnd)
+        return;     // nothing was added
+
+    if (nPrevBand != kNoBand)
+    {
+        size_t nCount = nCurBand - nPrevBand;
+        if (nCount == nEnd - nCurBand && mScratch[nPrevBand].bottom == mScratch[nCurBand].top)
+        {
+            bool bSame = true;
+            for (size_t i = 0; i < nCount && bSame; i++)
+                bSame = mScratch[nPrevBand + i].left == mScratch[nCurBand + i].left && mScratch[nPrevBand + i].right == mScratch[nCurBand + i].right;
+
+            if (bSame)
+            {
+                int64_t nBottom = mScratch[nCurBand].bottom;
+                for (size_t i = nPrevBand; i < nCurBand; i++)
+                    mScratch[i].bottom = nBottom;
+                mScratch.resize(nCurBand);
+                return;
+            }
+        }
+    }
+
+    nPrevBand = nCurBand;
+}
+
+void ZRegion::Combine(const ZRect* pB, const ZRect* pBEnd, const ZRect& rBBounds, eOp op)
+{
+    const ZRect* pA = mRects.data();
+    const ZRect* pAEnd = pA + mRects.size();
+
+    // Cases that need no sweep
+    bool bAEmpty = pA == pAEnd;
+    bool bBEmpty = pB == pBEnd;
+    bool bOverlap = !bAEmpty && !bBEmpty && mBounds.Overlaps(rBBounds);
+    if (op == kIntersect && !bOverlap)
+    {
+        Clear();
+        return;
+    }
+    if (op == kSubtract && !bOverlap)
+        return;
+    if (op == kUnion)
+    {
+        if (bBEmpty)
+            return;
+        if (bAEmpty || (pBEnd - pB == 1 && rBBounds.left <= mBounds.left && rBBounds.top <= mBounds.top && rBBounds.right >= mBounds.right && rBBounds.bottom >= mBounds.bottom))
+        {
+            mRects.assign(pB, pBEnd);
+            mBounds = rBBounds;
+            return;
+        }
+        if (mRects.size() == 1 && mBounds.left <= rBBounds.left && mBounds.top <= rBBounds.top && mBounds.right >= rBBounds.right && mBounds.bottom >= rBBounds.bottom)
+            return;
+    }
+
+    // Only B's bands within A's rows matter to subtract and intersect. Band tops and bottoms both increase down the list.
+    if (op != kUnion)
+    {
+        int64_t nTop = mBounds.top;
+        int64_t nBottom = mBounds.bottom;
+        pB = std::partition_point(pB, pBEnd, [nTop](const ZRect& r) { return r.bottom <= nTop; });
+        pBEnd = std::partition_point(pB, pBEnd, [nBottom](const ZRect& r) { return r.top < nBottom; });
+    }
+    if (op == kIntersect)
+    {
+        int64_t nTop = rBBounds.top;
+        int64_t nBottom = rBBounds.bottom;
+        pA = std::partition_point(pA, pAEnd, [nTop](const ZRect& r) { return r.bottom <= nTop; });
+        pAEnd = std::partition_point(pA, pAEnd, [nBottom](const ZRect& r) { return r.top < nBottom; });
+    }
+
+    bool bAppendA = op != kIntersect;
+    bool bAppendB = op == kUnion;
+
+    mScratch.clear();
+    size_t nPrevBand = kNoBand;
+
+    if (pA < pAEnd && pB < pBEnd)
+    {
+        // Sweep down both band lists. nBandBottom is how far the output has been built.
+        int64_t nBandBottom = std::min<int64_t>(pA->top, pB->top);
+        do
+        {
+            const ZRect* pABandEnd = BandEnd(pA, pAEnd);
+            const ZRect* pBBandEnd = BandEnd(pB, pBEnd);
+            int64_t nTop;
+
+            // rows only one of them covers
+            if (pA->top < pB->top)
+            {
+                if (bAppendA)
+                {
+                    int64_t nOnlyTop = std::max<int64_t>(pA->top, nBandBottom);
+                    int64_t nOnlyBottom = std::min<int64_t>(pA->bottom, pB->top);
+                    if (nOnlyTop < nOnlyBottom)
+                    {
+                        size_t nCurBand = mScratch.size();
+                        AppendBand(pA, pABandEnd, nOnlyTop, nOnlyBottom);
+                        Coalesce(nPrevBand, nCurBand);
+                    }
+                }
+                nTop = pB->top;
+            }
+            else if (pB->top < pA->top)
+            {
+                if (bAppendB)
+                {
+                    int64_t nOnlyTop = std::max<int64_t>(pB->top, nBandBottom);
+                    int64_t nOnlyBottom = std::min<int64_t>(pB->bottom, pA->top);
+                    if (nOnlyTop < nOnlyBottom)
+                    {
+                        size_t nCurBand = mScratch.size();
+                        AppendBand(pB, pBBandEnd, nOnlyTop, nOnlyBottom);
+                        Coalesce(nPrevBand, nCurBand);
+                    }
+                }
+                nTop = pA->top;
+            }
+            else
+            {
+                nTop = pA->top;
+            }
+
+            // rows both cover
+            nBandBottom = std::min<int64_t>(pA->bottom, pB->bottom);
+            if (nBandBottom > nTop)
+            {
+                size_t nCurBand = mScratch.size();
+                OverlapBand(pA, pABandEnd, pB, pBBandEnd, nTop, nBandBottom, op);
+                Coalesce(nPrevBand, nCurBand);
+            }
+
+            if (pA->bottom == nBandBottom)
+                pA = pABandEnd;
+            if (pB->bottom == nBandBottom)
+                pB = pBBandEnd;
+        } while (pA < pAEnd && pB < pBEnd);
+
+        // what's left of a band the sweep stopped inside
+        if (pA < pAEnd && bAppendA)
+        {
+            const ZRect* pABandEnd = BandEnd(pA, pAEnd);
+            size_t nCurBand = mScratch.size();
+            AppendBand(pA, pABandEnd, std::max<int64_t>(pA->top, nBandBottom), pA->bottom);
+            Coalesce(nPrevBand, nCurBand);
+            pA = pABandEnd;
+        }
+        else if (pB < pBEnd && bAppendB)
+        {
+            const ZRect* pBBandEnd = BandEnd(pB, pBEnd);
+            size_t nCurBand = mScratch.size();
+            AppendBand(pB, pBBandEnd, std::max<int64_t>(pB->top, nBandBottom), pB->bottom);
+            Coalesce(nPrevBand, nCurBand);
+            pB = pBBandEnd;
+        }
+    }
+
+    // remaining whole bands, only the first can continue the last band written
+    if (pA < pAEnd && bAppendA)
+    {
+        const ZRect* pABandEnd = BandEnd(pA, pAEnd);
+        size_t nCurBand = mScratch.size();
+        AppendBand(pA, pABandEnd, pA->top, pA->bottom);
+        Coalesce(nPrevBand, nCurBand);
+        mScratch.insert(mScratch.end(), pABandEnd, pAEnd);
+    }
+    else if (pB < pBEnd && bAppendB)
+    {
+        const ZRect* pBBandEnd = BandEnd(pB, pBEnd);
+        size_t nCurBand = mScratch.size();
+        AppendBand(pB, pBBandEnd, pB->top, pB->bottom);
+        Coalesce(nPrevBand, nCurBand);
+        mScratch.insert(mScratch.end(), pBBandEnd, pBEnd);
+    }
+
+    mRects.swap(mScratch);
+
+    mBounds = ZRect();
+    if (!mRects.empty())
+    {
+        mBounds.Set(mRects.front().left, mRects.front().top, mRects.front().right, mRects.back().bottom);
+        for (const ZRect& r : mRects)
+        {
+            mBounds.left = std::min<int64_t>(mBounds.left, r.left);
+            mBounds.right = std::max<int64_t>(mBounds.right, r.right);
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ZTypes.h"
+#include <vector>
+
+// Set of pixels as y-x banded rectangles, the X11 region representation.
+// Rects are sorted by top then left. Rects in one band share top and bottom and neither overlap nor touch, and vertically
+// adjacent bands with identical spans are merged into one. Operations sweep both operands' bands once, so their cost is
+// linear in the rects involved, and results reuse the region's storage.
+
+class ZRegion
+{
+public:
+    ZRegion() {}
+    ZRegion(const ZRect& r) { Set(r); }
+
+    void                        Clear() { mRects.clear(); mBounds = ZRect(); }
+    void                        Set(const ZRect& r);
+
+    bool                        IsEmpty() const { return mRects.empty(); }
+    const ZRect&                GetBounds() const { return mBounds; }
+    const std::vector<ZRect>&   GetRects() const { return mRects; }
+    int64_t                     Area() const;
+
+    void                        Union(const ZRegion& rhs);
+    void                        Union(const ZRect& r);
+    void                        Subtract(const ZRegion& rhs);
+    void                        Subtract(const ZRect& r);
+    void                        Intersect(const ZRegion& rhs);
+    void                        Intersect(const ZRect& r);
+
+private:
+    enum eOp : uint32_t
+    {
+        kUnion      = 0,
+        kSubtract   = 1,
+        kIntersect  = 2
+    };
+
+    void                        Combine(const ZRect* pB, const ZRect* pBEnd, const ZRect& rBBounds, eOp op);
+
+    // band helpers writing to mScratch
+    void                        AppendBand(const ZRect* pFirst, const ZRect* pEnd, int64_t nTop, int64_t nBottom);
+    void                        OverlapBand(const ZRect* pA, const ZRect* pAEnd, const ZRect* pB, const ZRect* pBEnd, int64_t nTop, int64_t nBottom, eOp op);
+    void                        Coalesce(size_t& nPrevBand, size_t nCurBand);
+
+    std::vector<ZRect>          mRects;
+    ZRect                       mBounds;
+    std::vector<ZRect>          mScratch;       // result under construction, swapped into mRects
+};
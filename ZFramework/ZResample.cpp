@@ -0,0 +1,334 @@
+#include "ZResample.h"
+#include "ZColor.h"
+#include <vector>
+#include <future>
+#include <functional>
+#include <math.h>
+#include <string.h>
+#include <emmintrin.h>
+
+#ifdef _DEBUG
+#define new new(_NORMAL_BLOCK, THIS_FILE, __LINE__)
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+namespace ZResample
+{
+    const int32_t kWeightShift  = 14;
+    const int32_t kWeightOne    = 1 << kWeightShift;
+    const int32_t kWeightHalf   = kWeightOne >> 1;
+
+    // For each destination index, the range of source indices and their weights
+    struct WeightTable
+    {
+        std::vector<int64_t>    first;
+        std::vector<int64_t>    count;
+        std::vector<int16_t>    weights;        // nMaxTaps per destination index
+        int64_t                 nMaxTaps = 0;
+
+        const int16_t* Weights(int64_t i) const { return weights.data() + i * nMaxTaps; }
+    };
+
+
+    static double Bicubic(double x)
+    {
+        const double a = -0.5;
+        x = fabs(x);
+        if (x < 1.0)
+            return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+        if (x < 2.0)
+            return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+        return 0.0;
+    }
+
+    static double Sinc(double x)
+    {
+        if (x == 0.0)
+            return 1.0;
+        x *= 3.14159265358979323846;
+        return sin(x) / x;
+    }
+
+    static double Lanczos3(double x)
+    {
+        if (x > -3.0 && x < 3.0)
+            return Sinc(x) * Sinc(x / 3.0);
+        return 0.0;
+    }
+
+    static eFilter ChooseFilter(eFilter filter, double fScale)
+    {
+        if (filter != kAuto)
+            return filter;
+        if (fScale >= kAreaMinReduction)
+            return kArea;
+        if (fScale > 1.0)
+            return kLanczos3;
+        return kBicubic;
+    }
+
+    static void BuildWeights(WeightTable& table, int64_t nSrc, int64_t nDst, eFilter filter)
+    {
+        double fScale = (double)nSrc / (double)nDst;
+        filter = ChooseFilter(filter, fScale);
+
+        double fFilterScale = std::max<double>(fScale, 1.0);       // stretch the kernel when reducing
+        double fSupport;
+        if (filter == kArea)
+            fSupport = fScale * 0.5 + 1.0;
+        else if (filter == kBicubic)
+            fSupport = 2.0 * fFilterScale;
+        else
+            fSupport = 3.0 * fFilterScale;
+
+        table.nMaxTaps = (int64_t)ceil(fSupport) * 2 + 1;
+        table.first.resize(nDst);
+        table.count.resize(nDst);
+        table.weights.assign(nDst * table.nMaxTaps, 0);
+
+        std::vector<double> fWeights(table.nMaxTaps);
+
+        for (int64_t i = 0; i < nDst; i++)
+        {
+            double fCenter = (i + 0.5) * fScale;
+            int64_t nFirst = std::max<int64_t>((int64_t)(fCenter - fSupport + 0.5), 0);
+            int64_t nLast = std::min<int64_t>((int64_t)(fCenter + fSupport + 0.5), nSrc);    // exclusive
+            int64_t nCount = std::min<int64_t>(nLast - nFirst, table.nMaxTaps);
+
+            double fSum = 0.0;
+            for (int64_t j = 0; j < nCount; j++)
+            {
+                double w;
+                if (filter == kArea)
+                {
+                    // overlap of source pixel [k, k+1) with this destination pixel's footprint
+                    double fLeft = std::max<double>(i * fScale, (double)(nFirst + j));
+                    double fRight = std::min<double>((i + 1) * fScale, (double)(nFirst + j + 1));
+                    w = std::max<double>(fRight - fLeft, 0.0);
+                }
+                else
+                {
+                    double x = (nFirst + j + 0.5 - fCenter) / fFilterScale;
+                    w = (filter == kBicubic) ? Bicubic(x) : Lanczos3(x);
+                }
+                fWeights[j] = w;
+                fSum += w;
+            }
+
+            // trim zero taps off both ends
+            int64_t nStart = 0;
+            while (nStart < nCount - 1 && fWeights[nStart] == 0.0)
+                nStart++;
+            while (nCount > nStart + 1 && fWeights[nCount - 1] == 0.0)
+                nCount--;
+
+            // quantize.  Largest tap absorbs rounding so the weights sum to exactly kWeightOne
+            int16_t* pW = table.weights.data() + i * table.nMaxTaps;
+            int32_t nTotal = 0;
+            int64_t nLargest = 0;
+            for (int64_t j = nStart; j < nCount; j++)
+            {
+                int32_t w = (fSum != 0.0) ? (int32_t)floor(fWeights[j] / fSum * kWeightOne + 0.5) : 0;
+                pW[j - nStart] = (int16_t)w;
+                nTotal += w;
+                if (fWeights[j] > fWeights[nLargest + nStart])
+                    nLargest = j - nStart;
+            }
+            pW[nLargest] = (int16_t)(pW[nLargest] + (kWeightOne - nTotal));
+
+            table.first[i] = nFirst + nStart;
+            table.count[i] = nCount - nStart;
+        }
+    }
+
+
+    inline uint32_t ClampPixel(int32_t a, int32_t r, int32_t g, int32_t b)
+    {
+        a = std::clamp<int32_t>(a >> kWeightShift, 0, 255);
+        r = std::clamp<int32_t>(r >> kWeightShift, 0, 255);
+        g = std::clamp<int32_t>(g >> kWeightShift, 0, 255);
+        b = std::clamp<int32_t>(b >> kWeightShift, 0, 255);
+        return ARGB((uint32_t)a, (uint32_t)r, (uint32_t)g, (uint32_t)b);
+    }
+
+    // 4 int32 channel sums (B,G,R,A) -> clamped pixel
+    inline uint32_t PackSums(__m128i acc)
+    {
+        acc = _mm_srai_epi32(acc, kWeightShift);
+        acc = _mm_packs_epi32(acc, acc);
+        return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(acc, acc));
+    }
+
+    // weights w0,w1 as a pair for _mm_madd_epi16
+    inline __m128i WeightPair(int16_t w0, int16_t w1)
+    {
+        return _mm_set1_epi32((int32_t)((uint32_t)(uint16_t)w0 | ((uint32_t)(uint16_t)w1 << 16)));
+    }
+
+
+    // Horizontal pass for rows [nFirst, nLast).  Two source taps per madd
+    static void HorizontalRows(const uint32_t* pSrc, int64_t nSrcStride, uint32_t* pDst, int64_t nDstW, int64_t nDstStride, const WeightTable* pTable, int64_t nFirst, int64_t nLast)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        for (int64_t y = nFirst; y < nLast; y++)
+        {
+            const uint32_t* pSrcRow = pSrc + y * nSrcStride;
+            uint32_t* pDstRow = pDst + y * nDstStride;
+
+            for (int64_t x = 0; x < nDstW; x++)
+            {
+                const uint32_t* pS = pSrcRow + pTable->first[x];
+                const int16_t* pW = pTable->Weights(x);
+                int64_t nCount = pTable->count[x];
+
+                __m128i acc = _mm_set1_epi32(kWeightHalf);
+                int64_t j = 0;
+                for (; j + 1 < nCount; j += 2)
+                {
+                    // bytes B0 B1 G0 G1 R0 R1 A0 A1 widened to 16 bits
+                    __m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)pS[j]), _mm_cvtsi32_si128((int)pS[j + 1]));
+                    p = _mm_unpacklo_epi8(p, zero);
+                    acc = _mm_add_epi32(acc, _mm_madd_epi16(p, WeightPair(pW[j], pW[j + 1])));
+                }
+                if (j < nCount)
+                {
+                    __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)pS[j]), zero), zero);
+                    acc = _mm_add_epi32(acc, _mm_madd_epi16(p, WeightPair(pW[j], 0)));
+                }
+
+                pDstRow[x] = PackSums(acc);
+            }
+        }
+    }
+
+    // Vertical pass for destination rows [nFirst, nLast).  Four pixels per iteration, two source rows per madd
+    static void VerticalRows(const uint32_t* pSrc, int64_t nSrcStride, uint32_t* pDst, int64_t nW, int64_t nDstStride, const WeightTable* pTable, int64_t nFirst, int64_t nLast)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i half = _mm_set1_epi32(kWeightHalf);
+
+        for (int64_t y = nFirst; y < nLast; y++)
+        {
+            const uint32_t* pS = pSrc + pTable->first[y] * nSrcStride;
+            const int16_t* pW = pTable->Weights(y);
+            int64_t nCount = pTable->count[y];
+            uint32_t* pDstRow = pDst + y * nDstStride;
+
+            int64_t x = 0;
+            for (; x + 4 <= nW; x += 4)
+            {
+                __m128i acc0 = half, acc1 = half, acc2 = half, acc3 = half;
+
+                for (int64_t j = 0; j < nCount; j += 2)
+                {
+                    __m128i a = _mm_loadu_si128((const __m128i*)(pS + j * nSrcStride + x));
+                    __m128i b = zero;
+                    int16_t w1 = 0;
+                    if (j + 1 < nCount)
+                    {
+                        b = _mm_loadu_si128((const __m128i*)(pS + (j + 1) * nSrcStride + x));
+                        w1 = pW[j + 1];
+                    }
+                    __m128i w = WeightPair(pW[j], w1);
+
+                    __m128i lo = _mm_unpacklo_epi8(a, b);
+                    __m128i hi = _mm_unpackhi_epi8(a, b);
+                    acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+                    acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+                    acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+                    acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+                }
+
+                acc0 = _mm_srai_epi32(acc0, kWeightShift);
+                acc1 = _mm_srai_epi32(acc1, kWeightShift);
+                acc2 = _mm_srai_epi32(acc2, kWeightShift);
+                acc3 = _mm_srai_epi32(acc3, kWeightShift);
+                __m128i out = _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_packs_epi32(acc2, acc3));
+                _mm_storeu_si128((__m128i*)(pDstRow + x), out);
+            }
+
+            for (; x < nW; x++)
+            {
+                int32_t a = kWeightHalf, r = kWeightHalf, g = kWeightHalf, b = kWeightHalf;
+                for (int64_t j = 0; j < nCount; j++)
+                {
+                    uint32_t nCol = pS[j * nSrcStride + x];
+                    int32_t w = pW[j];
+                    a += (int32_t)ARGB_A(nCol) * w;
+                    r += (int32_t)ARGB_R(nCol) * w;
+                    g += (int32_t)ARGB_G(nCol) * w;
+                    b += (int32_t)ARGB_B(nCol) * w;
+                }
+                pDstRow[x] = ClampPixel(a, r, g, b);
+            }
+        }
+    }
+
+
+    static void RunRows(int64_t nRows, int64_t nWorkPixels, ThreadPool* pPool, const std::function<void(int64_t, int64_t)>& func)
+    {
+        int64_t nRanges = 1;
+        if (pPool && nWorkPixels >= kMinPixelsToThread)
+            nRanges = std::min<int64_t>(nRows, (int64_t)pPool->size() * 2);
+
+        if (nRanges <= 1)
+        {
+            func(0, nRows);
+            return;
+        }
+
+        std::vector<std::future<void>> results;
+        results.reserve(nRanges);
+        for (int64_t r = 0; r < nRanges; r++)
+            results.emplace_back(pPool->enqueue(func, nRows * r / nRanges, nRows * (r + 1) / nRanges));
+
+        for (auto& result : results)
+            result.wait();
+    }
+
+    bool Resample(const uint32_t* pSrc, int64_t nSrcW, int64_t nSrcH, int64_t nSrcStride,
+                  uint32_t* pDst, int64_t nDstW, int64_t nDstH, int64_t nDstStride,
+                  eFilter filter, ThreadPool* pPool)
+    {
+        if (!pSrc || !pDst || nSrcW < 1 || nSrcH < 1 || nDstW < 1 || nDstH < 1)
+            return false;
+
+        if (nSrcW == nDstW && nSrcH == nDstH)
+        {
+            for (int64_t y = 0; y < nDstH; y++)
+                memcpy(pDst + y * nDstStride, pSrc + y * nSrcStride, nDstW * sizeof(uint32_t));
+            return true;
+        }
+
+        WeightTable columns;
+        WeightTable rows;
+        BuildWeights(columns, nSrcW, nDstW, filter);
+        BuildWeights(rows, nSrcH, nDstH, filter);
+
+        // horizontal pass only needs the source rows the vertical pass will read
+        int64_t nRowFirst = rows.first[0];
+        int64_t nRowLast = rows.first[nDstH - 1] + rows.count[nDstH - 1];
+        int64_t nTempH = nRowLast - nRowFirst;
+        std::vector<uint32_t> temp(nDstW * nTempH);
+        uint32_t* pTemp = temp.data();
+
+        const uint32_t* pSrcRows = pSrc + nRowFirst * nSrcStride;
+        RunRows(nTempH, nTempH * nSrcW, pPool, [=, &columns](int64_t nFirst, int64_t nLast)
+        {
+            HorizontalRows(pSrcRows, nSrcStride, pTemp, nDstW, nDstW, &columns, nFirst, nLast);
+        });
+
+        // row table indices relative to the temp buffer
+        for (int64_t y = 0; y < nDstH; y++)
+            rows.first[y] -= nRowFirst;
+
+        RunRows(nDstH, nDstH * nDstW * rows.nMaxTaps, pPool, [=, &rows](int64_t nFirst, int64_t nLast)
+        {
+            VerticalRows(pTemp, nDstW, pDst, nDstW, nDstStride, &rows, nFirst, nLast);
+        });
+
+        return true;
+    }
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ZTypes.h"
+#include "helpers/ThreadPool.h"
+
+// Separable resampler used by ZBuffer::BltScaled
+// Per column/per row weight tables are built once per call, then a horizontal and a vertical pass
+// accumulate in 2.14 fixed point with SSE2, split across rows on the thread pool.
+
+namespace ZResample
+{
+    enum eFilter : uint32_t
+    {
+        kAuto       = 0,        // per axis: area for large reductions, lanczos for modest ones, bicubic when enlarging
+        kArea       = 1,        // exact coverage average
+        kBicubic    = 2,        // catmull-rom
+        kLanczos3   = 3
+    };
+
+    const double    kAreaMinReduction   = 3.0;          // kAuto switches to kArea at this reduction factor or more
+    const int64_t   kMinPixelsToThread  = 256 * 256;
+
+    bool Resample(const uint32_t* pSrc, int64_t nSrcW, int64_t nSrcH, int64_t nSrcStride,
+                  uint32_t* pDst, int64_t nDstW, int64_t nDstH, int64_t nDstStride,
+                  eFilter filter = kAuto, ThreadPool* pPool = nullptr);
+};
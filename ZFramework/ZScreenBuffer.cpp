@@ -6,6 +6,7 @@
 #include "ZStringHelpers.h"
 #include "ZGUIStyle.h"
 #include <iostream>
+#include <filesystem>
 
 #ifdef _WIN64
 #include <GdiPlus.h>
@@ -32,8 +33,13 @@ using namespace std;
 
 ZScreenBuffer::ZScreenBuffer()
 {
+    mpGraphicSystem = nullptr;
+    mbVisibilityNeedsComputing = true;
+    mbVisibilityResolved = true;
     mbRenderingEnabled = true;
     mbCurrentlyRendering = false;
+    mnPresentedFrames = 0;
+    mnFrameDumpEvery = 1;
 }
 
 ZScreenBuffer::~ZScreenBuffer()
@@ -81,7 +87,7 @@ void ZScreenBuffer::BeginRender()
         return;
 
     mbCurrentlyRendering = true;
-#ifdef _WIN64
+#ifdef ZFRAME_GDI_PRESENT
     // Copy to our window surface
     mDC = BeginPaint(mpGraphicSystem->GetMainHWND(), &mPS);
 #endif
@@ -93,7 +99,7 @@ void ZScreenBuffer::EndRender()
     mbCurrentlyRendering = false;
     if (!mbRenderingEnabled)
         return;
-#ifdef _WIN64
+#ifdef ZFRAME_GDI_PRESENT
     EndPaint(mpGraphicSystem->GetMainHWND(), &mPS);
 #endif
 }
@@ -101,7 +107,176 @@ void ZScreenBuffer::EndRender()
 
 #define USE_LOCKING_SCREEN_RECTS
 
-#ifdef _WIN64
+int32_t ZScreenBuffer::RenderVisibleRects()
+{
+    if (!mbRenderingEnabled)
+        return 0;
+
+    int64_t nRenderedCount = 0;
+
+    const std::lock_guard<std::mutex> surfaceLock(mScreenRectListMutex);
+    ResolveVisibility();
+
+    // ResolveVisibility emits the pieces of each source buffer together. Each source is locked on its own, its pieces
+    // composited in parallel tiles and the source released before the next is taken, so only one source lock is held at
+    // a time and windows wait only while their own surface is being copied.
+    size_t nCount = mScreenRectList.size();
+    size_t nEnd = 0;
+    for (size_t nFirst = 0; nFirst < nCount; nFirst = nEnd)
+	{
+        tZBufferPtr pSource = mScreenRectList[nFirst].mpSourceBuffer;
+        for (nEnd = nFirst + 1; nEnd < nCount && mScreenRectList[nEnd].mpSourceBuffer == pSource; nEnd++);
+
+#ifdef USE_LOCKING_SCREEN_RECTS
+        const std::lock_guard<std::recursive_mutex> sourceLock(pSource->GetMutex());
+#endif
+        if (pSource->mRenderState == ZBuffer::kReadyToRender || pSource->mRenderState == ZBuffer::kFreeToModify)
+        {
+            mCompositeRects.clear();
+            for (size_t i = nFirst; i < nEnd; i++)
+            {
+                const ZScreenRect& sr = mScreenRectList[i];
+                nRenderedCount++;
+
+                ZRect rSource(sr.mSourcePt.x, sr.mSourcePt.y, sr.mSourcePt.x + sr.mrDest.Width(), sr.mSourcePt.y + sr.mrDest.Height());
+                ZRect rDest(sr.mrDest);
+                if (Clip(pSource->GetArea(), mSurfaceArea, rSource, rDest))
+                    mCompositeRects.emplace_back(pSource, rDest, ZPoint(rSource.left, rSource.top));
+            }
+
+            CompositeTiles();
+        }
+
+        pSource->mRenderState = ZBuffer::kFreeToModify;
+	}
+    mCompositeRects.clear();
+
+//    if (nRenderedCount > 0)
+//        ZDEBUG_OUT("ScreenBuffer Rendered:%d ", nRenderedCount);
+
+//    TIME_SECTION_END(RenderVisibleRects);
+
+	return (int32_t) nRenderedCount;
+}
+
+// Visible pieces never overlap, so any two screen tiles write disjoint pixels and can be composited in any order.
+// Pieces are binned into tiles the way ZRasterizer::RasterizeBatch bins quads, and tiles are handed out from a shared
+// counter to render pool helpers and the calling thread. Small updates stay on the calling thread.
+void ZScreenBuffer::CompositeTiles()
+{
+    int64_t nWork = 0;
+    for (auto& sr : mCompositeRects)
+        nWork += sr.mrDest.Area();
+
+    if (nWork < kMinCompositePixelsToThread)
+    {
+        for (auto& sr : mCompositeRects)
+        {
+            ZRect rSource(sr.mSourcePt.x, sr.mSourcePt.y, sr.mSourcePt.x + sr.mrDest.Width(), sr.mSourcePt.y + sr.mrDest.Height());
+            BltNoClip(sr.mpSourceBuffer.get(), rSource, sr.mrDest);
+        }
+        return;
+    }
+
+    int64_t nTilesX = (mSurfaceArea.Width() + kCompositeTileSize - 1) / kCompositeTileSize;
+    int64_t nTilesY = (mSurfaceArea.Height() + kCompositeTileSize - 1) / kCompositeTileSize;
+    mCompositeTileStart.assign(nTilesX * nTilesY + 1, 0);
+
+    for (auto& sr : mCompositeRects)
+    {
+        const ZRect& r = sr.mrDest;
+        for (int64_t ty = r.top / kCompositeTileSize; ty <= (r.bottom - 1) / kCompositeTileSize; ty++)
+            for (int64_t tx = r.left / kCompositeTileSize; tx <= (r.right - 1) / kCompositeTileSize; tx++)
+                mCompositeTileStart[ty * nTilesX + tx + 1]++;
+    }
+
+    // Counting sort of piece indices into per tile lists
+    for (size_t t = 1; t < mCompositeTileStart.size(); t++)
+        mCompositeTileStart[t] += mCompositeTileStart[t - 1];
+
+    mCompositeTilePieces.resize(mCompositeTileStart.back());
+    mCompositeTileFill.assign(mCompositeTileStart.begin(), mCompositeTileStart.end() - 1);
+    mActiveTiles.clear();
+    for (size_t i = 0; i < mCompositeRects.size(); i++)
+    {
+        const ZRect& r = mCompositeRects[i].mrDest;
+        for (int64_t ty = r.top / kCompositeTileSize; ty <= (r.bottom - 1) / kCompositeTileSize; ty++)
+            for (int64_t tx = r.left / kCompositeTileSize; tx <= (r.right - 1) / kCompositeTileSize; tx++)
+                mCompositeTilePieces[mCompositeTileFill[ty * nTilesX + tx]++] = (int32_t)i;
+    }
+
+    for (int64_t t = 0; t < nTilesX * nTilesY; t++)
+    {
+        if (mCompositeTileStart[t + 1] > mCompositeTileStart[t])
+            mActiveTiles.push_back(t);
+    }
+
+    auto compositeTile = [&](int64_t nTile)
+    {
+        ZRect rTile((nTile % nTilesX) * kCompositeTileSize, (nTile / nTilesX) * kCompositeTileSize, 0, 0);
+        rTile.right = std::min<int64_t>(rTile.left + kCompositeTileSize, mSurfaceArea.right);
+        rTile.bottom = std::min<int64_t>(rTile.top + kCompositeTileSize, mSurfaceArea.bottom);
+
+        for (int64_t n = mCompositeTileStart[nTile]; n < mCompositeTileStart[nTile + 1]; n++)
+        {
+            const ZScreenRect& sr = mCompositeRects[mCompositeTilePieces[n]];
+
+            ZRect rDest(sr.mrDest);
+            if (!rDest.Intersect(rTile) || rDest.Width() <= 0 || rDest.Height() <= 0)
+                continue;
+
+            int64_t nSrcX = sr.mSourcePt.x + rDest.left - sr.mrDest.left;
+            int64_t nSrcY = sr.mSourcePt.y + rDest.top - sr.mrDest.top;
+            ZRect rSource(nSrcX, nSrcY, nSrcX + rDest.Width(), nSrcY + rDest.Height());
+            BltNoClip(sr.mpSourceBuffer.get(), rSource, rDest);
+        }
+    };
+
+    int64_t nTiles = (int64_t)mActiveTiles.size();
+    int64_t nHelpers = std::min<int64_t>({ (int64_t)gRasterizer.renderPool.size(), kMaxCompositeHelpers, nTiles - 1 });
+
+    std::atomic<int64_t> nNextTile = 0;
+    auto worker = [&]()
+    {
+        for (int64_t nTile = nNextTile++; nTile < nTiles; nTile = nNextTile++)
+            compositeTile(mActiveTiles[nTile]);
+    };
+
+    std::future<void> helpers[kMaxCompositeHelpers];
+    for (int64_t i = 0; i < nHelpers; i++)
+        helpers[i] = gRasterizer.renderPool.enqueue(worker);
+
+    worker();
+
+    for (int64_t i = 0; i < nHelpers; i++)
+        helpers[i].wait();
+}
+
+void ZScreenBuffer::SetFrameDump(const std::string& sFolder, int64_t nEveryNFrames)
+{
+    msFrameDumpFolder = sFolder;
+    mnFrameDumpEvery = std::max<int64_t>(nEveryNFrames, 1);
+    if (!msFrameDumpFolder.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(msFrameDumpFolder, ec);
+        if (ec)
+            ZERROR("ZScreenBuffer::SetFrameDump couldn't create:", msFrameDumpFolder, "\n");
+    }
+}
+
+void ZScreenBuffer::DumpFrame()
+{
+    int64_t nFrame = mnPresentedFrames++;
+    if (msFrameDumpFolder.empty() || nFrame % mnFrameDumpEvery != 0)
+        return;
+
+    char name[32];
+    snprintf(name, sizeof(name), "frame_%06lld.png", (long long)nFrame);
+    SaveBuffer((std::filesystem::path(msFrameDumpFolder) / name).string());
+}
+
+#ifdef ZFRAME_GDI_PRESENT
 
 bool ZScreenBuffer::PaintToSystem()
 {
@@ -137,65 +312,10 @@ bool ZScreenBuffer::PaintToSystem()
         &bmpInfo,                          // BMPINFO
         DIB_RGB_COLORS);                    // Usage
 
+    DumpFrame();
     return true;
 }
 
-int32_t ZScreenBuffer::RenderVisibleRects()
-{
-    if (!mbRenderingEnabled)
-        return 0;
-
-    tZBufferPtr pCurBuffer;
-
-    int64_t nRenderedCount = 0;
-
-    const std::lock_guard<std::mutex> surfaceLock(mScreenRectListMutex);
-    for (auto& sr : mScreenRectList)
-	{
-        // Since the mScreenRectList happens to be sorted so that referenced textures are together, we should lock, render all from that texture, then unlock
-        if (sr.mpSourceBuffer != pCurBuffer)
-        {
-            if (pCurBuffer)
-                pCurBuffer->mRenderState = ZBuffer::kFreeToModify;
-
-#ifdef USE_LOCKING_SCREEN_RECTS
-            if (pCurBuffer)
-                pCurBuffer->GetMutex().unlock();
-#endif
-
-            pCurBuffer = sr.mpSourceBuffer;
-
-#ifdef USE_LOCKING_SCREEN_RECTS
-            pCurBuffer->GetMutex().lock();
-#endif
-        }
-
-        if (pCurBuffer->mRenderState == ZBuffer::kReadyToRender || pCurBuffer->mRenderState == ZBuffer::kFreeToModify)
-        {
-            nRenderedCount++;
-            ZRect rTexture(sr.mpSourceBuffer->GetArea());
-
-            ZRect rSource(sr.mSourcePt.x, sr.mSourcePt.y, sr.mSourcePt.x + sr.mrDest.Width(), sr.mSourcePt.y + sr.mrDest.Height());
-            Blt(sr.mpSourceBuffer.get(), rSource, sr.mrDest);
-        }
-	}
-
-    if (pCurBuffer)
-        pCurBuffer->mRenderState = ZBuffer::kFreeToModify;
-
-#ifdef USE_LOCKING_SCREEN_RECTS
-    if (pCurBuffer)
-        pCurBuffer->GetMutex().unlock();
-#endif
-
-//    if (nRenderedCount > 0)
-//        ZDEBUG_OUT("ScreenBuffer Rendered:%d ", nRenderedCount);
-
-//    TIME_SECTION_END(RenderVisibleRects);
-
-	return (int32_t) nRenderedCount;
-}
-
 bool ZScreenBuffer::PaintToSystem(const ZRect& rClip)
 {
     if (!mbRenderingEnabled)
@@ -325,8 +445,37 @@ bool ZScreenBuffer::RenderBuffer(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst)
 }
 */
 
+#else
+
+// Headless, the surface itself is the output
 
-#endif // _WIN64
+bool ZScreenBuffer::PaintToSystem()
+{
+    if (!mbRenderingEnabled)
+        return false;
+
+    DumpFrame();
+    return true;
+}
+
+bool ZScreenBuffer::PaintToSystem(const ZRect& /*rClip*/)
+{
+    return mbRenderingEnabled;
+}
+
+bool ZScreenBuffer::RenderBuffer(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst)
+{
+    if (!mbRenderingEnabled || !pSrc)
+        return false;
+
+    if (!mSurfaceArea.Overlaps(rDst))
+        return true;
+
+    const std::lock_guard<std::recursive_mutex> srcLock(pSrc->GetMutex());
+    return Blt(pSrc, rSrc, rDst);
+}
+
+#endif // ZFRAME_GDI_PRESENT
 
 //#define DEBUG_VISIBILITY
 #ifdef DEBUG_VISIBILITY
@@ -335,6 +484,14 @@ bool ZScreenBuffer::RenderBuffer(ZBuffer* pSrc, ZRect& rSrc, ZRect& rDst)
 #define DebugVisibilityOutput
 #endif
 
+void ZScreenBuffer::ResetVisibilityList()
+{
+    // Only the list being built is reset. The resolved visibility stays until the new list is compared against it.
+    const std::lock_guard<std::mutex> surfaceLock(mScreenRectListMutex);
+    mAddedRects.clear();
+    mbVisibilityResolved = false;
+}
+
 bool ZScreenBuffer::AddScreenRectAndComputeVisibility(const ZScreenRect& screenRect)
 {
     assert(screenRect.mpSourceBuffer);
@@ -343,170 +500,106 @@ bool ZScreenBuffer::AddScreenRectAndComputeVisibility(const ZScreenRect& screenR
         return false;
 
 	// The requirement here is that the newly added rect is on top of all previous rects (i.e. painters alg)
+    const std::lock_guard<std::mutex> surfaceLock(mScreenRectListMutex);
+    mAddedRects.push_back(screenRect);
+    mbVisibilityResolved = false;
+    return true;
+}
 
+size_t ZScreenBuffer::GetVisibilityCount()
+{
     const std::lock_guard<std::mutex> surfaceLock(mScreenRectListMutex);
+    ResolveVisibility();
+    return mScreenRectList.size();
+}
 
-	tScreenRectList oldList(std::move(mScreenRectList));		// move over the old list
-	tScreenRectList newList;
-
-	// for each screenrect in the list, 
-	// 
-	// 
-	// 	   if there is NO overlap just push the rect on the new list;
-	// 
-	// 	   if the new window overlaps completely then the oldRect is completely occluded and doesn't need to be considered further
-	// 
-	//	   if there is overlap with the new screenRect
-	// 	   Find the overlapping rect (intersection of two)
-	// 	   Find the 8 possible areas that are not occluded
-	// 
-	// 	   
-	//                              rDest
-	//     lw      mw      rw     /
-	//  ---^-------^-------^---- /
-	//         |       |        |             
-	//    TL   |   T   |   TR   > th         
-	//         |       |        |              
-	//  -------+-------+--------|             
-	//         |       |        |              
-	//     L   |Overlap|   R    > mh             
-	//         |       |        |              
-	//  -------+-------+--------|             
-	//         |       |        |              
-	//    BL   |   B   |   BR   > bh 
-	//         |       |        |              
-	// 
-	// For each of those 8 if they have area (i.e. either height or width non zero)
-	// 	    Compute the source rect from oldRect
-	//      Compute the dest TL based on the oldRect
-	//      Add a new ZScreenRect to new list with these attributes
-
-	for (auto oldRect : oldList)
-	{
-		if (!oldRect.mrDest.Overlaps(screenRect.mrDest))	// no overlap?
-		{
-			// No overlap so just add old rect to new list
-			newList.push_back(std::move(oldRect));		// TODO maybe use emplace_back with copy constructor?
-			DebugVisibilityOutput("No overlap... adding old rect. old(%d,%d,%d,%d)  new(%d,%d,%d,%d)\n", oldRect.mrDest.left, oldRect.mrDest.top, oldRect.mrDest.right, oldRect.mrDest.bottom, screenRect.mrDest.left, screenRect.mrDest.top, screenRect.mrDest.right, screenRect.mrDest.bottom);
-		}
-		else if (screenRect.mrDest.left <= oldRect.mrDest.left &&
-			screenRect.mrDest.top <= oldRect.mrDest.top &&
-			screenRect.mrDest.right >= oldRect.mrDest.right &&
-			screenRect.mrDest.bottom >= oldRect.mrDest.bottom)
-		{
-			// Complete overlap, so old rect can be removed entirely
-			DebugVisibilityOutput("Complete overlap... ignoring old rect. old(%d,%d,%d,%d)  new(%d,%d,%d,%d)\n", oldRect.mrDest.left, oldRect.mrDest.top, oldRect.mrDest.right, oldRect.mrDest.bottom, screenRect.mrDest.left, screenRect.mrDest.top, screenRect.mrDest.right, screenRect.mrDest.bottom);
-		}
-		else
-		{
-			ZRect rOverlap(oldRect.mrDest);
-			rOverlap.Intersect(screenRect.mrDest);
-
-			ZRect rDest(oldRect.mrDest);
-
-			int64_t lw = rOverlap.left - rDest.left;
-			int64_t mw = rOverlap.Width();
-			int64_t rw = rDest.right - rOverlap.right;
-
-			int64_t th = rOverlap.top - rDest.top;
-			int64_t mh = rOverlap.Height();
-			int64_t bh = rDest.bottom - rOverlap.bottom;
-
-
-			if (lw != 0)		// Consider left three?
-			{
-				if (th != 0)
-				{
-					// TL
-					ZRect rTL(rDest.left, rDest.top, rDest.left + lw, rDest.top + th);
-					ZPoint sourcePt(oldRect.mSourcePt);
-					newList.emplace_back(ZScreenRect(oldRect.mpSourceBuffer, rTL, sourcePt));
-					DebugVisibilityOutput("rTL:(%d,%d,%d,%d) sourcePt:(%d,%d)", rTL.left, rTL.top, rTL.right, rTL.bottom, sourcePt.x, sourcePt.y);
-
-				}
-
-				if (mh != 0)
-				{
-					// L
-					ZRect rL(rDest.left, rOverlap.top, rDest.left + lw, rOverlap.bottom);
-					ZPoint sourcePt(oldRect.mSourcePt.x, oldRect.mSourcePt.y+th);
-					newList.emplace_back(ZScreenRect(oldRect.mpSourceBuffer, rL, sourcePt));
-					DebugVisibilityOutput("rL:(%d,%d,%d,%d) sourcePt:(%d,%d)\n", rL.left, rL.top, rL.right, rL.bottom, sourcePt.x, sourcePt.y);
-				}
-
-				if (bh != 0)
-				{
-					// BL
-					ZRect rBL(rDest.left, rOverlap.bottom, rOverlap.left, rDest.bottom);
-					ZPoint sourcePt(oldRect.mSourcePt.x, oldRect.mSourcePt.y+th+mh);
-					newList.emplace_back(ZScreenRect(oldRect.mpSourceBuffer, rBL, sourcePt));
-					DebugVisibilityOutput("rBL:(%d,%d,%d,%d) sourcePt:(%d,%d)\n", rBL.left, rBL.top, rBL.right, rBL.bottom, sourcePt.x, sourcePt.y);
-				}
-			}
-
-			if (mw != 0)			// consider top and bottom two?
-			{
-				if (th != 0)
-				{
-					// T
-					ZRect rT(rOverlap.left, rDest.top, rOverlap.right, rDest.top + th);
-					ZPoint sourcePt(oldRect.mSourcePt.x+lw, oldRect.mSourcePt.y);
-					newList.emplace_back(ZScreenRect(oldRect.mpSourceBuffer, rT, sourcePt));
-					DebugVisibilityOutput("rT:(%d,%d,%d,%d) sourcePt:(%d,%d)\n", rT.left, rT.top, rT.right, rT.bottom, sourcePt.x, sourcePt.y);
-				}
-
-				if (bh != 0)
-				{
-					// B
-					ZRect rB(rOverlap.left, rOverlap.bottom, rOverlap.right, rDest.bottom);
-					ZPoint sourcePt(oldRect.mSourcePt.x+lw, oldRect.mSourcePt.y+th+mh);
-					newList.emplace_back(ZScreenRect(oldRect.mpSourceBuffer, rB, sourcePt));
-					DebugVisibilityOutput("rB:(%d,%d,%d,%d) sourcePt:(%d,%d)\n", rB.left, rB.top, rB.right, rB.bottom, sourcePt.x, sourcePt.y);
-				}
-			}
-
-			if (rw != 0)		// consider right three?
-			{
-				if (th != 0)
-				{
-					// TR
-					ZRect rTR(rOverlap.right, rDest.top, rDest.right, rOverlap.top);
-					ZPoint sourcePt(oldRect.mSourcePt.x+lw+mw, oldRect.mSourcePt.y);
-					newList.emplace_back(ZScreenRect(oldRect.mpSourceBuffer, rTR, sourcePt));
-					DebugVisibilityOutput("rTR:(%d,%d,%d,%d) sourcePt:(%d,%d)\n", rTR.left, rTR.top, rTR.right, rTR.bottom, sourcePt.x, sourcePt.y);
-				}
-
-				if (mh != 0)
-				{
-					// R
-					ZRect rR(rOverlap.right, rOverlap.top, rDest.right, rOverlap.bottom);
-					ZPoint sourcePt(oldRect.mSourcePt.x+lw+mw, oldRect.mSourcePt.y+th);
-					newList.emplace_back(ZScreenRect(oldRect.mpSourceBuffer, rR, sourcePt));
-					DebugVisibilityOutput("rR:(%d,%d,%d,%d) sourcePt:(%d,%d)\n", rR.left, rR.top, rR.right, rR.bottom, sourcePt.x, sourcePt.y);
-				}
-
-				if (bh != 0)
-				{
-					// BR
-					ZRect rBR(rOverlap.right, rOverlap.bottom, rDest.right, rDest.bottom);
-					ZPoint sourcePt(oldRect.mSourcePt.x+lw+mw, oldRect.mSourcePt.y+th+mh);
-					newList.emplace_back(ZScreenRect(oldRect.mpSourceBuffer, rBR, sourcePt));
-					DebugVisibilityOutput("rBR:(%d,%d,%d,%d) sourcePt:(%d,%d)\n", rBR.left, rBR.top, rBR.right, rBR.bottom, sourcePt.x, sourcePt.y);
-				}
-			}
-		}
-	}
+void ZScreenBuffer::GetVisibleRects(tScreenRectArray& rects)
+{
+    const std::lock_guard<std::mutex> surfaceLock(mScreenRectListMutex);
+    ResolveVisibility();
+    rects = mScreenRectList;
+}
+
+void ZScreenBuffer::ResolveVisibility()
+{
+    if (mbVisibilityResolved)
+        return;
+
+    // Compare the new list against the resolved one. Entries matching from the bottom and from the top, by source buffer,
+    // keep their visible regions, and only those that moved add their old and new bounds to the dirty region. Everything
+    // between the matched ends was added, removed or restacked, so all of it is dirty.
+    size_t nOld = mVisibility.size();
+    size_t nNew = mAddedRects.size();
+    size_t nBottom = 0;
+    while (nBottom < nOld && nBottom < nNew && mVisibility[nBottom].sr.mpSourceBuffer == mAddedRects[nBottom].mpSourceBuffer)
+        nBottom++;
+
+    size_t nTop = 0;
+    while (nTop < nOld - nBottom && nTop < nNew - nBottom && mVisibility[nOld - 1 - nTop].sr.mpSourceBuffer == mAddedRects[nNew - 1 - nTop].mpSourceBuffer)
+        nTop++;
+
+    mDirtyRegion.Clear();
+    for (size_t i = nBottom; i < nOld - nTop; i++)
+        mDirtyRegion.Union(mVisibility[i].sr.mrDest);
+    for (size_t i = nBottom; i < nNew - nTop; i++)
+        mDirtyRegion.Union(mAddedRects[i].mrDest);
+
+    mVisibility.erase(mVisibility.begin() + nBottom, mVisibility.end() - nTop);
+    mVisibility.insert(mVisibility.begin() + nBottom, nNew - nTop - nBottom, VisibilityEntry());
+
+    for (size_t i = 0; i < nNew; i++)
+    {
+        VisibilityEntry& entry = mVisibility[i];
+        const ZScreenRect& sr = mAddedRects[i];
+        bool bMatched = i < nBottom || i >= nNew - nTop;
+        if (bMatched && (entry.sr.mrDest != sr.mrDest || entry.sr.mSourcePt != sr.mSourcePt))
+        {
+            mDirtyRegion.Union(entry.sr.mrDest);
+            mDirtyRegion.Union(sr.mrDest);
+        }
+        entry.sr = sr;
+    }
+
+    // Topmost first, redo visibility inside the dirty region only. Outside it, every pixel is covered by the same rects in
+    // the same order as before, so the pieces there stand.
+    if (!mDirtyRegion.IsEmpty())
+    {
+        const ZRect& rDirty = mDirtyRegion.GetBounds();
+        mCoveredRegion.Clear();
+        for (auto it = mVisibility.rbegin(); it != mVisibility.rend(); it++)
+        {
+            VisibilityEntry& entry = *it;
+            if (!entry.sr.mrDest.Overlaps(rDirty) && !entry.visible.GetBounds().Overlaps(rDirty))
+                continue;
+
+            entry.visible.Subtract(mDirtyRegion);
 
-	// Finally add the new top level screenRect 
-	newList.push_back(std::move(screenRect));
+            mVisibleRegion.Set(entry.sr.mrDest);
+            mVisibleRegion.Intersect(mDirtyRegion);
+            mVisibleRegion.Subtract(mCoveredRegion);
+            mCoveredRegion.Union(mVisibleRegion);
+            entry.visible.Union(mVisibleRegion);
+        }
+    }
+
+    mScreenRectList.clear();
+    for (auto it = mVisibility.rbegin(); it != mVisibility.rend(); it++)
+    {
+        const ZScreenRect& sr = it->sr;
+        for (const ZRect& r : it->visible.GetRects())
+        {
+            ZPoint sourcePt(sr.mSourcePt.x + r.left - sr.mrDest.left, sr.mSourcePt.y + r.top - sr.mrDest.top);
+            mScreenRectList.emplace_back(sr.mpSourceBuffer, r, sourcePt);
+            DebugVisibilityOutput("visible:(%d,%d,%d,%d) sourcePt:(%d,%d)\n", r.left, r.top, r.right, r.bottom, sourcePt.x, sourcePt.y);
+        }
+    }
 
     // Set the render flag for all buffers in the new list
-    for (auto& sr : newList)
+    for (auto& sr : mScreenRectList)
     {
         if (sr.mpSourceBuffer->mRenderState != ZBuffer::eRenderState::kBusy_SkipRender) // only set ready to render if not busy
             sr.mpSourceBuffer->mRenderState = ZBuffer::kReadyToRender;
     }
 
-	mScreenRectList = newList;
-	return true;
+    mbVisibilityResolved = true;
 }
@@ -2,13 +2,20 @@
 
 #include "ZBuffer.h"
 #include "ZGraphicSystem.h"
+#include "ZRegion.h"
+#include <vector>
+#include <mutex>
+#include <string>
+
+#ifdef ZFRAME_GDI_PRESENT
 #include "ZD3D.h"
+#endif
 
 
 class ZScreenRect
 {
 public:
-	ZScreenRect();
+	ZScreenRect() {}
 	ZScreenRect(tZBufferPtr pSourceBuffer, ZRect rDest, ZPoint sourcePt) 
 	{ 
 		mpSourceBuffer = pSourceBuffer; 
@@ -30,7 +37,7 @@ public:
 };
 
 
-typedef std::list<ZScreenRect> tScreenRectList;
+typedef std::vector<ZScreenRect> tScreenRectArray;
 
 
 
@@ -50,11 +57,15 @@ public:
 
 
 	// Visibility Related
-	void	ResetVisibilityList() { mScreenRectList.clear(); }
+    // Rects are added bottom to top (painter's order). Their visible parts are worked out front to back against the
+    // region already covered, the first time they're needed. Each rebuilt list is compared with the last one resolved and
+    // only the screen area under rects that moved, appeared, disappeared or were restacked is worked out again.
+	void	ResetVisibilityList();
 	bool	AddScreenRectAndComputeVisibility(const ZScreenRect& screenRect);
 	void	SetVisibilityComputingFlag(bool bSet) { mbVisibilityNeedsComputing = bSet; }
 	bool	DoesVisibilityNeedComputing() { return mbVisibilityNeedsComputing; }
-	size_t	GetVisibilityCount() { return mScreenRectList.size(); }
+	size_t	GetVisibilityCount();
+    void    GetVisibleRects(tScreenRectArray& rects);     // resolved pieces, topmost first
 
 	int32_t	RenderVisibleRects();   // returns number of rects that needed rendering
 
@@ -63,16 +74,52 @@ public:
 
     bool    PaintToSystem();    // final transfer from internal surface
 
+    // Every nth presented frame written to sFolder as frame_000000.png and so on. An empty folder stops dumping.
+    void    SetFrameDump(const std::string& sFolder, int64_t nEveryNFrames = 1);
+    int64_t GetPresentedFrameCount() { return mnPresentedFrames; }
+
 protected:
+    void    DumpFrame();
+    void    ResolveVisibility();        // called with mScreenRectListMutex held
+    void    CompositeTiles();           // blts mCompositeRects, in parallel screen tiles when there's enough to draw. Source locked by the caller
+
+    // RenderVisibleRects fan out
+    static const int64_t kCompositeTileSize             = 256;          // multiple of ZBuffer::kTileSize
+    static const int64_t kMinCompositePixelsToThread    = 512 * 512;
+    static const int64_t kMaxCompositeHelpers           = 64;
+
 	ZGraphicSystem*     mpGraphicSystem;
 
-	tScreenRectList     mScreenRectList;
+    struct VisibilityEntry
+    {
+        ZScreenRect     sr;
+        ZRegion         visible;            // part of sr.mrDest not covered by later entries
+    };
+
+    tScreenRectArray    mAddedRects;        // as added, bottom to top
+    std::vector<VisibilityEntry> mVisibility;   // last resolved list, bottom to top
+	tScreenRectArray    mScreenRectList;    // visible parts, none overlapping
+    bool                mbVisibilityResolved;
+    ZRegion             mDirtyRegion;       // scratch for ResolveVisibility
+    ZRegion             mCoveredRegion;
+    ZRegion             mVisibleRegion;
+
+    // scratch for RenderVisibleRects / CompositeTiles
+    tScreenRectArray            mCompositeRects;        // drawable pieces of one source, clipped to the screen
+    std::vector<int64_t>        mCompositeTileStart;    // per tile ranges of mCompositeTilePieces
+    std::vector<int64_t>        mCompositeTileFill;
+    std::vector<int32_t>        mCompositeTilePieces;
+    std::vector<int64_t>        mActiveTiles;
     std::mutex          mScreenRectListMutex;
 	bool                mbVisibilityNeedsComputing;
     bool                mbRenderingEnabled; 
     bool                mbCurrentlyRendering;
 
-#ifdef _WIN64
+    int64_t             mnPresentedFrames;
+    std::string         msFrameDumpFolder;
+    int64_t             mnFrameDumpEvery;
+
+#ifdef ZFRAME_GDI_PRESENT
     PAINTSTRUCT         mPS;
     HDC                 mDC;
 
@@ -86,7 +86,7 @@ tZBufferPtr ZThumbCache::GetThumb(const std::filesystem::path& imagePath, bool b
     {
         ZDEBUG_OUT("Generating missing thumb:", imagePath, "\n");
         tZBufferPtr original(new ZBuffer());
-        if (original->LoadBuffer(imagePath.string()))
+        if (original->LoadBuffer(imagePath.string(), kThumbDimensions.x, kThumbDimensions.y))     // only needs enough resolution for the thumb
         {
             Add(imagePath, original);
             return original;
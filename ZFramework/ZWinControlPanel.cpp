@@ -287,7 +287,7 @@ bool ZWinControlPanel::Paint()
 
 bool ZWinControlPanel::OnMouseOut()
 {
-    mWorkToDoCV.notify_one();
+    WakeThread();
     return ZWin::OnMouseOut();
 }
 
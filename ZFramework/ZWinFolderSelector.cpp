@@ -13,6 +13,7 @@ ZWinFolderLabel::ZWinFolderLabel()
     mStyle = gDefaultDialogStyle;
     mStyle.pos = ZGUI::LC;
     mbAcceptsCursorMessages = true;
+    mIdleSleepMS = kIdleForever;
 }
 
 bool ZWinFolderLabel::Init()
@@ -222,6 +223,7 @@ ZWinFolderSelector::ZWinFolderSelector()
     mpOpenFolderBtn = nullptr;
     mpFolderList = nullptr;
     mbAcceptsCursorMessages = true;
+    mIdleSleepMS = kIdleForever;
     msWinName = kFolderSelectorName;
 }
 
@@ -26,6 +26,8 @@ ZWinImage::ZWinImage()
     mfMaxZoom = 100.0;
     mZoomHotkey = 0;
     nSubsampling = 0;
+    mMinification = ZRasterizer::kMinMipmapTrilinear;
+    mMagnification = ZRasterizer::kMagBilinear;
     mpTable = nullptr;
     mFillColor = 0xff000000;
     mIdleSleepMS = 10000;
@@ -618,7 +620,7 @@ bool ZWinImage::Paint()
                 if (nSubsampling == 0 || AmCapturing() || gInput.IsKeyDown(mZoomHotkey) || mfZoom == 1.00)
                     gRasterizer.RasterizeWithAlpha(mpSurface.get(), pRenderImage.get(), verts, &mAreaLocal);
                 else
-                    gRasterizer.MultiSampleRasterizeWithAlpha(mpSurface.get(), pRenderImage.get(), verts, &mAreaLocal, nSubsampling);
+                    gRasterizer.MultiSampleRasterizeWithAlpha(mpSurface.get(), pRenderImage.get(), verts, &mAreaLocal, nSubsampling, 255, mMinification, mMagnification);
             }
         }
     }
@@ -2,6 +2,7 @@
 
 #include "ZWin.h"
 #include "ZBuffer.h"
+#include "ZRasterizer.h"
 #include "ZTypes.h"
 #include "ZAnimObjects.h"
 #include "ZGUIElements.h"
@@ -59,6 +60,7 @@ public:
 
     void        SetZoom(double fZoom);
     double      GetZoom();
+    eViewState  GetViewState() { return mViewState; }
 
     void        ScrollTo(int64_t nX, int64_t nY);
 
@@ -84,6 +86,8 @@ public:
 
     tZBufferPtr mpImage;
     uint32_t    nSubsampling;
+    ZRasterizer::eMinification  mMinification;     // sampling when zoomed out with nSubsampling > 0
+    ZRasterizer::eMagnification mMagnification;    // sampling when zoomed in with nSubsampling > 0
 
 
     ZGUI::tTextboxMap   mCaptionMap;
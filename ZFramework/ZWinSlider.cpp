@@ -31,6 +31,7 @@ tZWinSlider<T>::tZWinSlider(T* pnSliderValue)
 
     mBehavior = kInvalidateOnMouseUp|kDrawSliderValueOnMouseOver;
     mbInvalidateParentWhenInvalid = true;
+    mIdleSleepMS = kIdleForever;
 
     if (msWinName.empty())
         msWinName = "ZWinSlider_" + gMessageSystem.GenerateUniqueTargetName();
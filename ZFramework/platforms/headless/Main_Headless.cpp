@@ -0,0 +1,159 @@
+// Headless entry point. Runs the same message / tick / visibility / composite loop as Main_Win64.cpp with no window.
+// The screen buffer composites into its own memory (see ZFRAME_GDI_PRESENT in ZGraphicSystem.h), which makes the
+// compositor measurable on build hosts and lets the window tree be rendered to files.
+//
+//  -width:<n> -height:<n>      surface size, default 1920x1080
+//  -frames:<n>                 frames to run before exiting, 0 runs until the app exits
+//  -fps:<n>                    frame pacing, 0 runs as fast as possible
+//  -dumpframes:<folder>        write presented frames as PNG
+//  -dumpevery:<n>              only every nth frame
+//  -rasterstats:<file>         writes the recent frame stats on exit
+
+#ifdef _WIN64
+#define WIN32_LEAN_AND_MEAN
+#include "windows.h"
+#endif
+
+#include "helpers/StringHelpers.h"
+#include "helpers/CommandLineParser.h"
+#include "helpers/Registry.h"
+#include "helpers/FileLogger.h"
+#include "ZDebug.h"
+#include "ZInput.h"
+#include "ZTickManager.h"
+#include "ZFrameClock.h"
+#include "ZGraphicSystem.h"
+#include "ZScreenBuffer.h"
+#include "ZTimer.h"
+#include "ZMainWin.h"
+#include "ZAnimator.h"
+#include "ZRasterStats.h"
+#include <thread>
+
+namespace ZFrameworkApp
+{
+    extern bool InitRegistry(std::filesystem::path userDataPath);
+    extern bool Initialize(int argc, char* argv[], std::filesystem::path userDataPath);
+    extern void Shutdown();
+};
+
+extern ZTickManager     gTickManager;
+extern bool             gbGraphicSystemResetNeeded;
+
+using namespace std;
+
+bool                    gbApplicationExiting = false;
+bool                    gbApplicationRestart = false;
+ZRect                   grFullArea;
+ZInput                  gInput;
+ZDebug                  gDebug;
+
+#ifdef _WIN64
+HWND                    ghWnd = NULL;           // fonts are built on the screen DC
+#endif
+
+
+int main(int argc, char* argv[])
+{
+    int64_t nWidth = 1920;
+    int64_t nHeight = 1080;
+    int64_t nFrames = 0;
+    int64_t nFPS = 0;
+    int64_t nDumpEvery = 1;
+    string sDumpFolder;
+    string sRasterStatsCSV;
+
+    CLP::CommandLineParser parser;
+    parser.RegisterParam(CLP::ParamDesc("width", &nWidth, CLP::kNamed));
+    parser.RegisterParam(CLP::ParamDesc("height", &nHeight, CLP::kNamed));
+    parser.RegisterParam(CLP::ParamDesc("frames", &nFrames, CLP::kNamed));
+    parser.RegisterParam(CLP::ParamDesc("fps", &nFPS, CLP::kNamed));
+    parser.RegisterParam(CLP::ParamDesc("dumpframes", &sDumpFolder, CLP::kNamed));
+    parser.RegisterParam(CLP::ParamDesc("dumpevery", &nDumpEvery, CLP::kNamed));
+    parser.RegisterParam(CLP::ParamDesc("rasterstats", &sRasterStatsCSV, CLP::kNamed));
+    parser.Parse(argc, argv);
+
+    if (nWidth <= 0 || nHeight <= 0)
+    {
+        ZERROR("Invalid surface size:", nWidth, "x", nHeight, "\n");
+        return -1;
+    }
+    grFullArea.Set(0, 0, nWidth, nHeight);
+
+    const char* pUserPath = getenv("APPDATA");
+    if (!pUserPath)
+        pUserPath = getenv("HOME");
+    std::filesystem::path userDataPath(pUserPath ? pUserPath : ".");
+    gLogger.msLogFilename = (userDataPath / "ZHeadless.log").string();
+
+    ZFrameworkApp::InitRegistry(userDataPath);
+    if (!ZFrameworkApp::Initialize(argc, argv, userDataPath))
+        return -1;
+
+    if (!sDumpFolder.empty() && gGraphicSystem.GetScreenBuffer())
+        gGraphicSystem.GetScreenBuffer()->SetFrameDump(sDumpFolder, nDumpEvery);
+
+    const int64_t nMinUSBetweenFrames = nFPS > 0 ? 1000000 / nFPS : 0;
+    int64_t nFrame = 0;
+    int64_t nCompositeUS = 0;
+    int64_t nStartUS = gTimer.GetUSSinceEpoch();
+
+    while (!gbApplicationExiting && (nFrames == 0 || nFrame < nFrames))
+    {
+        int64_t nLoopStartUS = gTimer.GetUSSinceEpoch();
+
+        gMessageSystem.Process();
+        gTickManager.Tick();
+        gFrameClock.Tick();            // releases windows waiting to paint
+        if (gbApplicationExiting)   // may have been set while processing messages
+            break;
+
+        gInput.Process();
+
+        ZScreenBuffer* pScreenBuffer = gGraphicSystem.GetScreenBuffer();
+        if (pScreenBuffer)
+        {
+            pScreenBuffer->BeginRender();
+
+            if (pScreenBuffer->DoesVisibilityNeedComputing())
+            {
+                pScreenBuffer->ResetVisibilityList();
+                if (gpMainWin->ComputeVisibility())
+                    pScreenBuffer->SetVisibilityComputingFlag(false);   // Only clear the flag if all visibility was computed successfully
+            }
+
+            int64_t nCompositeStartUS = gTimer.GetUSSinceEpoch();
+            pScreenBuffer->RenderVisibleRects();
+            gAnimator.Paint(pScreenBuffer);
+            gInput.Paint(pScreenBuffer);
+            pScreenBuffer->PaintToSystem();
+            nCompositeUS += gTimer.GetUSSinceEpoch() - nCompositeStartUS;
+
+            pScreenBuffer->EndRender();
+            ZRasterStats::Get().EndFrame();
+            nFrame++;
+        }
+
+        if (gbGraphicSystemResetNeeded && gpGraphicSystem->HandleModeChanges(grFullArea))
+            gbGraphicSystemResetNeeded = false;
+
+        gDebug.Flush();
+
+        int64_t nLoopUS = gTimer.GetUSSinceEpoch() - nLoopStartUS;
+        if (nLoopUS < nMinUSBetweenFrames)
+            std::this_thread::sleep_for(std::chrono::microseconds(nMinUSBetweenFrames - nLoopUS));
+    }
+
+    int64_t nTotalUS = gTimer.GetUSSinceEpoch() - nStartUS;
+    if (nFrame > 0)
+        ZOUT("Headless: ", nFrame, " frames in ", nTotalUS, "us. Avg frame:", nTotalUS / nFrame, "us composite:", nCompositeUS / nFrame, "us\n");
+
+    if (!sRasterStatsCSV.empty())
+        ZRasterStats::Get().DumpCSV(sRasterStatsCSV);
+
+    ZFrameworkApp::Shutdown();
+    gDebug.Flush();
+    gLogger.Flush();
+
+    return 0;
+}
@@ -12,11 +12,13 @@
 #include "helpers/FileLogger.h"
 #include "ZInput.h"
 #include "ZTickManager.h"
+#include "ZFrameClock.h"
 #include "ZGraphicSystem.h"
 #include "ZScreenBuffer.h"
 #include "ZTimer.h"
 #include "ZMainWin.h"
 #include "ZAnimator.h"
+#include "ZRasterStats.h"
 
 const char* szAppClass = "ZImageViewer";
 
@@ -47,6 +49,7 @@ bool                    gbWindowSizeChanged = false;
 bool                    gbRenderingEnabled = true;
 HINSTANCE               g_hInst;				// The current instance
 HWND                    ghWnd;
+string                  gsRasterStatsCSV;       // -rasterstats:<file> writes the recent frame stats on exit
 
 LRESULT CALLBACK        WndProc(HWND, UINT, WPARAM, LPARAM);
 
@@ -214,6 +217,7 @@ int main(int argc, char* argv[])
 
             gMessageSystem.Process();
             gTickManager.Tick();
+            gFrameClock.Tick();            // releases windows waiting to paint
 
             if (!gbApplicationExiting)  // have to check again because the state may have changed during the messagesystem process
             {
@@ -263,6 +267,7 @@ int main(int argc, char* argv[])
                     // ZOUT("render took time:%lld us. Rects:%d/%d. Total Frames:%d, avg frame time:%lld us\n", nEndRenderVisible - nStartRenderVisible, nRenderedCount, pScreenBuffer->GetVisibilityCount(), nTotalFrames, (nTotalRenderTime/nTotalFrames));
 
                     pScreenBuffer->EndRender();
+                    ZRasterStats::Get().EndFrame();
                     InvalidateRect(gpGraphicSystem->GetMainHWND(), NULL, false);
                 }
 
@@ -302,6 +307,9 @@ int main(int argc, char* argv[])
     }
 
 
+    if (!gsRasterStatsCSV.empty())
+        ZRasterStats::Get().DumpCSV(gsRasterStatsCSV);
+
     ZFrameworkApp::Shutdown();
 
     gDebug.Flush();
@@ -447,6 +455,7 @@ BOOL WinInitInstance(int argc, char* argv[])
     parser.RegisterParam(CLP::ParamDesc("width", &width, CLP::kNamed));
     parser.RegisterParam(CLP::ParamDesc("height", &height, CLP::kNamed));
     parser.RegisterParam(CLP::ParamDesc("fullscreen", &gGraphicSystem.mbFullScreen, CLP::kNamed));
+    parser.RegisterParam(CLP::ParamDesc("rasterstats", &gsRasterStatsCSV, CLP::kNamed));
     parser.Parse(argc, argv);
     if (parser.GetParamWasFound("width"))
         grWindowedArea.right = grWindowedArea.left + width;
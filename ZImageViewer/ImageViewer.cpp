@@ -24,6 +24,7 @@
 #include "ZScreenBuffer.h"
 #include "ZAnimator.h"
 #include "ZRandom.h"
+#include "ZPixelPool.h"
 
 
 using namespace std;
@@ -371,7 +372,7 @@ bool ImageViewer::HandleMessage(const ZMessage& message)
     }
     else if (sType == "saveimg")
     {
-        if (mpWinImage && mpWinImage->mpImage)
+        if (mpWinImage && mpWinImage->mpImage && FullResolutionShown())
         {
             string sFilename;
             if (ZWinFileDialog::ShowSaveDialog("Images", "*.jpg;*.jpeg;*.png;*.tga;*.bmp;*.hdr", sFilename))
@@ -524,6 +525,9 @@ bool ImageViewer::HandleMessage(const ZMessage& message)
 
     if (mpWinImage && mpWinImage->mpImage)
     {
+        if ((sType == "rotate_left" || sType == "rotate_right" || sType == "flipH" || sType == "flipV") && !FullResolutionShown())
+            return true;
+
         double fOldZoom = mpWinImage->GetZoom();
         if (sType == "rotate_left")
         {
@@ -680,6 +684,9 @@ void ImageViewer::ShowImageSelectionPanel(ZRect rSelection)
 
 void ImageViewer::CopySelection(ZRect rSelection)
 {
+    if (!FullResolutionShown())
+        return;
+
     ZBuffer imageSelection;
     imageSelection.Init(rSelection.Width(), rSelection.Height());
     imageSelection.Blt(mpWinImage->mpImage.get(), rSelection, imageSelection.GetArea(), 0, ZBuffer::kAlphaSource);
@@ -689,6 +696,9 @@ void ImageViewer::CopySelection(ZRect rSelection)
 
 void ImageViewer::SaveSelection(ZRect rSelection)
 {
+    if (!FullResolutionShown())
+        return;
+
     string sFolder;
     gRegistry.Get("ZImageViewer", "selectionsave", sFolder);
 
@@ -1101,7 +1111,7 @@ void ImageViewer::DeleteFile(std::filesystem::path& f)
 
 bool ImageViewer::SaveImage(const std::filesystem::path& filename)
 {
-    if (filename.empty())
+    if (filename.empty() || !FullResolutionShown())
         return false;
 
     return mpWinImage->mpImage.get()->SaveBuffer(filename.string());
@@ -1738,7 +1748,7 @@ void ImageViewer::FlushLoads()
 
 
 
-void ImageViewer::LoadImageProc(std::filesystem::path& imagePath, shared_ptr<ImageEntry> pEntry)
+void ImageViewer::LoadImageProc(std::filesystem::path& imagePath, shared_ptr<ImageEntry> pEntry, int64_t nMinWidth, int64_t nMinHeight, std::recursive_mutex* pArrayMutex)
 {
     if (!pEntry)
         return;
@@ -1750,7 +1760,7 @@ void ImageViewer::LoadImageProc(std::filesystem::path& imagePath, shared_ptr<Ima
     if (imagePath.extension() == ".svg")
         pNewImage->Init(100, 100);
 
-    if (!pNewImage->LoadBuffer(imagePath.string()))
+    if (!pNewImage->LoadBuffer(imagePath.string(), nMinWidth, nMinHeight))
     {
         pNewImage->Init(1920, 1080);
         string sError;
@@ -1766,6 +1776,8 @@ void ImageViewer::LoadImageProc(std::filesystem::path& imagePath, shared_ptr<Ima
 //        return nullptr;
     }
 
+    const std::lock_guard<std::recursive_mutex> lock(*pArrayMutex);
+    pEntry->mbReduced = pNewImage->mnLoadReduction > 1;
     pEntry->pImage = pNewImage;
     pEntry->mState = ImageEntry::kLoaded;
 }
@@ -1779,6 +1791,20 @@ tZBufferPtr ImageViewer::GetCurImage()
     return mImageArray[mViewingIndex.absoluteIndex]->pImage;
 }
 
+bool ImageViewer::FullResolutionShown()
+{
+    if (!mpWinImage || !mpWinImage->mpImage)
+        return false;
+
+    if (mpWinImage->mpImage->mnLoadReduction > 1)
+    {
+        ShowTooltipMessage("Loading full resolution", 0x88888800);
+        return false;
+    }
+
+    return true;
+}
+
 int64_t ImageViewer::CurMemoryUsage()
 {
     const std::lock_guard<std::recursive_mutex> lock(mImageArrayMutex);
@@ -1921,6 +1947,9 @@ bool ImageViewer::FreeCacheMemory()
         }
     }
 
+    // unloaded pixels stay pooled for upcoming loads, but only as much as fits in what's left of the budget
+    ZPixelPool::Trim((size_t)std::max<int64_t>(mMaxMemoryUsage - CurMemoryUsage(), 0));
+
     return true;
 }
 
@@ -1951,7 +1980,13 @@ bool ImageViewer::KickCaching()
     if (entry && entry->mState < ImageEntry::kLoadInProgress)
     {
         entry->mState = ImageEntry::kLoadInProgress;
-        mpImageLoaderPool->enqueue(&ImageViewer::LoadImageProc, entry->filename, entry);
+        mpImageLoaderPool->enqueue(&ImageViewer::LoadImageProc, entry->filename, entry, 0, 0, &mImageArrayMutex);
+    }
+    else if (entry && entry->mState == ImageEntry::kLoaded && entry->mbReduced)
+    {
+        // read ahead copy stays on screen, read only, until the full resolution one replaces it
+        entry->mState = ImageEntry::kLoadInProgress;
+        mpImageLoaderPool->enqueue(&ImageViewer::LoadImageProc, entry->filename, entry, 0, 0, &mImageArrayMutex);
     }
 
     if (GetLoadsInProgress() > (int64_t) mpImageLoaderPool->size())
@@ -1971,7 +2006,16 @@ bool ImageViewer::KickCaching()
         {
 //            ZOUT("caching image ", entry->filename, "\n");
             entry->mState = ImageEntry::kLoadInProgress;
-            mpImageLoaderPool->enqueue(&ImageViewer::LoadImageProc, entry->filename, entry);
+
+            // when fitting to the window, read ahead only needs screen resolution
+            int64_t nMinWidth = 0;
+            int64_t nMinHeight = 0;
+            if (mpWinImage && mpWinImage->GetViewState() == ZWinImage::kFitToWindow)
+            {
+                nMinWidth = grFullArea.Width();
+                nMinHeight = grFullArea.Height();
+            }
+            mpImageLoaderPool->enqueue(&ImageViewer::LoadImageProc, entry->filename, entry, nMinWidth, nMinHeight, &mImageArrayMutex);
         }
     }
     else
@@ -2000,9 +2044,9 @@ bool ImageViewer::AcceptedExtension(std::string sExt)
 
 void ImageViewer::Clear()
 {
-    const std::lock_guard<std::recursive_mutex> lock(mImageArrayMutex);
+    FlushLoads();   // loaders finish under mImageArrayMutex, so join them before taking it
 
-    FlushLoads();
+    const std::lock_guard<std::recursive_mutex> lock(mImageArrayMutex);
     mImageArray.clear();
     mCurrentFolder.clear();
     mRankedArray.clear();
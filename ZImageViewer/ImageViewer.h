@@ -80,6 +80,7 @@ public:
 
     std::filesystem::path   filename;
     tZBufferPtr             pImage;
+    bool                    mbReduced = false;      // pImage was loaded below full resolution for read ahead. Guarded by mImageArrayMutex
 
     // metadata
     easyexif::EXIFInfo      mEXIF;
@@ -149,6 +150,7 @@ protected:
     bool                    ScanForImagesInFolder(std::filesystem::path folder);
 
     tZBufferPtr             GetCurImage(); // null if no image or not loaded
+    bool                    FullResolutionShown();  // false while a reduced read ahead copy is on screen, which must not be edited, saved or copied
 
     int64_t                 CurMemoryUsage();       // only returns the in-memory bytes of buffers that have finished loading
     int64_t                 GetLoadsInProgress();
@@ -173,7 +175,7 @@ protected:
 
 
 
-    static void             LoadImageProc(std::filesystem::path& imagePath, std::shared_ptr<ImageEntry> pEntry);
+    static void             LoadImageProc(std::filesystem::path& imagePath, std::shared_ptr<ImageEntry> pEntry, int64_t nMinWidth, int64_t nMinHeight, std::recursive_mutex* pArrayMutex);    // min size of 0,0 loads full resolution
     static void             LoadMetadataProc(std::filesystem::path& imagePath, std::shared_ptr<ImageEntry> pEntry, std::atomic<int64_t>* pnOutstanding);
 
     void                    FlushLoads();
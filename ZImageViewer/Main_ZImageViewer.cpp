@@ -37,6 +37,7 @@ size_t                  gDebugHistoryCounter = 0;
 
 ZMessageSystem          gMessageSystem;
 ZTickManager            gTickManager;
+ZFrameClock             gFrameClock;
 ZAnimator               gAnimator;
 ZWin*                   gpCaptureWin = nullptr;
 ZWin*                   gpMouseOverWin = nullptr;
@@ -9,6 +9,7 @@
 
 #include "ZMessageSystem.h"
 #include "ZTickManager.h"
+#include "ZFrameClock.h"
 #include "ZRasterizer.h"
 #include "ZPreferences.h"
 #include "ZAnimator.h"
@@ -193,23 +193,30 @@ bool WinTopWinners::Paint()
         if (pMetaList->size() != mThumbRects.size())
             UpdateUI(); // compute thumb rects
 
+        // All thumbnails go out in one batch, the thumbs are held until it's drawn
+        std::vector<tZBufferPtr> thumbs;
+        ZRasterizer::tBatchQuads batch;
+        tUVVertexArray verts;
+
         int64_t rank = 1;
         for (auto& entry : *pMetaList)
         {
             tZBufferPtr pThumb = entry.Thumbnail();
+            gRasterizer.RectToVerts(mThumbRects[rank - 1], verts);
+            batch.emplace_back(pThumb.get(), verts, mpSurface->GetArea());
+            thumbs.push_back(pThumb);
 
-            ZRasterizer rasterizer;
-            tUVVertexArray verts;
-            rasterizer.RectToVerts(mThumbRects[rank - 1], verts);
+            if (rank++ >= mnTopNEntries)
+                break;
+        }
 
-            rasterizer.Rasterize(mpSurface.get(), pThumb.get(), verts);
+        gRasterizer.RasterizeBatch(mpSurface.get(), batch);
 
+        for (rank = 1; rank <= (int64_t)batch.size(); rank++)
+        {
             string sRank;
             Sprintf(sRank, "#%d", rank);
             mStyle.Font()->DrawTextParagraph(mpSurface.get(), sRank, mThumbRects[rank-1], &mStyle);
-
-            if (rank++ >= mnTopNEntries)
-                break;
         }
     }
 